@@ -0,0 +1,42 @@
+/* ============================================================================
+
+   Copyright (C) 2026  The pyhessio contributors
+
+   This file is part of the eventio/hessio library.
+
+   The eventio/hessio library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library. If not, see <http://www.gnu.org/licenses/>.
+
+============================================================================ */
+
+/** @file argsort.h
+ *  @short Index sorting and top-k selection of double type numbers.
+ */
+
+#ifndef ARGSORT_H__LOADED
+
+#define ARGSORT_H__LOADED 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int dargsort (const double *dnum, int nel, int *idx, int descending);
+int dtopk (const double *dnum, int nel, int k, int *idx);
+double dnth_largest (const double *dnum, int nel, int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -27,6 +27,11 @@ double rhofx (double height);
 double thickx (double height);
 double refidx (double height);
 double heighx (double thick);
+void set_atmprof_table (int on);
+void rhofx_n (const double *height, double *rho, int n);
+void thickx_n (const double *height, double *thick, int n);
+void refidx_n (const double *height, double *n_ref, int n);
+void heighx_n (const double *thick, double *height, int n);
 
 #ifdef __cplusplus
 }
@@ -87,6 +87,23 @@ struct basic_ntuple
 
 int list_ntuple(FILE *f, const struct basic_ntuple *b, int wtr);
 
+/** An open binary, column-chunked n-tuple file (see basic_ntuple.c). */
+struct ntuple_file;
+
+struct ntuple_file *open_ntuple_output (const char *fname, int compress, int wtr);
+int write_ntuple (struct ntuple_file *nf, const struct basic_ntuple *b);
+int close_ntuple (struct ntuple_file *nf);
+struct ntuple_file *open_ntuple_input (const char *fname);
+size_t ntuple_rows (const struct ntuple_file *nf);
+int ntuple_with_true (const struct ntuple_file *nf);
+int ntuple_column (const char *name);
+const char *ntuple_column_name (int icol);
+long read_ntuple_column (struct ntuple_file *nf, int icol, 
+   double *values, size_t max_values);
+long read_ntuple_chunk (struct ntuple_file *nf, size_t ic, 
+   struct basic_ntuple *rows);
+long ntuple_to_text (struct ntuple_file *nf, FILE *f);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
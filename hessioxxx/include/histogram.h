@@ -165,11 +165,25 @@ struct histogram
                                  /**< Extension for weighted histos  */
 #ifdef _REENTRANT
    pthread_mutex_t mlock_this;   /**< Mutex for locking concurrent access */
+   int is_shadow;                /**< Thread-private copy, filled without locking */
 #endif
 };
 
 typedef struct histogram HISTOGRAM;
 
+/** A set of histograms kept outside of the global list, sorted by ident. */
+
+struct histogram_set
+{
+   HISTOGRAM **histo;            /**< Vector of histogram pointers   */
+   size_t num;                   /**< Number of histograms in set    */
+   size_t max;                   /**< Allocated size of vector       */
+   int replace;                  /**< Readers replace histograms of the same
+                                      ident instead of adding them up */
+};
+
+typedef struct histogram_set HISTOGRAM_SET;
+
 /** Statistics element for histogram analysis */
 
 struct histstat
@@ -215,6 +229,19 @@ struct moments
 
 typedef struct moments MOMENTS;
 
+/** Multiply-add, using a fused instruction where the hardware has one. */
+#ifdef FP_FAST_FMA
+# define MOMENTS_FMA(a,b,c) fma((a),(b),(c))
+#else
+# define MOMENTS_FMA(a,b,c) ((a)*(b)+(c))
+#endif
+/** The same for single precision operands. */
+#ifdef FP_FAST_FMAF
+# define MOMENTS_FMAF(a,b,c) fmaf((a),(b),(c))
+#else
+# define MOMENTS_FMAF(a,b,c) ((a)*(b)+(c))
+#endif
+
 /* ----- Functions in histogram.c ----- */
 
 void histogram_lock (HISTOGRAM *histo);
@@ -231,6 +258,8 @@ HISTOGRAM *book_1d_histogram (long id, const char *title, const char *type,
    double low, double high, int nbins);
 HISTOGRAM *allocate_histogram (const char *type, int dimension,
    double *low, double *high, int *nbins);
+HISTOGRAM *alloc_histogram_detached (const char *type, int dimension,
+   double *low, double *high, int *nbins);
 HISTOGRAM *alloc_int_histogram (long low,
       long high, int nbins);
 HISTOGRAM *alloc_real_histogram (double low,
@@ -246,6 +275,7 @@ void clear_histogram (HISTOGRAM *histo);
 void free_histogram (HISTOGRAM *histo);
 void free_all_histograms (void);
 void unlink_histogram (HISTOGRAM *histo);
+void link_histogram (HISTOGRAM *histo);
 int fill_int_histogram (HISTOGRAM *histo, long value);
 int fill_real_histogram (HISTOGRAM *histo, double value);
 int fill_weighted_histogram (HISTOGRAM *histo, double value,
@@ -256,6 +286,11 @@ int fill_2d_real_histogram (HISTOGRAM *histo, double xvalue,
       double yvalue);
 int fill_2d_weighted_histogram (HISTOGRAM *histo, double xvalue,
       double yvalue, double weight);
+int fill_real_histogram_n (HISTOGRAM *histo, const double *x, size_t n);
+int fill_weighted_histogram_n (HISTOGRAM *histo, const double *x,
+      const double *w, size_t n);
+int fill_2d_weighted_histogram_n (HISTOGRAM *histo, const double *x,
+      const double *y, const double *w, size_t n);
 int fill_histogram (HISTOGRAM *histo, double xvalue,
       double yvalue, double weight);
 int fill_histogram_by_ident (long id, double xvalue,
@@ -265,6 +300,11 @@ double locate_histogram_fraction (HISTOGRAM *histo, double fraction);
 int fast_stat_histogram (HISTOGRAM *histo, struct histstat *stbuf);
 int histogram_matching (HISTOGRAM *histo1, HISTOGRAM *histo2);
 HISTOGRAM *add_histogram (HISTOGRAM *histo1, HISTOGRAM *histo2);
+HISTOGRAM *find_in_histogram_set (const HISTOGRAM_SET *hset, long ident);
+int add_to_histogram_set (HISTOGRAM_SET *hset, HISTOGRAM *histo, int add_flag);
+int merge_histogram_sets (HISTOGRAM_SET *to, HISTOGRAM_SET *from);
+void free_histogram_set (HISTOGRAM_SET *hset);
+int link_histogram_set (HISTOGRAM_SET *hset, int add_flag);
 void print_histogram (HISTOGRAM *histo);
 void display_histogram (HISTOGRAM *histo);
 void display_all_histograms (void);
@@ -274,6 +314,9 @@ double lookup_real (HISTOGRAM *lookup, double value, double factor);
 int histogram_hashing (int tabsize);
 void sort_histograms (void);
 void release_histogram (HISTOGRAM *histo);
+int histogram_shadowing (int on);
+HISTOGRAM *get_shadow_histogram (HISTOGRAM *histo);
+int merge_shadow_histograms (void);
 
 /* ---- Functions in moments.c ---- */
 
@@ -288,6 +331,10 @@ void fill_real_mean (MOMENTS *mom, double value, double weight);
 void fill_real_mean_and_sigma (MOMENTS *mom, double value, 
      double weight);
 int stat_moments (MOMENTS *mom, struct momstat *stmom);
+void sum_weighted_powers (const double *x, const double *w, size_t n,
+     double *s);
+void fill_real_moments_n (MOMENTS *mom, const double *value,
+     const double *weight, size_t n);
 
 /* ---- Functions in io_histogram.c (optional) ---- */
 
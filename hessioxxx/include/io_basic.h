@@ -81,6 +81,8 @@ struct _struct_IO_ITEM_HEADER
 };
 typedef struct _struct_IO_ITEM_HEADER IO_ITEM_HEADER;
 
+struct _struct_IO_ASYNC; /* Only used internally in eventio.c */
+
 /** The IO_BUFFER structure contains all data needed the manage the stuff. */
 
 struct _struct_IO_BUFFER
@@ -118,6 +120,7 @@ struct _struct_IO_BUFFER
    int extended;      /**< Set to 1 if you want to use the extension field always. */
    int sync_err_count;/**< Count of synchronization errors. */
    int sync_err_max;  /**< Maximum accepted number of synchronisation errors. */
+   struct _struct_IO_ASYNC *async; /**< Writer thread state, see set_async_output(). */
 };
 typedef struct _struct_IO_BUFFER IO_BUFFER;
 typedef int (*IO_USER_FUNCTION) (unsigned char *, long, int);
@@ -297,6 +300,8 @@ int list_sub_items (IO_BUFFER *iobuf, IO_ITEM_HEADER *item_header,
 /* File I/O: */
 int reset_io_block (IO_BUFFER *iobuf);
 int write_io_block (IO_BUFFER *iobuf);
+int set_async_output (IO_BUFFER *iobuf, int nbuf, size_t max_bytes);
+int flush_async_output (IO_BUFFER *iobuf);
 int find_io_block (IO_BUFFER *iobuf, IO_ITEM_HEADER *item_header);
 int read_io_block (IO_BUFFER *iobuf, IO_ITEM_HEADER *item_header);
 int skip_io_block (IO_BUFFER *iobuf, IO_ITEM_HEADER *item_header);
@@ -412,6 +412,9 @@ extern "C" {
 #ifndef H_MAX_DRAWERS
 # define H_MAX_DRAWERS    60   /**< Maximum number of drawers. */
 #endif
+#ifndef H_MAX_TEL_IDX_REF
+# define H_MAX_TEL_IDX_REF 17  /**< Number of telescope ID lookup tables, see set_tel_idx_ref(). */
+#endif
 #if defined(CTA_PROD1) || defined(SAVE_MEMORY)
 # ifndef H_SAVE_MEMORY
 #  define H_SAVE_MEMORY 1
@@ -792,6 +795,12 @@ struct hess_tel_event_adc_struct
    int list_known;     ///< Was list of significant pixels filled in?
    int list_size;      ///< Size of the list of available pixels (with list mode).
    int adc_list[H_MAX_PIX];  ///< List of available pixels (with list mode).
+   int sparse;         ///< If non-zero, only the pixels listed in sig_list get reset and need to be looked at.
+   int num_sig;        ///< Number of pixels in sig_list.
+   int sig_list[H_MAX_PIX];  ///< Pixels with any data filled in by the readers, in ascending order.
+   int num_smp;        ///< Number of pixels in smp_list.
+   int smp_samples;    ///< Number of samples filled in for pixels in smp_list.
+   int smp_list[H_MAX_PIX];  ///< Pixels with samples filled in by the reader (also from earlier events).
    uint8_t significant[H_MAX_PIX];  ///< Was amplitude large enough to record it? Bit 0: sum, 1: samples.
    uint8_t adc_known[H_MAX_GAINS][H_MAX_PIX]; ///< Was individual channel recorded? Bit 0: sum, 1: samples, 2: ADC was in saturation.
    uint32_t adc_sum[H_MAX_GAINS][H_MAX_PIX];  ///< Sum of ADC values.
@@ -799,6 +808,11 @@ struct hess_tel_event_adc_struct
 };
 typedef struct hess_tel_event_adc_struct AdcData;
 
+/** Number of pixels to loop over in AdcData: all or, in sparse mode, only the listed ones. */
+#define ADC_PIX_LOOP_SIZE(raw) ((raw)->sparse ? (raw)->num_sig : (raw)->num_pixels)
+/** Pixel ID for index j (0 <= j < ADC_PIX_LOOP_SIZE(raw)) of such a loop. */
+#define ADC_PIX_LOOP_ID(raw,j) ((raw)->sparse ? (raw)->sig_list[j] : (j))
+
 /* Auxilliary digital trace (derived from FADC samples) */
 
 struct hess_aux_digital_trace
@@ -829,6 +843,7 @@ typedef struct hess_aux_analog_trace AuxTraceA;
 
 #define MAX_AUX_TRACE_D 1   /**< Only one auxilliary digital trace */
 #define MAX_AUX_TRACE_A 4   /**< Up to four auxilliary analog traces */
+#define H_MAX_LAZY_ITEMS 8  /**< Sub-items per telescope event kept for decoding on demand */
  
 /** In addition to ADC we may (optionally) also have timing data. */
 
@@ -986,6 +1001,15 @@ struct hess_tel_event_data_struct
    PixelTrgTime pixeltrg_time; ///< Times when individual pixels fired.
    AuxTraceD aux_trace_d[MAX_AUX_TRACE_D]; ///< Optional auxilliary digital traces.
    AuxTraceA aux_trace_a[MAX_AUX_TRACE_A]; ///< Optional auxilliary analog traces.
+   int lazy;               ///< ADC, timing and image data only decoded on access (see hess_tel_raw).
+   int num_lazy;           ///< Number of sub-items not decoded yet.
+   int lazy_type[H_MAX_LAZY_ITEMS];    ///< Item types of these sub-items.
+   long lazy_offset[H_MAX_LAZY_ITEMS]; ///< Their offsets in the I/O buffer.
+   int lazy_what;          ///< The 'what' flags for decoding them.
+   int lazy_level;         ///< Item level of the telescope event item.
+   long lazy_item_offset;  ///< Where the data of the telescope event item starts in the I/O buffer.
+   long lazy_item_length;  ///< The length of that item.
+   IO_BUFFER *lazy_iobuf;  ///< Buffer holding them, only valid until the next block is read.
 };
 typedef struct hess_tel_event_data_struct TelEvent;
 
@@ -1422,6 +1446,9 @@ int print_hess_teladc_sums(IO_BUFFER *iobuf);
 int write_hess_teladc_samples(IO_BUFFER *iobuf, AdcData *raw);
 int read_hess_teladc_samples(IO_BUFFER *iobuf, AdcData *raw, int what);
 int print_hess_teladc_samples(IO_BUFFER *iobuf);
+void set_adc_sparse_mode(AdcData *raw, int sparse);
+void set_hess_verify_reset(int verify);
+void set_hess_fast_samples(int fast);
 
 int write_hess_aux_trace_digital(IO_BUFFER *iobuf, AuxTraceD *auxd);
 int read_hess_aux_trace_digital(IO_BUFFER *iobuf, AuxTraceD *auxd);
@@ -1457,7 +1484,19 @@ int print_hess_shower(IO_BUFFER *iobuf);
 
 int write_hess_event(IO_BUFFER *iobuf, FullEvent *ev, int what);
 int read_hess_event(IO_BUFFER *iobuf, FullEvent *ev, int what);
+void set_hess_lazy_decode(FullEvent *ev, int lazy);
+int hess_televent_decode(TelEvent *te, int what);
+AdcData *hess_tel_raw(FullEvent *ev, int itel);
+PixelTiming *hess_tel_pixtm(FullEvent *ev, int itel);
+ImgData *hess_tel_img(FullEvent *ev, int itel);
 int print_hess_event(IO_BUFFER *iobuf);
+int copy_hess_tel_item_remapped (IO_BUFFER *iobuf, IO_BUFFER *iobuf2, int tel_id);
+int init_hess_pass_through (void);
+void reset_hess_pass_through (void);
+int read_hess_event_pass_through (IO_BUFFER *iobuf, FullEvent *evi, 
+   int (*out_tel_id) (int tel_id, int ifile), int ifile,
+   int *tel_list, int *ntel_list);
+int write_hess_event_pass_through (IO_BUFFER *iobuf, FullEvent *ev, long ident);
 
 int write_hess_calib_event (IO_BUFFER *iobuf, FullEvent *ev, int what, int type);
 int read_hess_calib_event (IO_BUFFER *iobuf, FullEvent *ev, int what, int *ptype);
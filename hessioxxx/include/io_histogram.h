@@ -44,8 +44,16 @@ int read_histograms (HISTOGRAM **phisto, int nhisto, IO_BUFFER *iobuf);
 int read_histograms_x (HISTOGRAM **phisto, int nhisto, const long *xcld_ids, int nxcld, IO_BUFFER *iobuf);
 int print_histograms (IO_BUFFER *iobuf);
 int write_all_histograms (const char *fname);
+int write_histogram_set (const char *fname, const HISTOGRAM_SET *hset);
 int read_histogram_file (const char *fname, int add_flag);
 int read_histogram_file_x (const char *fname, int add_flag, const long *xcld_ids, int nxcld);
+int read_histograms_to_set (HISTOGRAM_SET *hset, const long *ids, int nids,
+   int *found, IO_BUFFER *iobuf);
+int read_histogram_set_file (const char *fname, HISTOGRAM_SET *hset,
+   const long *ids, int nids, int stop_early);
+int read_histogram_files (const char **fnames, int nfiles,
+   const long *ids, int nids, int stop_early, int nthreads,
+   HISTOGRAM_SET *result);
 
 #ifdef __cplusplus
 }
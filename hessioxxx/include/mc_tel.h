@@ -80,6 +80,60 @@ struct bunch
    float lambda;  /**< Wavelength in nanometers or 0 */
 };
 
+/**
+ *  The same data as in an array of struct bunch but with separate
+ *  arrays for each quantity, as filled by read_tel_photons_soa().
+ *  All arrays are provided by the caller, with the same length.
+ */
+
+struct bunch_arrays
+{
+   float *photons; /**< Number of photons in bunch */
+   float *x, *y;   /**< Arrival position relative to telescope (cm) */
+   float *cx, *cy; /**< Direction cosines of photon direction */
+   float *ctime;   /**< Arrival time (ns) */
+   float *zem;     /**< Height of emission point above sea level (cm) */
+   float *lambda;  /**< Wavelength in nanometers or 0 */
+};
+
+/**
+ *  State of reading the photon bunches of one telescope/detector
+ *  in chunks (see begin_read_tel_photons()).
+ */
+
+struct tel_photons_cursor
+{
+   IO_BUFFER *iobuf;   /**< The buffer being read from, NULL if not active */
+   IO_ITEM_HEADER item_header; /**< Header of the photon bunches item */
+   int array, tel;     /**< Array and telescope number */
+   double photons;     /**< Sum of photons (and fractions) in this device */
+   int nbunches;       /**< Total number of bunches */
+   int next;           /**< Number of bunches already obtained */
+   int compact;        /**< Compact (1) or long (0) format */
+   double check_photons; /**< Sum of photons in bunches obtained so far */
+};
+
+/**
+ *  Photo-electrons of one camera in compressed-sparse-row layout:
+ *  the times (and amplitudes) of pixel i are found at indices
+ *  offset[i] to offset[i+1]-1. Filled by read_photo_electrons_csr(),
+ *  which (re-) allocates the vectors as needed. Zero-initialize
+ *  before first use and release with free_photo_electrons_csr().
+ */
+
+struct photo_electrons_csr
+{
+   int array, tel;  /**< Array and telescope number */
+   int npe;         /**< The total number of photo-electrons */
+   int pixels;      /**< Number of pixels in the camera */
+   int flags;       /**< Bit 0: with amplitudes, bit 1: includes NSB */
+   int *offset;     /**< Start index for each pixel (pixels+1 elements) */
+   float *t;        /**< Arrival times [ns] of all photo-electrons */
+   float *a;        /**< Amplitudes [mean p.e.] or NULL if not available */
+   int max_pixels;  /**< Allocated size of 'offset' (minus one) */
+   int max_npe;     /**< Allocated size of 't' and 'a' */
+};
+
 /**
  *  The compact_bunch struct is equivalent to the bunch struct
  *  except that we try to use less memory.
@@ -223,6 +277,14 @@ int write_tel_compact_photons (IO_BUFFER *iobuf, int array, int tel,
       int ext_bunches, char *ext_fname);
 int read_tel_photons (IO_BUFFER *iobuf, int max_bunches, int *array,
       int *tel, double *photons, struct bunch *bunches, int *nbunches);
+int read_tel_photons_soa (IO_BUFFER *iobuf, int max_bunches, int *array,
+      int *tel, double *photons, struct bunch_arrays *ba, int *nbunches);
+int begin_read_tel_photons (IO_BUFFER *iobuf, struct tel_photons_cursor *cur);
+int read_tel_photons_chunk (struct tel_photons_cursor *cur, 
+      struct bunch *bunches, int max_bunches);
+int read_tel_photons_chunk_soa (struct tel_photons_cursor *cur, 
+      struct bunch_arrays *ba, int max_bunches);
+int end_read_tel_photons (struct tel_photons_cursor *cur);
 int print_tel_photons (IO_BUFFER *iobuf);
 
 int write_shower_longitudinal (IO_BUFFER *iobuf, int event, int type, 
@@ -243,6 +305,9 @@ int write_photo_electrons (IO_BUFFER *iobuf, int array, int tel,
 int read_photo_electrons (IO_BUFFER *iobuf, int max_pixel,
       int max_pe, int *array, int *tel, int *npe, int *pixels, int *flags, 
       int *pe_counts, int *tstart, double *t, double *a, int *photon_counts);
+int read_photo_electrons_csr (IO_BUFFER *iobuf, 
+      struct photo_electrons_csr *pe, int *pix_pe, int max_pix_pe);
+void free_photo_electrons_csr (struct photo_electrons_csr *pe);
 int print_photo_electrons (IO_BUFFER *iobuf);
 
 int write_shower_extra_parameters (IO_BUFFER *iobuf,
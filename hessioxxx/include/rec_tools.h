@@ -34,6 +34,10 @@ void cam_to_ref(double ximg, double yimg, double phi,
    double ref_azimuth, double ref_altitude, double cam_rot, 
    double azimuth, double altitude, double focal_length, 
    double *axref, double *ayref, double *phiref);
+void cam_to_ref_n(int n, const double *ximg, const double *yimg, 
+   const double *phi, double ref_azimuth, double ref_altitude, 
+   const double *cam_rot, const double *azimuth, const double *altitude,
+   const double *focal_length, double *axref, double *ayref, double *phiref);
 int intersect_lines(double xp1, double yp1, double phi1, 
    double xp2, double yp2, double phi2, double *xs, double *ys, double *sang);
 int shower_geometric_reconstruction(int ntel, const double *amp, 
@@ -40,6 +40,8 @@ double calibrate_pixel_amplitude(AllHessData *hsdata, int itel,
 double calibrate_pixel_sample_amplitude(AllHessData *hsdata, int itel, 
    int ipix, int flag_amp_tm, int itime, double clip_sample_amp);
 void set_reco_verbosity(int v);
+void image_moments_soa(const double *x, const double *y, const double *a,
+   int n, double x0, double y0, double *s);
 int set_disabled_pixels(AllHessData *hsdata, int itel, double broken_pixels_fraction);
 
 #ifdef __cplusplus
@@ -0,0 +1,69 @@
+/* ============================================================================
+
+Copyright (C) 2026  The pyhessio contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+============================================================================ */
+
+/** @file stage_timing.h
+ *  @short Optional timing of processing stages and data block types.
+ */
+
+#ifndef STAGE_TIMING_HEADER
+#define STAGE_TIMING_HEADER 1
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Processing stages timed separately. They do not nest. */
+enum stage_timing_stage
+{
+   STAGE_INPUT = 0,   /**< Finding and reading data blocks (incl. waiting for decompression). */
+   STAGE_DECODE,      /**< Decoding event data (read_hess_event). */
+   STAGE_INTEGRATION, /**< Pixel signal integration from samples. */
+   STAGE_CALIBRATION, /**< Calibrating pixel amplitudes. */
+   STAGE_CLEANING,    /**< Image cleaning, incl. raw data cleaning for DST output. */
+   STAGE_IMAGE,       /**< Image (Hillas) parameters and pixel timing analysis. */
+   STAGE_SHOWER,      /**< Shower (stereo) reconstruction. */
+   STAGE_USER_ANA,    /**< User analysis, incl. histogram filling. */
+   STAGE_OUTPUT,      /**< Writing DST output. */
+   STAGE_NUM_STAGES
+};
+
+extern int stage_timing_enabled;
+
+void stage_timing_begin_(int stage);
+void stage_timing_end_(int stage);
+
+/** Start timing of a stage, if timing is enabled at all. */
+#define stage_timing_begin(s) do { if ( stage_timing_enabled ) stage_timing_begin_(s); } while (0)
+/** Stop timing of a stage, if timing is enabled at all. */
+#define stage_timing_end(s) do { if ( stage_timing_enabled ) stage_timing_end_(s); } while (0)
+
+void stage_timing_enable(int on);
+void stage_timing_block(unsigned long type, size_t length);
+void stage_timing_block_done(void);
+double stage_timing_total(int stage, unsigned long *calls);
+void stage_timing_summary(FILE *f);
+int stage_timing_json(const char *fname);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,13 +21,24 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *  @short Utility program for adding up matching histograms.
  *
 @verbatim
-Syntax:  add_histograms [ -x id1,...] input_files ... -o output_file
+Syntax:  add_histograms [ -j nthreads ] [ -x id1,...] input_files ... -o output_file
 @endverbatim
  *  The histograms may be within multiple I/O blocks of the
  *  input file. Matching histograms will be added up, unless
  *  set to be excluded with the '-x' option.
  *  Only non-empty histograms are written to output.
  *
+ *  The input files are read by several threads (if compiled with
+ *  _REENTRANT), each adding up into its own set of histograms,
+ *  and the sets are merged pairwise at the end. Memory needs thus
+ *  scale with the number of distinct histograms (times the number
+ *  of threads) but not with the number of files. Other data blocks
+ *  in the input files are skipped without being read.
+ *  Unlike with sequential reading in earlier versions, an input file
+ *  which cannot be read does not end the reading of the remaining
+ *  files: all readable files are added up and the number of files
+ *  which could not be read is reported.
+ *
  *  @author Konrad Bernloehr
  *  @date    @verbatim CVS $Date: 2014/06/24 14:29:40 $ @endverbatim
  *  @version @verbatim CVS $Revision: 1.2 $ @endverbatim
@@ -47,22 +58,78 @@ void syntax(const char *prgm);
 
 void syntax(const char *prgm)
 {
-   fprintf(stderr,"Syntax: %s [-V | -VV ] [ -x id1,... ] input_files ... -o output_file\n",
+   fprintf(stderr,"Syntax: %s [-V | -VV ] [ -j nthreads ] [ -x id1,... ] input_files ... -o output_file\n",
             prgm);
    fprintf(stderr,"The '-V'/'-VV' results in more verbose screen output.\n");
+   fprintf(stderr,"The '-j' option sets the number of threads reading input files\n"
+                  "(default: number of CPUs).\n");
    fprintf(stderr,"The '-x' option excludes histograms from being added up.\n");
    exit(1);
 }
 
+static void replace_excluded (const char **fnames, int nfiles,
+   const long *xcld_ids, int nxcld, HISTOGRAM_SET *hset);
+
+/** Excluded histograms were added up like all others when reading
+    in parallel. Replace them by their last instance in file order,
+    as reading the files one after the other would have done. */
+
+static void replace_excluded (const char **fnames, int nfiles,
+   const long *xcld_ids, int nxcld, HISTOGRAM_SET *hset)
+{
+   HISTOGRAM_SET xset;
+   long *todo;
+   int ntodo = 0, ifile, i;
+   size_t j;
+
+   if ( (todo = (long *) malloc((size_t)nxcld*sizeof(long))) == NULL )
+   {
+      fprintf(stderr,"Allocation failed.\n");
+      exit(1);
+   }
+   /* IDs not seen in any file need not be searched for. */
+   for ( i=0; i<nxcld; i++ )
+      if ( find_in_histogram_set(hset,xcld_ids[i]) != NULL )
+         todo[ntodo++] = xcld_ids[i];
+   memset(&xset,0,sizeof(xset));
+   xset.replace = 1; /* Last instance within a file, as well */
+
+   /* Mostly, the last file has all of them. */
+   for ( ifile=nfiles-1; ifile>=0 && ntodo>0; ifile-- )
+   {
+      if ( read_histogram_set_file(fnames[ifile],&xset,todo,ntodo,0) <= 0 )
+         continue;
+      for ( j=0; j<xset.num; j++ )
+      {
+         for ( i=0; i<ntodo; i++ )
+            if ( todo[i] == xset.histo[j]->ident )
+               todo[i] = todo[--ntodo];
+         (void) add_to_histogram_set(hset,xset.histo[j],0);
+      }
+      xset.num = 0;
+   }
+
+   free_histogram_set(&xset);
+   free(todo);
+}
+
 /** Main program. */
 
 int main (int argc, char **argv)
 {
    char *ofname = NULL, *prgm = argv[0];
    int verbose = 0;
-   int iarg;
+   int iarg, nerr;
    long *xcld_ids = NULL;
    int nxcld = 0;
+   int nthreads = 1;
+   HISTOGRAM_SET hset;
+   size_t ihisto;
+
+#if defined(_REENTRANT) && defined(_SC_NPROCESSORS_ONLN)
+   if ( (nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN)) < 1 )
+      nthreads = 1;
+#endif
 
    while ( argc >= 2 )
    {
@@ -82,6 +149,13 @@ int main (int argc, char **argv)
       {
          syntax(prgm);
       }
+      else if ( (strcmp(argv[1],"-j") == 0 || strcmp(argv[1],"--threads") == 0) && argc >= 3 )
+      {
+         if ( (nthreads = atoi(argv[2])) < 1 )
+            nthreads = 1;
+         argc -= 2;
+         argv += 2;
+      }
       else if ( strcmp(argv[1],"-x") == 0 && argc >= 3 )
       {
          int ipos = 0;
@@ -91,7 +165,7 @@ int main (int argc, char **argv)
          {
             if ( ( xi = atol(word)) > 0 )
             {
-               size_t m = (size_t) (nxcld+1) * sizeof(int);
+               size_t m = (size_t) (nxcld+1) * sizeof(long);
                if ( xcld_ids == NULL )
                   xcld_ids = (long *) malloc(m);
                else
@@ -136,12 +210,17 @@ int main (int argc, char **argv)
    {
       if ( argv[iarg][0] == '-' )
          syntax(prgm);
-      if ( read_histogram_file_x(argv[iarg],1,xcld_ids,nxcld) < 0 )
-         break;
    }
 
-   sort_histograms();
-   if ( get_first_histogram() == 0 )
+   memset(&hset,0,sizeof(hset));
+   nerr = read_histogram_files((const char **) argv+1,argc-1,NULL,0,0,
+             nthreads,&hset);
+   if ( nerr > 0 )
+      fprintf(stderr,"%d of %d input files could not be read.\n", nerr, argc-1);
+   if ( nxcld > 0 && hset.num > 0 )
+      replace_excluded((const char **) argv+1,argc-1,xcld_ids,nxcld,&hset);
+
+   if ( hset.num == 0 )
    {
       fprintf(stderr,"No histograms available for conversion.\n");
       exit(1);
@@ -149,9 +228,9 @@ int main (int argc, char **argv)
 
    if ( verbose )
    {
-      HISTOGRAM *h = get_first_histogram();
-      while ( h != NULL )
+      for ( ihisto=0; ihisto<hset.num; ihisto++ )
       {
+         HISTOGRAM *h = hset.histo[ihisto];
          printf("Histogram of type %c, ID=%ld, title=\"%s\" is %cD: ",
             h->type, h->ident, (h->title!=NULL)?h->title:"(none)",
             (h->nbins_2d > 0) ? '2' : '1');
@@ -160,14 +239,17 @@ int main (int argc, char **argv)
          else
             printf("%d bins",h->nbins);
          printf(", %ld entries.\n",h->entries);
-         h = h->next;
       }
 
       if ( verbose >= 2 )
-         display_all_histograms(); 
+         for ( ihisto=0; ihisto<hset.num; ihisto++ )
+            display_histogram(hset.histo[ihisto]);
    }
    
-   write_all_histograms(ofname);
+   write_histogram_set(ofname,&hset);
+   free_histogram_set(&hset);
+   if ( xcld_ids != NULL )
+      free(xcld_ids);
    return(0);
 }
 
@@ -0,0 +1,381 @@
+/* ============================================================================
+
+   Copyright (C) 2026  The pyhessio contributors
+
+   This file is part of the eventio/hessio library.
+
+   The eventio/hessio library is free software; you can redistribute it and/or
+   modify it under the terms of the GNU Lesser General Public
+   License as published by the Free Software Foundation; either
+   version 2.1 of the License, or (at your option) any later version.
+
+   This library is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with this library. If not, see <http://www.gnu.org/licenses/>.
+
+============================================================================ */
+
+/** @file argsort.c
+ *  @short Index sorting and top-k selection of double type numbers.
+ *
+ *  Unlike dhsort(), which sorts the values themselves, the functions
+ *  here return the order of the values as a vector of indices
+ *  ('argsort'), as needed for sorting pixels by their amplitude.
+ *
+ *  Each value is turned into a 64-bit unsigned integer key with the
+ *  same ordering (IEEE-754 bits with the sign bit flipped for positive
+ *  and all bits flipped for negative numbers). Larger inputs are then
+ *  sorted by a least-significant-digit radix sort on 8-bit digits,
+ *  skipping digits which are the same for all keys (like the sign
+ *  and most exponent bits of typical amplitudes). Small inputs use
+ *  an insertion sort. Selection of the k largest values is done by
+ *  quickselect with median-of-three pivots, falling back to sorting
+ *  when the partitioning does not make progress.
+ *
+ *  Values are ordered like with the '<' operator, except that any NaN
+ *  ends up at one end of the list. Equal values keep the order
+ *  of their indices, i.e. all results are fully deterministic.
+ */
+/* ================================================================ */
+
+#include "initial.h"
+#include "argsort.h"
+
+/** A sort key together with the index of the value it came from. */
+struct sort_item
+{
+   uint64_t key;
+   int idx;
+};
+
+/** Below this number of values, insertion sort is faster than radix sort. */
+#define ARGSORT_SMALL 40
+
+/** Up to this number of values, the work space lives on the stack. */
+#define ARGSORT_STACK 512
+
+/* -------------------------- dsort_key --------------------------- */
+
+static uint64_t dsort_key (double d, int descending);
+
+/** Unsigned integer key with the same ordering as the double value. */
+
+static uint64_t dsort_key (double d, int descending)
+{
+   union { double d; uint64_t u; } v;
+
+   v.d = (d == 0.) ? 0. : d; /* No difference between -0 and +0 */
+   if ( (v.u >> 63) != 0 )
+      v.u = ~v.u;
+   else
+      v.u |= ((uint64_t) 1) << 63;
+   return descending ? ~v.u : v.u;
+}
+
+/* -------------------------- item_less --------------------------- */
+
+static int item_less (const struct sort_item *a, const struct sort_item *b);
+
+/** Order by key and, for equal keys, by index. */
+
+static int item_less (const struct sort_item *a, const struct sort_item *b)
+{
+   return a->key < b->key || (a->key == b->key && a->idx < b->idx);
+}
+
+/* ----------------------- insertion_sort_items ------------------- */
+
+static void insertion_sort_items (struct sort_item *item, int n);
+
+static void insertion_sort_items (struct sort_item *item, int n)
+{
+   int i, j;
+
+   for ( i=1; i<n; i++ )
+   {
+      struct sort_item t = item[i];
+      for ( j=i; j>0 && item_less(&t,&item[j-1]); j-- )
+         item[j] = item[j-1];
+      item[j] = t;
+   }
+}
+
+/* ------------------------- radix_sort_items --------------------- */
+
+static void radix_sort_items (struct sort_item *item, struct sort_item *tmp,
+   int n, int by_index);
+
+/**
+ *  LSD radix sort of items by key and index, with 8-bit digits.
+ *  Digits equal in all items need no pass. If the items are
+ *  known to be in index order already (by_index=0), the index
+ *  digits are skipped altogether, as the sort is stable.
+ *  The result always ends up in item[], tmp[] is work space.
+ */
+
+static void radix_sort_items (struct sort_item *item, struct sort_item *tmp,
+   int n, int by_index)
+{
+   size_t count[12][256];
+   struct sort_item *src = item, *dst = tmp, *swp;
+   int i, d;
+
+   memset(count,0,sizeof(count));
+   for ( i=0; i<n; i++ )
+   {
+      uint64_t k = item[i].key;
+      for ( d=0; d<8; d++ )
+         count[4+d][(k >> (8*d)) & 0xff]++;
+   }
+   if ( by_index )
+      for ( i=0; i<n; i++ )
+      {
+         unsigned u = (unsigned) item[i].idx;
+         for ( d=0; d<4; d++ )
+            count[d][(u >> (8*d)) & 0xff]++;
+      }
+
+   for ( d=(by_index?0:4); d<12; d++ )
+   {
+      size_t pos[256], sum = 0;
+      int shift = (d < 4) ? 8*d : 8*(d-4), b;
+      for ( b=0; b<256; b++ )
+      {
+         if ( count[d][b] == (size_t) n )
+            break;
+         pos[b] = sum;
+         sum += count[d][b];
+      }
+      if ( b < 256 ) /* All items have the same digit */
+         continue;
+      if ( d < 4 )
+      {
+         for ( i=0; i<n; i++ )
+            dst[pos[((unsigned) src[i].idx >> shift) & 0xff]++] = src[i];
+      }
+      else
+      {
+         for ( i=0; i<n; i++ )
+            dst[pos[(src[i].key >> shift) & 0xff]++] = src[i];
+      }
+      swp = src;
+      src = dst;
+      dst = swp;
+   }
+
+   if ( src != item )
+      memcpy(item,src,(size_t)n*sizeof(struct sort_item));
+}
+
+/* ---------------------------- sort_items ------------------------ */
+
+static void sort_items (struct sort_item *item, struct sort_item *tmp,
+   int n, int by_index);
+
+static void sort_items (struct sort_item *item, struct sort_item *tmp,
+   int n, int by_index)
+{
+   if ( n < ARGSORT_SMALL )
+      insertion_sort_items(item,n);
+   else
+      radix_sort_items(item,tmp,n,by_index);
+}
+
+/* --------------------------- select_items ----------------------- */
+
+static void select_items (struct sort_item *item, struct sort_item *tmp,
+   int n, int k);
+
+/**
+ *  Rearrange the items such that the k smallest ones (by key and
+ *  index) come first, in no particular order, with the k-th smallest
+ *  at position k-1.
+ */
+
+static void select_items (struct sort_item *item, struct sort_item *tmp,
+   int n, int k)
+{
+   int lo = 0, hi = n-1, depth = 0, m;
+
+   for ( m=n; m>1; m/=2 )
+      depth += 2;
+
+   while ( hi > lo )
+   {
+      struct sort_item pivot, t;
+      int i, j, mid;
+
+      if ( hi-lo < ARGSORT_SMALL || depth-- <= 0 )
+      {
+         /* Small enough or degenerate partitioning: just sort. */
+         sort_items(item+lo,tmp,hi-lo+1,1);
+         return;
+      }
+
+      /* Median of three as pivot, also serving as sentinels. */
+      mid = lo + (hi-lo)/2;
+      if ( item_less(&item[mid],&item[lo]) )
+         { t = item[mid]; item[mid] = item[lo]; item[lo] = t; }
+      if ( item_less(&item[hi],&item[lo]) )
+         { t = item[hi]; item[hi] = item[lo]; item[lo] = t; }
+      if ( item_less(&item[hi],&item[mid]) )
+         { t = item[hi]; item[hi] = item[mid]; item[mid] = t; }
+      pivot = item[mid];
+
+      /* Hoare partition; all items are distinct by (key,index). */
+      i = lo;
+      j = hi;
+      for (;;)
+      {
+         while ( item_less(&item[i],&pivot) )
+            i++;
+         while ( item_less(&pivot,&item[j]) )
+            j--;
+         if ( i >= j )
+            break;
+         t = item[i];
+         item[i] = item[j];
+         item[j] = t;
+         i++;
+         j--;
+      }
+      /* Now item[lo..j] <= pivot <= item[j+1..hi] */
+      if ( k-1 <= j )
+         hi = j;
+      else
+         lo = j+1;
+   }
+}
+
+/* ---------------------------- dargsort -------------------------- */
+/**
+ *  @short Sort the indices of double type values by value.
+ *
+ *  Equal values keep the order of their indices (stable sort).
+ *
+ *  @param dnum  The values (not modified).
+ *  @param nel   The number of values.
+ *  @param idx   Filled with the indices 0 to nel-1 in the order
+ *               of ascending or descending values.
+ *  @param descending  Sort in descending order if non-zero.
+ *
+ *  @return 0 (o.k.), -1 (not enough memory)
+ */
+
+int dargsort (const double *dnum, int nel, int *idx, int descending)
+{
+   struct sort_item sitem[2*ARGSORT_STACK], *item = sitem;
+   int i;
+
+   if ( nel <= 0 || dnum == NULL || idx == NULL )
+      return 0;
+   if ( nel > ARGSORT_STACK &&
+        (item = (struct sort_item *) malloc(2*(size_t)nel*sizeof(struct sort_item))) == NULL )
+      return -1;
+
+   for ( i=0; i<nel; i++ )
+   {
+      item[i].key = dsort_key(dnum[i],descending);
+      item[i].idx = i;
+   }
+   sort_items(item,item+nel,nel,0);
+   for ( i=0; i<nel; i++ )
+      idx[i] = item[i].idx;
+
+   if ( item != sitem )
+      free(item);
+   return 0;
+}
+
+/* ----------------------------- dtopk ---------------------------- */
+/**
+ *  @short Find the indices of the k largest of a number of double values.
+ *
+ *  Only the k largest values get sorted, which is much faster
+ *  than sorting all of them if k is small. Of equal values, those
+ *  with lower index come first, exactly as with dargsort().
+ *
+ *  @param dnum  The values (not modified).
+ *  @param nel   The number of values.
+ *  @param k     The number of largest values wanted.
+ *  @param idx   Filled with the indices of the k largest values,
+ *               in the order of descending values.
+ *
+ *  @return The number of indices filled in (k, or nel if less),
+ *          or -1 (not enough memory).
+ */
+
+int dtopk (const double *dnum, int nel, int k, int *idx)
+{
+   struct sort_item sitem[2*ARGSORT_STACK], *item = sitem;
+   int i;
+
+   if ( k > nel )
+      k = nel;
+   if ( k <= 0 || dnum == NULL || idx == NULL )
+      return 0;
+   if ( nel > ARGSORT_STACK &&
+        (item = (struct sort_item *) malloc(2*(size_t)nel*sizeof(struct sort_item))) == NULL )
+      return -1;
+
+   for ( i=0; i<nel; i++ )
+   {
+      item[i].key = dsort_key(dnum[i],1);
+      item[i].idx = i;
+   }
+   if ( k < nel )
+      select_items(item,item+nel,nel,k);
+   sort_items(item,item+nel,k,k<nel);
+   for ( i=0; i<k; i++ )
+      idx[i] = item[i].idx;
+
+   if ( item != sitem )
+      free(item);
+   return k;
+}
+
+/* -------------------------- dnth_largest ------------------------ */
+/**
+ *  @short The n-th largest of a number of double values.
+ *
+ *  This is the value which would be at position n-1 after sorting
+ *  in descending order, found in linear time on average.
+ *  Example: the amplitude of the third hottest pixel is
+ *  dnth_largest(amp,npix,3).
+ *
+ *  @param dnum  The values (not modified).
+ *  @param nel   The number of values.
+ *  @param n     Which value (1: the largest).
+ *
+ *  @return The n-th largest value, or 0 if n is outside 1 to nel
+ *          (or there is not enough memory).
+ */
+
+double dnth_largest (const double *dnum, int nel, int n)
+{
+   struct sort_item sitem[2*ARGSORT_STACK], *item = sitem;
+   double d;
+   int i;
+
+   if ( n <= 0 || n > nel || dnum == NULL )
+      return 0.;
+   if ( nel > ARGSORT_STACK &&
+        (item = (struct sort_item *) malloc(2*(size_t)nel*sizeof(struct sort_item))) == NULL )
+      return 0.;
+
+   for ( i=0; i<nel; i++ )
+   {
+      item[i].key = dsort_key(dnum[i],1);
+      item[i].idx = i;
+   }
+   select_items(item,item+nel,nel,n);
+   d = dnum[item[n-1].idx];
+
+   if ( item != sitem )
+      free(item);
+   return d;
+}
@@ -190,6 +190,129 @@ static double rpol ( double *x, double *y, int n, double xp )
    return y[ipl-1]*(1.-rpl) + y[ipl]*rpl;
 }
 
+/* ======================================================================= */
+/*
+   Uniform-grid index tables, set up by init_atmprof(), replacing the
+   binary search in interp() by a direct index computation. Each grid
+   cell records the profile segment at its lower edge, such that only
+   the rare cells containing a profile level need a further step.
+   The interpolation itself is the same as in rpol(), on the same
+   segment, and results are thus identical to those without the tables.
+*/
+
+#define ATM_GRID_CELLS 1024
+
+/** Index table for a uniform grid over a monotonic coordinate vector. */
+struct atm_grid
+{
+   int ncells;       /**< Number of grid cells or 0 if not usable. */
+   int nv;           /**< Number of tabulated coordinates covered. */
+   int desc;         /**< Coordinates are descending (1) or ascending (0). */
+   double lo;        /**< Lowest coordinate covered by the grid. */
+   double inv_step;  /**< Grid cells per coordinate unit. */
+   int seg[ATM_GRID_CELLS]; /**< Segment (as 'ipl' of interp) at each lower cell edge. */
+};
+
+static struct atm_grid alt_grid, log_thick_grid;
+static int use_atm_grid = -1;
+
+/* ------------------------- set_atmprof_table ---------------------- */
+/**
+ *  @short Enable or disable the uniform-grid tables for the profile lookups.
+ *
+ *  The tables are used by default, unless the environment variable
+ *  ATMPROF_NO_TABLE is set. The results are the same either way,
+ *  only the speed is different.
+ *
+ *  @param  on  1: use the tables, 0: always use the binary search.
+*/
+
+void set_atmprof_table (int on)
+{
+   use_atm_grid = (on != 0);
+}
+
+static void atm_grid_init (struct atm_grid *g, double *v, int n);
+
+/**
+ *  Set up the index table for the first 'n' coordinates in 'v',
+ *  which must be strictly monotonic, else the table is not used.
+ */
+
+static void atm_grid_init (struct atm_grid *g, double *v, int n)
+{
+   int i, j;
+   double lo, hi, step;
+
+   g->ncells = 0;
+   if ( n < 2 )
+      return;
+   g->desc = (v[0] > v[n-1]);
+   for ( i=1; i<n; i++ )
+      if ( g->desc ? !(v[i] < v[i-1]) : !(v[i] > v[i-1]) )
+         return;
+   lo = g->desc ? v[n-1] : v[0];
+   hi = g->desc ? v[0] : v[n-1];
+   step = (hi-lo) / ATM_GRID_CELLS;
+   if ( !(step > 0.) )
+      return;
+   g->lo = lo;
+   g->inv_step = 1./step;
+   g->nv = n;
+   for ( i=0, j=1; i<ATM_GRID_CELLS; i++ )
+   {
+      double x = lo + i*step;
+      if ( g->desc )
+         while ( j < n-1 && x < v[j] )
+            j++;
+      else
+         while ( j < n-1 && x > v[j] )
+            j++;
+      g->seg[i] = j;
+   }
+   g->ncells = ATM_GRID_CELLS;
+}
+
+static double grid_rpol (const struct atm_grid *g, double *x, double *y, 
+   int n, double xp);
+
+/**
+ *  Same as rpol() but with the segment taken from the index table,
+ *  if available and 'xp' is inside its range.
+ */
+
+static double grid_rpol (const struct atm_grid *g, double *x, double *y, 
+   int n, double xp)
+{
+   double u, rpl;
+   int j, nv = g->nv;
+
+   if ( g->ncells <= 0 || !use_atm_grid )
+      return rpol(x,y,n,xp);
+   u = (xp - g->lo) * g->inv_step;
+   if ( !(u >= 0. && u < (double) g->ncells) ) /* Also catches NaN */
+      return rpol(x,y,n,xp);
+   j = g->seg[(int) u];
+   /* The loops below need at most a few steps (and those only in
+      cells containing a profile level or due to rounding). */
+   if ( g->desc )
+   {
+      while ( j < nv-1 && xp < x[j] )
+         j++;
+      while ( j > 1 && xp > x[j-1] )
+         j--;
+   }
+   else
+   {
+      while ( j < nv-1 && xp > x[j] )
+         j++;
+      while ( j > 1 && xp < x[j-1] )
+         j--;
+   }
+   rpl = (xp-x[j-1])/(x[j]-x[j-1]);
+   return y[j-1]*(1.-rpl) + y[j]*rpl;
+}
+
 /* ======================================================================= */
 
 /* ------------------------ find_elsewhere ------------------------ */
@@ -342,6 +465,7 @@ int init_atmprof (int atmosphere)
       return -1;
 
    count = num_prof = 0;
+   alt_grid.ncells = log_thick_grid.ncells = 0;
    while ( fgets(line,sizeof(line)-1,f) != NULL && num_prof < MAX_PROFILE )
    {
       char *s;
@@ -391,6 +515,14 @@ int init_atmprof (int atmosphere)
    bottom_of_atmosphere = p_alt[0];
    top_of_atmosphere    = p_alt[num_prof-1];
    
+   if ( use_atm_grid < 0 )
+      use_atm_grid = (getenv("ATMPROF_NO_TABLE") == NULL);
+   atm_grid_init(&alt_grid,p_alt,num_prof);
+   /* Levels with zero thickness (at the top) are left to rpol(). */
+   for ( count=0; count<num_prof && p_log_thick[count] > -999.; count++ )
+      ;
+   atm_grid_init(&log_thick_grid,p_log_thick,count);
+
    current_atmosphere = atmosphere;
    
    return 0;
@@ -410,7 +542,7 @@ double rhofx (double height)
 {
    if ( current_atmosphere <= 0 )
       return 0.;
-   return exp(rpol(p_alt,p_log_rho,num_prof,height));
+   return exp(grid_rpol(&alt_grid,p_alt,p_log_rho,num_prof,height));
 }
 
 /* ---------------------------- thickx ----------------------------- */
@@ -428,7 +560,7 @@ double thickx (double height)
 {
    if ( current_atmosphere <= 0 )
       return 0.;
-   return exp(rpol(p_alt,p_log_thick,num_prof,height));
+   return exp(grid_rpol(&alt_grid,p_alt,p_log_thick,num_prof,height));
 }
 
 /* ---------------------------- refidx_ ----------------------------- */
@@ -446,7 +578,7 @@ double refidx (double height)
 {
    if ( current_atmosphere <= 0 )
       return 1.;
-   return 1.+exp(rpol(p_alt,p_log_n1,num_prof,height));
+   return 1.+exp(grid_rpol(&alt_grid,p_alt,p_log_n1,num_prof,height));
 }
 
 /* ---------------------------- heighx ----------------------------- */
@@ -466,9 +598,86 @@ double heighx (double thick)
       return 0.;
    if ( (thick) <= 0. )
       return top_of_atmosphere;
-   h = rpol(p_log_thick,p_alt,num_prof,log(thick));
+   h = grid_rpol(&log_thick_grid,p_log_thick,p_alt,num_prof,log(thick));
    if ( h < top_of_atmosphere )
       return h;
    else
       return top_of_atmosphere;
 }
+
+/* ---------------------------- thickx_n ----------------------------- */
+/**
+ *
+ *  @short Atmospheric thickness [g/cm**2] for a vector of altitudes.
+ *
+ *  Same as thickx() applied to each element, with the checks done once.
+ *
+ *  @param  height altitudes [m]
+ *  @param  thick  resulting thickness values [g/cm**2]
+ *  @param  n      number of elements
+*/
+
+void thickx_n (const double *height, double *thick, int n)
+{
+   int i;
+   if ( current_atmosphere <= 0 )
+   {
+      for ( i=0; i<n; i++ )
+         thick[i] = 0.;
+      return;
+   }
+   for ( i=0; i<n; i++ )
+      thick[i] = exp(grid_rpol(&alt_grid,p_alt,p_log_thick,num_prof,height[i]));
+}
+
+/* ---------------------------- rhofx_n ----------------------------- */
+/**
+ *
+ *  @short Density [g/cm**3] for a vector of altitudes [m], see rhofx().
+*/
+
+void rhofx_n (const double *height, double *rho, int n)
+{
+   int i;
+   if ( current_atmosphere <= 0 )
+   {
+      for ( i=0; i<n; i++ )
+         rho[i] = 0.;
+      return;
+   }
+   for ( i=0; i<n; i++ )
+      rho[i] = exp(grid_rpol(&alt_grid,p_alt,p_log_rho,num_prof,height[i]));
+}
+
+/* ---------------------------- refidx_n ----------------------------- */
+/**
+ *
+ *  @short Index of refraction for a vector of altitudes [m], see refidx().
+*/
+
+void refidx_n (const double *height, double *n_ref, int n)
+{
+   int i;
+   if ( current_atmosphere <= 0 )
+   {
+      for ( i=0; i<n; i++ )
+         n_ref[i] = 1.;
+      return;
+   }
+   for ( i=0; i<n; i++ )
+      n_ref[i] = 1.+exp(grid_rpol(&alt_grid,p_alt,p_log_n1,num_prof,height[i]));
+}
+
+/* ---------------------------- heighx_n ----------------------------- */
+/**
+ *
+ *  @short Altitude [m] for a vector of atmospheric thickness values
+ *         [g/cm**2], see heighx().
+*/
+
+void heighx_n (const double *thick, double *height, int n)
+{
+   int i;
+   for ( i=0; i<n; i++ )
+      height[i] = heighx(thick[i]);
+}
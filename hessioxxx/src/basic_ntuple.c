@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
@@ -130,3 +131,738 @@ int list_ntuple(FILE *f, const struct basic_ntuple *b, int wtr)
 
    return 0;
 }
+
+/* ======================================================================= */
+/*  Binary, column-chunked n-tuple files.                                  */
+/* ======================================================================= */
+
+/*
+ * File layout (all numbers in native byte order, checked on reading):
+ *
+ *   Header:  magic "HESSBNT", byte-order mark, format version,
+ *            flag for true MC data, number of columns,
+ *            and for each column its type code and name.
+ *   Chunks:  up to NTUPLE_CHUNK_ROWS rows each, stored as one
+ *            block per column, either raw or compressed.
+ *   Footer:  total number of rows and chunks, and for each chunk
+ *            its row count and the offset, size and codec of
+ *            every column block.
+ *   Trailer: offset of the footer, magic "HESSBNT".
+ *
+ * Compressed column blocks (codec 1) store each value relative
+ * to the preceding one in the same block (integer difference,
+ * zig-zag folded, or XOR of the bit patterns for doubles) as
+ * a variable-length integer of 7 bits per byte.
+ */
+
+#define NTUPLE_MAGIC "HESSBNT"
+#define NTUPLE_BOM 0x01020304U
+#define NTUPLE_VERSION 1
+#define NTUPLE_CHUNK_ROWS 8192
+
+#define NTUPLE_INT    1   /* int, stored as 32-bit integer */
+#define NTUPLE_SIZE   2   /* size_t, stored as 64-bit integer */
+#define NTUPLE_DOUBLE 3   /* double, 64 bit */
+
+struct ntuple_column_def
+{
+   const char *name;
+   int type;
+   size_t offset;
+};
+
+#define NTUPLE_COL(n,t) { #n, t, offsetof(struct basic_ntuple,n) }
+
+/** The fixed schema, in the order of struct basic_ntuple. */
+static const struct ntuple_column_def ntuple_columns[] =
+{
+   NTUPLE_COL(primary,NTUPLE_INT),
+   NTUPLE_COL(run,NTUPLE_INT),
+   NTUPLE_COL(event,NTUPLE_INT),
+   NTUPLE_COL(weight,NTUPLE_DOUBLE),
+   NTUPLE_COL(lg_e_true,NTUPLE_DOUBLE),
+   NTUPLE_COL(xfirst_true,NTUPLE_DOUBLE),
+   NTUPLE_COL(xmax_true,NTUPLE_DOUBLE),
+   NTUPLE_COL(xc_true,NTUPLE_DOUBLE),
+   NTUPLE_COL(yc_true,NTUPLE_DOUBLE),
+   NTUPLE_COL(az_true,NTUPLE_DOUBLE),
+   NTUPLE_COL(alt_true,NTUPLE_DOUBLE),
+   NTUPLE_COL(xc,NTUPLE_DOUBLE),
+   NTUPLE_COL(yc,NTUPLE_DOUBLE),
+   NTUPLE_COL(az,NTUPLE_DOUBLE),
+   NTUPLE_COL(alt,NTUPLE_DOUBLE),
+   NTUPLE_COL(rcm,NTUPLE_DOUBLE),
+   NTUPLE_COL(mdisp,NTUPLE_DOUBLE),
+   NTUPLE_COL(theta,NTUPLE_DOUBLE),
+   NTUPLE_COL(sig_theta,NTUPLE_DOUBLE),
+   NTUPLE_COL(mscrw,NTUPLE_DOUBLE),
+   NTUPLE_COL(sig_mscrw,NTUPLE_DOUBLE),
+   NTUPLE_COL(mscrl,NTUPLE_DOUBLE),
+   NTUPLE_COL(sig_mscrl,NTUPLE_DOUBLE),
+   NTUPLE_COL(xmax,NTUPLE_DOUBLE),
+   NTUPLE_COL(sig_xmax,NTUPLE_DOUBLE),
+   NTUPLE_COL(lg_e,NTUPLE_DOUBLE),
+   NTUPLE_COL(sig_e,NTUPLE_DOUBLE),
+   NTUPLE_COL(chi2_e,NTUPLE_DOUBLE),
+   NTUPLE_COL(tslope,NTUPLE_DOUBLE),
+   NTUPLE_COL(tsphere,NTUPLE_DOUBLE),
+   NTUPLE_COL(n_img,NTUPLE_SIZE),
+   NTUPLE_COL(n_trg,NTUPLE_SIZE),
+   NTUPLE_COL(n_fail,NTUPLE_SIZE),
+   NTUPLE_COL(n_tsl0,NTUPLE_SIZE),
+   NTUPLE_COL(n_pix,NTUPLE_SIZE),
+   NTUPLE_COL(acceptance,NTUPLE_SIZE)
+};
+
+#define NTUPLE_NCOL ((int)(sizeof(ntuple_columns)/sizeof(ntuple_columns[0])))
+
+/** Location of one column block in the file. */
+struct ntuple_block
+{
+   uint64_t offset;
+   uint32_t nbytes;
+   uint32_t codec;
+};
+
+/** State of an open binary n-tuple file, for writing or reading. */
+struct ntuple_file
+{
+   FILE *f;
+   int writing;           /**< Opened for writing (1) or reading (0) */
+   int compress;          /**< Compress column blocks if that saves space */
+   int with_true;         /**< True MC data is meaningful */
+   uint64_t pos;          /**< Bytes written so far */
+   uint64_t nrows;        /**< Total number of rows */
+   size_t nchunks;        /**< Number of chunks (complete, when writing) */
+   size_t max_chunks;     /**< Allocated size of the following vectors */
+   uint32_t *chunk_rows;  /**< Rows per chunk */
+   struct ntuple_block *blocks; /**< nchunks * NTUPLE_NCOL block locations */
+   struct basic_ntuple *rows; /**< Pending rows of the current chunk */
+   size_t nrows_pending;
+   unsigned char *buf;    /**< Encoding/decoding buffer for one block */
+   size_t buf_size;
+};
+
+static int ntuple_col_size (int type);
+
+static int ntuple_col_size (int type)
+{
+   return (type == NTUPLE_INT) ? 4 : 8;
+}
+
+static uint64_t ntuple_get_bits (const struct basic_ntuple *b, int icol);
+
+/** Value of a column in one row, as the bits stored in the file. */
+
+static uint64_t ntuple_get_bits (const struct basic_ntuple *b, int icol)
+{
+   const char *p = (const char *) b + ntuple_columns[icol].offset;
+   uint64_t u = 0;
+   switch ( ntuple_columns[icol].type )
+   {
+      case NTUPLE_INT:
+         u = (uint64_t) (int64_t) *((const int *) p);
+         break;
+      case NTUPLE_SIZE:
+         u = (uint64_t) *((const size_t *) p);
+         break;
+      case NTUPLE_DOUBLE:
+         memcpy(&u,p,sizeof(u));
+         break;
+   }
+   return u;
+}
+
+static void ntuple_set_bits (struct basic_ntuple *b, int icol, uint64_t u);
+
+static void ntuple_set_bits (struct basic_ntuple *b, int icol, uint64_t u)
+{
+   char *p = (char *) b + ntuple_columns[icol].offset;
+   switch ( ntuple_columns[icol].type )
+   {
+      case NTUPLE_INT:
+         *((int *) p) = (int) (int64_t) u;
+         break;
+      case NTUPLE_SIZE:
+         *((size_t *) p) = (size_t) u;
+         break;
+      case NTUPLE_DOUBLE:
+         memcpy(p,&u,sizeof(u));
+         break;
+   }
+}
+
+static double ntuple_bits_to_double (int type, uint64_t u);
+
+static double ntuple_bits_to_double (int type, uint64_t u)
+{
+   double d;
+   switch ( type )
+   {
+      case NTUPLE_INT:
+         return (double) (int32_t) (int64_t) u;
+      case NTUPLE_SIZE:
+         return (double) u;
+      default:
+         memcpy(&d,&u,sizeof(d));
+         return d;
+   }
+}
+
+/** Difference to the preceding value, folded such that small
+    values of either sign give small unsigned numbers. */
+
+static uint64_t ntuple_delta (int type, uint64_t u, uint64_t prev);
+
+static uint64_t ntuple_delta (int type, uint64_t u, uint64_t prev)
+{
+   if ( type == NTUPLE_DOUBLE )
+      return u ^ prev;
+   else
+   {
+      int64_t d = (int64_t) (u - prev);
+      return ((uint64_t) d << 1) ^ (uint64_t) (d >> 63);
+   }
+}
+
+static uint64_t ntuple_undelta (int type, uint64_t z, uint64_t prev);
+
+static uint64_t ntuple_undelta (int type, uint64_t z, uint64_t prev)
+{
+   if ( type == NTUPLE_DOUBLE )
+      return z ^ prev;
+   else
+      return prev + ((z >> 1) ^ (~(z & 1) + 1));
+}
+
+static int ntuple_buf_reserve (struct ntuple_file *nf, size_t n);
+
+static int ntuple_buf_reserve (struct ntuple_file *nf, size_t n)
+{
+   unsigned char *p;
+   if ( n <= nf->buf_size )
+      return 0;
+   if ( (p = (unsigned char *) realloc(nf->buf,n)) == NULL )
+      return -1;
+   nf->buf = p;
+   nf->buf_size = n;
+   return 0;
+}
+
+static int ntuple_fwrite (struct ntuple_file *nf, const void *p, size_t n);
+
+static int ntuple_fwrite (struct ntuple_file *nf, const void *p, size_t n)
+{
+   if ( n > 0 && fwrite(p,1,n,nf->f) != n )
+      return -1;
+   nf->pos += n;
+   return 0;
+}
+
+static int ntuple_flush_chunk (struct ntuple_file *nf);
+
+/** Write the pending rows as one chunk of column blocks. */
+
+static int ntuple_flush_chunk (struct ntuple_file *nf)
+{
+   size_t nr = nf->nrows_pending, i, n;
+   int icol;
+
+   if ( nr == 0 )
+      return 0;
+   if ( nf->nchunks >= nf->max_chunks )
+   {
+      size_t m = (nf->max_chunks > 0) ? 2*nf->max_chunks : 16;
+      uint32_t *cr = (uint32_t *) realloc(nf->chunk_rows,m*sizeof(uint32_t));
+      struct ntuple_block *bl;
+      if ( cr == NULL )
+         return -1;
+      nf->chunk_rows = cr;
+      bl = (struct ntuple_block *) realloc(nf->blocks,
+         m*NTUPLE_NCOL*sizeof(struct ntuple_block));
+      if ( bl == NULL )
+         return -1;
+      nf->blocks = bl;
+      nf->max_chunks = m;
+   }
+   /* Worst case of variable-length coding is 10 bytes per value. */
+   if ( ntuple_buf_reserve(nf,10*nr) != 0 )
+      return -1;
+
+   for ( icol=0; icol<NTUPLE_NCOL; icol++ )
+   {
+      int type = ntuple_columns[icol].type;
+      int sz = ntuple_col_size(type);
+      struct ntuple_block *bl = &nf->blocks[nf->nchunks*NTUPLE_NCOL+icol];
+      size_t nraw = nr * sz;
+      n = 0;
+      if ( nf->compress )
+      {
+         uint64_t prev = 0;
+         for ( i=0; i<nr; i++ )
+         {
+            uint64_t u = ntuple_get_bits(&nf->rows[i],icol);
+            uint64_t z = ntuple_delta(type,u,prev);
+            prev = u;
+            while ( z >= 0x80 )
+            {
+               nf->buf[n++] = (unsigned char) (z | 0x80);
+               z >>= 7;
+            }
+            nf->buf[n++] = (unsigned char) z;
+         }
+      }
+      bl->offset = nf->pos;
+      if ( nf->compress && n < nraw )
+      {
+         bl->codec = 1;
+      }
+      else
+      {
+         for ( i=0, n=0; i<nr; i++ )
+         {
+            uint64_t u = ntuple_get_bits(&nf->rows[i],icol);
+            if ( type == NTUPLE_INT )
+            {
+               int32_t v = (int32_t) (int64_t) u;
+               memcpy(nf->buf+n,&v,4);
+            }
+            else
+               memcpy(nf->buf+n,&u,8);
+            n += sz;
+         }
+         bl->codec = 0;
+      }
+      bl->nbytes = (uint32_t) n;
+      if ( ntuple_fwrite(nf,nf->buf,n) != 0 )
+         return -1;
+   }
+   nf->chunk_rows[nf->nchunks++] = (uint32_t) nr;
+   nf->nrows += nr;
+   nf->nrows_pending = 0;
+   return 0;
+}
+
+/* ------------------------ open_ntuple_output ------------------------ */
+/**
+ * Create a binary, column-chunked n-tuple file.
+ *
+ * @param fname Name of the output file.
+ * @param compress Non-zero for compressed column blocks where that
+ *        saves space.
+ * @param wtr Non-zero if the true MC parameters are meaningful,
+ *        as for list_ntuple().
+ * @return Pointer to the open file or NULL on failure.
+ */
+
+struct ntuple_file *open_ntuple_output (const char *fname, int compress, int wtr)
+{
+   struct ntuple_file *nf;
+   uint32_t hd[4];
+   int icol;
+
+   if ( fname == NULL || 
+        (nf = (struct ntuple_file *) calloc(1,sizeof(struct ntuple_file))) == NULL )
+      return NULL;
+   if ( (nf->rows = (struct basic_ntuple *) 
+           malloc(NTUPLE_CHUNK_ROWS*sizeof(struct basic_ntuple))) == NULL ||
+        (nf->f = fopen(fname,"wb")) == NULL )
+   {
+      perror(fname);
+      free(nf->rows);
+      free(nf);
+      return NULL;
+   }
+   nf->writing = 1;
+   nf->compress = compress;
+   nf->with_true = wtr;
+
+   hd[0] = NTUPLE_BOM;
+   hd[1] = NTUPLE_VERSION;
+   hd[2] = (uint32_t) wtr;
+   hd[3] = (uint32_t) NTUPLE_NCOL;
+   ntuple_fwrite(nf,NTUPLE_MAGIC,8);
+   ntuple_fwrite(nf,hd,sizeof(hd));
+   for ( icol=0; icol<NTUPLE_NCOL; icol++ )
+   {
+      unsigned char t[2];
+      size_t l = strlen(ntuple_columns[icol].name);
+      t[0] = (unsigned char) ntuple_columns[icol].type;
+      t[1] = (unsigned char) l;
+      ntuple_fwrite(nf,t,2);
+      ntuple_fwrite(nf,ntuple_columns[icol].name,l);
+   }
+   if ( ferror(nf->f) )
+   {
+      close_ntuple(nf);
+      return NULL;
+   }
+   return nf;
+}
+
+/* ---------------------------- write_ntuple -------------------------- */
+/**
+ * Append one row to a binary n-tuple file. The row is buffered
+ * until a chunk is complete.
+ *
+ * @return 0 (OK), -1 (error)
+ */
+
+int write_ntuple (struct ntuple_file *nf, const struct basic_ntuple *b)
+{
+   if ( nf == NULL || b == NULL || !nf->writing )
+      return -1;
+   nf->rows[nf->nrows_pending++] = *b;
+   if ( nf->nrows_pending >= NTUPLE_CHUNK_ROWS )
+      return ntuple_flush_chunk(nf);
+   return 0;
+}
+
+/* ---------------------------- close_ntuple -------------------------- */
+/**
+ * Close a binary n-tuple file. For output files, pending rows
+ * and the footer get written first.
+ *
+ * @return 0 (OK), -1 (error)
+ */
+
+int close_ntuple (struct ntuple_file *nf)
+{
+   int rc = 0;
+
+   if ( nf == NULL )
+      return -1;
+   if ( nf->writing && nf->f != NULL )
+   {
+      uint64_t footer = nf->pos;
+      uint32_t nc[2];
+      size_t ic;
+      if ( ntuple_flush_chunk(nf) != 0 )
+         rc = -1;
+      footer = nf->pos;
+      nc[0] = (uint32_t) nf->nchunks;
+      nc[1] = (uint32_t) NTUPLE_NCOL;
+      ntuple_fwrite(nf,&nf->nrows,sizeof(nf->nrows));
+      ntuple_fwrite(nf,nc,sizeof(nc));
+      for ( ic=0; ic<nf->nchunks; ic++ )
+      {
+         ntuple_fwrite(nf,&nf->chunk_rows[ic],sizeof(uint32_t));
+         ntuple_fwrite(nf,&nf->blocks[ic*NTUPLE_NCOL],
+            NTUPLE_NCOL*sizeof(struct ntuple_block));
+      }
+      ntuple_fwrite(nf,&footer,sizeof(footer));
+      ntuple_fwrite(nf,NTUPLE_MAGIC,8);
+      if ( ferror(nf->f) )
+         rc = -1;
+   }
+   if ( nf->f != NULL && fclose(nf->f) != 0 )
+      rc = -1;
+   free(nf->chunk_rows);
+   free(nf->blocks);
+   free(nf->rows);
+   free(nf->buf);
+   free(nf);
+   return rc;
+}
+
+/* ------------------------- open_ntuple_input ------------------------ */
+/**
+ * Open a binary n-tuple file for reading. The file must be
+ * seekable and written with the same schema and byte order.
+ *
+ * @return Pointer to the open file or NULL on failure.
+ */
+
+struct ntuple_file *open_ntuple_input (const char *fname)
+{
+   struct ntuple_file *nf;
+   char magic[8];
+   uint32_t hd[4], nc[2];
+   uint64_t footer;
+   size_t ic;
+   int icol;
+
+   if ( fname == NULL ||
+        (nf = (struct ntuple_file *) calloc(1,sizeof(struct ntuple_file))) == NULL )
+      return NULL;
+   if ( (nf->f = fopen(fname,"rb")) == NULL )
+   {
+      perror(fname);
+      free(nf);
+      return NULL;
+   }
+
+   if ( fread(magic,1,8,nf->f) != 8 || memcmp(magic,NTUPLE_MAGIC,8) != 0 ||
+        fread(hd,sizeof(hd),1,nf->f) != 1 )
+   {
+      fprintf(stderr,"%s: not a binary n-tuple file.\n", fname);
+      close_ntuple(nf);
+      return NULL;
+   }
+   if ( hd[0] != NTUPLE_BOM || hd[1] != NTUPLE_VERSION || 
+        hd[3] != (uint32_t) NTUPLE_NCOL )
+   {
+      fprintf(stderr,"%s: unsupported byte order, version, or number of columns.\n",
+         fname);
+      close_ntuple(nf);
+      return NULL;
+   }
+   nf->with_true = (int) hd[2];
+   for ( icol=0; icol<NTUPLE_NCOL; icol++ )
+   {
+      unsigned char t[2];
+      char name[256];
+      if ( fread(t,1,2,nf->f) != 2 || fread(name,1,t[1],nf->f) != t[1] )
+         break;
+      name[t[1]] = '\0';
+      if ( t[0] != ntuple_columns[icol].type || 
+           strcmp(name,ntuple_columns[icol].name) != 0 )
+         break;
+   }
+   if ( icol < NTUPLE_NCOL )
+   {
+      fprintf(stderr,"%s: n-tuple schema does not match.\n", fname);
+      close_ntuple(nf);
+      return NULL;
+   }
+
+   if ( fseek(nf->f,-16L,SEEK_END) != 0 ||
+        fread(&footer,sizeof(footer),1,nf->f) != 1 ||
+        fread(magic,1,8,nf->f) != 8 || memcmp(magic,NTUPLE_MAGIC,8) != 0 ||
+        fseek(nf->f,(long)footer,SEEK_SET) != 0 ||
+        fread(&nf->nrows,sizeof(nf->nrows),1,nf->f) != 1 ||
+        fread(nc,sizeof(nc),1,nf->f) != 1 || nc[1] != (uint32_t) NTUPLE_NCOL )
+   {
+      fprintf(stderr,"%s: n-tuple file is truncated or not seekable.\n", fname);
+      close_ntuple(nf);
+      return NULL;
+   }
+   nf->nchunks = nf->max_chunks = nc[0];
+   if ( (nf->chunk_rows = (uint32_t *) malloc((nc[0]+1)*sizeof(uint32_t))) == NULL ||
+        (nf->blocks = (struct ntuple_block *) 
+           malloc((nc[0]+1)*NTUPLE_NCOL*sizeof(struct ntuple_block))) == NULL )
+   {
+      close_ntuple(nf);
+      return NULL;
+   }
+   for ( ic=0; ic<nf->nchunks; ic++ )
+   {
+      if ( fread(&nf->chunk_rows[ic],sizeof(uint32_t),1,nf->f) != 1 ||
+           fread(&nf->blocks[ic*NTUPLE_NCOL],sizeof(struct ntuple_block),
+              NTUPLE_NCOL,nf->f) != (size_t) NTUPLE_NCOL ||
+           nf->chunk_rows[ic] > NTUPLE_CHUNK_ROWS )
+      {
+         fprintf(stderr,"%s: bad n-tuple footer.\n", fname);
+         close_ntuple(nf);
+         return NULL;
+      }
+   }
+   return nf;
+}
+
+/** Number of rows in a binary n-tuple file. */
+
+size_t ntuple_rows (const struct ntuple_file *nf)
+{
+   return (nf != NULL) ? (size_t) (nf->nrows + nf->nrows_pending) : 0;
+}
+
+/** Whether the true MC parameters in a binary n-tuple are meaningful. */
+
+int ntuple_with_true (const struct ntuple_file *nf)
+{
+   return (nf != NULL) ? nf->with_true : 0;
+}
+
+/** Column number for a parameter name of struct basic_ntuple, or -1. */
+
+int ntuple_column (const char *name)
+{
+   int icol;
+   if ( name == NULL )
+      return -1;
+   for ( icol=0; icol<NTUPLE_NCOL; icol++ )
+      if ( strcmp(name,ntuple_columns[icol].name) == 0 )
+         return icol;
+   return -1;
+}
+
+/** Name of a column, or NULL if out of range. */
+
+const char *ntuple_column_name (int icol)
+{
+   if ( icol < 0 || icol >= NTUPLE_NCOL )
+      return NULL;
+   return ntuple_columns[icol].name;
+}
+
+static int ntuple_read_block (struct ntuple_file *nf, size_t ic, int icol,
+   uint64_t *u);
+
+/** Read and decode one column block into its stored bit patterns. */
+
+static int ntuple_read_block (struct ntuple_file *nf, size_t ic, int icol,
+   uint64_t *u)
+{
+   const struct ntuple_block *bl = &nf->blocks[ic*NTUPLE_NCOL+icol];
+   int type = ntuple_columns[icol].type;
+   size_t nr = nf->chunk_rows[ic], i, n;
+
+   if ( ntuple_buf_reserve(nf,bl->nbytes) != 0 ||
+        fseek(nf->f,(long)bl->offset,SEEK_SET) != 0 ||
+        fread(nf->buf,1,bl->nbytes,nf->f) != bl->nbytes )
+      return -1;
+   if ( bl->codec == 0 )
+   {
+      int sz = ntuple_col_size(type);
+      if ( bl->nbytes != nr*sz )
+         return -1;
+      for ( i=0; i<nr; i++ )
+      {
+         if ( type == NTUPLE_INT )
+         {
+            int32_t v;
+            memcpy(&v,nf->buf+i*sz,4);
+            u[i] = (uint64_t) (int64_t) v;
+         }
+         else
+            memcpy(&u[i],nf->buf+i*sz,8);
+      }
+   }
+   else if ( bl->codec == 1 )
+   {
+      uint64_t prev = 0;
+      for ( i=n=0; i<nr; i++ )
+      {
+         uint64_t z = 0;
+         int shift = 0;
+         for (;;)
+         {
+            if ( n >= bl->nbytes || shift > 63 )
+               return -1;
+            z |= (uint64_t) (nf->buf[n] & 0x7f) << shift;
+            shift += 7;
+            if ( (nf->buf[n++] & 0x80) == 0 )
+               break;
+         }
+         u[i] = prev = ntuple_undelta(type,z,prev);
+      }
+   }
+   else
+      return -1;
+   return 0;
+}
+
+/* ------------------------- read_ntuple_column ----------------------- */
+/**
+ * Read all values of one column (a column scan, without touching
+ * the blocks of other columns), converted to double.
+ *
+ * @param nf Binary n-tuple file opened with open_ntuple_input().
+ * @param icol Column number, see ntuple_column().
+ * @param values Where the values get stored.
+ * @param max_values Size of the 'values' vector.
+ * @return Number of values read or -1 on error.
+ */
+
+long read_ntuple_column (struct ntuple_file *nf, int icol, 
+   double *values, size_t max_values)
+{
+   uint64_t u[NTUPLE_CHUNK_ROWS];
+   size_t ic, i, n = 0;
+
+   if ( nf == NULL || nf->writing || values == NULL ||
+        icol < 0 || icol >= NTUPLE_NCOL )
+      return -1;
+   for ( ic=0; ic<nf->nchunks; ic++ )
+   {
+      size_t nr = nf->chunk_rows[ic];
+      if ( n + nr > max_values )
+         return -1;
+      if ( ntuple_read_block(nf,ic,icol,u) != 0 )
+      {
+         fprintf(stderr,"Bad block for column %s in n-tuple chunk %zu.\n",
+            ntuple_columns[icol].name, ic);
+         return -1;
+      }
+      for ( i=0; i<nr; i++ )
+         values[n++] = ntuple_bits_to_double(ntuple_columns[icol].type,u[i]);
+   }
+   return (long) n;
+}
+
+/* ------------------------- read_ntuple_chunk ------------------------ */
+/**
+ * Read all columns of one chunk back into rows.
+ *
+ * @param nf Binary n-tuple file opened with open_ntuple_input().
+ * @param ic Chunk number, starting at 0.
+ * @param rows Where the rows get stored, must have space for
+ *        at least NTUPLE_CHUNK_ROWS (8192) rows.
+ * @return Number of rows in the chunk, 0 after the last chunk,
+ *         -1 on error.
+ */
+
+long read_ntuple_chunk (struct ntuple_file *nf, size_t ic, 
+   struct basic_ntuple *rows)
+{
+   uint64_t u[NTUPLE_CHUNK_ROWS];
+   size_t i, nr;
+   int icol;
+
+   if ( nf == NULL || nf->writing || rows == NULL )
+      return -1;
+   if ( ic >= nf->nchunks )
+      return 0;
+   nr = nf->chunk_rows[ic];
+   memset(rows,0,nr*sizeof(struct basic_ntuple));
+   for ( icol=0; icol<NTUPLE_NCOL; icol++ )
+   {
+      if ( ntuple_read_block(nf,ic,icol,u) != 0 )
+      {
+         fprintf(stderr,"Bad block for column %s in n-tuple chunk %zu.\n",
+            ntuple_columns[icol].name, ic);
+         return -1;
+      }
+      for ( i=0; i<nr; i++ )
+         ntuple_set_bits(&rows[i],icol,u[i]);
+   }
+   return (long) nr;
+}
+
+/* -------------------------- ntuple_to_text -------------------------- */
+/**
+ * Convert a binary n-tuple file to the text form of list_ntuple().
+ *
+ * @return Number of rows converted or -1 on error.
+ */
+
+long ntuple_to_text (struct ntuple_file *nf, FILE *f)
+{
+   struct basic_ntuple *rows;
+   size_t ic;
+   long nr, i, n = 0;
+
+   if ( nf == NULL || f == NULL || nf->writing )
+      return -1;
+   if ( (rows = (struct basic_ntuple *) 
+           malloc(NTUPLE_CHUNK_ROWS*sizeof(struct basic_ntuple))) == NULL )
+      return -1;
+   for ( ic=0; ic<nf->nchunks; ic++ )
+   {
+      if ( (nr = read_ntuple_chunk(nf,ic,rows)) < 0 )
+      {
+         free(rows);
+         return -1;
+      }
+      for ( i=0; i<nr; i++ )
+         if ( list_ntuple(f,&rows[i],nf->with_true) != 0 )
+         {
+            free(rows);
+            return -1;
+         }
+      n += nr;
+   }
+   free(rows);
+   return n;
+}
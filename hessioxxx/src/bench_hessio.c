@@ -0,0 +1,1756 @@
+/* ============================================================================
+
+Copyright (C) 2026  The pyhessio contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+============================================================================ */
+
+/** @file bench_hessio.c
+ *  @short Benchmarks for the eventio/hessio layers on synthetic data.
+ *
+ *  A sim_telarray-like data file is generated with the usual
+ *  write_hess_... functions, with configurable numbers of telescopes,
+ *  pixels, gains and samples, and optional zero suppression.
+ *  Then each layer is timed on its own: the variable-length integer
+ *  coding, sorting of pixel amplitudes, finding and reading of data
+ *  blocks, decoding of ADC sums and samples, of complete events, the
+ *  pyhessio event access, and the image integration, calibration,
+ *  cleaning and parametrisation in reconstruct().
+ *
+ *  Each measurement is repeated and the best time is reported,
+ *  one line per benchmark, in a fixed format:
+@verbatim
+name   items   ns/item   MB/s
+@endverbatim
+ *  Lines starting with '#' are comments. Such a listing can be given
+ *  as a baseline for a later run, which then fails (exit status 2)
+ *  if any benchmark got slower than the given tolerance.
+ *
+@verbatim
+Syntax: bench_hessio [ options ]
+Options:
+   --telescopes n   (Number of telescopes, default: 4)
+   --pixels n       (Number of pixels per camera, default: 1855)
+   --gains n        (Number of gains, 1 or 2, default: 2)
+   --samples n      (Number of samples per pixel, 0: sums only, default: 25)
+   --zero-sup n     (Zero suppression mode for sums (and samples), default: 0)
+   --sparse         (Read ADC data in sparse mode, see set_adc_sparse_mode())
+   --events n       (Number of events generated, default: 50)
+   --repeat n       (Repeat each measurement n times, default: 3)
+   --seed n         (Seed for the synthetic data, default: 1)
+   --only name      (Run only benchmarks with names starting like that)
+   --keep fname     (Keep the generated data file under that name)
+   --baseline fname (Compare with results listed in that file)
+   --tolerance p    (Slow-down accepted against baseline [%], default: 20)
+   --fuzz n         (Only run self-checks of fast against general code on n random cases:
+                     ADC sample decoding, image moments, lazy decoding)
+@endverbatim
+ */
+
+/** @defgroup bench_hessio_c The bench_hessio program */
+/** @{ */
+
+#include "initial.h"
+#include "io_basic.h"
+#include "mc_tel.h"
+#include "io_hess.h"
+#include "fileopen.h"
+#include "histogram.h"
+#include "reconstruct.h"
+#include "user_analysis.h"
+#include "stage_timing.h"
+#include "basic_ntuple.h"
+#include "dhsort.h"
+#include "argsort.h"
+#include <time.h>
+
+/* The pyhessio C interface has no header of its own. */
+int file_open (const char *filename);
+void close_file (void);
+int move_to_next (void);
+int get_num_teldata (void);
+int get_telescope_with_data_list (int *list);
+int get_num_channel (int telescope_id);
+int get_adc_sample (int telescope_id, int channel, uint16_t *data);
+int get_adc_sum (int telescope_id, int channel, uint32_t *data);
+
+/** Configuration of the synthetic data. */
+struct bench_config
+{
+   int ntel;        /**< Number of telescopes. */
+   int npix;        /**< Number of pixels per camera. */
+   int ngains;      /**< Number of gains. */
+   int nsamples;    /**< Number of samples (0: only sums). */
+   int zero_sup;    /**< Zero suppression mode. */
+   int sparse;      /**< Read ADC data in sparse mode. */
+   int nevents;     /**< Number of events. */
+   int repeat;      /**< Number of repetitions of each measurement. */
+   unsigned seed;   /**< Seed for the pseudo-random numbers. */
+};
+
+/** One line of benchmark results. */
+struct bench_result
+{
+   char name[64];
+   unsigned long items;
+   double ns_per_item;
+   double mb_per_s;
+};
+
+#define MAX_BENCH_RESULTS 100
+static struct bench_result results[MAX_BENCH_RESULTS];
+static int num_results;
+static const char *only_prefix = NULL;
+
+static AllHessData *hsdata;
+
+/** Expected by the user analysis, even though no ntuple is written here. */
+struct basic_ntuple bnt;
+
+/* ---------------------------- bench_now ------------------------------- */
+
+static double bench_now (void);
+
+static double bench_now (void)
+{
+   struct timespec ts;
+#ifdef CLOCK_MONOTONIC
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+#else
+   clock_gettime(CLOCK_REALTIME,&ts);
+#endif
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* ---------------------------- bench_rndm ------------------------------ */
+/** Own pseudo-random numbers (xorshift), same on all platforms. */
+
+static uint32_t rndm_state = 1;
+
+static double bench_rndm (void);
+
+static double bench_rndm (void)
+{
+   uint32_t x = rndm_state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   rndm_state = x;
+   return (x >> 8) * (1./16777216.);
+}
+
+/* ---------------------------- bench_wanted ---------------------------- */
+
+static int bench_wanted (const char *name);
+
+static int bench_wanted (const char *name)
+{
+   if ( only_prefix == NULL )
+      return 1;
+   return strncmp(name,only_prefix,strlen(only_prefix)) == 0;
+}
+
+/* ---------------------------- bench_report ---------------------------- */
+/**
+ *  Report the (best) time for a benchmark.
+ *
+ *  @param name   Name of the benchmark.
+ *  @param items  Number of items processed in that time.
+ *  @param bytes  Number of bytes processed (0: not applicable).
+ *  @param t      Best time over all repetitions [s].
+ */
+
+static void bench_report (const char *name, unsigned long items, double bytes, double t);
+
+static void bench_report (const char *name, unsigned long items, double bytes, double t)
+{
+   struct bench_result *r;
+   if ( num_results >= MAX_BENCH_RESULTS )
+      return;
+   r = &results[num_results++];
+   strncpy(r->name,name,sizeof(r->name)-1);
+   r->items = items;
+   r->ns_per_item = (items > 0) ? 1e9*t/items : 0.;
+   r->mb_per_s = (bytes > 0. && t > 0.) ? 1e-6*bytes/t : 0.;
+   printf("%-32s %10lu %12.2f %10.2f\n", r->name, r->items, r->ns_per_item, r->mb_per_s);
+   fflush(stdout);
+}
+
+/* ------------------------- bench_fill_camera -------------------------- */
+/**
+ *  Set up the configuration of the synthetic telescopes: a hexagonal
+ *  pixel grid, pedestals, calibration, and a reference pulse shape.
+ */
+
+static void bench_fill_camera (const struct bench_config *cfg);
+
+static void bench_fill_camera (const struct bench_config *cfg)
+{
+   int itel, ipix, igain;
+   int ncol = (int) ceil(sqrt((double)cfg->npix));
+   double d = 0.05; /* Pixel spacing [m] */
+   int nsum = (cfg->nsamples > 0) ? cfg->nsamples : 10;
+
+   hsdata->run_header.run = 1;
+   hsdata->run_header.run_type = -1;
+   hsdata->run_header.ntel = cfg->ntel;
+   hsdata->run_header.target = "synthetic";
+   hsdata->run_header.observer = "bench_hessio";
+   hsdata->run_header.min_tel_trig = 2;
+   hsdata->mc_run_header.shower_prog_id = 1;
+   hsdata->mc_run_header.spectral_index = -2.;
+   hsdata->mc_run_header.E_range[0] = 0.01;
+   hsdata->mc_run_header.E_range[1] = 100.;
+   hsdata->event.num_tel = cfg->ntel;
+
+   for ( itel=0; itel<cfg->ntel; itel++ )
+   {
+      int tel_id = itel + 1;
+      CameraSettings *cs = &hsdata->camera_set[itel];
+      CameraOrganisation *co = &hsdata->camera_org[itel];
+      PixelSetting *ps = &hsdata->pixel_set[itel];
+      TelMoniData *mon = &hsdata->tel_moni[itel];
+      LasCalData *lc = &hsdata->tel_lascal[itel];
+      TelEvent *te = &hsdata->event.teldata[itel];
+      int is;
+
+      hsdata->run_header.tel_id[itel] = tel_id;
+      hsdata->run_header.tel_pos[itel][0] = 100. * (itel % 5);
+      hsdata->run_header.tel_pos[itel][1] = 100. * (itel / 5);
+      hsdata->run_header.tel_pos[itel][2] = 0.;
+
+      cs->tel_id = tel_id;
+      cs->num_pixels = cfg->npix;
+      cs->flen = 16.;
+      cs->num_mirrors = 200;
+      cs->mirror_area = 100.;
+      for ( ipix=0; ipix<cfg->npix; ipix++ )
+      {
+         int row = ipix / ncol, col = ipix % ncol;
+         cs->xpix[ipix] = (col - 0.5*ncol + 0.5*(row%2)) * d;
+         cs->ypix[ipix] = (row - 0.5*ncol) * d * 0.5*sqrt(3.);
+         cs->size[ipix] = d;
+         cs->area[ipix] = 0.5*sqrt(3.)*d*d;
+         cs->pixel_shape[ipix] = -1;
+      }
+
+      co->tel_id = tel_id;
+      co->num_pixels = cfg->npix;
+      co->num_gains = cfg->ngains;
+      co->num_drawers = (cfg->npix+6) / 7;
+      co->num_sectors = 0;
+      for ( ipix=0; ipix<cfg->npix; ipix++ )
+         co->drawer[ipix] = ipix / 7;
+
+      ps->tel_id = tel_id;
+      ps->num_pixels = cfg->npix;
+      ps->num_drawers = co->num_drawers;
+      ps->time_slice = 1.;
+      ps->sum_bins = nsum;
+      ps->nrefshape = cfg->ngains;
+      ps->lrefshape = 40;
+      ps->ref_step = 0.5;
+      for ( igain=0; igain<cfg->ngains; igain++ )
+         for ( is=0; is<ps->lrefshape; is++ )
+         {
+            double t = is * ps->ref_step;
+            ps->refshape[igain][is] = t * exp(-t/3.);
+         }
+
+      mon->tel_id = tel_id;
+      mon->known = 0x04; /* Pedestals and noise */
+      mon->num_pixels = cfg->npix;
+      mon->num_gains = cfg->ngains;
+      mon->num_drawers = co->num_drawers;
+      mon->num_ped_slices = nsum;
+      lc->tel_id = tel_id;
+      lc->known = 1;
+      lc->num_pixels = cfg->npix;
+      lc->num_gains = cfg->ngains;
+      for ( igain=0; igain<cfg->ngains; igain++ )
+      {
+         for ( ipix=0; ipix<cfg->npix; ipix++ )
+         {
+            mon->pedestal[igain][ipix] = (igain==HI_GAIN ? 300. : 100.) * nsum;
+            mon->noise[igain][ipix] = (igain==HI_GAIN ? 2. : 0.5) * sqrt((double)nsum);
+            lc->calib[igain][ipix] = (igain==HI_GAIN ? 0.1 : 2.);
+         }
+         lc->max_int_frac[igain] = 1.;
+      }
+
+      te->tel_id = tel_id;
+      if ( te->raw == NULL )
+         te->raw = (AdcData *) calloc(1,sizeof(AdcData));
+      if ( te->pixtm == NULL )
+         te->pixtm = (PixelTiming *) calloc(1,sizeof(PixelTiming));
+      if ( te->img == NULL )
+      {
+         te->img = (ImgData *) calloc(2,sizeof(ImgData));
+         te->max_image_sets = 2;
+      }
+      if ( te->raw == NULL || te->pixtm == NULL || te->img == NULL )
+      {
+         fprintf(stderr,"Not enough memory.\n");
+         exit(1);
+      }
+      te->raw->tel_id = te->pixtm->tel_id = tel_id;
+      te->img[0].tel_id = te->img[1].tel_id = tel_id;
+      hsdata->event.trackdata[itel].tel_id = tel_id;
+   }
+}
+
+/* -------------------------- bench_fill_event -------------------------- */
+/**
+ *  Fill one synthetic event: an elliptical image of random position,
+ *  orientation and intensity on top of night-sky background noise,
+ *  in all telescopes, with a simple pulse shape in the samples.
+ *  The true image parameters are included as image data, as in
+ *  files from an analysis, such that lazy reading of images only
+ *  has something to decode.
+ */
+
+static void bench_fill_event (const struct bench_config *cfg, int iev);
+
+static void bench_fill_event (const struct bench_config *cfg, int iev)
+{
+   int itel, ipix, igain, is;
+   FullEvent *ev = &hsdata->event;
+
+   hsdata->mc_shower.shower_num = iev + 1;
+   hsdata->mc_shower.primary_id = 0;
+   hsdata->mc_shower.energy = 0.1 * exp(5.*bench_rndm());
+   hsdata->mc_event.event = hsdata->mc_event.shower_num = iev + 1;
+   hsdata->mc_event.xcore = 200.*(bench_rndm()-0.5);
+   hsdata->mc_event.ycore = 200.*(bench_rndm()-0.5);
+
+   ev->central.glob_count = iev + 1;
+   ev->central.num_teltrg = ev->central.num_teldata = cfg->ntel;
+   ev->num_teldata = cfg->ntel;
+   for ( itel=0; itel<cfg->ntel; itel++ )
+   {
+      TelEvent *te = &ev->teldata[itel];
+      AdcData *raw = te->raw;
+      CameraSettings *cs = &hsdata->camera_set[itel];
+      double amp = 50. * exp(4.*bench_rndm());
+      double xc = 0.3*(bench_rndm()-0.5), yc = 0.3*(bench_rndm()-0.5);
+      double phi = M_PI*bench_rndm(), cp = cos(phi), sp = sin(phi);
+      double wid = 0.02 + 0.02*bench_rndm(), len = wid * (1.+2.*bench_rndm());
+      double t0 = 0.35*cfg->nsamples;
+      ImgData *img;
+
+      ev->central.teltrg_list[itel] = ev->central.teldata_list[itel] = te->tel_id;
+      ev->central.teltrg_time[itel] = 0.;
+      ev->central.teltrg_type_mask[itel] = 1;
+      ev->teldata_list[itel] = te->tel_id;
+      ev->trackdata[itel].raw_known = 1;
+      ev->trackdata[itel].azimuth_raw = 0.;
+      ev->trackdata[itel].altitude_raw = 1.2;
+
+      te->known = 1;
+      te->glob_count = iev + 1;
+      te->loc_count = iev + 1;
+      te->readout_mode = (cfg->nsamples > 0) ? 2 : 0;
+      te->num_image_sets = 1;
+      te->img[0].known = 1;
+      te->img[1].known = 0;
+      te->pixtm->known = 0;
+      te->trigger_pixels.pixels = te->image_pixels.pixels = 0;
+
+      raw->known = 1;
+      raw->num_pixels = cfg->npix;
+      raw->num_gains = cfg->ngains;
+      raw->num_samples = cfg->nsamples;
+      raw->zero_sup_mode = cfg->zero_sup | ((cfg->zero_sup && cfg->nsamples > 0) ? 0x20 : 0);
+      raw->data_red_mode = 0;
+      for ( ipix=0; ipix<cfg->npix; ipix++ )
+      {
+         double dx = cs->xpix[ipix] - xc, dy = cs->ypix[ipix] - yc;
+         double u = cp*dx + sp*dy, v = -sp*dx + cp*dy;
+         double npe = amp * exp(-0.5*(u*u/(len*len)+v*v/(wid*wid))) *
+            cs->area[ipix] / (2.*M_PI*len*wid) + bench_rndm();
+         double tpk = t0 + 20.*u;
+         raw->significant[ipix] = (npe > 4.) ? 1 : 0;
+         if ( raw->significant[ipix] && (raw->zero_sup_mode & 0x20) )
+            raw->significant[ipix] |= 0x20;
+         for ( igain=0; igain<cfg->ngains; igain++ )
+         {
+            double ped = (igain==HI_GAIN ? 300. : 100.);
+            double gain = (igain==HI_GAIN ? 10. : 0.5);
+            uint32_t sum = 0;
+            raw->adc_known[igain][ipix] = 1;
+            for ( is=0; is<cfg->nsamples; is++ )
+            {
+               double t = is - tpk + 1.;
+               double a = ped + 4.*(bench_rndm()-0.5) +
+                  ((t > 0.) ? gain*npe*t*exp(-t/1.5)/2.25 : 0.);
+               uint16_t s = (a >= 4095.) ? 4095 : (uint16_t) a;
+               raw->adc_sample[igain][ipix][is] = s;
+               sum += s;
+            }
+            if ( cfg->nsamples == 0 )
+               sum = (uint32_t) (10.*ped + gain*npe + 8.*(bench_rndm()-0.5));
+            raw->adc_sum[igain][ipix] = sum;
+         }
+      }
+
+      img = &te->img[0];
+      img->pixels = 0;
+      for ( ipix=0; ipix<cfg->npix; ipix++ )
+         if ( raw->significant[ipix] )
+            img->pixels++;
+      img->cut_id = 0;
+      img->amplitude = amp;
+      img->clip_amp = 0.;
+      img->num_sat = 0;
+      img->x = xc;
+      img->y = yc;
+      img->phi = phi;
+      img->l = len;
+      img->w = wid;
+      img->x_err = img->y_err = img->phi_err = img->l_err = img->w_err = 0.;
+      img->skewness = img->kurtosis = 0.;
+      img->skewness_err = img->kurtosis_err = -1.;
+      img->num_conc = 0;
+      img->concentration = 0.;
+      img->tm_slope = 20.*len;
+      img->tm_residual = img->tm_width1 = img->tm_width2 = img->tm_rise = 0.;
+      img->num_hot = 0;
+   }
+}
+
+/* -------------------------- bench_generate ---------------------------- */
+/**
+ *  Write the synthetic data file: configuration blocks followed by
+ *  MC shower, MC event and event blocks for each event.
+ *  A second file gets the ADC sums and samples of the same telescope
+ *  data as separate top-level blocks.
+ */
+
+static int bench_generate (const struct bench_config *cfg, FILE *f, FILE *fadc);
+
+static int bench_generate (const struct bench_config *cfg, FILE *f, FILE *fadc)
+{
+   IO_BUFFER *iobuf;
+   int itel, iev;
+
+   if ( (iobuf = allocate_io_buffer(1000000L)) == NULL )
+      return -1;
+   iobuf->max_length = 200000000L;
+   iobuf->output_file = f;
+
+   write_hess_runheader(iobuf,&hsdata->run_header);
+   write_hess_mcrunheader(iobuf,&hsdata->mc_run_header);
+   for ( itel=0; itel<cfg->ntel; itel++ )
+   {
+      write_hess_camsettings(iobuf,&hsdata->camera_set[itel]);
+      write_hess_camorgan(iobuf,&hsdata->camera_org[itel]);
+      write_hess_pixelset(iobuf,&hsdata->pixel_set[itel]);
+      write_hess_tel_monitor(iobuf,&hsdata->tel_moni[itel],-1);
+      write_hess_laser_calib(iobuf,&hsdata->tel_lascal[itel]);
+   }
+
+   for ( iev=0; iev<cfg->nevents; iev++ )
+   {
+      bench_fill_event(cfg,iev);
+      write_hess_mc_shower(iobuf,&hsdata->mc_shower);
+      write_hess_mc_event(iobuf,&hsdata->mc_event);
+      if ( write_hess_event(iobuf,&hsdata->event,-1) != 0 )
+      {
+         fprintf(stderr,"Writing synthetic event failed.\n");
+         free_io_buffer(iobuf);
+         return -1;
+      }
+      iobuf->output_file = fadc;
+      for ( itel=0; itel<cfg->ntel; itel++ )
+      {
+         AdcData *raw = hsdata->event.teldata[itel].raw;
+         write_hess_teladc_sums(iobuf,raw);
+         if ( cfg->nsamples > 0 )
+            write_hess_teladc_samples(iobuf,raw);
+      }
+      iobuf->output_file = f;
+   }
+
+   fflush(f);
+   fflush(fadc);
+   free_io_buffer(iobuf);
+   return 0;
+}
+
+/* ---------------------------- bench_varint ---------------------------- */
+/**
+ *  Time the variable-length integer coding, with values spread over
+ *  all typically used byte lengths.
+ */
+
+#define NUM_VARINT 1000000
+
+static void bench_varint (const struct bench_config *cfg);
+
+static void bench_varint (const struct bench_config *cfg)
+{
+   IO_BUFFER *iobuf;
+   IO_ITEM_HEADER item_header;
+   uint32_t *uval;
+   int32_t *sval;
+   uint16_t *vec16;
+   int i, irep;
+   double t, best[6];
+   size_t nbytes[6] = { 0, 0, 0, 0, 0, 0 };
+   FILE *f;
+
+   if ( !bench_wanted("varint") )
+      return;
+
+   uval = (uint32_t *) malloc(NUM_VARINT*sizeof(uint32_t));
+   sval = (int32_t *) malloc(NUM_VARINT*sizeof(int32_t));
+   vec16 = (uint16_t *) malloc(NUM_VARINT*sizeof(uint16_t));
+   iobuf = allocate_io_buffer(10*NUM_VARINT+1000);
+   if ( uval == NULL || sval == NULL || vec16 == NULL || iobuf == NULL ||
+        (f = tmpfile()) == NULL )
+   {
+      fprintf(stderr,"Not enough memory or no temporary file.\n");
+      exit(1);
+   }
+   iobuf->max_length = 20*NUM_VARINT+1000;
+   for ( i=0; i<NUM_VARINT; i++ )
+   {
+      /* Mostly small numbers, as in differential sample coding */
+      int nbits = (int) (28. * pow(bench_rndm(),3.)) + 1;
+      uval[i] = (uint32_t) (bench_rndm() * (1U<<nbits));
+      sval[i] = (i%2) ? -(int32_t)(uval[i]/2) : (int32_t)(uval[i]/2);
+      vec16[i] = (uint16_t) (300 + 40.*bench_rndm() * (i%25 > 8 && i%25 < 12 ? 30. : 1.));
+   }
+   for ( i=0; i<6; i++ )
+      best[i] = 1e30;
+
+   for ( irep=0; irep<cfg->repeat; irep++ )
+   {
+      /* Encoding */
+      item_header.type = 999;
+      item_header.version = 0;
+      item_header.ident = 0;
+      put_item_begin(iobuf,&item_header);
+      t = bench_now();
+      for ( i=0; i<NUM_VARINT; i++ )
+         put_count32(uval[i],iobuf);
+      t = bench_now() - t;
+      if ( t < best[0] )
+         best[0] = t;
+      nbytes[0] = (size_t) (iobuf->data - iobuf->buffer);
+      t = bench_now();
+      for ( i=0; i<NUM_VARINT; i++ )
+         put_scount32(sval[i],iobuf);
+      t = bench_now() - t;
+      if ( t < best[2] )
+         best[2] = t;
+      nbytes[2] = (size_t) (iobuf->data - iobuf->buffer) - nbytes[0];
+      t = bench_now();
+      put_vector_of_uint16_scount_differential(vec16,NUM_VARINT,iobuf);
+      t = bench_now() - t;
+      if ( t < best[4] )
+         best[4] = t;
+      nbytes[4] = (size_t) (iobuf->data - iobuf->buffer) - nbytes[0] - nbytes[2];
+      rewind(f);
+      iobuf->output_file = f;
+      put_item_end(iobuf,&item_header);
+      iobuf->output_file = NULL;
+      fflush(f);
+
+      /* Decoding */
+      rewind(f);
+      iobuf->input_file = f;
+      if ( find_io_block(iobuf,&item_header) != 0 ||
+           read_io_block(iobuf,&item_header) != 0 ||
+           get_item_begin(iobuf,&item_header) != 0 )
+      {
+         fprintf(stderr,"Reading back varint data failed.\n");
+         exit(1);
+      }
+      iobuf->input_file = NULL;
+      t = bench_now();
+      for ( i=0; i<NUM_VARINT; i++ )
+         if ( get_count32(iobuf) != uval[i] )
+            break;
+      t = bench_now() - t;
+      if ( i < NUM_VARINT )
+      {
+         fprintf(stderr,"Varint mismatch at value %d.\n", i);
+         exit(1);
+      }
+      if ( t < best[1] )
+         best[1] = t;
+      t = bench_now();
+      for ( i=0; i<NUM_VARINT; i++ )
+         if ( get_scount32(iobuf) != sval[i] )
+            break;
+      t = bench_now() - t;
+      if ( i < NUM_VARINT )
+      {
+         fprintf(stderr,"Signed varint mismatch at value %d.\n", i);
+         exit(1);
+      }
+      if ( t < best[3] )
+         best[3] = t;
+      t = bench_now();
+      get_vector_of_uint16_scount_differential(vec16,NUM_VARINT,iobuf);
+      t = bench_now() - t;
+      if ( t < best[5] )
+         best[5] = t;
+      get_item_end(iobuf,&item_header);
+   }
+
+   bench_report("varint.put_count32",NUM_VARINT,(double)nbytes[0],best[0]);
+   bench_report("varint.get_count32",NUM_VARINT,(double)nbytes[0],best[1]);
+   bench_report("varint.put_scount32",NUM_VARINT,(double)nbytes[2],best[2]);
+   bench_report("varint.get_scount32",NUM_VARINT,(double)nbytes[2],best[3]);
+   bench_report("varint.put_uint16_diff",NUM_VARINT,(double)nbytes[4],best[4]);
+   bench_report("varint.get_uint16_diff",NUM_VARINT,(double)nbytes[4],best[5]);
+
+   fclose(f);
+   free_io_buffer(iobuf);
+   free(uval);
+   free(sval);
+   free(vec16);
+}
+
+/* ----------------------------- bench_sort ----------------------------- */
+/**
+ *  Time the sorting of pixel amplitudes: the exchange sort formerly
+ *  used in image cleaning, dhsort(), dargsort(), and the selection
+ *  of the hottest pixels with dtopk() and dnth_largest().
+ *  Amplitudes are spread over several orders of magnitude, like
+ *  in bright images. Each item is one amplitude.
+ */
+
+#define NUM_SORT_VALUES 2000000
+
+static void bench_sort (const struct bench_config *cfg);
+
+static void bench_sort (const struct bench_config *cfg)
+{
+   double *amp, *work, t, best[6], dsum = 0.;
+   int *idx, *tmp;
+   int n = cfg->npix, nimg = (cfg->npix+3)/4, nset, nset_x, iset, irep, i, j;
+
+   if ( !bench_wanted("sort") || n < 4 )
+      return;
+
+   nset = NUM_SORT_VALUES / n + 1;
+   /* The exchange sort is much slower; only that many images for it. */
+   nset_x = 20000000 / (nimg*nimg) + 1;
+   if ( nset_x > nset )
+      nset_x = nset;
+   amp = (double *) malloc((size_t)nset*n*sizeof(double));
+   work = (double *) malloc((size_t)n*sizeof(double));
+   idx = (int *) malloc((size_t)n*sizeof(int));
+   tmp = (int *) malloc((size_t)n*sizeof(int));
+   if ( amp == NULL || work == NULL || idx == NULL || tmp == NULL )
+   {
+      fprintf(stderr,"Not enough memory.\n");
+      exit(1);
+   }
+   for ( i=0; i<nset*n; i++ )
+      amp[i] = 5. * exp(8.*bench_rndm());
+   for ( i=0; i<6; i++ )
+      best[i] = 1e30;
+
+   for ( irep=0; irep<cfg->repeat; irep++ )
+   {
+      /* Exchange sort of a (quarter-camera) image, as in former cleaning */
+      t = bench_now();
+      for ( iset=0; iset<nset_x; iset++ )
+      {
+         const double *a = amp + (size_t)iset*n;
+         for ( i=0; i<nimg; i++ )
+            idx[i] = i;
+         for ( i=0; i<nimg; i++ )
+            for ( j=i+1; j<nimg; j++ )
+               if ( a[idx[j]] > a[idx[i]] )
+               {
+                  int k = idx[i];
+                  idx[i] = idx[j];
+                  idx[j] = k;
+               }
+         dsum += a[idx[2]];
+      }
+      t = bench_now() - t;
+      if ( t < best[0] )
+         best[0] = t;
+
+      /* Same images with dargsort() */
+      t = bench_now();
+      for ( iset=0; iset<nset_x; iset++ )
+      {
+         dargsort(amp+(size_t)iset*n,nimg,idx,1);
+         dsum += amp[(size_t)iset*n+idx[2]];
+      }
+      t = bench_now() - t;
+      if ( t < best[1] )
+         best[1] = t;
+
+      /* Whole cameras */
+      t = bench_now();
+      for ( iset=0; iset<nset; iset++ )
+      {
+         memcpy(work,amp+(size_t)iset*n,(size_t)n*sizeof(double));
+         dhsort(work,n);
+         dsum += work[n-3];
+      }
+      t = bench_now() - t;
+      if ( t < best[2] )
+         best[2] = t;
+
+      t = bench_now();
+      for ( iset=0; iset<nset; iset++ )
+      {
+         dargsort(amp+(size_t)iset*n,n,idx,1);
+         dsum += amp[(size_t)iset*n+idx[2]];
+      }
+      t = bench_now() - t;
+      if ( t < best[3] )
+         best[3] = t;
+
+      t = bench_now();
+      for ( iset=0; iset<nset; iset++ )
+      {
+         dtopk(amp+(size_t)iset*n,n,10,tmp);
+         dsum += amp[(size_t)iset*n+tmp[2]];
+      }
+      t = bench_now() - t;
+      if ( t < best[4] )
+         best[4] = t;
+
+      t = bench_now();
+      for ( iset=0; iset<nset; iset++ )
+         dsum += dnth_largest(amp+(size_t)iset*n,n,3);
+      t = bench_now() - t;
+      if ( t < best[5] )
+         best[5] = t;
+   }
+
+   bench_report("sort.exchange_image",(unsigned long)nset_x*nimg,0.,best[0]);
+   bench_report("sort.dargsort_image",(unsigned long)nset_x*nimg,0.,best[1]);
+   bench_report("sort.dhsort",(unsigned long)nset*n,0.,best[2]);
+   bench_report("sort.dargsort",(unsigned long)nset*n,0.,best[3]);
+   bench_report("sort.dtopk_10",(unsigned long)nset*n,0.,best[4]);
+   bench_report("sort.dnth_largest_3",(unsigned long)nset*n,0.,best[5]);
+   if ( dsum == 0. ) /* Never true, keeps the compiler from skipping work */
+      printf("#\n");
+
+   free(amp);
+   free(work);
+   free(idx);
+   free(tmp);
+}
+
+/* ---------------------------- bench_blocks ---------------------------- */
+/**
+ *  Time finding and reading all data blocks of a file, and the
+ *  decoding of selected block types (ADC sums, ADC samples, or
+ *  complete events, also in lazy mode). Only the decoding is timed
+ *  for the latter.
+ */
+
+static void bench_blocks (const struct bench_config *cfg, FILE *f, FILE *fadc);
+
+static void bench_blocks (const struct bench_config *cfg, FILE *f, FILE *fadc)
+{
+   IO_BUFFER *iobuf;
+   IO_ITEM_HEADER item_header;
+   AdcData *raw = hsdata->event.teldata[0].raw;
+   int irep;
+   double best_read = 1e30, best_sums = 1e30, best_samples = 1e30, best_event = 1e30;
+   double best_lazy = 1e30;
+   unsigned long nblocks = 0, nsums = 0, nsamples = 0, nevents = 0;
+   double bytes = 0., bytes_sums = 0., bytes_samples = 0., bytes_events = 0.;
+
+   if ( (iobuf = allocate_io_buffer(1000000L)) == NULL )
+      exit(1);
+   iobuf->max_length = 200000000L;
+
+   for ( irep=0; irep<cfg->repeat; irep++ )
+   {
+      double t, t_sums = 0., t_samples = 0., t_event = 0., t_lazy = 0.;
+
+      /* Plain block I/O on the (cached) event file */
+      if ( bench_wanted("io.read_blocks") )
+      {
+         rewind(f);
+         iobuf->input_file = f;
+         nblocks = 0;
+         bytes = 0.;
+         t = bench_now();
+         while ( find_io_block(iobuf,&item_header) == 0 &&
+                 read_io_block(iobuf,&item_header) == 0 )
+         {
+            nblocks++;
+            bytes += item_header.length + 16;
+         }
+         t = bench_now() - t;
+         if ( t < best_read )
+            best_read = t;
+      }
+
+      /* Separate ADC sums and samples blocks */
+      if ( bench_wanted("hess.teladc") )
+      {
+         rewind(fadc);
+         iobuf->input_file = fadc;
+         nsums = nsamples = 0;
+         bytes_sums = bytes_samples = 0.;
+         while ( find_io_block(iobuf,&item_header) == 0 &&
+                 read_io_block(iobuf,&item_header) == 0 )
+         {
+            t = bench_now();
+            if ( item_header.type == IO_TYPE_HESS_TELADCSUM )
+            {
+               read_hess_teladc_sums(iobuf,raw);
+               t_sums += bench_now() - t;
+               nsums++;
+               bytes_sums += item_header.length + 16;
+            }
+            else if ( item_header.type == IO_TYPE_HESS_TELADCSAMP )
+            {
+               read_hess_teladc_samples(iobuf,raw,-1);
+               t_samples += bench_now() - t;
+               nsamples++;
+               bytes_samples += item_header.length + 16;
+            }
+         }
+         if ( t_sums < best_sums )
+            best_sums = t_sums;
+         if ( t_samples < best_samples )
+            best_samples = t_samples;
+      }
+
+      /* Complete events */
+      if ( bench_wanted("hess.event") )
+      {
+         rewind(f);
+         iobuf->input_file = f;
+         nevents = 0;
+         bytes_events = 0.;
+         while ( find_io_block(iobuf,&item_header) == 0 &&
+                 read_io_block(iobuf,&item_header) == 0 )
+         {
+            if ( item_header.type != IO_TYPE_HESS_EVENT )
+               continue;
+            t = bench_now();
+            read_hess_event(iobuf,&hsdata->event,-1);
+            t_event += bench_now() - t;
+            nevents++;
+            bytes_events += item_header.length + 16;
+         }
+         if ( t_event < best_event )
+            best_event = t_event;
+      }
+
+      /* Complete events in lazy mode, with only the images accessed */
+      if ( bench_wanted("hess.event_lazy") )
+      {
+         rewind(f);
+         iobuf->input_file = f;
+         nevents = 0;
+         bytes_events = 0.;
+         set_hess_lazy_decode(&hsdata->event,1);
+         while ( find_io_block(iobuf,&item_header) == 0 &&
+                 read_io_block(iobuf,&item_header) == 0 )
+         {
+            int itel;
+            if ( item_header.type != IO_TYPE_HESS_EVENT )
+               continue;
+            t = bench_now();
+            read_hess_event(iobuf,&hsdata->event,-1);
+            for ( itel=0; itel<hsdata->event.num_tel; itel++ )
+               (void) hess_tel_img(&hsdata->event,itel);
+            t_lazy += bench_now() - t;
+            nevents++;
+            bytes_events += item_header.length + 16;
+         }
+         set_hess_lazy_decode(&hsdata->event,0);
+         if ( t_lazy < best_lazy )
+            best_lazy = t_lazy;
+      }
+   }
+
+   if ( bench_wanted("io.read_blocks") )
+      bench_report("io.read_blocks",nblocks,bytes,best_read);
+   if ( bench_wanted("hess.teladc") )
+   {
+      bench_report("hess.teladc_sums",nsums,bytes_sums,best_sums);
+      if ( nsamples > 0 )
+         bench_report("hess.teladc_samples",nsamples,bytes_samples,best_samples);
+   }
+   if ( bench_wanted("hess.event") )
+      bench_report("hess.event",nevents,bytes_events,best_event);
+   if ( bench_wanted("hess.event_lazy") )
+      bench_report("hess.event_lazy",nevents,bytes_events,best_lazy);
+
+   iobuf->input_file = NULL;
+   free_io_buffer(iobuf);
+}
+
+/* --------------------------- bench_pyhessio --------------------------- */
+/**
+ *  Time the C layer behind the pyhessio event access: filling its
+ *  data structures block by block, and copying the ADC data of all
+ *  telescopes with data out of each event.
+ */
+
+static void bench_pyhessio (const struct bench_config *cfg, const char *fname);
+
+static void bench_pyhessio (const struct bench_config *cfg, const char *fname)
+{
+   int irep, tel_list[H_MAX_TEL];
+   double best_fill = 1e30, best_get = 1e30;
+   unsigned long nblocks = 0, nget = 0;
+   double bytes_get = 0.;
+   size_t nbuf = (size_t) cfg->npix * (cfg->nsamples > 0 ? cfg->nsamples : 1);
+   uint16_t *sbuf = (uint16_t *) calloc(nbuf,sizeof(uint16_t));
+   uint32_t *abuf = (uint32_t *) calloc(cfg->npix,sizeof(uint32_t));
+
+   if ( !bench_wanted("pyhessio") )
+      return;
+   if ( sbuf == NULL || abuf == NULL )
+      exit(1);
+
+   for ( irep=0; irep<cfg->repeat; irep++ )
+   {
+      double t, t_fill = 0., t_get = 0.;
+      int rc;
+      if ( file_open(fname) != 0 )
+      {
+         fprintf(stderr,"pyhessio file_open failed for %s\n", fname);
+         break;
+      }
+      nblocks = nget = 0;
+      bytes_get = 0.;
+      for (;;)
+      {
+         t = bench_now();
+         rc = move_to_next();
+         t_fill += bench_now() - t;
+         if ( rc < 0 )
+            break;
+         nblocks++;
+         if ( rc == IO_TYPE_HESS_EVENT )
+         {
+            int n, i, ichan;
+            t = bench_now();
+            n = get_num_teldata();
+            get_telescope_with_data_list(tel_list);
+            for ( i=0; i<n; i++ )
+            {
+               int nchan = get_num_channel(tel_list[i]);
+               for ( ichan=0; ichan<nchan; ichan++ )
+               {
+                  if ( cfg->nsamples > 0 )
+                     get_adc_sample(tel_list[i],ichan,sbuf);
+                  get_adc_sum(tel_list[i],ichan,abuf);
+                  nget++;
+               }
+            }
+            t_get += bench_now() - t;
+            bytes_get += (double) n * cfg->ngains * cfg->npix *
+               (sizeof(uint32_t) + cfg->nsamples*sizeof(uint16_t));
+         }
+      }
+      close_file();
+      if ( t_fill < best_fill )
+         best_fill = t_fill;
+      if ( t_get < best_get )
+         best_get = t_get;
+   }
+
+   bench_report("pyhessio.fill_hsdata",nblocks,0.,best_fill);
+   bench_report("pyhessio.get_adc",nget,bytes_get,best_get);
+   free(sbuf);
+   free(abuf);
+}
+
+/* ---------------------------- bench_reco ------------------------------ */
+/**
+ *  Time reconstruct() for the available integration schemes.
+ *  Calibration, cleaning and image parameters are broken out
+ *  from the stage timing accumulated in reconstruct().
+ */
+
+static void bench_reco (const struct bench_config *cfg, FILE *f);
+
+static void bench_reco (const struct bench_config *cfg, FILE *f)
+{
+   static double min_amp[H_MAX_TEL], tcl[H_MAX_TEL], tch[H_MAX_TEL], minfrac[H_MAX_TEL];
+   static size_t min_pix[H_MAX_TEL];
+   static int lref[H_MAX_TEL];
+   IO_BUFFER *iobuf;
+   IO_ITEM_HEADER item_header;
+   int itel, integrator, irep;
+   const int integrators[] = { 1, 2, 3, 4, 5, 6 };
+   int nintegrators = (cfg->nsamples > 0) ? (int) (sizeof(integrators)/sizeof(integrators[0])) : 1;
+   char name[64];
+
+   if ( !bench_wanted("reco") )
+      return;
+   if ( (iobuf = allocate_io_buffer(1000000L)) == NULL )
+      exit(1);
+   iobuf->max_length = 200000000L;
+
+   for ( itel=0; itel<cfg->ntel; itel++ )
+   {
+      min_amp[itel] = 50.;
+      min_pix[itel] = 3;
+      tcl[itel] = 5.;
+      tch[itel] = 10.;
+      lref[itel] = 0;
+      minfrac[itel] = 0.;
+   }
+   user_init_parameters();
+   user_set_tail_cuts(5.,10.,0,0.);
+   user_set_verbosity(-1);
+   set_reco_verbosity(-1);
+
+   for ( integrator=0; integrator<nintegrators; integrator++ )
+   {
+      double best = 1e30, best_stage[3] = { 1e30, 1e30, 1e30 };
+      unsigned long nimg = 0;
+      const int stages[3] = { STAGE_CALIBRATION, STAGE_CLEANING, STAGE_IMAGE };
+      int is;
+
+      if ( cfg->nsamples > 0 )
+      {
+         user_set_integrator(integrators[integrator]);
+         user_set_integ_window(cfg->nsamples > 10 ? 7 : cfg->nsamples/2, 2, 0);
+      }
+      else
+         user_set_integrator(0);
+
+      for ( irep=0; irep<cfg->repeat; irep++ )
+      {
+         double t, t_reco = 0.;
+         rewind(f);
+         iobuf->input_file = f;
+         nimg = 0;
+         stage_timing_enable(1);
+         while ( find_io_block(iobuf,&item_header) == 0 &&
+                 read_io_block(iobuf,&item_header) == 0 )
+         {
+            if ( item_header.type != IO_TYPE_HESS_EVENT )
+               continue;
+            if ( read_hess_event(iobuf,&hsdata->event,-1) < 0 )
+               continue;
+            t = bench_now();
+            reconstruct(hsdata,3,min_amp,min_pix,tcl,tch,lref,minfrac,-1,0,0);
+            t_reco += bench_now() - t;
+            nimg += hsdata->event.num_teldata;
+         }
+         if ( t_reco < best )
+            best = t_reco;
+         for ( is=0; is<3; is++ )
+         {
+            double ts = stage_timing_total(stages[is],NULL);
+            if ( ts < best_stage[is] )
+               best_stage[is] = ts;
+         }
+         stage_timing_enable(0);
+      }
+
+      if ( cfg->nsamples > 0 )
+         snprintf(name,sizeof(name),"reco.integrator%d", integrators[integrator]);
+      else
+         snprintf(name,sizeof(name),"reco.sums");
+      bench_report(name,nimg,0.,best);
+      if ( integrator == 0 )
+      {
+         bench_report("reco.calibration",nimg,0.,best_stage[0]);
+         bench_report("reco.cleaning",nimg,0.,best_stage[1]);
+         bench_report("reco.image",nimg,0.,best_stage[2]);
+      }
+   }
+
+   iobuf->input_file = NULL;
+   free_io_buffer(iobuf);
+}
+
+/* ------------------------- bench_fuzz_samples ------------------------- */
+/**
+ *  Check that the fast decoder for sampled ADC data gives exactly the
+ *  same results as the general code path, on random blocks of random
+ *  size and contents, in part with corrupted sample data, and with
+ *  or without sums known beforehand. Returns the number of blocks
+ *  where the decoded data differs.
+ */
+
+static int bench_fuzz_samples (int nfuzz);
+
+static int bench_fuzz_samples (int nfuzz)
+{
+   IO_BUFFER *iobuf;
+   IO_ITEM_HEADER item_header;
+   AdcData *raw0, *raw[2];
+   FILE *f;
+   int ifuzz, ipix, igain, is, k, nbad = 0, ncorrupt = 0;
+   int rc[2];
+
+   raw0 = (AdcData *) calloc(1,sizeof(AdcData));
+   raw[0] = (AdcData *) calloc(1,sizeof(AdcData));
+   raw[1] = (AdcData *) calloc(1,sizeof(AdcData));
+   if ( raw0 == NULL || raw[0] == NULL || raw[1] == NULL ||
+        (iobuf = allocate_io_buffer(1000000L)) == NULL ||
+        (f = tmpfile()) == NULL )
+   {
+      fprintf(stderr,"Not enough memory.\n");
+      exit(1);
+   }
+   iobuf->max_length = 200000000L;
+
+   for ( ifuzz=0; ifuzz<nfuzz; ifuzz++ )
+   {
+      int what = (bench_rndm() < 0.8) ? -1 : RAWDATA_FLAG;
+      double psum = (bench_rndm() < 0.5) ? 0. : bench_rndm();
+
+      memset(raw0,0,sizeof(AdcData));
+      raw0->tel_id = 1;
+      raw0->known = 1;
+      if ( bench_rndm() < 0.3 )
+         raw0->num_pixels = 1 + (int) (bench_rndm()*20);
+      else
+         raw0->num_pixels = 1 + (int) (bench_rndm()*H_MAX_PIX);
+      if ( raw0->num_pixels > H_MAX_PIX )
+         raw0->num_pixels = H_MAX_PIX;
+      raw0->num_gains = 1 + (int) (bench_rndm()*H_MAX_GAINS);
+      if ( raw0->num_gains > H_MAX_GAINS )
+         raw0->num_gains = H_MAX_GAINS;
+      if ( bench_rndm() < 0.3 )
+         raw0->num_samples = (int) (bench_rndm()*(H_MAX_SLICES+1));
+      else
+         raw0->num_samples = (int) (bench_rndm()*40);
+      if ( raw0->num_samples > H_MAX_SLICES )
+         raw0->num_samples = H_MAX_SLICES;
+      for ( igain=0; igain<raw0->num_gains; igain++ )
+         for ( ipix=0; ipix<raw0->num_pixels; ipix++ )
+         {
+            /* Differences coded in one, two or three bytes */
+            double r = bench_rndm();
+            int range = (r < 0.6) ? 60 : (r < 0.9) ? 8000 : 65536;
+            int32_t val = (int32_t) (bench_rndm()*65536.);
+            for ( is=0; is<raw0->num_samples; is++ )
+            {
+               val += (int32_t) ((bench_rndm()-0.5)*range);
+               if ( val < 0 || val > 65535 )
+                  val = (int32_t) (bench_rndm()*65536.);
+               raw0->adc_sample[igain][ipix][is] = (uint16_t) val;
+            }
+         }
+
+      /* One block written, to be read back and decoded twice */
+      rewind(f);
+      iobuf->output_file = f;
+      write_hess_teladc_samples(iobuf,raw0);
+      fflush(f);
+      rewind(f);
+      iobuf->output_file = NULL;
+      iobuf->input_file = f;
+      if ( find_io_block(iobuf,&item_header) != 0 ||
+           read_io_block(iobuf,&item_header) != 0 )
+      {
+         fprintf(stderr,"Reading back random ADC samples block failed.\n");
+         nbad++;
+         break;
+      }
+      iobuf->input_file = NULL;
+      if ( bench_rndm() < 0.1 && item_header.length > 8 )
+      {
+         /* Corrupted sample data, behind the block header and sizes */
+         int n = 1 + (int) (bench_rndm()*4);
+         for ( k=0; k<n; k++ )
+            iobuf->buffer[24 + (long) (bench_rndm()*(item_header.length-8))] = 
+               (BYTE) (bench_rndm()*256.);
+         ncorrupt++;
+      }
+
+      /* Sums may be known beforehand (sum data preceding the samples). */
+      memset(raw0->adc_sample,0,sizeof(raw0->adc_sample));
+      for ( igain=0; igain<raw0->num_gains; igain++ )
+         for ( ipix=0; ipix<raw0->num_pixels; ipix++ )
+         {
+            raw0->adc_known[igain][ipix] = 0;
+            raw0->adc_sum[igain][ipix] = 0;
+            if ( bench_rndm() < psum )
+            {
+               raw0->adc_known[igain][ipix] = 1;
+               raw0->adc_sum[igain][ipix] = (uint32_t) (bench_rndm()*1e6);
+            }
+         }
+
+      for ( k=0; k<2; k++ )
+      {
+         memcpy(raw[k],raw0,sizeof(AdcData));
+         set_hess_fast_samples(k==0);
+         rc[k] = read_hess_teladc_samples(iobuf,raw[k],what);
+      }
+      if ( rc[0] != rc[1] || memcmp(raw[0],raw[1],sizeof(AdcData)) != 0 )
+      {
+         printf("# Block %d (pixels=%d gains=%d samples=%d) differs between fast and general decoding\n",
+            ifuzz, raw0->num_pixels, raw0->num_gains, raw0->num_samples);
+         nbad++;
+      }
+   }
+   set_hess_fast_samples(1);
+
+   printf("# fuzz.teladc_samples: %d blocks (%d corrupted), %d different\n",
+      nfuzz, ncorrupt, nbad);
+
+   fclose(f);
+   free_io_buffer(iobuf);
+   free(raw0);
+   free(raw[0]);
+   free(raw[1]);
+   return nbad;
+}
+
+/* ------------------------- bench_fuzz_moments ------------------------- */
+/**
+ *  Check the one-pass image moments (image_moments_soa() and
+ *  sum_weighted_powers(), as used in reconstruct()) against the
+ *  straight sums over the image pixels done before, on random
+ *  elliptical images of random size. Central second moments must
+ *  agree to a small fraction of the image extent (1e-9 in double
+ *  precision, 1e-4 with single precision sums), higher moments
+ *  along the major axis to 1e-9 of their scale. Returns the number
+ *  of images where they do not.
+ */
+
+static int bench_fuzz_moments (int nfuzz);
+
+static int bench_fuzz_moments (int nfuzz)
+{
+#ifdef HILLAS_FLOAT_SUMS
+   const double tol = 1e-4;
+#else
+   const double tol = 1e-9;
+#endif
+   double *x, *y, *a, *p;
+   double maxdev = 0.;
+   int ifuzz, nbad = 0;
+
+   x = (double *) calloc(4*(size_t)H_MAX_PIX,sizeof(double));
+   if ( x == NULL )
+   {
+      fprintf(stderr,"Not enough memory.\n");
+      exit(1);
+   }
+   y = x + H_MAX_PIX;
+   a = y + H_MAX_PIX;
+   p = a + H_MAX_PIX;
+
+   for ( ifuzz=0; ifuzz<nfuzz; ifuzz++ )
+   {
+      int n = 2 + (int) (bench_rndm()*((bench_rndm() < 0.5) ? 50 : 3000));
+      double xc = 2.*(bench_rndm()-0.5), yc = 2.*(bench_rndm()-0.5);
+      double phi = M_PI*bench_rndm(), cp = cos(phi), sp = sin(phi);
+      double wid = 0.01 + 0.05*bench_rndm(), len = wid * (1.+3.*bench_rndm());
+      double sA = 0., sx = 0., sy = 0., sxx = 0., sxy = 0., syy = 0.;
+      double s[5], x0, y0, ahot = -1., tx, ty, txx, txy, tyy, b, cb, sb;
+      double rxx = 0., rx3 = 0., rx4 = 0., scale, dev;
+      int j;
+
+      if ( n > H_MAX_PIX )
+         n = H_MAX_PIX;
+      x0 = y0 = 0.;
+      for ( j=0; j<n; j++ )
+      {
+         double u = len*3.*(bench_rndm()-0.5), v = wid*3.*(bench_rndm()-0.5);
+         x[j] = xc + cp*u - sp*v;
+         y[j] = yc + sp*u + cp*v;
+         a[j] = 5. + 1000.*exp(-0.5*(u*u/(len*len)+v*v/(wid*wid))) * bench_rndm();
+         if ( a[j] > ahot )
+         {
+            ahot = a[j];
+            x0 = x[j];
+            y0 = y[j];
+         }
+      }
+
+      /* Reference: straight sums, as in second_moments() before */
+      for ( j=0; j<n; j++ )
+      {
+         sA  += a[j];
+         sx  += (a[j] * x[j]);
+         sxx += (a[j] * x[j]) * x[j];
+         sxy += (a[j] * x[j]) * y[j];
+         sy  += (a[j] * y[j]);
+         syy += (a[j] * y[j]) * y[j];
+      }
+      sx /= sA;
+      sy /= sA;
+      sxx = sxx/sA - sx*sx;
+      sxy = sxy/sA - sx*sy;
+      syy = syy/sA - sy*sy;
+
+      /* Tested: one pass relative to the hottest pixel */
+      image_moments_soa(x, y, a, n, x0, y0, s);
+      tx = s[0]/sA;
+      ty = s[1]/sA;
+      txx = s[2]/sA - tx*tx;
+      txy = s[3]/sA - tx*ty;
+      tyy = s[4]/sA - ty*ty;
+      tx += x0;
+      ty += y0;
+
+      scale = sxx + syy;
+      dev = fabs(tx-sx)/sqrt(scale);
+      if ( fabs(ty-sy)/sqrt(scale) > dev )
+         dev = fabs(ty-sy)/sqrt(scale);
+      if ( fabs(txx-sxx)/scale > dev )
+         dev = fabs(txx-sxx)/scale;
+      if ( fabs(txy-sxy)/scale > dev )
+         dev = fabs(txy-sxy)/scale;
+      if ( fabs(tyy-syy)/scale > dev )
+         dev = fabs(tyy-syy)/scale;
+
+      /* Higher moments along the major axis, both ways */
+      b = atan2(2.*sxy, sxx-syy) / 2.;
+      cb = cos(b);
+      sb = sin(b);
+      for ( j=0; j<n; j++ )
+      {
+         double xp = cb*(x[j]-sx) + sb*(y[j]-sy);
+         p[j] = xp;
+         rxx += (a[j]*xp) * xp;
+         rx3 += ((a[j]*xp) * xp) * xp;
+         rx4 += (((a[j]*xp) * xp) * xp) * xp;
+      }
+      sum_weighted_powers(p, a, (size_t) n, s);
+      if ( fabs(s[2]-rxx) > 1e-9*rxx ||
+           fabs(s[3]-rx3) > 1e-9*sqrt(rxx*rxx*rxx/sA) ||
+           fabs(s[4]-rx4) > 1e-9*rx4 )
+         dev = 1.;
+
+      if ( dev > maxdev )
+         maxdev = dev;
+      if ( dev > tol )
+      {
+         printf("# Image %d (%d pixels) moments differ by %g of the image extent\n",
+            ifuzz, n, dev);
+         nbad++;
+      }
+   }
+
+   printf("# fuzz.image_moments: %d images, %d different (largest deviation %g)\n",
+      nfuzz, nbad, maxdev);
+
+   free(x);
+   return nbad;
+}
+
+/* --------------------------- bench_fuzz_lazy -------------------------- */
+/**
+ *  Check that decoding telescope events on demand (lazy mode) gives
+ *  exactly the same results as decoding them right away, on random
+ *  sequences of ADC sum, ADC sample and image sub-items. With more
+ *  sub-items than can be kept for later (H_MAX_LAZY_ITEMS), lazy mode
+ *  has to give up in the middle of the event. Returns the number of
+ *  events where the decoded data differs.
+ */
+
+#define FUZZ_IMG_SETS 12
+
+static int bench_fuzz_lazy (int nfuzz);
+
+static int bench_fuzz_lazy (int nfuzz)
+{
+   IO_BUFFER *iobuf;
+   IO_ITEM_HEADER item_header;
+   TelEvent *src, *te[2];
+   FILE *f;
+   int ifuzz, ipix, igain, is, k, nbad = 0, nover = 0;
+   int rc[2];
+
+   src = (TelEvent *) calloc(3,sizeof(TelEvent));
+   if ( src == NULL || (iobuf = allocate_io_buffer(1000000L)) == NULL ||
+        (f = tmpfile()) == NULL )
+   {
+      fprintf(stderr,"Not enough memory.\n");
+      exit(1);
+   }
+   iobuf->max_length = 200000000L;
+   te[0] = src + 1;
+   te[1] = src + 2;
+   for ( k=0; k<3; k++ )
+   {
+      src[k].raw = (AdcData *) calloc(1,sizeof(AdcData));
+      src[k].pixtm = (PixelTiming *) calloc(1,sizeof(PixelTiming));
+      src[k].img = (ImgData *) calloc(FUZZ_IMG_SETS,sizeof(ImgData));
+      if ( src[k].raw == NULL || src[k].pixtm == NULL || src[k].img == NULL )
+      {
+         fprintf(stderr,"Not enough memory.\n");
+         exit(1);
+      }
+   }
+
+   for ( ifuzz=0; ifuzz<nfuzz; ifuzz++ )
+   {
+      AdcData *raw = src->raw;
+      int nitems = 1 + (int) (bench_rndm()*16), nimg = 0, item;
+
+      src->tel_id = 1;
+      src->known = 1;
+      src->glob_count = src->loc_count = ifuzz + 1;
+      memset(raw,0,sizeof(AdcData));
+      raw->tel_id = 1;
+      raw->known = 1;
+      raw->num_pixels = 1 + (int) (bench_rndm()*200);
+      raw->num_gains = 1 + (int) (bench_rndm()*H_MAX_GAINS);
+      if ( raw->num_gains > H_MAX_GAINS )
+         raw->num_gains = H_MAX_GAINS;
+      raw->num_samples = 1 + (int) (bench_rndm()*30);
+      if ( raw->num_samples > H_MAX_SLICES )
+         raw->num_samples = H_MAX_SLICES;
+
+      /* One telescope event with a random sequence of sub-items */
+      rewind(f);
+      iobuf->output_file = f;
+      item_header.type = IO_TYPE_HESS_TELEVENT + 1;
+      item_header.version = 1;
+      item_header.ident = src->glob_count;
+      put_item_begin(iobuf,&item_header);
+      write_hess_televt_head(iobuf,src);
+      for ( item=0; item<nitems; item++ )
+      {
+         double r = bench_rndm();
+         if ( r < 0.4 && nimg < FUZZ_IMG_SETS )
+         {
+            ImgData *img = &src->img[nimg++];
+            memset(img,0,sizeof(ImgData));
+            img->tel_id = 1;
+            img->known = 1;
+            img->cut_id = nimg;
+            img->pixels = (int) (bench_rndm()*raw->num_pixels);
+            img->amplitude = 1e4*bench_rndm();
+            img->x = bench_rndm()-0.5;
+            img->y = bench_rndm()-0.5;
+            img->phi = M_PI*bench_rndm();
+            img->l = 0.1*bench_rndm();
+            img->w = 0.5*img->l;
+            img->skewness_err = img->kurtosis_err = -1.;
+            write_hess_telimage(iobuf,img,-1);
+         }
+         else
+         {
+            /* New random ADC data, for sums and samples alike */
+            for ( igain=0; igain<raw->num_gains; igain++ )
+               for ( ipix=0; ipix<raw->num_pixels; ipix++ )
+               {
+                  uint32_t sum = 0;
+                  raw->adc_known[igain][ipix] = 1;
+                  for ( is=0; is<raw->num_samples; is++ )
+                  {
+                     raw->adc_sample[igain][ipix][is] = (uint16_t) (bench_rndm()*4096.);
+                     sum += raw->adc_sample[igain][ipix][is];
+                  }
+                  raw->adc_sum[igain][ipix] = sum;
+               }
+            if ( r < 0.7 )
+               write_hess_teladc_sums(iobuf,raw);
+            else
+               write_hess_teladc_samples(iobuf,raw);
+         }
+      }
+      put_item_end(iobuf,&item_header);
+      fflush(f);
+      if ( nitems > H_MAX_LAZY_ITEMS )
+         nover++;
+
+      rewind(f);
+      iobuf->output_file = NULL;
+      iobuf->input_file = f;
+      if ( find_io_block(iobuf,&item_header) != 0 ||
+           read_io_block(iobuf,&item_header) != 0 )
+      {
+         fprintf(stderr,"Reading back random telescope event failed.\n");
+         nbad++;
+         break;
+      }
+      iobuf->input_file = NULL;
+
+      /* Decoded right away and on demand, from the same initial state */
+      for ( k=0; k<2; k++ )
+      {
+         memset(te[k]->raw,0,sizeof(AdcData));
+         memset(te[k]->pixtm,0,sizeof(PixelTiming));
+         memset(te[k]->img,0,FUZZ_IMG_SETS*sizeof(ImgData));
+         te[k]->tel_id = te[k]->raw->tel_id = te[k]->pixtm->tel_id = 1;
+         for ( is=0; is<FUZZ_IMG_SETS; is++ )
+            te[k]->img[is].tel_id = 1;
+         te[k]->max_image_sets = FUZZ_IMG_SETS;
+         te[k]->num_image_sets = 0;
+         te[k]->lazy = k;
+         rc[k] = read_hess_televent(iobuf,te[k],-1);
+         if ( rc[k] == 0 && k == 1 )
+            rc[k] = hess_televent_decode(te[k],-1);
+      }
+      if ( rc[0] != rc[1] || rc[0] != 0 ||
+           te[0]->readout_mode != te[1]->readout_mode ||
+           te[0]->num_image_sets != te[1]->num_image_sets ||
+           te[0]->num_image_sets != nimg || te[1]->num_lazy != 0 ||
+           memcmp(te[0]->raw,te[1]->raw,sizeof(AdcData)) != 0 ||
+           memcmp(te[0]->img,te[1]->img,FUZZ_IMG_SETS*sizeof(ImgData)) != 0 )
+      {
+         printf("# Event %d (%d sub-items, %d images) differs between immediate and lazy decoding\n",
+            ifuzz, nitems, nimg);
+         nbad++;
+      }
+   }
+
+   printf("# fuzz.televent_lazy: %d events (%d beyond lazy limit), %d different\n",
+      nfuzz, nover, nbad);
+
+   fclose(f);
+   free_io_buffer(iobuf);
+   for ( k=0; k<3; k++ )
+   {
+      free(src[k].raw);
+      free(src[k].pixtm);
+      free(src[k].img);
+   }
+   free(src);
+   return nbad;
+}
+
+/* -------------------------- bench_baseline ---------------------------- */
+/**
+ *  Compare results with those listed in a baseline file.
+ *
+ *  @return Number of benchmarks slower than tolerated, or -1 on error.
+ */
+
+static int bench_baseline (const char *fname, double tolerance);
+
+static int bench_baseline (const char *fname, double tolerance)
+{
+   FILE *f;
+   char line[1024], name[64];
+   unsigned long items;
+   double ns, mbs;
+   int nbad = 0, i;
+
+   if ( (f = fopen(fname,"r")) == NULL )
+   {
+      perror(fname);
+      return -1;
+   }
+   printf("\n# Comparison with baseline %s (tolerance %.1f%%):\n", fname, tolerance);
+   while ( fgets(line,sizeof(line)-1,f) != NULL )
+   {
+      if ( line[0] == '#' || sscanf(line,"%63s %lu %lf %lf",name,&items,&ns,&mbs) != 4 )
+         continue;
+      for ( i=0; i<num_results; i++ )
+      {
+         if ( strcmp(results[i].name,name) != 0 || ns <= 0. )
+            continue;
+         if ( results[i].ns_per_item > ns * (1.+0.01*tolerance) )
+         {
+            printf("# %-30s %12.2f -> %12.2f ns/item (%+.1f%%) SLOWER\n", name, ns,
+               results[i].ns_per_item, 100.*(results[i].ns_per_item/ns-1.));
+            nbad++;
+         }
+         else
+            printf("# %-30s %12.2f -> %12.2f ns/item (%+.1f%%)\n", name, ns,
+               results[i].ns_per_item, 100.*(results[i].ns_per_item/ns-1.));
+      }
+   }
+   fclose(f);
+   return nbad;
+}
+
+/* ------------------------------ syntax -------------------------------- */
+
+static void syntax (const char *prg);
+
+static void syntax (const char *prg)
+{
+   printf("Syntax: %s [ options ]\n", prg);
+   printf("Options:\n");
+   printf("   --telescopes n   (Number of telescopes, default: 4)\n");
+   printf("   --pixels n       (Number of pixels per camera, default: 1855)\n");
+   printf("   --gains n        (Number of gains, 1 or 2, default: 2)\n");
+   printf("   --samples n      (Number of samples per pixel, 0: sums only, default: 25)\n");
+   printf("   --zero-sup n     (Zero suppression mode for sums (and samples), default: 0)\n");
+   printf("   --sparse         (Read ADC data in sparse mode, see set_adc_sparse_mode())\n");
+   printf("   --events n       (Number of events generated, default: 50)\n");
+   printf("   --repeat n       (Repeat each measurement n times, default: 3)\n");
+   printf("   --seed n         (Seed for the synthetic data, default: 1)\n");
+   printf("   --only name      (Run only benchmarks with names starting like that)\n");
+   printf("   --keep fname     (Keep the generated data file under that name)\n");
+   printf("   --baseline fname (Compare with results listed in that file)\n");
+   printf("   --tolerance p    (Slow-down accepted against baseline [%%], default: 20)\n");
+   printf("   --fuzz n         (Only run self-checks of fast against general code on n random cases:\n"
+          "                     ADC sample decoding, image moments, lazy decoding)\n");
+   exit(1);
+}
+
+/* ------------------------------- main --------------------------------- */
+
+/** Main program */
+
+int main (int argc, char **argv)
+{
+   struct bench_config cfg;
+   const char *prg = argv[0];
+   const char *keep_fname = NULL, *baseline = NULL;
+   double tolerance = 20.;
+   char fname[1024];
+   FILE *f, *fadc;
+   int fd, rc = 0, nfuzz = 0;
+
+   cfg.ntel = 4;
+   cfg.npix = 1855;
+   cfg.ngains = 2;
+   cfg.nsamples = 25;
+   cfg.zero_sup = 0;
+   cfg.sparse = 0;
+   cfg.nevents = 50;
+   cfg.repeat = 3;
+   cfg.seed = 1;
+
+   while ( argc > 1 )
+   {
+      if ( strcmp(argv[1],"--sparse") == 0 )
+      {
+         cfg.sparse = 1;
+         argc--;
+         argv++;
+         continue;
+      }
+      else if ( strcmp(argv[1],"--telescopes") == 0 && argc > 2 )
+         cfg.ntel = atoi(argv[2]);
+      else if ( strcmp(argv[1],"--pixels") == 0 && argc > 2 )
+         cfg.npix = atoi(argv[2]);
+      else if ( strcmp(argv[1],"--gains") == 0 && argc > 2 )
+         cfg.ngains = atoi(argv[2]);
+      else if ( strcmp(argv[1],"--samples") == 0 && argc > 2 )
+         cfg.nsamples = atoi(argv[2]);
+      else if ( strcmp(argv[1],"--zero-sup") == 0 && argc > 2 )
+         cfg.zero_sup = atoi(argv[2]);
+      else if ( strcmp(argv[1],"--events") == 0 && argc > 2 )
+         cfg.nevents = atoi(argv[2]);
+      else if ( strcmp(argv[1],"--repeat") == 0 && argc > 2 )
+         cfg.repeat = atoi(argv[2]);
+      else if ( strcmp(argv[1],"--seed") == 0 && argc > 2 )
+         cfg.seed = (unsigned) atol(argv[2]);
+      else if ( strcmp(argv[1],"--only") == 0 && argc > 2 )
+         only_prefix = argv[2];
+      else if ( strcmp(argv[1],"--keep") == 0 && argc > 2 )
+         keep_fname = argv[2];
+      else if ( strcmp(argv[1],"--baseline") == 0 && argc > 2 )
+         baseline = argv[2];
+      else if ( strcmp(argv[1],"--tolerance") == 0 && argc > 2 )
+         tolerance = atof(argv[2]);
+      else if ( strcmp(argv[1],"--fuzz") == 0 && argc > 2 )
+         nfuzz = atoi(argv[2]);
+      else
+         syntax(prg);
+      argc -= 2;
+      argv += 2;
+   }
+
+   if ( cfg.ntel < 1 || cfg.ntel > H_MAX_TEL ||
+        cfg.npix < 1 || cfg.npix > H_MAX_PIX ||
+        cfg.ngains < 1 || cfg.ngains > H_MAX_GAINS ||
+        cfg.nsamples < 0 || cfg.nsamples > H_MAX_SLICES ||
+        cfg.zero_sup < 0 || cfg.zero_sup > 2 ||
+        cfg.nevents < 1 || cfg.repeat < 1 )
+   {
+      fprintf(stderr,"Configuration outside of the limits of this build.\n");
+      H_CHECK_MAX();
+      exit(1);
+   }
+   rndm_state = cfg.seed ? cfg.seed : 1;
+
+   if ( nfuzz > 0 )
+   {
+      int nbad = bench_fuzz_samples(nfuzz);
+      nbad += bench_fuzz_moments(nfuzz);
+      nbad += bench_fuzz_lazy(nfuzz);
+      return (nbad != 0) ? 3 : 0;
+   }
+
+   if ( (hsdata = (AllHessData *) calloc(1,sizeof(AllHessData))) == NULL )
+   {
+      fprintf(stderr,"Not enough memory.\n");
+      exit(1);
+   }
+
+   /* The pyhessio layer needs a file name. */
+   if ( keep_fname != NULL )
+   {
+      strncpy(fname,keep_fname,sizeof(fname)-1);
+      fname[sizeof(fname)-1] = '\0';
+      f = fopen(fname,"w+b");
+   }
+   else
+   {
+      const char *tmpdir = getenv("TMPDIR");
+      snprintf(fname,sizeof(fname),"%s/bench_hessio_XXXXXX",
+         tmpdir != NULL ? tmpdir : "/tmp");
+      if ( (fd = mkstemp(fname)) < 0 )
+         f = NULL;
+      else
+         f = fdopen(fd,"w+b");
+   }
+   if ( f == NULL || (fadc = tmpfile()) == NULL )
+   {
+      perror(fname);
+      exit(1);
+   }
+
+   printf("# bench_hessio format 1\n");
+   printf("# telescopes=%d pixels=%d gains=%d samples=%d zero_sup=%d%s events=%d repeat=%d seed=%u\n",
+      cfg.ntel, cfg.npix, cfg.ngains, cfg.nsamples, cfg.zero_sup,
+      cfg.sparse ? " sparse" : "", cfg.nevents, cfg.repeat, cfg.seed);
+
+   bench_fill_camera(&cfg);
+   if ( bench_generate(&cfg,f,fadc) != 0 )
+      rc = 1;
+   else
+   {
+      /* The generated data was filled in directly, not by the readers. */
+      int itel;
+      for ( itel=0; itel<cfg.ntel; itel++ )
+         set_adc_sparse_mode(hsdata->event.teldata[itel].raw,cfg.sparse);
+      printf("# %-30s %10s %12s %10s\n", "name", "items", "ns/item", "MB/s");
+      bench_varint(&cfg);
+      bench_sort(&cfg);
+      bench_blocks(&cfg,f,fadc);
+      bench_pyhessio(&cfg,fname);
+      bench_reco(&cfg,f);
+      if ( baseline != NULL )
+      {
+         int nbad = bench_baseline(baseline,tolerance);
+         if ( nbad != 0 )
+            rc = 2;
+      }
+   }
+
+   fclose(f);
+   fclose(fadc);
+   if ( keep_fname == NULL )
+      unlink(fname);
+
+   return rc;
+}
+
+/** @} */
@@ -213,6 +213,9 @@
 #ifdef OS_UNIX
 #include <unistd.h>
 #endif
+#ifdef _REENTRANT
+#include <pthread.h>
+#endif
 
 #ifdef __GLIBC__
 # ifdef __GNUC__
@@ -349,6 +352,7 @@ IO_BUFFER *allocate_io_buffer (size_t buflen)
    buf->extended = 0;
    buf->sync_err_count = 0;
    buf->sync_err_max = 100;
+   buf->async = NULL;
 
 #if ( defined(CPU_68K) || defined(CPU_RS6000) || defined(CPU_PowerPC) )
 # ifndef REVERSE_BYTE_ORDER
@@ -503,6 +507,8 @@ void free_io_buffer (IO_BUFFER *iobuf)
 {
    if ( iobuf != (IO_BUFFER *) NULL )
    {
+      if ( iobuf->async != NULL ) /* Pending output gets written first. */
+         (void) set_async_output(iobuf,0,0);
       if ( iobuf->buffer != (BYTE *) NULL && iobuf->is_allocated )
          free((void *)iobuf->buffer);
       free((void *)iobuf);
@@ -3119,6 +3125,32 @@ void get_vector_of_float (float *fvec, int num, IO_BUFFER *iobuf)
       return;
    }
 
+#ifdef IEEE_FLOAT_FORMAT
+   /* Same bit patterns and byte order treatment as for 32-bit integers, */
+   /* but only copied as bytes into the floats (no int32_t access to them). */
+   if ( sizeof(float) == 4 && num > 0 && iobuf->r_remaining >= 4*num )
+   {
+      iobuf->r_remaining -= 4*num;
+      if ( iobuf->byte_order == 0 )
+         COPY_BYTES((void *) fvec,(void *) iobuf->data,(size_t)(4*num));
+      else
+      {
+         uint32_t u;
+         for ( i=0; i<num; i++ )
+         {
+            COPY_BYTES((void *) &u,(void *) (iobuf->data+4*i),(size_t) 4);
+            u = (u >> 24) | ((u >> 8) & 0xff00U) | ((u << 8) & 0xff0000U) | (u << 24);
+            COPY_BYTES((void *) &fvec[i],(void *) &u,(size_t) 4);
+         }
+      }
+      iobuf->data += 4*num;
+#ifdef BUG_CHECK
+      bug_check(iobuf);
+#endif
+      return;
+   }
+#endif
+
    for (i=0; i<num; i++)
       fvec[i] = (float) get_real(iobuf);
 #ifdef BUG_CHECK
@@ -4515,6 +4547,266 @@ int reset_io_block (IO_BUFFER *iobuf)
    return 0;
 }
 
+#ifdef _REENTRANT
+/** One block copied for the writer thread, with its destination. */
+struct io_async_block
+{
+   unsigned char *data;  /**< Copy of the block (buffer re-used for later blocks). */
+   size_t length;        /**< Length of block data. */
+   size_t alloc;         /**< Allocated size of data buffer. */
+   FILE *output_file;    /**< Output stream at the time the block was written, */
+   int output_fileno;    /**< or output file descriptor. */
+};
+
+/** State of the writer thread for an I/O buffer in asynchronous mode. */
+struct _struct_IO_ASYNC
+{
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond_data;  /**< Signals blocks queued to the writer. */
+   pthread_cond_t cond_space; /**< Signals blocks written to the producer. */
+   struct io_async_block *ring; /**< Ring of block buffers. */
+   int nbuf;             /**< Number of buffers in ring. */
+   int head;             /**< Next buffer to be written. */
+   int count;            /**< Number of buffers queued (incl. the one being written). */
+   size_t queued_bytes;  /**< Bytes in queued buffers. */
+   size_t max_bytes;     /**< Producer waits if more than that would be queued. */
+   int stop;             /**< Tell the writer thread to finish. */
+   int error;            /**< Set after a write error, reported to producer. */
+};
+
+/* ------------------------ async_writer ------------------------- */
+/**
+ *  The writer thread writes queued blocks in order, to the
+ *  destination they had when they were passed to write_io_block().
+ */
+
+static void *async_writer (void *arg);
+
+static void *async_writer (void *arg)
+{
+   struct _struct_IO_ASYNC *as = (struct _struct_IO_ASYNC *) arg;
+
+   pthread_mutex_lock(&as->mutex);
+   for (;;)
+   {
+      struct io_async_block *b;
+      int err = 0;
+
+      while ( as->count == 0 && !as->stop )
+         pthread_cond_wait(&as->cond_data,&as->mutex);
+      if ( as->count == 0 )
+         break;
+      b = &as->ring[as->head];
+      pthread_mutex_unlock(&as->mutex);
+
+      if ( b->output_fileno >= 0 )
+      {
+         if ( write(b->output_fileno,(char *)b->data,b->length) == -1 )
+            err = 1;
+      }
+      else if ( fwrite((void *)b->data,(size_t)1,b->length,
+            b->output_file) != b->length )
+      {
+         if ( ferror(b->output_file) )
+         {
+            clearerr(b->output_file);
+            err = 1;
+         }
+      }
+
+      pthread_mutex_lock(&as->mutex);
+      if ( err )
+         as->error = 1;
+      as->queued_bytes -= b->length;
+      as->head = (as->head + 1) % as->nbuf;
+      as->count--;
+      pthread_cond_broadcast(&as->cond_space);
+   }
+   pthread_mutex_unlock(&as->mutex);
+
+   return NULL;
+}
+
+/* ------------------------ async_put_block ---------------------- */
+/**
+ *  Hand over a copy of the current block to the writer thread,
+ *  waiting as long as the queue is full.
+ */
+
+static int async_put_block (IO_BUFFER *iobuf, size_t length);
+
+static int async_put_block (IO_BUFFER *iobuf, size_t length)
+{
+   struct _struct_IO_ASYNC *as = iobuf->async;
+   struct io_async_block *b;
+   int rc = 0;
+
+   pthread_mutex_lock(&as->mutex);
+   while ( as->count >= as->nbuf ||
+           (as->count > 0 && as->queued_bytes + length > as->max_bytes) )
+      pthread_cond_wait(&as->cond_space,&as->mutex);
+   if ( as->error )
+   {
+      as->error = 0;
+      rc = -1;
+   }
+   /* With only one producer, this buffer is ours until it gets queued. */
+   b = &as->ring[(as->head + as->count) % as->nbuf];
+   pthread_mutex_unlock(&as->mutex);
+
+   if ( b->alloc < length || b->alloc > 4*length+1048576 )
+   {
+      unsigned char *d = (unsigned char *) malloc(length);
+      if ( d == NULL )
+      {
+         Warning("Not enough memory for asynchronous output");
+         return -1;
+      }
+      free(b->data);
+      b->data = d;
+      b->alloc = length;
+   }
+   memcpy(b->data,iobuf->buffer,length);
+   b->length = length;
+   b->output_file = iobuf->output_file;
+   b->output_fileno = iobuf->output_fileno;
+
+   pthread_mutex_lock(&as->mutex);
+   as->queued_bytes += length;
+   as->count++;
+   pthread_cond_signal(&as->cond_data);
+   pthread_mutex_unlock(&as->mutex);
+
+   return rc;
+}
+#endif
+
+/* ------------------------ set_async_output --------------------- */
+/**
+ *  @short Switch between asynchronous and synchronous output of an I/O buffer.
+ *
+ *  In asynchronous mode, write_io_block() copies the block into one
+ *  of a ring of 'nbuf' buffers (two for plain double-buffering) and
+ *  a writer thread does the actual output, in the same order. The
+ *  buffer contents remain available to the caller after writing,
+ *  like in synchronous mode. If all buffers are in use, or if the
+ *  queued blocks exceed 'max_bytes', write_io_block() waits.
+ *  Only output to a file descriptor or stream is done asynchronously,
+ *  a user function is always called directly.
+ *
+ *  Before closing or switching the output stream of the I/O buffer
+ *  with pending data, call flush_async_output() (or this function
+ *  with nbuf=0) to make sure everything has been written.
+ *  Other I/O buffers writing into the same stream from the same
+ *  thread must either flush the queue first or temporarily use the
+ *  same 'async' pointer, to keep the blocks in order.
+ *
+ *  @param  iobuf     The I/O buffer descriptor.
+ *  @param  nbuf      Number of block buffers, 0 to revert to synchronous output.
+ *  @param  max_bytes Maximum number of bytes queued (0: no limit besides nbuf).
+ *
+ *  @return  0 (O.k.),  -1 (error or not supported without threads, output stays synchronous)
+ */
+
+int set_async_output (IO_BUFFER *iobuf, int nbuf, size_t max_bytes)
+{
+#ifdef _REENTRANT
+   struct _struct_IO_ASYNC *as;
+   int rc = 0, i;
+
+   if ( iobuf == (IO_BUFFER *) NULL )
+      return -1;
+
+   if ( (as = iobuf->async) != NULL ) /* Finish previous mode */
+   {
+      rc = flush_async_output(iobuf);
+      pthread_mutex_lock(&as->mutex);
+      as->stop = 1;
+      pthread_cond_signal(&as->cond_data);
+      pthread_mutex_unlock(&as->mutex);
+      pthread_join(as->thread,NULL);
+      pthread_mutex_destroy(&as->mutex);
+      pthread_cond_destroy(&as->cond_data);
+      pthread_cond_destroy(&as->cond_space);
+      for ( i=0; i<as->nbuf; i++ )
+         free(as->ring[i].data);
+      free(as->ring);
+      free(as);
+      iobuf->async = NULL;
+   }
+   if ( nbuf <= 0 )
+      return rc;
+
+   if ( (as = (struct _struct_IO_ASYNC *) calloc(1,sizeof(struct _struct_IO_ASYNC))) == NULL ||
+        (as->ring = (struct io_async_block *) calloc(nbuf,sizeof(struct io_async_block))) == NULL )
+   {
+      Warning("Not enough memory for asynchronous output");
+      free(as);
+      return -1;
+   }
+   as->nbuf = nbuf;
+   as->max_bytes = (max_bytes > 0) ? max_bytes : (size_t) -1;
+   pthread_mutex_init(&as->mutex,NULL);
+   pthread_cond_init(&as->cond_data,NULL);
+   pthread_cond_init(&as->cond_space,NULL);
+   if ( pthread_create(&as->thread,NULL,async_writer,as) != 0 )
+   {
+      Warning("Cannot create writer thread; output stays synchronous");
+      pthread_mutex_destroy(&as->mutex);
+      pthread_cond_destroy(&as->cond_data);
+      pthread_cond_destroy(&as->cond_space);
+      free(as->ring);
+      free(as);
+      return -1;
+   }
+   iobuf->async = as;
+
+   return rc;
+#else
+   if ( iobuf == (IO_BUFFER *) NULL || nbuf > 0 )
+      return -1;
+   (void) max_bytes;
+   return 0;
+#endif
+}
+
+/* ----------------------- flush_async_output -------------------- */
+/**
+ *  @short Wait until all blocks queued for asynchronous output are written.
+ *
+ *  Without asynchronous output, nothing needs to be done.
+ *
+ *  @param  iobuf  The I/O buffer descriptor.
+ *
+ *  @return  0 (O.k.),  -1 (some earlier asynchronous write failed)
+ */
+
+int flush_async_output (IO_BUFFER *iobuf)
+{
+#ifdef _REENTRANT
+   struct _struct_IO_ASYNC *as;
+   int rc = 0;
+
+   if ( iobuf == (IO_BUFFER *) NULL || (as = iobuf->async) == NULL )
+      return 0;
+   pthread_mutex_lock(&as->mutex);
+   while ( as->count > 0 )
+      pthread_cond_wait(&as->cond_space,&as->mutex);
+   if ( as->error )
+   {
+      Warning("Output error for I/O buffer");
+      as->error = 0;
+      rc = -1;
+   }
+   pthread_mutex_unlock(&as->mutex);
+   return rc;
+#else
+   (void) iobuf;
+   return 0;
+#endif
+}
+
 /* ----------------------- write_io_block ------------------------ */
 /**
  *  @short Write an I/O block to the block's output.
@@ -4523,6 +4815,8 @@ int reset_io_block (IO_BUFFER *iobuf)
  *  which can be raw I/O (through write), buffered I/O (through
  *  fwrite) or user-defined I/O (through a user funtion).
  *  All items must have been closed before.
+ *  With asynchronous output (see set_async_output()), raw and
+ *  buffered I/O is done by a writer thread, on a copy of the block.
  *
  *  @param  iobuf  The I/O buffer descriptor.
  *
@@ -4561,6 +4855,17 @@ int write_io_block (IO_BUFFER *iobuf)
       Warning("Output cancelled due to invalid length of top item");
       rc = -1;
    }
+#ifdef _REENTRANT
+   else if ( iobuf->async != NULL &&
+             (iobuf->output_fileno >= 0 || iobuf->output_file != (FILE *) NULL) )
+   {
+      if ( async_put_block(iobuf,length) != 0 )
+      {
+         Warning("Output error for I/O buffer");
+         rc = -1;
+      }
+   }
+#endif
    else if ( iobuf->output_fileno >= 0 )
    {
       if (write(iobuf->output_fileno,(char *)iobuf->buffer,(size_t)length) == -1 )
@@ -4582,6 +4887,7 @@ int write_io_block (IO_BUFFER *iobuf)
    }
    else if ( iobuf->user_function != NULL )
    {
+      (void) flush_async_output(iobuf); /* Keep the order of any queued output. */
       rc = (iobuf->user_function)(iobuf->buffer,(long)length,1);
    }
    else
@@ -66,6 +66,8 @@ Options:
      --auto-trgmask  : Load trgmask.gz files for each input file where available.
      --min-trg-tel n : Require at least n telescopes in extracted event (default: 2).
      --verbose       : Show events being extracted.
+     --full-decode   : Decode and re-encode all telescope event data instead
+                       of copying it with re-mapped telescope IDs only.
 @endverbatim
  *
  *  @author  Konrad Bernloehr
@@ -145,6 +147,8 @@ static void syntax (const char *program)
    printf("     --auto-trgmask  : Load trgmask.gz files for each input file where available.\n");
    printf("     --min-trg-tel n : Require at least n telescopes in extracted event (default: 2).\n");
    printf("     --verbose       : Show events being extracted.\n");
+   printf("     --full-decode   : Decode and re-encode all telescope event data instead\n");
+   printf("                       of copying it with re-mapped telescope IDs only.\n");
    printf("\nCompiled for a maximum of %d telescopes before and after extracting.\n", H_MAX_TEL);
    printf("Linked against eventIO/hessio library\n");
 #ifdef EVENTIO_VERSION
@@ -274,6 +278,31 @@ int write_io_block_to_file (IO_BUFFER *iobuf, FILE *f)
    return rc;
 }
 
+/* ----------------------------------------------------------------------- */
+/*
+ *  Pass-through of telescope-specific event data (see
+ *  read_hess_event_pass_through() in the library):
+ *  Telescope event and tracking data blocks only get their
+ *  telescope IDs changed, without decoding and re-encoding them.
+ */
+
+static int pass_through = 1;     /**< Disabled with the '--full-decode' option. */
+
+static int pt_out_tel_id (int tel_id, int ifile);
+
+/**
+ *  Output telescope ID for an input telescope of given ID, for the
+ *  data passed through, or -1 if the telescope is not in the output.
+ */
+
+static int pt_out_tel_id (int tel_id, int ifile)
+{
+   int itel3 = find_out_tel_idx(tel_id,ifile);
+   if ( itel3 < 0 || itel3 >= H_MAX_TEL )
+      return -1;
+   return map_tel[itel3].tel_id;
+}
+
 /* ----------------------------------------------------------------------- */
 
 int check_for_delayed_write(IO_ITEM_HEADER *item_header, int ifile, AllHessData *hsdata_out, IO_BUFFER *iobuf_out);
@@ -323,9 +352,10 @@ printf("Delayed writing of data event %ld (current data block type: %d, id: %ld)
               hsdata_out->event.central.num_teldata >= min_trg )
          {
             set_tel_idx_ref(0);
-            rc = write_hess_event(iobuf_out,&hsdata_out->event,-1);
+            rc = write_hess_event_pass_through(iobuf_out,&hsdata_out->event,ev_hess_event);
          }
          ev_hess_event = 0;
+         reset_hess_pass_through();
       }
    }
    else if ( type == IO_TYPE_HESS_EVENT )
@@ -350,9 +380,10 @@ printf("Delayed writing of data event %ld (current data block type: %d, id: %ld)
               hsdata_out->event.central.num_teldata >= min_trg )
          {
             set_tel_idx_ref(0);
-            rc = write_hess_event(iobuf_out,&hsdata_out->event,-1);
+            rc = write_hess_event_pass_through(iobuf_out,&hsdata_out->event,ev_hess_event);
          }
          ev_hess_event = 0;
+         reset_hess_pass_through();
       }
    }
    else if ( type == IO_TYPE_HESS_MC_PE_SUM )
@@ -377,9 +408,10 @@ printf("Delayed writing of data event %ld (current data block type: %d, id: %ld)
               hsdata_out->event.central.num_teldata >= min_trg )
          {
             set_tel_idx_ref(0);
-            rc = write_hess_event(iobuf_out,&hsdata_out->event,-1);
+            rc = write_hess_event_pass_through(iobuf_out,&hsdata_out->event,ev_hess_event);
          }
          ev_hess_event = 0;
+         reset_hess_pass_through();
       }
    }
    return rc;
@@ -958,7 +990,12 @@ if ( ev_hess_event > 0 && ev_hess_event < item_header->ident )
          FullEvent *evi = &hsdata->event;
          FullEvent *evo = &hsdata_out->event;
          int j, ntrg=0, ndata=0, ndt=0;
-         rc = read_hess_event(iobuf,evi,-1);
+         int pt_list[H_MAX_TEL], npt=0;
+         rc = -3;
+         if ( pass_through )
+            rc = read_hess_event_pass_through(iobuf,evi,pt_out_tel_id,ifile,pt_list,&npt);
+         if ( rc == -3 ) /* Needs full decoding */
+            rc = read_hess_event(iobuf,evi,-1);
 	 if ( rc != 0 || verbose )
          {
             printf("read_hess_event(), rc = %d\n",rc);
@@ -1239,6 +1276,9 @@ if ( ev_hess_event > 0 && ev_hess_event < item_header->ident )
                ndt++;
             }
          }
+         /* Telescopes with event data passed through without decoding */
+         for ( j=0; j<npt && ndt<H_MAX_TEL; j++ )
+            evo->teldata_list[ndt++] = pt_list[j];
          ndt = evo->num_teldata = ndt;
          ev_hess_event = item_header->ident;
 if ( nlist < max_list || nlist%1000 ==0 )
@@ -1885,6 +1925,11 @@ int main (int argc, char **argv)
             verbose = 1;
 	    continue;
          }
+         else if ( strcmp(argv[iarg],"--full-decode") == 0 )
+         {
+            pass_through = 0;
+	    continue;
+         }
          else if ( strcmp(argv[iarg],"--min-trg-tel") == 0 && iarg+1<argc )
          {
             min_trg = atoi(argv[iarg+1]);
@@ -1984,6 +2029,12 @@ int main (int argc, char **argv)
    /* Allow buffers much larger than during simulation: most likely never exceeded */
    iobuf1->max_length = 400000000L;
    iobuf3->max_length = 400000000L;
+   /* Staging buffer for telescope data passed through without decoding */
+   if ( pass_through && init_hess_pass_through() != 0 )
+   {
+      Error("Cannot allocate I/O buffers");
+      exit(1);
+   }
 
    if ( auto_trgmask )
       check_autoload_trgmask(input_fname1, iobuf1, 1);
@@ -30,6 +30,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *  see how the lookup file should be called (depends on tail cut
  *  parameters, and so on).
  *
+ *  Histogram files from many runs can be given at once. They are read
+ *  and added up in parallel (see read_histogram_files()), and the
+ *  lookups for different telescope types are generated in parallel
+ *  as well, when compiled with _REENTRANT.
+ *
  *  @date    @verbatim CVS $Revision: 1.21 $ @endverbatim
  *  @version @verbatim CVS $Date: 2012/05/11 13:18:48 $ @endverbatim
  */
@@ -41,16 +46,21 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "io_histogram.h"
 #include "fileopen.h"
 
-HISTOGRAM *h18000, *h18001, *h18011, *h18012, *h18021, *h18022, *h18051, *h18052;
-HISTOGRAM *h18100, *h18101, *h18111, *h18112, *h18121, *h18122, *h18151, *h18152;
-HISTOGRAM *h18113, *h18114, *h18123, *h18124, *h18140, *h18141, *h18153, *h18154;
-HISTOGRAM *h18005, *h18006, *h18071, *h18072, *h18081, *h18082;
-HISTOGRAM *h18105, *h18106, *h18171, *h18172, *h18181, *h18182;
-HISTOGRAM *h18173, *h18174, *h18183, *h18184;
-HISTOGRAM *h18200, *h18201, *h18211, *h18212;
-HISTOGRAM *h18301, *h18311, *h18321, *h18322;
+/** The histograms used and generated for one telescope type. */
+
+struct type_lookups
+{
+   HISTOGRAM *h18000, *h18001, *h18011, *h18012, *h18021, *h18022, *h18051, *h18052;
+   HISTOGRAM *h18100, *h18101, *h18111, *h18112, *h18121, *h18122, *h18151, *h18152;
+   HISTOGRAM *h18113, *h18114, *h18123, *h18124, *h18140, *h18141, *h18153, *h18154;
+   HISTOGRAM *h18005, *h18006, *h18071, *h18072, *h18081, *h18082;
+   HISTOGRAM *h18105, *h18106, *h18171, *h18172, *h18181, *h18182;
+   HISTOGRAM *h18173, *h18174, *h18183, *h18184;
+};
 
-void fill_gaps(void);
+#define MAX_TEL_TYPES 20
+
+void fill_gaps(struct type_lookups *lh);
 
 /**
   * @short Fill gaps in those histograms used for generating the lookups.
@@ -59,11 +69,11 @@ void fill_gaps(void);
   * strategies for interpolation/extrapolation/smoothing.
   */
 
-void fill_gaps()
+void fill_gaps(struct type_lookups *lh)
 {
    int min_count = 50;
-   int nx = h18000->nbins;
-   int ny = h18000->nbins_2d;
+   int nx = lh->h18000->nbins;
+   int ny = lh->h18000->nbins_2d;
    int iy, ix, iy2;
    // double *ty, *ty2;
 
@@ -74,167 +84,167 @@ void fill_gaps()
 
    for (iy=0; iy<ny; iy++)
    {
-      double y = h18000->specific_2d.real.lower_limit + 
-             (iy+0.5) * (h18000->specific_2d.real.upper_limit
-                - h18000->specific_2d.real.lower_limit) /
-                 h18000->nbins_2d;
+      double y = lh->h18000->specific_2d.real.lower_limit + 
+             (iy+0.5) * (lh->h18000->specific_2d.real.upper_limit
+                - lh->h18000->specific_2d.real.lower_limit) /
+                 lh->h18000->nbins_2d;
       for (ix = 0; ix <nx; ix++ )
       {
          int ix1 = ix, ix2 = ix, kx = 0;
-         double x = h18000->specific.real.lower_limit + 
-                (ix+0.5) * (h18000->specific.real.upper_limit
-                   - h18000->specific.real.lower_limit) /
-                    h18000->nbins;
-         double ns = h18000->extension->ddata[ix+nx*iy],
-                nxs= h18000->extension->ddata[ix+nx*iy];
-         double s  = h18001->extension->ddata[ix+nx*iy],
-                sw = h18011->extension->ddata[ix+nx*iy],
-                sww= h18012->extension->ddata[ix+nx*iy],
-                sl = h18021->extension->ddata[ix+nx*iy],
-                sll= h18022->extension->ddata[ix+nx*iy],
-                xs = h18001->extension->ddata[ix+nx*iy],
-                se = h18051->extension->ddata[ix+nx*iy],
-                see= h18052->extension->ddata[ix+nx*iy];
+         double x = lh->h18000->specific.real.lower_limit + 
+                (ix+0.5) * (lh->h18000->specific.real.upper_limit
+                   - lh->h18000->specific.real.lower_limit) /
+                    lh->h18000->nbins;
+         double ns = lh->h18000->extension->ddata[ix+nx*iy],
+                nxs= lh->h18000->extension->ddata[ix+nx*iy];
+         double s  = lh->h18001->extension->ddata[ix+nx*iy],
+                sw = lh->h18011->extension->ddata[ix+nx*iy],
+                sww= lh->h18012->extension->ddata[ix+nx*iy],
+                sl = lh->h18021->extension->ddata[ix+nx*iy],
+                sll= lh->h18022->extension->ddata[ix+nx*iy],
+                xs = lh->h18001->extension->ddata[ix+nx*iy],
+                se = lh->h18051->extension->ddata[ix+nx*iy],
+                see= lh->h18052->extension->ddata[ix+nx*iy];
          while ( ns < min_count && kx<=5 )
          {
             kx++;
             if ( ix >= kx )
             {
                ix1 = ix-kx;
-               ns += h18000->extension->ddata[ix1+nx*iy];
-               s  += h18001->extension->ddata[ix1+nx*iy];
-               sw += h18011->extension->ddata[ix1+nx*iy];
-               sww+= h18012->extension->ddata[ix1+nx*iy];
-               sl += h18021->extension->ddata[ix1+nx*iy];
-               sll+= h18022->extension->ddata[ix1+nx*iy];
+               ns += lh->h18000->extension->ddata[ix1+nx*iy];
+               s  += lh->h18001->extension->ddata[ix1+nx*iy];
+               sw += lh->h18011->extension->ddata[ix1+nx*iy];
+               sww+= lh->h18012->extension->ddata[ix1+nx*iy];
+               sl += lh->h18021->extension->ddata[ix1+nx*iy];
+               sll+= lh->h18022->extension->ddata[ix1+nx*iy];
             }
             if ( ix+kx < nx )
             {
                ix2 = ix+kx;
-               ns += h18000->extension->ddata[ix2+nx*iy];
-               s  += h18001->extension->ddata[ix2+nx*iy];
-               sw += h18011->extension->ddata[ix2+nx*iy];
-               sww+= h18012->extension->ddata[ix2+nx*iy];
-               sl += h18021->extension->ddata[ix2+nx*iy];
-               sll+= h18022->extension->ddata[ix2+nx*iy];
+               ns += lh->h18000->extension->ddata[ix2+nx*iy];
+               s  += lh->h18001->extension->ddata[ix2+nx*iy];
+               sw += lh->h18011->extension->ddata[ix2+nx*iy];
+               sww+= lh->h18012->extension->ddata[ix2+nx*iy];
+               sl += lh->h18021->extension->ddata[ix2+nx*iy];
+               sll+= lh->h18022->extension->ddata[ix2+nx*iy];
             }
          }
          if ( ns >= min_count-1. )
          {
-            fill_histogram(h18100,x,y,ns);
-            fill_histogram(h18101,x,y,s);
-            fill_histogram(h18111,x,y,sw);
-            fill_histogram(h18112,x,y,sww);
-            fill_histogram(h18121,x,y,sl);
-            fill_histogram(h18122,x,y,sll);
+            fill_histogram(lh->h18100,x,y,ns);
+            fill_histogram(lh->h18101,x,y,s);
+            fill_histogram(lh->h18111,x,y,sw);
+            fill_histogram(lh->h18112,x,y,sww);
+            fill_histogram(lh->h18121,x,y,sl);
+            fill_histogram(lh->h18122,x,y,sll);
          }
          for ( iy2=iy-3; iy2<=iy+3; iy2++ )
          {
             double w = (iy2<iy) ? 1.-(iy-iy2)/4. : (iy2>iy) ? 1.-(iy2-iy)/4. : 0.;
             if ( iy2 >= 0 && iy2 < ny )
             {
-               nxs += w * h18000->extension->ddata[ix+nx*iy2];
-               xs  += w * h18001->extension->ddata[ix+nx*iy2];
-               se  += w * h18051->extension->ddata[ix+nx*iy2],
-               see += w * h18052->extension->ddata[ix+nx*iy2];
+               nxs += w * lh->h18000->extension->ddata[ix+nx*iy2];
+               xs  += w * lh->h18001->extension->ddata[ix+nx*iy2];
+               se  += w * lh->h18051->extension->ddata[ix+nx*iy2],
+               see += w * lh->h18052->extension->ddata[ix+nx*iy2];
             }
          }
          if ( nxs >= min_count-1. )
          {
-            fill_histogram(h18140,x,y,nxs);
-            fill_histogram(h18141,x,y,xs);
-            fill_histogram(h18151,x,y,se);
-            fill_histogram(h18152,x,y,see);
+            fill_histogram(lh->h18140,x,y,nxs);
+            fill_histogram(lh->h18141,x,y,xs);
+            fill_histogram(lh->h18151,x,y,se);
+            fill_histogram(lh->h18152,x,y,see);
          }
       }
 
    }
 
 
-   if ( h18005 == NULL || h18171 == NULL )
+   if ( lh->h18005 == NULL || lh->h18171 == NULL )
       return;
 
-   nx = h18005->nbins;
-   ny = h18005->nbins_2d;
+   nx = lh->h18005->nbins;
+   ny = lh->h18005->nbins_2d;
    
    for (iy=0; iy<ny; iy++)
    {
-      double y = h18005->specific_2d.real.lower_limit + 
-             (iy+0.5) * (h18005->specific_2d.real.upper_limit
-                - h18005->specific_2d.real.lower_limit) /
-                 h18005->nbins_2d;
+      double y = lh->h18005->specific_2d.real.lower_limit + 
+             (iy+0.5) * (lh->h18005->specific_2d.real.upper_limit
+                - lh->h18005->specific_2d.real.lower_limit) /
+                 lh->h18005->nbins_2d;
       for (ix = 0; ix <nx; ix++ )
       {
-         double x = h18005->specific.real.lower_limit + 
-                (ix+0.5) * (h18005->specific.real.upper_limit
-                   - h18005->specific.real.lower_limit) /
-                    h18005->nbins;
-         double ns = h18005->extension->ddata[ix+nx*iy];
-         double s  = h18006->extension->ddata[ix+nx*iy],
-                sr = h18071->extension->ddata[ix+nx*iy],
-                srr= h18072->extension->ddata[ix+nx*iy],
-                sd = h18081->extension->ddata[ix+nx*iy],
-                sdd= h18082->extension->ddata[ix+nx*iy];
+         double x = lh->h18005->specific.real.lower_limit + 
+                (ix+0.5) * (lh->h18005->specific.real.upper_limit
+                   - lh->h18005->specific.real.lower_limit) /
+                    lh->h18005->nbins;
+         double ns = lh->h18005->extension->ddata[ix+nx*iy];
+         double s  = lh->h18006->extension->ddata[ix+nx*iy],
+                sr = lh->h18071->extension->ddata[ix+nx*iy],
+                srr= lh->h18072->extension->ddata[ix+nx*iy],
+                sd = lh->h18081->extension->ddata[ix+nx*iy],
+                sdd= lh->h18082->extension->ddata[ix+nx*iy];
          
          /* No gap filling / smoothing here yet */
          
-         fill_histogram(h18105,x,y,ns);
-         fill_histogram(h18106,x,y,s);
-         fill_histogram(h18171,x,y,sr);
-         fill_histogram(h18172,x,y,srr);
-         fill_histogram(h18181,x,y,sd);
-         fill_histogram(h18182,x,y,sdd);
+         fill_histogram(lh->h18105,x,y,ns);
+         fill_histogram(lh->h18106,x,y,s);
+         fill_histogram(lh->h18171,x,y,sr);
+         fill_histogram(lh->h18172,x,y,srr);
+         fill_histogram(lh->h18181,x,y,sd);
+         fill_histogram(lh->h18182,x,y,sdd);
       }
    }
 }
 
-void gen_image_lookups(void);
+void gen_image_lookups(struct type_lookups *lh);
 
 /**
  *  @short Generate the lookups for image shape parameters and energy.
  */
 
-void gen_image_lookups()
+void gen_image_lookups(struct type_lookups *lh)
 {
-   int nx = h18000->nbins;
-   int ny = h18000->nbins_2d;
+   int nx = lh->h18000->nbins;
+   int ny = lh->h18000->nbins_2d;
    int iy, ix;
    if ( nx == 0 || ny == 0 )
       exit(1);
 
-   clear_histogram(h18113);
-   clear_histogram(h18114);
-   clear_histogram(h18123);
-   clear_histogram(h18124);
-   clear_histogram(h18153);
-   clear_histogram(h18154);
-   clear_histogram(h18173);
-   clear_histogram(h18174);
-   clear_histogram(h18183);
-   clear_histogram(h18184);
+   clear_histogram(lh->h18113);
+   clear_histogram(lh->h18114);
+   clear_histogram(lh->h18123);
+   clear_histogram(lh->h18124);
+   clear_histogram(lh->h18153);
+   clear_histogram(lh->h18154);
+   clear_histogram(lh->h18173);
+   clear_histogram(lh->h18174);
+   clear_histogram(lh->h18183);
+   clear_histogram(lh->h18184);
 
    for (iy=0; iy<ny; iy++)
    {
-      double y = h18000->specific_2d.real.lower_limit + 
-             (iy+0.5) * (h18000->specific_2d.real.upper_limit
-                - h18000->specific_2d.real.lower_limit) /
-                 h18000->nbins_2d;
+      double y = lh->h18000->specific_2d.real.lower_limit + 
+             (iy+0.5) * (lh->h18000->specific_2d.real.upper_limit
+                - lh->h18000->specific_2d.real.lower_limit) /
+                 lh->h18000->nbins_2d;
       for (ix = 0; ix <nx; ix++ )
       {
-         double x = h18000->specific.real.lower_limit + 
-                (ix+0.5) * (h18000->specific.real.upper_limit
-                   - h18000->specific.real.lower_limit) /
-                    h18000->nbins;
-         double ns = h18100->extension->ddata[ix+nx*iy];
-         double s  = h18101->extension->ddata[ix+nx*iy];
-         double sw = h18111->extension->ddata[ix+nx*iy];
-         double sww= h18112->extension->ddata[ix+nx*iy];
-         double sl = h18121->extension->ddata[ix+nx*iy];
-         double sll= h18122->extension->ddata[ix+nx*iy];
-         double nxs= h18140->extension->ddata[ix+nx*iy];
-         double xs = h18141->extension->ddata[ix+nx*iy];
-         double se = h18151->extension->ddata[ix+nx*iy];
-         double see= h18152->extension->ddata[ix+nx*iy];
+         double x = lh->h18000->specific.real.lower_limit + 
+                (ix+0.5) * (lh->h18000->specific.real.upper_limit
+                   - lh->h18000->specific.real.lower_limit) /
+                    lh->h18000->nbins;
+         double ns = lh->h18100->extension->ddata[ix+nx*iy];
+         double s  = lh->h18101->extension->ddata[ix+nx*iy];
+         double sw = lh->h18111->extension->ddata[ix+nx*iy];
+         double sww= lh->h18112->extension->ddata[ix+nx*iy];
+         double sl = lh->h18121->extension->ddata[ix+nx*iy];
+         double sll= lh->h18122->extension->ddata[ix+nx*iy];
+         double nxs= lh->h18140->extension->ddata[ix+nx*iy];
+         double xs = lh->h18141->extension->ddata[ix+nx*iy];
+         double se = lh->h18151->extension->ddata[ix+nx*iy];
+         double see= lh->h18152->extension->ddata[ix+nx*iy];
 
          double wm = 0., ws = 1e-10, lm = 0., ls = 1e-10, em = 0., es = 1e-10;
          if ( ns >= 2 && s > 0. )
@@ -250,38 +260,38 @@ void gen_image_lookups()
 	    es = sqrt((see/xs - em*em) * nxs/(nxs-1));
          }
 
-         fill_histogram(h18113,x,y,wm);
-         fill_histogram(h18114,x,y,ws);
-         fill_histogram(h18123,x,y,lm);
-         fill_histogram(h18124,x,y,ls);
-         fill_histogram(h18153,x,y,em);
-         fill_histogram(h18154,x,y,es);
+         fill_histogram(lh->h18113,x,y,wm);
+         fill_histogram(lh->h18114,x,y,ws);
+         fill_histogram(lh->h18123,x,y,lm);
+         fill_histogram(lh->h18124,x,y,ls);
+         fill_histogram(lh->h18153,x,y,em);
+         fill_histogram(lh->h18154,x,y,es);
       }
    }
 
-   if ( h18005 == NULL || h18171 == NULL )
+   if ( lh->h18005 == NULL || lh->h18171 == NULL )
       return;
 
-   nx = h18005->nbins;
-   ny = h18005->nbins_2d;
+   nx = lh->h18005->nbins;
+   ny = lh->h18005->nbins_2d;
    for (iy=0; iy<ny; iy++)
    {
-      double y = h18005->specific_2d.real.lower_limit + 
-             (iy+0.5) * (h18005->specific_2d.real.upper_limit
-                - h18005->specific_2d.real.lower_limit) /
-                 h18005->nbins_2d;
+      double y = lh->h18005->specific_2d.real.lower_limit + 
+             (iy+0.5) * (lh->h18005->specific_2d.real.upper_limit
+                - lh->h18005->specific_2d.real.lower_limit) /
+                 lh->h18005->nbins_2d;
       for (ix = 0; ix <nx; ix++ )
       {
-         double x = h18005->specific.real.lower_limit + 
-                (ix+0.5) * (h18005->specific.real.upper_limit
-                   - h18005->specific.real.lower_limit) /
-                    h18005->nbins;
-         double nwol = h18105->extension->ddata[ix+nx*iy];
-         double swol = h18106->extension->ddata[ix+nx*iy];
-         double rwol = h18171->extension->ddata[ix+nx*iy];
-         double rwol2= h18172->extension->ddata[ix+nx*iy];
-         double dwol = h18181->extension->ddata[ix+nx*iy];
-         double dwol2= h18182->extension->ddata[ix+nx*iy];
+         double x = lh->h18005->specific.real.lower_limit + 
+                (ix+0.5) * (lh->h18005->specific.real.upper_limit
+                   - lh->h18005->specific.real.lower_limit) /
+                    lh->h18005->nbins;
+         double nwol = lh->h18105->extension->ddata[ix+nx*iy];
+         double swol = lh->h18106->extension->ddata[ix+nx*iy];
+         double rwol = lh->h18171->extension->ddata[ix+nx*iy];
+         double rwol2= lh->h18172->extension->ddata[ix+nx*iy];
+         double dwol = lh->h18181->extension->ddata[ix+nx*iy];
+         double dwol2= lh->h18182->extension->ddata[ix+nx*iy];
          double rm = 0., rs = 0., dm= 0., ds = 0.;
 
          if ( nwol >= 1.999 && swol > 0. )
@@ -294,14 +304,110 @@ void gen_image_lookups()
                ds = sqrt((dwol2/swol-dm*dm) * nwol/(nwol-1.));
          }
 
-         fill_histogram(h18173,x,y,rm);
-         fill_histogram(h18174,x,y,rs);
-         fill_histogram(h18183,x,y,dm);
-         fill_histogram(h18184,x,y,ds);
+         fill_histogram(lh->h18173,x,y,rm);
+         fill_histogram(lh->h18174,x,y,rs);
+         fill_histogram(lh->h18183,x,y,dm);
+         fill_histogram(lh->h18184,x,y,ds);
       }
    }
 }
 
+/* ------------------------ gen_all_type_lookups ------------------- */
+
+#ifdef _REENTRANT
+/** Shared state of the threads generating the lookups. */
+struct type_lookups_job
+{
+   struct type_lookups *lookups;
+   int ntypes;
+   int next_type;
+   pthread_mutex_t lock;
+};
+
+static void *gen_type_lookups_thread (void *arg);
+
+/** Thread function: take the next telescope type until none is left. */
+
+static void *gen_type_lookups_thread (void *arg)
+{
+   struct type_lookups_job *job = (struct type_lookups_job *) arg;
+
+   for (;;)
+   {
+      int itype;
+      pthread_mutex_lock(&job->lock);
+      itype = job->next_type++;
+      pthread_mutex_unlock(&job->lock);
+      if ( itype >= job->ntypes )
+         break;
+      if ( job->lookups[itype].h18000 == NULL )
+         continue;
+      fill_gaps(&job->lookups[itype]);
+      gen_image_lookups(&job->lookups[itype]);
+   }
+   return NULL;
+}
+#endif
+
+void gen_all_type_lookups (struct type_lookups *lookups, int ntypes, int nthreads);
+
+/**
+ *  @short Fill gaps and generate the lookups for all telescope types.
+ *
+ *  All needed histograms must have been booked before. Since each
+ *  telescope type only fills its own histograms, the types can be
+ *  handled by separate threads (if compiled with _REENTRANT),
+ *  with the same results as for one type after the other.
+ *
+ *  @param lookups  The histograms for each type (h18000 is NULL
+ *                  for types without data).
+ *  @param ntypes   The number of telescope types.
+ *  @param nthreads Maximum number of threads to use.
+ */
+
+void gen_all_type_lookups (struct type_lookups *lookups, int ntypes, int nthreads)
+{
+   int itype;
+
+#ifdef _REENTRANT
+   if ( nthreads > ntypes )
+      nthreads = ntypes;
+   if ( nthreads > 1 )
+   {
+      struct type_lookups_job job;
+      pthread_t threads[MAX_TEL_TYPES];
+      int ithr, nstarted = 0;
+
+      job.lookups = lookups;
+      job.ntypes = ntypes;
+      job.next_type = 0;
+      pthread_mutex_init(&job.lock,NULL);
+      /* The calling thread does its share of the work as well. */
+      for ( ithr=0; ithr<nthreads-1; ithr++ )
+      {
+         if ( pthread_create(&threads[ithr],NULL,gen_type_lookups_thread,&job) != 0 )
+            break;
+         nstarted++;
+      }
+      (void) gen_type_lookups_thread(&job);
+      for ( ithr=0; ithr<nstarted; ithr++ )
+         pthread_join(threads[ithr],NULL);
+      pthread_mutex_destroy(&job.lock);
+      return;
+   }
+#else
+   (void) nthreads;
+#endif
+
+   for ( itype=0; itype<ntypes; itype++ )
+   {
+      if ( lookups[itype].h18000 == NULL )
+         continue;
+      fill_gaps(&lookups[itype]);
+      gen_image_lookups(&lookups[itype]);
+   }
+}
+
 void fill_ebias_correction(void);
 
 void fill_ebias_correction()
@@ -349,43 +455,113 @@ void syntax (char * prgm);
 
 void syntax (char * prgm)
 {
-   fprintf(stderr,"Syntax: %s [ input_file_name [ output_file_name ]\n", prgm);
+   fprintf(stderr,"Syntax: %s [ input_file_name [ output_file_name ] ]\n", prgm);
+   fprintf(stderr,"   or:  %s [ -j nthreads ] [ -o output_file_name ] input_file_name ...\n", prgm);
    fprintf(stderr,"Default input file name: user_histograms.hdata.gz\n");
    fprintf(stderr,"Default output file name: lookups.hdata.gz\n");
+   fprintf(stderr,"With several input files, their histograms get added up\n"
+                  "(except for the user parameters, taken from the first file).\n");
+   fprintf(stderr,"The '-j' option sets the number of threads for reading the\n"
+                  "input files and generating the lookups (default: number of CPUs).\n");
    exit(1);
 }
 
+static int set_lookup_ids (long *ids, int ntypes);
+
+/** Set up the list of histogram IDs to be read from the input files.
+    Anything else would be dropped before writing the lookups anyway. */
+
+static int set_lookup_ids (long *ids, int ntypes)
+{
+   int n = 0, tel_type, res_type, i;
+
+   for ( tel_type=0; tel_type<ntypes; tel_type++ )
+   {
+      long ht = 100000L*tel_type;
+      for ( i=18000; i<=18199; i++ )
+         ids[n++] = ht+i;
+      for ( i=18300; i<=18339; i++ )
+         ids[n++] = ht+i;
+   }
+   for ( i=18900; i<=18939; i++ )
+      ids[n++] = i;
+   for ( res_type=1; res_type<=7; res_type++ )
+   {
+      ids[n++] = 19001+100*res_type;
+      ids[n++] = 19002+100*res_type;
+   }
+   ids[n++] = 19114;
+   ids[n++] = 19119;
+
+   return n;
+}
+
+/** Upper limit for the number of IDs from set_lookup_ids(). */
+#define MAX_LOOKUP_IDS (240*MAX_TEL_TYPES+60)
+
 int main(int argc, char **argv)
 {
    double xylow[2], xyhigh[2];
    int nbins[2];
    HISTOGRAM *histo, *next_histo, *h;
-   const char *histo_file = "user_histograms.hdata.gz";
-   const char *lookup_file = "lookups.hdata.gz";
+   const char *default_file = "user_histograms.hdata.gz";
+   const char **histo_files = &default_file;
+   const char *lookup_file = NULL;
+   int nfiles = 1, nerr;
    int tel_type = 0, res_type = 0;
    char *prgm = argv[0];
    int uvers = 0, ntypes = 1;
-
-   if ( argc > 1 )
+   int nthreads = 1;
+   struct type_lookups lookups[MAX_TEL_TYPES];
+   HISTOGRAM_SET hset;
+   long uparam_id = 12099;
+   long *ids;
+   int nids;
+
+#if defined(_REENTRANT) && defined(_SC_NPROCESSORS_ONLN)
+   if ( (nthreads = (int) sysconf(_SC_NPROCESSORS_ONLN)) < 1 )
+      nthreads = 1;
+#endif
+
+   while ( argc > 1 && argv[1][0] == '-' )
    {
-      if ( strcmp(argv[1],"-h") == 0 || strcmp(argv[1],"--help") == 0 ||
-           argv[1][0] == '-'  )
+      if ( (strcmp(argv[1],"-j") == 0 || strcmp(argv[1],"--threads") == 0) && argc > 2 )
+      {
+         if ( (nthreads = atoi(argv[2])) < 1 )
+            nthreads = 1;
+         argc -= 2;
+         argv += 2;
+      }
+      else if ( strcmp(argv[1],"-o") == 0 && argc > 2 )
+      {
+         lookup_file = argv[2];
+         argc -= 2;
+         argv += 2;
+      }
+      else
          syntax(prgm);
-      histo_file = argv[1];
-      if ( argc > 2 )
+   }
+   if ( argc > 1 )
+   {
+      histo_files = (const char **) argv+1;
+      nfiles = argc-1;
+      /* Traditional syntax: input and output file name only. */
+      if ( lookup_file == NULL && nfiles == 2 )
+      {
          lookup_file = argv[2];
+         nfiles = 1;
+      }
+      else if ( lookup_file == NULL && nfiles > 2 )
+         syntax(prgm);
    }
+   if ( lookup_file == NULL )
+      lookup_file = "lookups.hdata.gz";
 
-   if ( read_histogram_file(histo_file,0) == -1 )
-      exit(1);
-
-   sort_histograms();
-   if ( get_first_histogram() == 0 )
-   {
-      fprintf(stderr,"No histograms available.\n");
+   /* The user parameters from the first file tell us what else we need. */
+   memset(&hset,0,sizeof(hset));
+   if ( read_histogram_set_file(histo_files[0],&hset,&uparam_id,1,1) < 0 )
       exit(1);
-   }
-   
+   link_histogram_set(&hset,0);
    if ( (h = get_histogram_by_ident(12099)) == NULL )
    {
       fprintf(stderr, "Cannot identify user parameters.\n");
@@ -399,42 +575,62 @@ int main(int argc, char **argv)
       else
          ntypes = (int)(h->extension->ddata[1]+0.01);
    }
-   if ( ntypes < 1 || ntypes > 20 )
+   if ( ntypes < 1 || ntypes > MAX_TEL_TYPES )
    {
       fprintf(stderr,"Unreasonable number of telescope types.\n");
       exit(1);
    }
 
+   /* Read and add up the histograms from all input files in parallel. */
+   if ( (ids = (long *) calloc(MAX_LOOKUP_IDS,sizeof(long))) == NULL )
+      exit(1);
+   nids = set_lookup_ids(ids,ntypes);
+   nerr = read_histogram_files(histo_files,nfiles,ids,nids,0,nthreads,&hset);
+   free(ids);
+   if ( nerr != 0 )
+   {
+      fprintf(stderr,"%d of %d histogram files could not be read.\n",
+         nerr, nfiles);
+      exit(1);
+   }
+   link_histogram_set(&hset,0);
+   free_histogram_set(&hset);
+
+   sort_histograms();
+
+   memset(lookups,0,sizeof(lookups));
    for ( tel_type=0; tel_type < ntypes; tel_type++ )
    {
       int ht = 100000*tel_type;
+      struct type_lookups *lh = &lookups[tel_type];
+      HISTOGRAM *h18301, *h18311, *h18321, *h18322;
       if ( get_histogram_by_ident(18000+100000*tel_type) == 0 )
          continue;
 
-      h18000 = get_histogram_by_ident(ht+18000);
-      h18001 = get_histogram_by_ident(ht+18001);
-      h18011 = get_histogram_by_ident(ht+18011);
-      h18012 = get_histogram_by_ident(ht+18012);
-      h18021 = get_histogram_by_ident(ht+18021);
-      h18022 = get_histogram_by_ident(ht+18022);
-      h18051 = get_histogram_by_ident(ht+18051);
-      h18052 = get_histogram_by_ident(ht+18052);
+      lh->h18000 = get_histogram_by_ident(ht+18000);
+      lh->h18001 = get_histogram_by_ident(ht+18001);
+      lh->h18011 = get_histogram_by_ident(ht+18011);
+      lh->h18012 = get_histogram_by_ident(ht+18012);
+      lh->h18021 = get_histogram_by_ident(ht+18021);
+      lh->h18022 = get_histogram_by_ident(ht+18022);
+      lh->h18051 = get_histogram_by_ident(ht+18051);
+      lh->h18052 = get_histogram_by_ident(ht+18052);
       
-      if ( h18000 == NULL || h18001 == NULL || 
-           h18011 == NULL || h18012 == NULL ||
-           h18021 == NULL || h18022 == NULL ||
-	   h18051 == NULL || h18052 == NULL )
+      if ( lh->h18000 == NULL || lh->h18001 == NULL || 
+           lh->h18011 == NULL || lh->h18012 == NULL ||
+           lh->h18021 == NULL || lh->h18022 == NULL ||
+	   lh->h18051 == NULL || lh->h18052 == NULL )
       {
          fprintf(stderr,"Not the right histograms available.\n");
          exit(1);
       }
 
-      xylow[0]  = h18000->specific.real.lower_limit;
-      xylow[1]  = h18000->specific_2d.real.lower_limit;
-      xyhigh[0] = h18000->specific.real.upper_limit;
-      xyhigh[1] = h18000->specific_2d.real.upper_limit;
-      nbins[0]  = h18000->nbins;
-      nbins[1]  = h18000->nbins_2d;
+      xylow[0]  = lh->h18000->specific.real.lower_limit;
+      xylow[1]  = lh->h18000->specific_2d.real.lower_limit;
+      xyhigh[0] = lh->h18000->specific.real.upper_limit;
+      xyhigh[1] = lh->h18000->specific_2d.real.upper_limit;
+      nbins[0]  = lh->h18000->nbins;
+      nbins[1]  = lh->h18000->nbins_2d;
       if ( (h = get_histogram_by_ident(ht+18100)) != NULL )
          free_histogram(h);
       if ( (h = get_histogram_by_ident(ht+18101)) != NULL )
@@ -467,41 +663,41 @@ int main(int argc, char **argv)
          free_histogram(h);
       if ( (h = get_histogram_by_ident(ht+18154)) != NULL )
          free_histogram(h);
-      h18100 = book_histogram(ht+18100, h18000->title, "D", 2, xylow, xyhigh, nbins);
-      h18101 = book_histogram(ht+18101, h18001->title, "D", 2, xylow, xyhigh, nbins);
-      h18111 = book_histogram(ht+18111, h18011->title, "D", 2, xylow, xyhigh, nbins);
-      h18112 = book_histogram(ht+18112, h18012->title, "D", 2, xylow, xyhigh, nbins);
-      h18113 = book_histogram(ht+18113, 
+      lh->h18100 = book_histogram(ht+18100, lh->h18000->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18101 = book_histogram(ht+18101, lh->h18001->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18111 = book_histogram(ht+18111, lh->h18011->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18112 = book_histogram(ht+18112, lh->h18012->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18113 = book_histogram(ht+18113, 
             "Log10(image ampl.) versus core distance: mean image width", 
             "D", 2, xylow, xyhigh, nbins);
-      h18114 = book_histogram(ht+18114, 
+      lh->h18114 = book_histogram(ht+18114, 
             "Log10(image ampl.) versus core distance: image width r.m.s.", 
             "D", 2, xylow, xyhigh, nbins);
-      h18121 = book_histogram(ht+18121, h18021->title, "D", 2, xylow, xyhigh, nbins);
-      h18122 = book_histogram(ht+18122, h18022->title, "D", 2, xylow, xyhigh, nbins);
-      h18123 = book_histogram(ht+18123,  
+      lh->h18121 = book_histogram(ht+18121, lh->h18021->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18122 = book_histogram(ht+18122, lh->h18022->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18123 = book_histogram(ht+18123,  
             "Log10(image ampl.) versus core distance: mean image length", 
             "D", 2, xylow, xyhigh, nbins);
-      h18124 = book_histogram(ht+18124,  
+      lh->h18124 = book_histogram(ht+18124,  
             "Log10(image ampl.) versus core distance: image length r.m.s.", 
             "D", 2, xylow, xyhigh, nbins);
-      h18140 = book_histogram(ht+18140, h18000->title, "D", 2, xylow, xyhigh, nbins);
-      h18141 = book_histogram(ht+18141, h18001->title, "D", 2, xylow, xyhigh, nbins);
-      h18151 = book_histogram(ht+18151, h18051->title, "D", 2, xylow, xyhigh, nbins);
-      h18152 = book_histogram(ht+18152, h18052->title, "D", 2, xylow, xyhigh, nbins);
-      h18153 = book_histogram(ht+18153,  
+      lh->h18140 = book_histogram(ht+18140, lh->h18000->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18141 = book_histogram(ht+18141, lh->h18001->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18151 = book_histogram(ht+18151, lh->h18051->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18152 = book_histogram(ht+18152, lh->h18052->title, "D", 2, xylow, xyhigh, nbins);
+      lh->h18153 = book_histogram(ht+18153,  
             "Log10(image ampl.) versus core distance: mean amp/E", 
             "D", 2, xylow, xyhigh, nbins);
-      h18154 = book_histogram(ht+18154,  
+      lh->h18154 = book_histogram(ht+18154,  
             "Log10(image ampl.) versus core distance: amp/E r.m.s.", 
             "D", 2, xylow, xyhigh, nbins);
 
-      h18005 = get_histogram_by_ident(ht+18005);
-      h18006 = get_histogram_by_ident(ht+18006);
-      h18071 = get_histogram_by_ident(ht+18071);
-      h18072 = get_histogram_by_ident(ht+18072);
-      h18081 = get_histogram_by_ident(ht+18081);
-      h18082 = get_histogram_by_ident(ht+18082);
+      lh->h18005 = get_histogram_by_ident(ht+18005);
+      lh->h18006 = get_histogram_by_ident(ht+18006);
+      lh->h18071 = get_histogram_by_ident(ht+18071);
+      lh->h18072 = get_histogram_by_ident(ht+18072);
+      lh->h18081 = get_histogram_by_ident(ht+18081);
+      lh->h18082 = get_histogram_by_ident(ht+18082);
       if ( (h = get_histogram_by_ident(ht+18105)) != NULL )
          free_histogram(h);
       if ( (h = get_histogram_by_ident(ht+18106)) != NULL )
@@ -529,33 +725,33 @@ int main(int argc, char **argv)
       if ( (h = get_histogram_by_ident(ht+18333)) != NULL )
          free_histogram(h);
 
-      if ( h18005 != NULL && h18006 != NULL &&
-           h18071 != NULL && h18071 != NULL &&
-           h18081 != NULL && h18081 != NULL )
+      if ( lh->h18005 != NULL && lh->h18006 != NULL &&
+           lh->h18071 != NULL && lh->h18071 != NULL &&
+           lh->h18081 != NULL && lh->h18081 != NULL )
       {
-         xylow[0]  = h18005->specific.real.lower_limit;
-         xylow[1]  = h18005->specific_2d.real.lower_limit;
-         xyhigh[0] = h18005->specific.real.upper_limit;
-         xyhigh[1] = h18005->specific_2d.real.upper_limit;
-         nbins[0]  = h18005->nbins;
-         nbins[1]  = h18005->nbins_2d;
-
-         h18105 = book_histogram(ht+18105, h18005->title, "D", 2, xylow, xyhigh, nbins);
-         h18106 = book_histogram(ht+18106, h18006->title, "D", 2, xylow, xyhigh, nbins);
-         h18171 = book_histogram(ht+18171, h18071->title, "D", 2, xylow, xyhigh, nbins);
-         h18172 = book_histogram(ht+18172, h18072->title, "D", 2, xylow, xyhigh, nbins);
-         h18173 = book_histogram(ht+18173,
+         xylow[0]  = lh->h18005->specific.real.lower_limit;
+         xylow[1]  = lh->h18005->specific_2d.real.lower_limit;
+         xyhigh[0] = lh->h18005->specific.real.upper_limit;
+         xyhigh[1] = lh->h18005->specific_2d.real.upper_limit;
+         nbins[0]  = lh->h18005->nbins;
+         nbins[1]  = lh->h18005->nbins_2d;
+
+         lh->h18105 = book_histogram(ht+18105, lh->h18005->title, "D", 2, xylow, xyhigh, nbins);
+         lh->h18106 = book_histogram(ht+18106, lh->h18006->title, "D", 2, xylow, xyhigh, nbins);
+         lh->h18171 = book_histogram(ht+18171, lh->h18071->title, "D", 2, xylow, xyhigh, nbins);
+         lh->h18172 = book_histogram(ht+18172, lh->h18072->title, "D", 2, xylow, xyhigh, nbins);
+         lh->h18173 = book_histogram(ht+18173,
                "Log10(image ampl.) versus width/length: mean core distance", 
                "D", 2, xylow, xyhigh, nbins);
-         h18174 = book_histogram(ht+18174,
+         lh->h18174 = book_histogram(ht+18174,
                "Log10(image ampl.) versus width/length: core distance r.m.s.", 
                "D", 2, xylow, xyhigh, nbins);
-         h18181 = book_histogram(ht+18181, h18081->title, "D", 2, xylow, xyhigh, nbins);
-         h18182 = book_histogram(ht+18182, h18082->title, "D", 2, xylow, xyhigh, nbins);
-         h18183 = book_histogram(ht+18183,
+         lh->h18181 = book_histogram(ht+18181, lh->h18081->title, "D", 2, xylow, xyhigh, nbins);
+         lh->h18182 = book_histogram(ht+18182, lh->h18082->title, "D", 2, xylow, xyhigh, nbins);
+         lh->h18183 = book_histogram(ht+18183,
                "Log10(image ampl.) versus width/length: mean image distance", 
                "D", 2, xylow, xyhigh, nbins);
-         h18184 = book_histogram(ht+18184,
+         lh->h18184 = book_histogram(ht+18184,
                "Log10(image ampl.) versus width/length: image distance r.m.s.", 
                "D", 2, xylow, xyhigh, nbins);
       }
@@ -612,11 +808,12 @@ int main(int argc, char **argv)
          }
       }
 
-      fill_gaps();
-
-      gen_image_lookups();
    }
 
+   /* The booking is done, all remaining work goes to separate histograms
+      for each telescope type and can be done in parallel. */
+   gen_all_type_lookups(lookups,ntypes,nthreads);
+
    /* Angular resolution versus telescope multiplicity for different cuts. */
    for ( res_type=1; res_type<=7; res_type++ ) 
       if ( (h = get_histogram_by_ident(19001+100*res_type)) != NULL )
@@ -46,18 +46,34 @@
 static pthread_mutex_t mlock_hist = PTHREAD_MUTEX_INITIALIZER;
 #define _HLOCK_ pthread_mutex_lock(&mlock_hist);
 #define _HUNLOCK_ pthread_mutex_unlock(&mlock_hist);
-#define _WAIT_IF_BUSY_(histo) histogram_lock(histo);
-#define _CLEAR_BUSY_(histo) histogram_unlock(histo);
+#define _WAIT_IF_BUSY_(histo) if ( !(histo)->is_shadow ) histogram_lock(histo);
+#define _CLEAR_BUSY_(histo) if ( !(histo)->is_shadow ) histogram_unlock(histo);
+/* Redirect filling to the thread-private shadow, if the thread asked for it. */
+#define _USE_SHADOW_(histo) if ( _SHADOWING_ && !(histo)->is_shadow ) \
+                               histo = get_shadow_histogram(histo);
+/* Number of threads with shadowing enabled. Changed and tested */
+/* with atomic operations, since it is tested on every fill. */
+static int shadowing_threads = 0;
+#define _SHADOWING_ (__atomic_load_n(&shadowing_threads,__ATOMIC_ACQUIRE) > 0)
+#define _SHADOWING_ADD_(n) (void) __atomic_add_fetch(&shadowing_threads,(n),__ATOMIC_ACQ_REL);
 #else
 #define _HLOCK_
 #define _HUNLOCK_
 #define _WAIT_IF_BUSY_(histo)
 #define _CLEAR_BUSY_(histo)
+#define _USE_SHADOW_(histo)
 #endif
 
-static void initialize_histogram (HISTOGRAM *histo);
+static void initialize_histogram (HISTOGRAM *histo, int detached);
+static HISTOGRAM *alloc_any_histogram (const char *type, int dimension,
+   double *low, double *high, int *nbins, int detached);
+static HISTOGRAM *alloc_1d_int_histo (long low, long high, int nbins,
+   int detached);
+static HISTOGRAM *alloc_2d_int_histo (long xlow, long xhigh, int nxbins,
+   long ylow, long yhigh, int nybins, int detached);
 static HISTOGRAM *aux_alloc_histogram (int nbins, const char *type);
 static void free_histo_contents (HISTOGRAM *histo);
+static void free_detached_histogram (HISTOGRAM *histo);
 static void display_2d_histogram (HISTOGRAM *histo);
 
 static HISTOGRAM *first_histogram = (HISTOGRAM *) NULL;
@@ -67,11 +83,136 @@ static HISTOGRAM *last_histogram = (HISTOGRAM *) NULL;
 /* should on be set during program startup. */
 FILE *histogram_file;  /* Global variable, initialized to NULL */
 
+/* Index from ident to histogram: open addressing with linear probing, */
+/* size a power of two, at most half full. Only accessed with the lock held. */
 static HISTOGRAM **hash_table;
-static long hash_size = 0;
-static CONST_QUAL short primetab[] = 
-     { 131, 233, 353, 541, 751, 1051, 1367, 1511, 1723,
-       1931, 2393, 3163, 3907, 5261, 6143, 7187, 8623, 9749, 11321, 15031 };
+static size_t hash_size = 0;
+static size_t hash_used = 0;
+static int hash_stale = 0;  /* Needs to be rebuilt from the linked list */
+static int hash_dups = 0;   /* Any ident ever used for more than one histogram */
+
+static void hash_rebuild (size_t min_size);
+
+/* ---------------------- Ident hash index ------------------------- */
+
+static size_t hash_slot (long ident)
+{
+   unsigned long h = ((unsigned long) ident) * 2654435761UL;
+   h ^= h >> 16;
+   return (size_t) h & (hash_size-1);
+}
+
+/** Find the slot for an ident: either where it is or the empty slot ending the probe. */
+
+static size_t hash_probe (long ident)
+{
+   size_t i = hash_slot(ident);
+   while ( hash_table[i] != (HISTOGRAM *) NULL && hash_table[i]->ident != ident )
+      i = (i+1) & (hash_size-1);
+   return i;
+}
+
+/** Look up a histogram by ident (>0), rebuilding the index if needed. */
+
+static HISTOGRAM *hash_find (long ident)
+{
+   if ( hash_table == (HISTOGRAM **) NULL || hash_stale )
+      hash_rebuild(hash_size);
+   if ( hash_table == (HISTOGRAM **) NULL )
+      return (HISTOGRAM *) NULL;
+   return hash_table[hash_probe(ident)];
+}
+
+/** Enter a histogram (replacing any other with the same ident). */
+
+static void hash_insert (HISTOGRAM *histo)
+{
+   size_t i;
+   if ( histo->ident <= 0 )
+      return;
+   if ( hash_table == (HISTOGRAM **) NULL || hash_stale ||
+        2*(hash_used+1) > hash_size )
+   {
+      hash_rebuild(2*(hash_used+1));
+      if ( hash_table == (HISTOGRAM **) NULL )
+         return;
+   }
+   i = hash_probe(histo->ident);
+   if ( hash_table[i] == (HISTOGRAM *) NULL )
+      hash_used++;
+   hash_table[i] = histo;
+}
+
+/** Remove a histogram from the index (if it is the one indexed for its ident). */
+
+static void hash_remove (HISTOGRAM *histo)
+{
+   size_t i, j, k;
+   HISTOGRAM *other;
+
+   if ( hash_table == (HISTOGRAM **) NULL || hash_stale || histo->ident <= 0 )
+      return;
+   i = hash_probe(histo->ident);
+   if ( hash_table[i] != histo )
+      return;
+   /* Another histogram with the same ident (rarely used) takes over. */
+   if ( hash_dups )
+      for ( other = first_histogram; other != (HISTOGRAM *) NULL; other = other->next )
+         if ( other != histo && other->ident == histo->ident )
+         {
+            hash_table[i] = other;
+            return;
+         }
+   /* Backward-shift deletion: no tombstones needed with linear probing. */
+   hash_table[i] = (HISTOGRAM *) NULL;
+   hash_used--;
+   for ( j = (i+1) & (hash_size-1); hash_table[j] != (HISTOGRAM *) NULL;
+         j = (j+1) & (hash_size-1) )
+   {
+      k = hash_slot(hash_table[j]->ident);
+      /* Entry at j may move to i unless its home slot k is cyclically in (i,j]. */
+      if ( (i <= j) ? (i < k && k <= j) : (i < k || k <= j) )
+         continue;
+      hash_table[i] = hash_table[j];
+      hash_table[j] = (HISTOGRAM *) NULL;
+      i = j;
+   }
+}
+
+/** (Re-)Build the index for all histograms in the linked list,
+    with at least twice as many slots as histograms with an ident. */
+
+static void hash_rebuild (size_t min_size)
+{
+   size_t nid = 0, size = 256;
+   HISTOGRAM *histo;
+
+   for ( histo = first_histogram; histo != (HISTOGRAM *) NULL; histo = histo->next )
+      if ( histo->ident > 0 )
+         nid++;
+   while ( size < min_size || size < 2*nid )
+      size *= 2;
+   if ( hash_table != (HISTOGRAM **) NULL )
+      free((void *) hash_table);
+   hash_used = 0;
+   hash_stale = 0;
+   if ( (hash_table = (HISTOGRAM **) calloc(size,sizeof(HISTOGRAM *))) == NULL )
+   {
+      Warning("Too little memory for histogram hashing");
+      hash_size = 0;
+      return;
+   }
+   hash_size = size;
+   /* Later histograms with the same ident take precedence, like when booked. */
+   for ( histo = first_histogram; histo != (HISTOGRAM *) NULL; histo = histo->next )
+      if ( histo->ident > 0 )
+      {
+         size_t i = hash_probe(histo->ident);
+         if ( hash_table[i] == (HISTOGRAM *) NULL )
+            hash_used++;
+         hash_table[i] = histo;
+      }
+}
 
 /* --------------------- histo_lock ------------------------ */
 
@@ -92,6 +233,310 @@ void histogram_unlock (HISTOGRAM *histo)
 }
 
 
+/* ================== Thread-private shadow histograms =================== */
+
+/*
+ *  With shadowing enabled in a thread, all fill functions called from
+ *  that thread go to private copies ('shadows') of the histograms,
+ *  with the same ident and binning but not in the linked list of
+ *  histograms. Shadows are filled without any locking and added to
+ *  their master histograms (with add_histogram() semantics) when the
+ *  thread calls merge_shadow_histograms(), disables shadowing, or
+ *  terminates. Master histograms must not be freed while any thread
+ *  still has shadows of them.
+ */
+
+#ifdef _REENTRANT
+
+/** Association of a shadow histogram with its master. */
+struct shadow_entry
+{
+   HISTOGRAM *master;
+   HISTOGRAM *shadow;
+};
+
+/** Thread-specific shadowing data, with two open-addressing hash tables
+    (keyed by master pointer and by ident) of the same power-of-two size. */
+struct shadow_specific_data
+{
+   int active;                   /**< Fills are redirected to shadows */
+   size_t nused;                 /**< Number of shadows */
+   size_t size;                  /**< Size of each table (0 or power of two) */
+   struct shadow_entry *by_ptr;  /**< Keyed by master pointer */
+   struct shadow_entry *by_id;   /**< Keyed by ident (>0 only) */
+};
+
+/** Global key for thread-specific data. */
+static pthread_key_t shadow_tsd_key;
+static pthread_once_t shadow_key_once = PTHREAD_ONCE_INIT;
+
+static size_t shadow_ptr_hash (const HISTOGRAM *histo, size_t size)
+{
+   return (size_t) ((((size_t) histo) >> 4) * 2654435761UL) & (size-1);
+}
+
+static size_t shadow_id_hash (long ident, size_t size)
+{
+   return (size_t) (((unsigned long) ident) * 2654435761UL) & (size-1);
+}
+
+static void shadow_insert (struct shadow_specific_data *sd, HISTOGRAM *master,
+   HISTOGRAM *shadow)
+{
+   size_t i = shadow_ptr_hash(master,sd->size);
+   while ( sd->by_ptr[i].master != NULL )
+      i = (i+1) & (sd->size-1);
+   sd->by_ptr[i].master = master;
+   sd->by_ptr[i].shadow = shadow;
+   if ( master->ident > 0 )
+   {
+      i = shadow_id_hash(master->ident,sd->size);
+      while ( sd->by_id[i].master != NULL )
+         i = (i+1) & (sd->size-1);
+      sd->by_id[i].master = master;
+      sd->by_id[i].shadow = shadow;
+   }
+   sd->nused++;
+}
+
+/** Make room for at least one more shadow (load factor up to 1/2). */
+
+static int shadow_reserve (struct shadow_specific_data *sd)
+{
+   struct shadow_entry *old_ptr = sd->by_ptr, *old_id = sd->by_id;
+   size_t old_size = sd->size, i;
+
+   if ( 2*(sd->nused+1) <= sd->size )
+      return 0;
+   sd->size = (old_size == 0) ? 256 : 2*old_size;
+   sd->by_ptr = (struct shadow_entry *) calloc(sd->size,sizeof(struct shadow_entry));
+   sd->by_id = (struct shadow_entry *) calloc(sd->size,sizeof(struct shadow_entry));
+   if ( sd->by_ptr == NULL || sd->by_id == NULL )
+   {
+      if ( sd->by_ptr != NULL )
+         free(sd->by_ptr);
+      if ( sd->by_id != NULL )
+         free(sd->by_id);
+      sd->by_ptr = old_ptr;
+      sd->by_id = old_id;
+      sd->size = old_size;
+      return -1;
+   }
+   sd->nused = 0;
+   for ( i=0; i<old_size; i++ )
+      if ( old_ptr[i].master != NULL )
+         shadow_insert(sd,old_ptr[i].master,old_ptr[i].shadow);
+   if ( old_ptr != NULL )
+      free(old_ptr);
+   if ( old_id != NULL )
+      free(old_id);
+   return 0;
+}
+
+/** Add all shadows of the calling thread to their masters and clear them. */
+
+static int shadow_merge (struct shadow_specific_data *sd)
+{
+   size_t i;
+   int nmerged = 0;
+
+   for ( i=0; i<sd->size; i++ )
+   {
+      HISTOGRAM *shadow = sd->by_ptr[i].shadow;
+      if ( shadow == NULL || shadow->entries == 0 )
+         continue;
+      if ( add_histogram(sd->by_ptr[i].master,shadow) != NULL )
+         nmerged++;
+      clear_histogram(shadow);
+   }
+   return nmerged;
+}
+
+static void shadow_destructor (void *whatever)
+{
+   struct shadow_specific_data *sd = (struct shadow_specific_data *) whatever;
+   size_t i;
+
+   if ( sd == NULL )
+      return;
+   shadow_merge(sd);
+   for ( i=0; i<sd->size; i++ )
+      if ( sd->by_ptr[i].shadow != NULL )
+      {
+         free_histo_contents(sd->by_ptr[i].shadow);
+         free(sd->by_ptr[i].shadow);
+      }
+   if ( sd->by_ptr != NULL )
+      free(sd->by_ptr);
+   if ( sd->by_id != NULL )
+      free(sd->by_id);
+   if ( sd->active )
+   {
+_SHADOWING_ADD_(-1)
+   }
+   free(sd);
+}
+
+static void shadow_func_once()
+{
+#ifdef OS_LYNX
+   pthread_keycreate(&shadow_tsd_key,shadow_destructor);
+#else
+   pthread_key_create(&shadow_tsd_key,shadow_destructor);
+#endif
+}
+
+static struct shadow_specific_data *get_shadow_specific (int create)
+{
+   void *specific;
+
+   /* Make sure that the key has been set up */
+   if ( pthread_once(&shadow_key_once,shadow_func_once) != 0 )
+      return NULL;
+   if ( (specific = pthread_getspecific(shadow_tsd_key)) == NULL && create )
+   {
+      if ( (specific = calloc(1,sizeof(struct shadow_specific_data))) == NULL )
+         return NULL;
+      if ( pthread_setspecific(shadow_tsd_key,specific) != 0 )
+      {
+         free(specific);
+         return NULL;
+      }
+   }
+   return (struct shadow_specific_data *) specific;
+}
+
+/** Allocate a shadow with the same type, ident and binning as the master,
+    but outside of the linked list of histograms. */
+
+static HISTOGRAM *alloc_shadow_histogram (HISTOGRAM *master)
+{
+   HISTOGRAM *shadow;
+   int ncounts = master->nbins;
+   
+   if ( master->type != 'I' && master->type != 'R' &&
+        master->type != 'F' && master->type != 'D' )
+      return NULL;
+   if ( master->nbins_2d > 0 )
+      ncounts *= master->nbins_2d;
+   if ( (shadow = aux_alloc_histogram(ncounts,&master->type)) == NULL )
+      return NULL;
+   shadow->is_shadow = 1;
+   shadow->ident = master->ident;
+   shadow->title = NULL;
+   shadow->previous = shadow->next = NULL;
+   shadow->nbins = master->nbins;
+   shadow->nbins_2d = master->nbins_2d;
+   /* The limits share a union with sums updated by filling threads. */
+   histogram_lock(master);
+   shadow->specific = master->specific;
+   shadow->specific_2d = master->specific_2d;
+   histogram_unlock(master);
+   clear_histogram(shadow);
+   return shadow;
+}
+
+#endif
+
+/* ----------------------- histogram_shadowing ------------------------ */
+/**
+ *  @short Enable or disable thread-private shadow histograms for the calling thread.
+ *
+ *  While enabled, fill functions called from this thread fill private
+ *  shadow copies without locking. Disabling it merges the shadows into
+ *  their master histograms. Without _REENTRANT, this is a no-op.
+ *
+ *  @param  on  Non-zero to enable, zero to disable shadowing.
+ *
+ *  @return 0 (o.k.), -1 (error)
+ */
+
+int histogram_shadowing (int on)
+{
+#ifdef _REENTRANT
+   struct shadow_specific_data *sd = get_shadow_specific(on);
+
+   if ( sd == NULL )
+      return on ? -1 : 0;
+   if ( on && !sd->active )
+   {
+      sd->active = 1;
+_SHADOWING_ADD_(1)
+   }
+   else if ( !on && sd->active )
+   {
+      shadow_merge(sd);
+      sd->active = 0;
+_SHADOWING_ADD_(-1)
+   }
+#else
+   (void) on;
+#endif
+   return 0;
+}
+
+/* ---------------------- get_shadow_histogram ------------------------ */
+/**
+ *  @short Get the calling thread's shadow of a histogram.
+ *
+ *  The shadow is allocated on first use. If shadowing is not enabled
+ *  for the calling thread (or the shadow cannot be allocated),
+ *  the histogram itself is returned.
+ *
+ *  @param  histo  Pointer to master histogram.
+ *
+ *  @return Pointer to shadow (or master) histogram.
+ */
+
+HISTOGRAM *get_shadow_histogram (HISTOGRAM *histo)
+{
+#ifdef _REENTRANT
+   struct shadow_specific_data *sd;
+   HISTOGRAM *shadow;
+   size_t i;
+
+   if ( histo == NULL || histo->is_shadow )
+      return histo;
+   if ( (sd = get_shadow_specific(0)) == NULL || !sd->active )
+      return histo;
+   if ( sd->size > 0 )
+   {
+      for ( i = shadow_ptr_hash(histo,sd->size); sd->by_ptr[i].master != NULL;
+            i = (i+1) & (sd->size-1) )
+         if ( sd->by_ptr[i].master == histo )
+            return sd->by_ptr[i].shadow;
+   }
+   if ( shadow_reserve(sd) != 0 || (shadow = alloc_shadow_histogram(histo)) == NULL )
+      return histo;
+   shadow_insert(sd,histo,shadow);
+   return shadow;
+#else
+   return histo;
+#endif
+}
+
+/* --------------------- merge_shadow_histograms ---------------------- */
+/**
+ *  @short Add the calling thread's shadow histograms to their masters.
+ *
+ *  This is meant for synchronisation points (e.g. before writing
+ *  histograms). Shadows are cleared after merging and remain in use.
+ *
+ *  @return Number of histograms merged.
+ */
+
+int merge_shadow_histograms ()
+{
+#ifdef _REENTRANT
+   struct shadow_specific_data *sd = get_shadow_specific(0);
+   if ( sd == NULL )
+      return 0;
+   return shadow_merge(sd);
+#else
+   return 0;
+#endif
+}
+
 /* --------------------- get_first_histogram ------------------------ */
 /**
  *  @short Get a pointer to the first histogram.
@@ -238,6 +683,7 @@ _HLOCK_
    }
    first_histogram = fhisto;
    last_histogram = lhisto;
+   hash_stale = 1;
 _HUNLOCK_
 }
 
@@ -245,8 +691,10 @@ _HUNLOCK_
 /**
  *  @short Get a histogram with the given ID.
  *
- *  Get the first histogram with a given ident (different from 0)
- *  or return NULL pointer if none exists.
+ *  Get the histogram with a given ident (different from 0)
+ *  or return NULL pointer if none exists. If the ident was
+ *  given to more than one histogram, the last one described
+ *  with it is returned. This is a hash table lookup.
  *
  *  @param  ident  --  The histogram ident to be searched for.
  *
@@ -256,38 +704,12 @@ _HUNLOCK_
 
 HISTOGRAM *get_histogram_by_ident (long ident)
 {
-   HISTOGRAM *histo;
-   HISTOGRAM *hptr = NULL;
+   HISTOGRAM *hptr;
 
    if ( ident <= 0 )
       return ((HISTOGRAM *) NULL);
 _HLOCK_
-   if ( hash_table != (HISTOGRAM **) NULL )
-   {
-      if ( (histo = hash_table[ident % hash_size]) != (HISTOGRAM *) NULL )
-         if ( histo->ident == ident )
-	 {
-	    hptr = histo;
-            goto finished;
-	 }
-   }
-   histo = first_histogram;
-   while ( histo != (HISTOGRAM *) NULL )
-   {
-      if ( histo->ident == ident )
-      {
-         if ( hash_table != (HISTOGRAM **) NULL )
-            hash_table[ident % hash_size] = histo;
-	 {
-	    hptr = histo;
-	    goto finished;
-         }
-      }
-      else
-         histo = histo->next;
-   }
-   hptr = ((HISTOGRAM *) NULL);
-finished:
+   hptr = hash_find(ident);
 _HUNLOCK_
    return hptr;
 }
@@ -498,6 +920,41 @@ HISTOGRAM *book_int_histogram (long id, const char *title, int dimension,
 
 HISTOGRAM *allocate_histogram (const char *type, int dimension, 
    double *low, double *high, int *nbins)
+{
+   return alloc_any_histogram(type,dimension,low,high,nbins,0);
+}
+
+/* --------------------- alloc_histogram_detached -------------------- */
+/**
+ *  @short Allocate any histogram without ID and title, outside the list.
+ *
+ *  Same as allocate_histogram() but the new histogram is not added
+ *  to the linked list of histograms and the global histogram lock
+ *  is not needed for it. This is meant for histograms which are
+ *  only kept in a HISTOGRAM_SET, e.g. when reading histogram files
+ *  in several threads. The histogram can still be added to the list
+ *  later on, with link_histogram().
+ *
+ *  @param  type   "I", "R", "F" or "D", as for allocate_histogram()
+ *  @param  dimension 1 or 2 for 1-D or 2-D histogram
+ *  @param  low    Pointer to lower limits (x or x,y for 1-D or 2-D)
+ *  @param  high   Pointer to upper limits
+ *  @param  nbins  Pointer to no. of bins per dimension (nx or nx, ny)
+ *
+ *  @return  Pointer to new histogram or NULL
+ */
+
+HISTOGRAM *alloc_histogram_detached (const char *type, int dimension, 
+   double *low, double *high, int *nbins)
+{
+   return alloc_any_histogram(type,dimension,low,high,nbins,1);
+}
+
+/* ----------------------- alloc_any_histogram ----------------------- */
+/** For internal purpose only */
+
+static HISTOGRAM *alloc_any_histogram (const char *type, int dimension,
+   double *low, double *high, int *nbins, int detached)
 {
    HISTOGRAM *thisto;
    int idim;
@@ -547,10 +1004,11 @@ HISTOGRAM *allocate_histogram (const char *type, int dimension,
             return((HISTOGRAM *) NULL);
          }
       if ( dimension == 1 )
-         return(alloc_int_histogram((long)low[0],(long)high[0],nbins[0]));
+         return(alloc_1d_int_histo((long)low[0],(long)high[0],nbins[0],
+             detached));
       else
-         return(alloc_2d_int_histogram((long)low[0],(long)high[0],nbins[0],
-             (long)low[1],(long)high[1],nbins[1]));
+         return(alloc_2d_int_histo((long)low[0],(long)high[0],nbins[0],
+             (long)low[1],(long)high[1],nbins[1],detached));
    }
    else if ( *type != 'R' && *type != 'F' && *type != 'D' )
    {
@@ -582,7 +1040,7 @@ HISTOGRAM *allocate_histogram (const char *type, int dimension,
       thisto->nbins_2d = nbins[1];
    }
 
-   initialize_histogram(thisto);
+   initialize_histogram(thisto,detached);
 
    return (thisto);
 }
@@ -603,6 +1061,15 @@ HISTOGRAM *allocate_histogram (const char *type, int dimension,
  */
 
 HISTOGRAM *alloc_int_histogram (long low, long high, int nbins)
+{
+   return alloc_1d_int_histo(low,high,nbins,0);
+}
+
+/* ------------------------ alloc_1d_int_histo ----------------------- */
+/** For internal purpose only */
+
+static HISTOGRAM *alloc_1d_int_histo (long low, long high, int nbins,
+   int detached)
 {
    HISTOGRAM *thisto;
 
@@ -620,7 +1087,7 @@ HISTOGRAM *alloc_int_histogram (long low, long high, int nbins)
    thisto->nbins_2d = 0;
    thisto->specific.integer.width = high-low;
 
-   initialize_histogram(thisto);
+   initialize_histogram(thisto,detached);
 
    return (thisto);
 }
@@ -664,6 +1131,15 @@ HISTOGRAM *alloc_real_histogram (double low, double high, int nbins)
 
 HISTOGRAM *alloc_2d_int_histogram (long xlow, long xhigh,
    int nxbins, long ylow, long yhigh, int nybins)
+{
+   return alloc_2d_int_histo(xlow,xhigh,nxbins,ylow,yhigh,nybins,0);
+}
+
+/* ------------------------ alloc_2d_int_histo ----------------------- */
+/** For internal purpose only */
+
+static HISTOGRAM *alloc_2d_int_histo (long xlow, long xhigh, int nxbins,
+   long ylow, long yhigh, int nybins, int detached)
 {
    HISTOGRAM *thisto;
 
@@ -684,7 +1160,7 @@ HISTOGRAM *alloc_2d_int_histogram (long xlow, long xhigh,
    thisto->nbins = nxbins;
    thisto->nbins_2d = nybins;
 
-   initialize_histogram(thisto);
+   initialize_histogram(thisto,detached);
 
    return (thisto);
 }
@@ -792,12 +1268,19 @@ static HISTOGRAM *aux_alloc_histogram (int ncounts, const char *type)
 /* ---------------------- initialize_histogram ---------------------- */
 /** For internal purpose only */
 
-static void initialize_histogram (HISTOGRAM *histo)
+static void initialize_histogram (HISTOGRAM *histo, int detached)
 {
    /* The histogram has no title so far */
    histo->title = (char *) NULL;
    histo->ident = 0;
 
+   if ( detached )
+   {
+      histo->previous = histo->next = (HISTOGRAM *) NULL;
+      clear_histogram(histo);
+      return;
+   }
+
 _HLOCK_
    /* Add the new histogram to the double linked list of histograms */
    histo->previous = last_histogram;
@@ -844,7 +1327,8 @@ _WAIT_IF_BUSY_(histo)
          }
    if ( ident < 0 )
       ident = 0;
-   else if ( (thisto = get_histogram_by_ident(ident)) != (HISTOGRAM *) NULL &&
+   else if ( ident > 0 &&
+             (thisto = get_histogram_by_ident(ident)) != (HISTOGRAM *) NULL &&
               thisto != histo )
    {
       char message[1024];
@@ -853,14 +1337,15 @@ _WAIT_IF_BUSY_(histo)
            ident,(title==(char*)NULL)?"unnamed":title,
            (thisto->title==(char*)NULL)?"unnamed":thisto->title);
       Information(message);
+      hash_dups = 1;
    }
-   histo->ident = ident;
-_CLEAR_BUSY_(histo)
-
 _HLOCK_
-   if ( hash_table != (HISTOGRAM **) NULL && ident > 0 )
-      hash_table[ident % hash_size] = histo;
+   if ( histo->ident != ident )
+      hash_remove(histo);
+   histo->ident = ident;
+   hash_insert(histo);
 _HUNLOCK_
+_CLEAR_BUSY_(histo)
 }
 
 /* ---------------------- clear_histogram --------------------------- */
@@ -945,6 +1430,20 @@ _CLEAR_BUSY_(histo)
    free(histo);
 }
 
+/* -------------------- free_detached_histogram -------------------- */
+/**
+ *  Free a histogram known not to be in the linked list (like those
+ *  in a HISTOGRAM_SET), without taking the global histogram lock.
+ */
+
+static void free_detached_histogram (HISTOGRAM *histo)
+{
+   if ( histo == (HISTOGRAM *) NULL )
+      return;
+   free_histo_contents(histo);
+   free(histo);
+}
+
 /* --------------------- free_histo_contents ----------------------- */
 /**
  *  Free the contents (data pointers) of a histogram to be released or removed.
@@ -1034,8 +1533,38 @@ _HLOCK_
       last_histogram = histo->previous;
    if ( first_histogram == histo )
       first_histogram = histo->next;
-   if ( hash_table != (HISTOGRAM **) NULL && histo->ident > 0 )
-      hash_table[histo->ident % hash_size] = (HISTOGRAM *) NULL;
+   histo->previous = histo->next = (HISTOGRAM *) NULL;
+   hash_remove(histo);
+_HUNLOCK_
+}
+
+/* --------------------- link_histogram --------------------- */
+/**
+ *  @short Append a histogram not (or no longer) in the list to it.
+ *
+ *  This is the counterpart to unlink_histogram(), for histograms
+ *  which were read or built detached from the global list, e.g.
+ *  in a HISTOGRAM_SET. The histogram must not already be linked.
+ *
+ *  @param  histo   Pointer to histogram.
+ *
+ *  @return (none)
+ */
+
+void link_histogram (HISTOGRAM *histo)
+{
+   if ( histo == (HISTOGRAM *) NULL )
+      return;
+
+_HLOCK_
+   histo->previous = last_histogram;
+   histo->next = (HISTOGRAM *) NULL;
+   if ( last_histogram != (HISTOGRAM *) NULL )
+      last_histogram->next = histo;
+   last_histogram = histo;
+   if ( first_histogram == (HISTOGRAM *) NULL )
+      first_histogram = histo;
+   hash_insert(histo);
 _HUNLOCK_
 }
 
@@ -1062,6 +1591,7 @@ int fill_int_histogram (HISTOGRAM *histo, long value)
 
    if ( histo == (HISTOGRAM *) NULL )
       return -1;
+_USE_SHADOW_(histo)
    if ( histo->type != 'I' )
    {
       if ( histo->type == 'R' || histo->type == 'F' || histo->type == 'D' )
@@ -1129,6 +1659,7 @@ int fill_real_histogram (HISTOGRAM *histo, double value)
 
    if ( histo == (HISTOGRAM *) NULL )
       return -1;
+_USE_SHADOW_(histo)
    if ( histo->type != 'R' )
    {
       if ( histo->type == 'F' || histo->type == 'D' )
@@ -1196,6 +1727,7 @@ int fill_weighted_histogram (HISTOGRAM *histo, double value,
 
    if ( histo == (HISTOGRAM *) NULL )
       return -1;
+_USE_SHADOW_(histo)
    if ( histo->type != 'F' && histo->type != 'D' )
    {
       char message[1024];
@@ -1280,6 +1812,7 @@ int fill_2d_int_histogram (HISTOGRAM *histo, long xvalue,
 
    if ( histo == (HISTOGRAM *) NULL )
       return  -1;
+_USE_SHADOW_(histo)
    if ( histo->type != 'I' )
       if ( histo->type == 'R' || histo->type == 'F' || histo->type == 'D' )
          return(fill_2d_real_histogram(histo,(double)xvalue,(double)yvalue));
@@ -1366,6 +1899,7 @@ int fill_2d_real_histogram (HISTOGRAM *histo, double xvalue,
 
    if ( histo == (HISTOGRAM *) NULL )
       return -1;
+_USE_SHADOW_(histo)
    if ( histo->type != 'R' )
       if ( histo->type == 'F' || histo->type == 'D' )
          return(fill_2d_weighted_histogram(histo,xvalue,yvalue,1.));
@@ -1448,6 +1982,7 @@ int fill_2d_weighted_histogram (HISTOGRAM *histo, double xvalue,
 
    if ( histo == (HISTOGRAM *) NULL )
       return -1;
+_USE_SHADOW_(histo)
    if ( histo->type != 'F' && histo->type != 'D' )
    {
       char message[1024];
@@ -1510,6 +2045,287 @@ _CLEAR_BUSY_(histo)
    return 0;
 }
 
+/* ---------------------- Batch filling of histograms ------------------- */
+
+#define HIST_BATCH 256   /* Values per block of bin index computation */
+
+/** Bin indices for a block of (up to HIST_BATCH) values, with the same
+    rounding checks as in the single-value fill functions, but free of
+    branches so that the compiler can vectorise it.
+    Values below range get index -1, values above range get -2.
+    The value is clamped to the histogram range before conversion
+    to int, since huge, infinite or NaN values cannot be converted. */
+
+static void bin_index_block (const double *x, size_t m, double lower, double upper,
+   double inverse_binwidth, int nbins, int *idx)
+{
+   size_t k;
+   for ( k=0; k<m; k++ )
+   {
+      double v = x[k];
+      double c = (v > lower) ? v : lower;  /* NaN ends up as lower */
+      int i;
+      c = (c < upper) ? c : upper;
+      i = (int) ((c-lower) * inverse_binwidth);
+      i = (i >= nbins) ? nbins-1 : i;  /* check for rounding errors */
+      i = (i < 0) ? 0 : i;
+      i = (v < lower) ? -1 : i;
+      idx[k] = (v >= upper) ? -2 : i;
+   }
+}
+
+/* ------------------------ fill_real_histogram_n ------------------------ */
+/**
+ *  @short Increment bins of a 1-D 'real' histogram by one for each of n values.
+ *
+ *  Same result as n calls of fill_real_histogram() but the histogram
+ *  is locked only once, bin indices are computed in vectorisable blocks,
+ *  and the sums are updated once per block.
+ *
+ *  @param  histo  Pointer to histogram
+ *  @param  x      Positions where entries are to be added
+ *  @param  n      Number of values
+ *
+ *  @return 0 (o.k.), -1 (no histogram that can be filled)
+ */
+
+int fill_real_histogram_n (HISTOGRAM *histo, const double *x, size_t n)
+{
+   int idx[HIST_BATCH];
+   size_t i, k, m;
+
+   if ( histo == (HISTOGRAM *) NULL || (x == NULL && n > 0) )
+      return -1;
+_USE_SHADOW_(histo)
+   if ( histo->type != 'R' )
+   {
+      if ( histo->type == 'F' || histo->type == 'D' )
+         return(fill_weighted_histogram_n(histo,x,NULL,n));
+      else
+         return -1;
+   }
+
+_WAIT_IF_BUSY_(histo)
+   for ( i=0; i<n; i+=m )
+   {
+      double sum = 0., tsum = 0.;
+      unsigned long nin = 0, nunder = 0, nover = 0;
+      m = (n-i < HIST_BATCH) ? n-i : HIST_BATCH;
+      bin_index_block(x+i, m, histo->specific.real.lower_limit,
+         histo->specific.real.upper_limit, histo->specific.real.inverse_binwidth,
+         histo->nbins, idx);
+      for ( k=0; k<m; k++ )
+      {
+         int ib = idx[k];
+         sum += x[i+k];
+         if ( ib >= 0 )
+         {
+            tsum += x[i+k];
+            nin++;
+            /* Increment histogram bin but avoid count overflow (wrap around) */
+            if ( histo->counts[ib] < MAX_HISTCOUNT )
+               histo->counts[ib]++;
+         }
+         else if ( ib == -1 )
+            nunder++;
+         else
+            nover++;
+      }
+      histo->specific.real.sum += sum;
+      histo->specific.real.tsum += tsum;
+      histo->entries += m;
+      histo->tentries += nin;
+      histo->underflow += nunder;
+      histo->overflow += nover;
+   }
+_CLEAR_BUSY_(histo)
+   return 0;
+}
+
+/* --------------------- fill_weighted_histogram_n ---------------------- */
+/**
+ *  @short Add n weighted entries to a 1-D histogram.
+ *
+ *  Same result as n calls of fill_weighted_histogram() (up to the
+ *  order of summation) but with locking, range checks and the
+ *  update of contents and sums done once per block of values.
+ *
+ *  @param  histo   Pointer to histogram.
+ *  @param  x       Positions where entries are to be added.
+ *  @param  w       The weights of the entries (NULL: all weights are 1).
+ *  @param  n       Number of entries.
+ *
+ *  @return 0 (o.k.),  -1 (no histogram that can be filled with weights)
+ */
+
+int fill_weighted_histogram_n (HISTOGRAM *histo, const double *x,
+   const double *w, size_t n)
+{
+   int idx[HIST_BATCH];
+   size_t i, k, m;
+   struct Histogram_Extension *he;
+
+   if ( histo == (HISTOGRAM *) NULL || (x == NULL && n > 0) )
+      return -1;
+_USE_SHADOW_(histo)
+   if ( (histo->type != 'F' && histo->type != 'D') || 
+        (he = histo->extension) == (struct Histogram_Extension *) NULL )
+   {
+      char message[1024];
+      sprintf(message,"Weighted filling invalid for type '%c' histogram %ld",
+         histo->type,histo->ident);
+      Warning(message);
+      return -1;
+   }
+
+_WAIT_IF_BUSY_(histo)
+   for ( i=0; i<n; i+=m )
+   {
+      double sum = 0., tsum = 0., c_all = 0., c_in = 0., c_under = 0., c_over = 0.;
+      unsigned long nin = 0, nunder = 0, nover = 0;
+      m = (n-i < HIST_BATCH) ? n-i : HIST_BATCH;
+      bin_index_block(x+i, m, histo->specific.real.lower_limit,
+         histo->specific.real.upper_limit, histo->specific.real.inverse_binwidth,
+         histo->nbins, idx);
+      for ( k=0; k<m; k++ )
+      {
+         double weight = (w != NULL) ? w[i+k] : 1.;
+         int ib = idx[k];
+         sum += weight * x[i+k];
+         c_all += weight;
+         if ( ib >= 0 )
+         {
+            tsum += weight * x[i+k];
+            c_in += weight;
+            nin++;
+            if ( he->fdata != (float *) NULL )   /* 'F' type */
+               he->fdata[ib] += (float) weight;
+            else if ( he->ddata != (double *) NULL )  /* 'D' type */
+               he->ddata[ib] += weight;
+         }
+         else if ( ib == -1 )
+         {
+            nunder++;
+            c_under += weight;
+         }
+         else
+         {
+            nover++;
+            c_over += weight;
+         }
+      }
+      histo->specific.real.sum += sum;
+      histo->specific.real.tsum += tsum;
+      histo->entries += m;
+      histo->tentries += nin;
+      histo->underflow += nunder;
+      histo->overflow += nover;
+      he->content_all += c_all;
+      he->content_inside += c_in;
+      he->content_outside[0] += c_under;
+      he->content_outside[1] += c_over;
+   }
+_CLEAR_BUSY_(histo)
+   return 0;
+}
+
+/* -------------------- fill_2d_weighted_histogram_n -------------------- */
+/**
+ *  @short Add n weighted entries to a 2-D histogram.
+ *
+ *  Same result as n calls of fill_2d_weighted_histogram() (up to the
+ *  order of summation) but with locking, range checks and the
+ *  update of contents and sums done once per block of values.
+ *
+ *  @param  histo   Pointer to histogram.
+ *  @param  x       X positions where entries are to be added.
+ *  @param  y       Y positions where entries are to be added.
+ *  @param  w       The weights of the entries (NULL: all weights are 1).
+ *  @param  n       Number of entries.
+ *
+ *  @return 0 (o.k.),  -1 (no histogram that can be filled with weights)
+ */
+
+int fill_2d_weighted_histogram_n (HISTOGRAM *histo, const double *x,
+   const double *y, const double *w, size_t n)
+{
+   int idx[HIST_BATCH], idy[HIST_BATCH];
+   size_t i, k, m;
+   struct Histogram_Extension *he;
+
+   if ( histo == (HISTOGRAM *) NULL || ((x == NULL || y == NULL) && n > 0) )
+      return -1;
+_USE_SHADOW_(histo)
+   if ( (histo->type != 'F' && histo->type != 'D') ||
+        (he = histo->extension) == (struct Histogram_Extension *) NULL )
+   {
+      char message[1024];
+      sprintf(message,"Weighted filling invalid for type '%c' histogram %ld",
+         histo->type,histo->ident);
+      Warning(message);
+      return -1;
+   }
+   if ( histo->nbins_2d <= 0 )
+      return(fill_weighted_histogram_n(histo,x,w,n));
+
+_WAIT_IF_BUSY_(histo)
+   for ( i=0; i<n; i+=m )
+   {
+      double sum = 0., sum_2d = 0., tsum = 0., tsum_2d = 0., c_all = 0., c_in = 0.;
+      unsigned long nin = 0;
+      m = (n-i < HIST_BATCH) ? n-i : HIST_BATCH;
+      bin_index_block(x+i, m, histo->specific.real.lower_limit,
+         histo->specific.real.upper_limit, histo->specific.real.inverse_binwidth,
+         histo->nbins, idx);
+      bin_index_block(y+i, m, histo->specific_2d.real.lower_limit,
+         histo->specific_2d.real.upper_limit, histo->specific_2d.real.inverse_binwidth,
+         histo->nbins_2d, idy);
+      for ( k=0; k<m; k++ )
+      {
+         double weight = (w != NULL) ? w[i+k] : 1.;
+         sum += weight * x[i+k];
+         sum_2d += weight * y[i+k];
+         c_all += weight;
+         if ( idx[k] >= 0 && idy[k] >= 0 )
+         {
+            int ibin = idy[k]*histo->nbins + idx[k];
+            tsum += weight * x[i+k];
+            tsum_2d += weight * y[i+k];
+            c_in += weight;
+            nin++;
+            if ( histo->type == 'F' )
+               he->fdata[ibin] += (float) weight;
+            else
+               he->ddata[ibin] += weight;
+         }
+         else
+         {
+            /* Same zone numbering as in fill_2d_weighted_histogram() */
+            int izone = 8;
+            if ( idx[k] == -1 )
+               { izone -= 2; histo->underflow++; }
+            else if ( idx[k] == -2 )
+               { izone -= 1; histo->overflow++; }
+            if ( idy[k] == -1 )
+               { if ( (izone -= 6) == 2 ) histo->underflow_2d++; }
+            else if ( idy[k] == -2 )
+               { if ( (izone -= 3) == 5 ) histo->overflow_2d++; }
+            he->content_outside[izone] += weight;
+         }
+      }
+      histo->specific.real.sum += sum;
+      histo->specific_2d.real.sum += sum_2d;
+      histo->specific.real.tsum += tsum;
+      histo->specific_2d.real.tsum += tsum_2d;
+      histo->entries += m;
+      histo->tentries += nin;
+      he->content_all += c_all;
+      he->content_inside += c_in;
+   }
+_CLEAR_BUSY_(histo)
+   return 0;
+}
+
 /* --------------------------- fill_histogram ------------------------- */
 /**
  *  @short Fill any type of 1-D or 2-D histogram known by its pointer.
@@ -1602,15 +2418,21 @@ int fill_histogram (HISTOGRAM *histo, double xvalue, double yvalue,
 int fill_histogram_by_ident (long id, double xvalue, double yvalue,
    double weight)
 {
-   /* This static variable is not considered problematic with multi-threading */
-   static int warned = 0;
-
-   if ( hash_table == (HISTOGRAM **) NULL )
-      if ( !warned ) /* Warning is displayed only once */
+#ifdef _REENTRANT
+   /* With thread-private shadows we may not even need the global lookup. */
+   if ( _SHADOWING_ && id > 0 )
+   {
+      struct shadow_specific_data *sd = get_shadow_specific(0);
+      if ( sd != NULL && sd->active && sd->size > 0 )
       {
-         Warning("Inefficient histogram filling due to missing hashing table.");
-         warned = 1;
+         size_t i;
+         for ( i = shadow_id_hash(id,sd->size); sd->by_id[i].master != NULL;
+               i = (i+1) & (sd->size-1) )
+            if ( sd->by_id[i].master->ident == id )
+               return(fill_histogram(sd->by_id[i].shadow,xvalue,yvalue,weight));
       }
+   }
+#endif
 
    return(fill_histogram(get_histogram_by_ident(id),xvalue,yvalue,weight));
 }
@@ -1632,7 +2454,7 @@ int histogram_matching (HISTOGRAM *histo1, HISTOGRAM *histo2)
         histo1->nbins != histo2->nbins ||
         histo1->nbins_2d != histo2->nbins_2d ||
         (histo1->counts == NULL && histo2->counts != NULL) ||
-        (histo1->counts != NULL && histo2->counts != NULL) ||
+        (histo1->counts != NULL && histo2->counts == NULL) ||
         (histo1->extension == NULL && histo2->extension !=NULL) ||
         (histo1->extension != NULL && histo2->extension == NULL) )
    {
@@ -1726,6 +2548,8 @@ _CLEAR_BUSY_(histo1);
    nbins = histo1->nbins;
    if ( histo1->nbins_2d > 0 )
       nbins *= histo1->nbins_2d;
+   histo1->entries += histo2->entries;
+   histo1->tentries += histo2->tentries;
    histo1->underflow += histo2->underflow;
    histo1->overflow += histo2->overflow;
    histo1->underflow_2d += histo2->underflow_2d;
@@ -1764,6 +2588,206 @@ _CLEAR_BUSY_(histo1);
    return histo1;
 }
 
+/* ------------------------ find_in_histogram_set ------------------- */
+/**
+ *  @short Find a histogram in a set by its ident (binary search).
+ *
+ *  @param  hset   The set of (detached) histograms, sorted by ident.
+ *  @param  ident  The histogram ID looked for.
+ *
+ *  @return Pointer to histogram or NULL if not in the set.
+ */
+
+HISTOGRAM *find_in_histogram_set (const HISTOGRAM_SET *hset, long ident)
+{
+   size_t lo = 0, hi;
+
+   if ( hset == (const HISTOGRAM_SET *) NULL || hset->histo == NULL )
+      return (HISTOGRAM *) NULL;
+   hi = hset->num;
+   while ( lo < hi )
+   {
+      size_t mid = lo + (hi-lo)/2;
+      if ( hset->histo[mid]->ident < ident )
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   if ( lo < hset->num && hset->histo[lo]->ident == ident )
+      return hset->histo[lo];
+   return (HISTOGRAM *) NULL;
+}
+
+/* ------------------------ add_to_histogram_set -------------------- */
+/**
+ *  @short Enter a detached histogram into a set of histograms.
+ *
+ *  The set takes over the histogram. If the set already has a
+ *  histogram with the same ident, the new one is added to it and
+ *  then freed (if add_flag is true and the definitions match) or
+ *  it replaces the old one (otherwise).
+ *  Histograms without an ident (0) cannot be kept in a set and
+ *  are freed.
+ *
+ *  @param  hset     The set of histograms.
+ *  @param  histo    A histogram not linked into the global list.
+ *  @param  add_flag Add up matching histograms rather than replacing.
+ *
+ *  @return 0 (o.k.), -1 (failure, histogram was freed)
+ */
+
+int add_to_histogram_set (HISTOGRAM_SET *hset, HISTOGRAM *histo, int add_flag)
+{
+   size_t lo = 0, hi;
+
+   if ( hset == (HISTOGRAM_SET *) NULL || histo == (HISTOGRAM *) NULL )
+      return -1;
+   if ( histo->ident <= 0 )
+   {
+      free_detached_histogram(histo);
+      return -1;
+   }
+   hi = hset->num;
+   while ( lo < hi )
+   {
+      size_t mid = lo + (hi-lo)/2;
+      if ( hset->histo[mid]->ident < histo->ident )
+         lo = mid+1;
+      else
+         hi = mid;
+   }
+   if ( lo < hset->num && hset->histo[lo]->ident == histo->ident )
+   {
+      if ( add_flag && histogram_matching(hset->histo[lo],histo) )
+      {
+         add_histogram(hset->histo[lo],histo);
+         free_detached_histogram(histo);
+      }
+      else
+      {
+         free_detached_histogram(hset->histo[lo]);
+         hset->histo[lo] = histo;
+      }
+      return 0;
+   }
+   if ( hset->num >= hset->max )
+   {
+      size_t nmax = (hset->max < 16) ? 16 : 2*hset->max;
+      HISTOGRAM **nh = (HISTOGRAM **) realloc(hset->histo, nmax*sizeof(HISTOGRAM *));
+      if ( nh == (HISTOGRAM **) NULL )
+      {
+         Warning("Not enough memory for histogram set");
+         free_detached_histogram(histo);
+         return -1;
+      }
+      hset->histo = nh;
+      hset->max = nmax;
+   }
+   if ( lo < hset->num )
+      memmove(hset->histo+lo+1, hset->histo+lo, (hset->num-lo)*sizeof(HISTOGRAM *));
+   hset->histo[lo] = histo;
+   hset->num++;
+   return 0;
+}
+
+/* ------------------------ merge_histogram_sets -------------------- */
+/**
+ *  @short Merge all histograms from one set into another one.
+ *
+ *  Matching histograms of the same ident are added up, others
+ *  replace those in the target set. The source set is left empty.
+ *
+ *  @return 0 (o.k.), -1 (at least one histogram lost)
+ */
+
+int merge_histogram_sets (HISTOGRAM_SET *to, HISTOGRAM_SET *from)
+{
+   size_t i;
+   int rc = 0;
+
+   if ( to == (HISTOGRAM_SET *) NULL || from == (HISTOGRAM_SET *) NULL )
+      return -1;
+   if ( to->num == 0 )
+   {
+      /* Just take over the whole vector (but keep the flags). */
+      HISTOGRAM **histo = to->histo;
+      size_t max = to->max;
+      to->histo = from->histo;
+      to->num = from->num;
+      to->max = from->max;
+      from->histo = histo;
+      from->num = 0;
+      from->max = max;
+      return 0;
+   }
+   for ( i=0; i<from->num; i++ )
+      if ( add_to_histogram_set(to,from->histo[i],1) != 0 )
+         rc = -1;
+   from->num = 0;
+   return rc;
+}
+
+/* ------------------------ free_histogram_set ---------------------- */
+/**
+ *  @short Free all histograms in a set and the set's own vector.
+ *  The set structure itself is not freed and may be re-used.
+ */
+
+void free_histogram_set (HISTOGRAM_SET *hset)
+{
+   size_t i;
+
+   if ( hset == (HISTOGRAM_SET *) NULL )
+      return;
+   for ( i=0; i<hset->num; i++ )
+      free_detached_histogram(hset->histo[i]);
+   if ( hset->histo != NULL )
+      free(hset->histo);
+   hset->histo = NULL;
+   hset->num = hset->max = 0;
+}
+
+/* ------------------------ link_histogram_set ---------------------- */
+/**
+ *  @short Move all histograms of a set into the global list.
+ *
+ *  Histograms with an ident already in the list are added to the
+ *  existing one (if add_flag is true and the definitions match)
+ *  or replace it, like read_histogram_file() does.
+ *  The set is left empty.
+ *
+ *  @return Number of histograms moved into or added to the list.
+ */
+
+int link_histogram_set (HISTOGRAM_SET *hset, int add_flag)
+{
+   size_t i;
+   int n = 0;
+
+   if ( hset == (HISTOGRAM_SET *) NULL )
+      return 0;
+   for ( i=0; i<hset->num; i++ )
+   {
+      HISTOGRAM *histo = hset->histo[i];
+      HISTOGRAM *ohisto = get_histogram_by_ident(histo->ident);
+      if ( ohisto != (HISTOGRAM *) NULL )
+      {
+         if ( add_flag && histogram_matching(ohisto,histo) )
+         {
+            add_histogram(ohisto,histo);
+            free_detached_histogram(histo);
+            n++;
+            continue;
+         }
+         free_histogram(ohisto);
+      }
+      link_histogram(histo);
+      n++;
+   }
+   hset->num = 0;
+   return n;
+}
+
 /* --------------------------- stat_histogram ------------------------- */
 /**
  *  @short Statistical analysis of a histogram.
@@ -2794,55 +3818,41 @@ double lookup_real (HISTOGRAM *lookup, double value, double factor)
 
 /* --------------------- histogram_hashing --------------------- */
 /**
- *  Turn hashing of histograms (using their ident as key) on or off.
+ *  Size or release the index of histograms by ident.
+ *
+ *  The index is always maintained (and grows as needed) when
+ *  histograms are booked or removed, so this is merely a hint
+ *  to avoid re-hashing while booking many histograms.
  *
- *  @param  tabsize   Minimum number of elements in
- *		      hashing table or 0 if hash table
- *		      should be released (max: 15000).
+ *  @param  tabsize   Expected number of histograms with an ident
+ *		      or 0 if the index memory should be released
+ *		      (it is re-built when needed).
  *
  *  @return  0 (o.k.),  -1 (error)
  */
 
 int histogram_hashing (int tabsize)
 {
-   size_t i;
-   HISTOGRAM *histo;
+   int rc = 0;
 
 _HLOCK_
-   if ( tabsize != 0 )
+   if ( tabsize > 0 )
    {
-      /* No dynamical change of hash table size: do nothing if */
-      /* hashing is already active. */
-      if ( hash_table != (HISTOGRAM **) NULL )
-      {
-_HUNLOCK_
-         return 0;
-      }
-      for (i=0; i < sizeof(primetab)/sizeof(primetab[0])-1; i++ )
-         if ( (int)primetab[i] >= tabsize )
-            break;
-      hash_size = primetab[i];
-      if ( (hash_table = (HISTOGRAM **) 
-             calloc((size_t)hash_size,sizeof(HISTOGRAM *)))
-           == (HISTOGRAM **) NULL )
+      if ( hash_table == (HISTOGRAM **) NULL || hash_stale ||
+           hash_size < 2*(size_t)tabsize )
       {
-         Warning("Too little memory for histogram hashing");
-         hash_size = 0;
-_HUNLOCK_
-         return -1;
+         hash_rebuild(2*(size_t)tabsize);
+         if ( hash_table == (HISTOGRAM **) NULL )
+            rc = -1;
       }
-      /* Initialize the hashing table with all known histograms. */
-      for ( histo = first_histogram; histo != (HISTOGRAM *) NULL;
-            histo=histo->next )
-         if ( histo->ident > 0 )
-            hash_table[histo->ident % hash_size] = histo;
    }
    else
    {
       if ( hash_table != (HISTOGRAM **) NULL )
          free((void *) hash_table);
-      hash_size = 0;
+      hash_table = (HISTOGRAM **) NULL;
+      hash_size = hash_used = 0;
    }
 _HUNLOCK_
-   return 0;
+   return rc;
 }
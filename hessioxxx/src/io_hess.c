@@ -117,8 +117,8 @@ static void hs_check_env()
 static void put_time_blob (HTime *t, IO_BUFFER *iobuf);
 static void get_time_blob (HTime *t, IO_BUFFER *iobuf);
 
-static int g_tel_idx[3][H_MAX_TEL+1];
-static int g_tel_idx_init[3];
+static int g_tel_idx[H_MAX_TEL_IDX_REF][H_MAX_TEL+1];
+static int g_tel_idx_init[H_MAX_TEL_IDX_REF];
 static int g_tel_idx_ref;
 
 /* ----------------- set_tel_idx_ref ---------------------- */
@@ -130,14 +130,14 @@ static int g_tel_idx_ref;
  *  Both the set_tel_idx and the find_tel_idx will then work
  *  wit the selected choice of lookup table.
  *
- *  @param iref Which lookup table to use from now on (0<=iref<=2).
+ *  @param iref Which lookup table to use from now on (0<=iref<H_MAX_TEL_IDX_REF).
  *              Not switching lookup if iref is out of range.
  */
  
 
 void set_tel_idx_ref (int iref)
 {
-   if ( iref >= 0 && iref<3 )
+   if ( iref >= 0 && iref<H_MAX_TEL_IDX_REF )
       g_tel_idx_ref = iref;
    else
    {
@@ -3816,6 +3816,262 @@ printf("#+# %d %d %d (%d)\n", mlg_tot, mhg16_tot, mhg8_tot, m_tot);
    return put_item_end(iobuf,&item_header);
 }
 
+static int hs_verify_reset = -1; /**< Check incremental resets against a full reset? */
+
+/* -------------------- set_hess_verify_reset ----------------- */
+/**
+ *  @short Switch verification of the incremental reset of ADC data on or off.
+ *
+ *  Before each new event only those parts of the ADC data structures
+ *  which were filled in for the previous event get cleared (see adc_sig_reset).
+ *  For debugging, the result can be compared with a full reset, reporting
+ *  (and then clearing) any left-over data. This debug mode can also be
+ *  activated through the HESSIO_VERIFY_RESET environment variable.
+ *
+ *  @param verify 1: verify after each reset, 0: no verification.
+ */
+
+void set_hess_verify_reset (int verify)
+{
+   hs_verify_reset = (verify != 0);
+}
+
+/* -------------------- adc_full_reset ----------------- */
+/**
+ *  @short Reset all pixels, gains and samples in use, no matter
+ *         which ones were filled in.
+ */
+
+static void adc_full_reset (AdcData *raw);
+
+static void adc_full_reset (AdcData *raw)
+{
+   int ipix, igain;
+//   int is;
+   size_t nb = raw->num_samples * sizeof(raw->adc_sample[0][0][0]);
+   for (igain=0; igain<raw->num_gains; igain++)
+   {
+      for (ipix=0; ipix<raw->num_pixels; ipix++)
+      {
+         raw->significant[ipix] = 0;
+         raw->adc_known[igain][ipix] = 0;
+         raw->adc_sum[igain][ipix] = 0;
+//         /* Traditionally resetting samples one by one */
+//         for (is=0; is<raw->num_samples; is++)
+//            raw->adc_sample[igain][ipix][is] = 0;
+         /* At the typical length of traces, memset is a bit faster than 
+            resetting the samples one by one. */
+         memset(&raw->adc_sample[igain][ipix][0],0,nb);
+      }
+   }
+   raw->num_sig = raw->num_smp = 0;
+}
+
+/* -------------------- adc_sig_reset ----------------- */
+/**
+ *  @short Reset flags and sums only for those pixels for which data was filled in.
+ *
+ *  The readers keep track of all pixels with any data in sig_list,
+ *  in both sparse and dense mode. Resetting the listed pixels is
+ *  thus sufficient for getting the same state as after a full reset,
+ *  apart from the sums written for all pixels by some analysis code
+ *  in dense mode (which the callers clear separately in dense mode).
+ *  Samples are left alone here, see adc_smp_reset().
+ */
+
+static void adc_sig_reset (AdcData *raw);
+
+static void adc_sig_reset (AdcData *raw)
+{
+   int j, ipix, igain;
+
+   for ( j=0; j<raw->num_sig; j++ )
+   {
+      ipix = raw->sig_list[j];
+      raw->significant[ipix] = 0;
+      for (igain=0; igain<H_MAX_GAINS; igain++)
+      {
+         raw->adc_known[igain][ipix] = 0;
+         raw->adc_sum[igain][ipix] = 0;
+      }
+   }
+   raw->num_sig = 0;
+}
+
+/* -------------------- adc_smp_reset ----------------- */
+/**
+ *  @short Reset samples only for those pixels for which samples were filled in.
+ *
+ *  This is done before reading any sample-mode data, since a readout
+ *  with zero suppression or with fewer pixels, gains or samples than
+ *  the previous one does not overwrite all of them. Sums-only
+ *  data does not invalidate the list of pixels with samples, which
+ *  is why samples are tracked separately from sig_list.
+ */
+
+static void adc_smp_reset (AdcData *raw);
+
+static void adc_smp_reset (AdcData *raw)
+{
+   int j, igain;
+   size_t nb = 0;
+
+   if ( raw->smp_samples > 0 && raw->smp_samples <= H_MAX_SLICES )
+      nb = raw->smp_samples * sizeof(raw->adc_sample[0][0][0]);
+   if ( nb > 0 )
+      for ( j=0; j<raw->num_smp; j++ )
+         for (igain=0; igain<H_MAX_GAINS; igain++)
+            memset(&raw->adc_sample[igain][raw->smp_list[j]][0],0,nb);
+   raw->num_smp = 0;
+}
+
+/* -------------------- adc_verify_reset ----------------- */
+/**
+ *  @short Check that nothing is left over after an incremental reset.
+ *
+ *  Any left-over data is reported and cleared, i.e. the end result
+ *  is the same as with a full reset.
+ *
+ *  @param raw    Pointer to the ADC data structure of one telescope.
+ *  @param npix   Number of pixels to be checked.
+ *  @param ngains Number of gains to be checked.
+ *  @param nsamp  Number of samples to be checked.
+ *  @param sums   If non-zero, significance bits, adc_known and sums are
+ *                checked as well, otherwise only samples.
+ *
+ *  @return Number of left-over non-zero elements.
+ */
+
+static int adc_verify_reset (AdcData *raw, int npix, int ngains, int nsamp, int sums);
+
+static int adc_verify_reset (AdcData *raw, int npix, int ngains, int nsamp, int sums)
+{
+   int ipix, igain, isamp, nbad = 0;
+   static int nwarn = 0;
+
+   if ( npix > H_MAX_PIX )
+      npix = H_MAX_PIX;
+   if ( ngains > H_MAX_GAINS )
+      ngains = H_MAX_GAINS;
+   if ( nsamp > H_MAX_SLICES )
+      nsamp = H_MAX_SLICES;
+   for (ipix=0; ipix<npix; ipix++)
+   {
+      if ( sums && raw->significant[ipix] )
+      {
+         nbad++;
+         raw->significant[ipix] = 0;
+      }
+      for (igain=0; igain<ngains; igain++)
+      {
+         if ( sums && (raw->adc_known[igain][ipix] || raw->adc_sum[igain][ipix]) )
+         {
+            nbad++;
+            raw->adc_known[igain][ipix] = 0;
+            raw->adc_sum[igain][ipix] = 0;
+         }
+         for (isamp=0; isamp<nsamp; isamp++)
+         {
+            if ( raw->adc_sample[igain][ipix][isamp] )
+            {
+               nbad++;
+               raw->adc_sample[igain][ipix][isamp] = 0;
+            }
+         }
+      }
+   }
+   if ( nbad > 0 && nwarn++ < 10 )
+   {
+      char msg[200];
+      snprintf(msg,sizeof(msg),"Incremental reset of ADC data for telescope %d"
+         " left %d non-zero elements (now cleared).", raw->tel_id, nbad);
+      Warning(msg);
+   }
+   return nbad;
+}
+
+/* -------------------------------- adc_reset ------------------------- */
+/**
+ *  @short Reset ADC data before reading samples without preceding sums.
+ *
+ *  Only the pixels filled in before get cleared, except for the small
+ *  per-pixel flags and sums which are cleared for all pixels in dense mode.
+ *  Samples are cleared (as far as needed) by the sample-mode data reader.
+ */
+
+static void adc_reset (AdcData *raw);
+
+static void adc_reset (AdcData *raw)
+{
+   int igain;
+   if ( raw == NULL )
+      return;
+   raw->known = 0;
+   raw->list_known = 0;
+   raw->list_size = 0;
+   adc_sig_reset(raw);
+   if ( !raw->sparse )
+   {
+      memset(raw->significant,0,(size_t)raw->num_pixels*sizeof(raw->significant[0]));
+      for (igain=0; igain<raw->num_gains; igain++)
+      {
+         memset(raw->adc_known[igain],0,(size_t)raw->num_pixels*sizeof(raw->adc_known[0][0]));
+         memset(raw->adc_sum[igain],0,(size_t)raw->num_pixels*sizeof(raw->adc_sum[0][0]));
+      }
+   }
+   if ( hs_verify_reset < 0 )
+      hs_verify_reset = (getenv("HESSIO_VERIFY_RESET") != NULL) ? 1 : 0;
+   if ( hs_verify_reset )
+      adc_verify_reset(raw,raw->num_pixels,raw->num_gains,0,1);
+}
+
+/* -------------------- adc_sig_add ----------------- */
+/**
+ *  @short Add a pixel to the list of pixels with data unless it is in the list already.
+ *
+ *  Must be called before any significance or adc_known bits
+ *  of the pixel get set.
+ */
+
+static void adc_sig_add (AdcData *raw, int ipix);
+
+static void adc_sig_add (AdcData *raw, int ipix)
+{
+   int igain;
+
+   if ( raw->significant[ipix] )
+      return;
+   for (igain=0; igain<H_MAX_GAINS; igain++)
+      if ( raw->adc_known[igain][ipix] )
+         return;
+   raw->sig_list[raw->num_sig++] = ipix;
+}
+
+/* -------------------- adc_sig_sort ----------------- */
+/**
+ *  @short Make sure the list of pixels with data is in ascending order.
+ *
+ *  The list is normally sorted already or only has a few
+ *  pixels out of place, thus a simple insertion sort is fine.
+ */
+
+static void adc_sig_sort (AdcData *raw);
+
+static void adc_sig_sort (AdcData *raw)
+{
+   int i, j, ipix;
+
+   for ( i=1; i<raw->num_sig; i++ )
+   {
+      if ( raw->sig_list[i] >= raw->sig_list[i-1] )
+         continue;
+      ipix = raw->sig_list[i];
+      for ( j=i; j>0 && raw->sig_list[j-1] > ipix; j-- )
+         raw->sig_list[j] = raw->sig_list[j-1];
+      raw->sig_list[j] = ipix;
+   }
+}
+
 /* -------------------- read_hess_teladc_sums ----------------- */
 /**
  *  Write ADC sum data for one camera in eventio format.
@@ -3829,7 +4085,7 @@ int read_hess_teladc_sums (IO_BUFFER *iobuf, AdcData *raw)
    uint32_t lgval[16], hgval[16];
    uint8_t hgval8[16];
    int mlg, mhg16, mhg8, i, j, k, m, n;
-   int rc;
+   int rc, prev_pixels;
 #ifdef XXDEBUG
    int mlg_tot = 0, mhg16_tot = 0, mhg8_tot = 0, m_tot = 0;
 #endif
@@ -3837,6 +4093,14 @@ int read_hess_teladc_sums (IO_BUFFER *iobuf, AdcData *raw)
    if ( iobuf == (IO_BUFFER *) NULL || raw == NULL )
       return -1;
 
+   /* In sparse mode, only pixels with data in the previous event need */
+   /* a reset. In dense mode all pixels get initialized further below. */
+   prev_pixels = raw->num_pixels;
+   if ( raw->sparse )
+      adc_sig_reset(raw);
+   else
+      raw->num_sig = 0;
+
    raw->known = 0;
    raw->num_pixels = 0;
    item_header.type = IO_TYPE_HESS_TELADCSUM;  /* Data type */
@@ -3918,29 +4182,50 @@ int read_hess_teladc_sums (IO_BUFFER *iobuf, AdcData *raw)
    else
       k = 0;
 
-   if ( k != 0 )
+   if ( raw->sparse && raw->zero_sup_mode != 0 )
    {
-      /* Initialize values one by one */
-      for ( j=0; j<raw->num_pixels; j++ )
-         raw->significant[j] = k;
-      for (i=0; i<raw->num_gains; i++)
+      /* Nothing to initialize: all pixels not in the (now empty) sparse */
+      /* list are zero already and the list gets filled as we go. */
+   }
+   else
+   {
+      if ( k != 0 )
       {
+         /* Initialize values one by one */
          for ( j=0; j<raw->num_pixels; j++ )
+            raw->significant[j] = k;
+         for (i=0; i<raw->num_gains; i++)
          {
-	    raw->adc_known[i][j] = k;
-	    /* raw->adc_sum[i][j] = 0; now done with memset below */
+            for ( j=0; j<raw->num_pixels; j++ )
+            {
+	       raw->adc_known[i][j] = k;
+	       /* raw->adc_sum[i][j] = 0; now done with memset below */
+            }
          }
       }
+      else
+      {
+         /* Memset should be faster for setting all to zero */
+         memset(raw->significant,0,(size_t)raw->num_pixels*sizeof(raw->significant[0]));
+         for (i=0; i<raw->num_gains; i++)
+            memset(raw->adc_known[i],0,(size_t)raw->num_pixels*sizeof(raw->adc_known[0][0]));
+      }
+      for (i=0; i<raw->num_gains; i++)
+         memset(raw->adc_sum[i],0,(size_t)raw->num_pixels*sizeof(raw->adc_sum[0][0]));
    }
-   else
+   /* Without zero suppression all pixels are listed. */
+   if ( raw->zero_sup_mode == 0 )
    {
-      /* Memset should be faster for setting all to zero */
-      memset(raw->significant,0,(size_t)raw->num_pixels*sizeof(raw->significant[0]));
-      for (i=0; i<raw->num_gains; i++)
-         memset(raw->adc_known[i],0,(size_t)raw->num_pixels*sizeof(raw->adc_known[0][0]));
+      for ( j=0; j<raw->num_pixels; j++ )
+         raw->sig_list[j] = j;
+      raw->num_sig = raw->num_pixels;
    }
-   for (i=0; i<raw->num_gains; i++)
-      memset(raw->adc_sum[i],0,(size_t)raw->num_pixels*sizeof(raw->adc_sum[0][0]));
+
+   if ( hs_verify_reset < 0 )
+      hs_verify_reset = (getenv("HESSIO_VERIFY_RESET") != NULL) ? 1 : 0;
+   /* In dense mode everything was initialized above anyway. */
+   if ( hs_verify_reset && raw->sparse && raw->zero_sup_mode != 0 )
+      adc_verify_reset(raw,prev_pixels,raw->num_gains,0,1);
 
 #ifdef XXDEBUG
 printf("### z = %d, d = %d\n", raw->zero_sup_mode, raw->data_red_mode);
@@ -4211,6 +4496,7 @@ mhg8_tot += mhg8;
 #ifdef XXDEBUG
 m_tot++;
 #endif
+			      raw->sig_list[raw->num_sig++] = k+j;
 			      raw->significant[k+j] = 1;
 			      if ( raw->data_red_mode < 1 ||
 			      	   (cflags & (1<<j)) )
@@ -4333,6 +4619,7 @@ mhg8_tot += mhg8;
       	       for ( j=0; j<raw->list_size; j++ )
 	       {
 	          k = raw->adc_list[j];
+		  adc_sig_add(raw,k);
 		  raw->significant[k] = 1;
 		  if ( reduced_width[j] )
 		     raw->adc_sum[HI_GAIN][k] = adc_hg8[mhg8++] * scale_hg8 + offset_hg8;
@@ -4370,6 +4657,10 @@ mhg8_tot += mhg8;
 printf("#+# %d %d %d (%d)\n", mlg_tot, mhg16_tot, mhg8_tot, m_tot);
 #endif
 
+   /* A pixel list from the data may not be in ascending order. */
+   if ( raw->zero_sup_mode == 2 )
+      adc_sig_sort(raw);
+
    raw->known = 1;
 
    return get_item_end(iobuf,&item_header);
@@ -4673,6 +4964,127 @@ int write_hess_teladc_samples (IO_BUFFER *iobuf, AdcData *raw)
    return put_item_end(iobuf,&item_header);
 }
 
+static int hs_fast_samples = -1; /**< Use specialised decoders for common sample data layouts? */
+
+/* -------------------- set_hess_fast_samples ----------------- */
+/**
+ *  @short Switch the specialised decoding of sampled ADC data on or off.
+ *
+ *  The most common layout of sampled ADC data (all pixels, no zero
+ *  suppression, differential coding) is normally decoded by a
+ *  dedicated fast routine. For testing, the general code path can be
+ *  enforced, either here or through the HESSIO_GENERIC_SAMPLES
+ *  environment variable. Results are identical in both cases.
+ *
+ *  @param fast 1: use fast decoders where possible, 0: always use the general path.
+ */
+
+void set_hess_fast_samples (int fast)
+{
+   hs_fast_samples = (fast != 0);
+}
+
+/* ------------------- read_adc_samples_all ------------------- */
+/*
+ *  Fast decoder for sampled ADC data of all pixels, without zero
+ *  suppression and without data reduction, in differential coding
+ *  (version 3 and up). The samples are decoded straight into the
+ *  destination, with the sums of samples obtained on the way, and
+ *  all pixels are marked as significant.
+ *  Only where fewer than three bytes per sample are left or an
+ *  invalid code is found, the general vector decoder takes over.
+ */
+
+static void read_adc_samples_all (IO_BUFFER *iobuf, AdcData *raw, int what);
+
+static void read_adc_samples_all (IO_BUFFER *iobuf, AdcData *raw, int what)
+{
+   int npix = raw->num_pixels, nsamp = raw->num_samples;
+   int igain, ipix, isamp;
+   uint32_t sum;
+   int32_t val, d;
+   BYTE *data = iobuf->data, *end = iobuf->data + iobuf->r_remaining, *data0;
+   BYTE v0;
+
+   for (igain=0; igain<raw->num_gains; igain++)
+   {
+      uint8_t *adc_known = raw->adc_known[igain];
+      uint32_t *adc_sum = raw->adc_sum[igain];
+
+      for (ipix=0; ipix<npix; ipix++)
+      {
+         uint16_t *vec = raw->adc_sample[igain][ipix];
+
+         data0 = data;
+         val = 0;
+         sum = 0;
+         isamp = 0;
+         if ( end - data >= 3*nsamp )
+         {
+            for ( ; isamp<nsamp; isamp++ )
+            {
+               v0 = data[0];
+               if ( (v0 & 0x80) == 0 ) /* One-byte count */
+               {
+                  d = v0 >> 1;
+                  data++;
+               }
+               else if ( (v0 & 0xc0) == 0x80 ) /* Two-byte count */
+               {
+                  d = (((int32_t) (v0&0x3f)) << 7) | (int32_t) (data[1]>>1);
+                  v0 = data[1];
+                  data += 2;
+               }
+               else if ( (v0 & 0xe0) == 0xc0 ) /* Three-byte count */
+               {
+                  d = (((int32_t) (v0&0x1f)) << 15) | (((int32_t) data[1]) << 7) | 
+                      (int32_t) (data[2]>>1);
+                  v0 = data[2];
+                  data += 3;
+               }
+               else
+                  break;
+               /* Sign is in bit 0 of the last byte */
+               if ( (v0 & 0x01) == 0 )
+                  val += d;
+               else
+                  val -= d + 1;
+               vec[isamp] = (uint16_t) val;
+               sum += vec[isamp];
+            }
+         }
+         if ( isamp < nsamp ) /* Near the end of the buffer or unexpected codes */
+         {
+            iobuf->data = data0;
+            iobuf->r_remaining = (long) (end - data0);
+            get_vector_of_uint16_scount_differential(vec,nsamp,iobuf);
+            data = iobuf->data;
+            sum = 0;
+            for (isamp=0; isamp<nsamp; isamp++)
+               sum += vec[isamp];
+         }
+
+         /* If there is preceding sum data, we keep that (as in the general path). */
+         if ( !adc_known[ipix] )
+         {
+            adc_sum[ipix] = (what & RAWSUM_FLAG) ? sum : 0;
+            adc_known[ipix] = 1;
+         }
+         adc_known[ipix] |= 2;
+      }
+   }
+
+   iobuf->data = data;
+   iobuf->r_remaining = (long) (end - data);
+
+   for (ipix=0; ipix<npix; ipix++)
+   {
+      raw->significant[ipix] = 1;
+      raw->sig_list[ipix] = raw->smp_list[ipix] = ipix;
+   }
+   raw->num_sig = raw->num_smp = npix;
+}
+
 /* -------------------- read_hess_teladc_samples ----------------- */
 /**
  *  Read sampled ADC data in eventio format.
@@ -4750,6 +5162,9 @@ int read_hess_teladc_samples (IO_BUFFER *iobuf, AdcData *raw, int what)
 
    raw->num_samples = get_short(iobuf);
 
+   if ( hs_fast_samples < 0 )
+      hs_fast_samples = (getenv("HESSIO_GENERIC_SAMPLES") != NULL) ? 0 : 1;
+
    if ( raw->num_pixels > H_MAX_PIX ||
         raw->num_gains > H_MAX_GAINS ||
 	raw->num_samples > H_MAX_SLICES )
@@ -4762,6 +5177,15 @@ int read_hess_teladc_samples (IO_BUFFER *iobuf, AdcData *raw, int what)
       return -1;
    }
 
+   /* Clear the samples filled in before. Even without zero suppression */
+   /* a readout with fewer pixels, gains or samples does not overwrite all. */
+   adc_smp_reset(raw);
+   if ( hs_verify_reset < 0 )
+      hs_verify_reset = (getenv("HESSIO_VERIFY_RESET") != NULL) ? 1 : 0;
+   if ( hs_verify_reset )
+      adc_verify_reset(raw,raw->num_pixels,H_MAX_GAINS,
+         (raw->smp_samples > raw->num_samples ? raw->smp_samples : raw->num_samples),0);
+
    if ( zero_sup_mode )
    {
       int ilist, ipix1, ipix2;
@@ -4769,8 +5193,11 @@ int read_hess_teladc_samples (IO_BUFFER *iobuf, AdcData *raw, int what)
 #if ( H_MAX_GAINS >= 2 )
       int pixel_list_lg[H_MAX_PIX][2], list_size_lg = 0;
 #endif
-      for (ipix=0; ipix<raw->num_pixels; ipix++)
+      int nloop = ADC_PIX_LOOP_SIZE(raw), j;
+
+      for (j=0; j<nloop; j++)
       {
+         ipix = ADC_PIX_LOOP_ID(raw,j);
          raw->significant[ipix] &= ~0xe0; /* Clear sample mode significance bits. */
          raw->adc_known[0][ipix] &= 0x01; /* Same for adc_known sample-mode bits; */
 #if ( H_MAX_GAINS >= 2 )
@@ -4830,6 +5257,9 @@ int read_hess_teladc_samples (IO_BUFFER *iobuf, AdcData *raw, int what)
             for ( ipix=pixel_list[ilist][0]; ipix<=pixel_list[ilist][1]; ipix++ )
             {
                get_vector_of_uint16_scount_differential(raw->adc_sample[HI_GAIN][ipix],raw->num_samples,iobuf);
+               adc_sig_add(raw,ipix);
+               if ( raw->num_smp < H_MAX_PIX )
+                  raw->smp_list[raw->num_smp++] = ipix;
                raw->significant[ipix] |= 0x20;
                raw->adc_known[HI_GAIN][ipix] |= 2;
             }
@@ -4838,6 +5268,9 @@ int read_hess_teladc_samples (IO_BUFFER *iobuf, AdcData *raw, int what)
             for ( ipix=pixel_list_lg[ilist][0]; ipix<=pixel_list_lg[ilist][1]; ipix++ )
             {
                get_vector_of_uint16_scount_differential(raw->adc_sample[LO_GAIN][ipix],raw->num_samples,iobuf);
+               adc_sig_add(raw,ipix);
+               if ( !(raw->adc_known[HI_GAIN][ipix] & 2) && raw->num_smp < H_MAX_PIX )
+                  raw->smp_list[raw->num_smp++] = ipix;
                raw->adc_known[LO_GAIN][ipix] |= 2;
             }
          if ( (what & RAWSUM_FLAG) )
@@ -4858,6 +5291,9 @@ int read_hess_teladc_samples (IO_BUFFER *iobuf, AdcData *raw, int what)
 #else
                get_vector_of_uint16_scount_differential(raw->adc_sample[igain][ipix],raw->num_samples,iobuf);
 #endif
+               adc_sig_add(raw,ipix);
+               if ( igain == 0 && raw->num_smp < H_MAX_PIX )
+                  raw->smp_list[raw->num_smp++] = ipix;
                raw->significant[ipix] |= 0x20;
                
                /* Should the sampled data also be summed up here? There might be sum data preceding this sample mode data! */
@@ -4888,6 +5324,11 @@ int read_hess_teladc_samples (IO_BUFFER *iobuf, AdcData *raw, int what)
       }
     }
    }
+   else if ( hs_fast_samples && item_header.version >= 3 )
+   {
+      /* The most common layout (all pixels, differential coding) has its own decoder. */
+      read_adc_samples_all(iobuf,raw,what);
+   }
    else /* No (sample data) zero suppression, no data reduction, no pixel lists. */
    {
       for (igain=0; igain<raw->num_gains; igain++)
@@ -4931,8 +5372,16 @@ int read_hess_teladc_samples (IO_BUFFER *iobuf, AdcData *raw, int what)
          }
       }
       for (ipix=0; ipix<raw->num_pixels; ipix++)
+      {
          raw->significant[ipix] = 1;
+         raw->sig_list[ipix] = raw->smp_list[ipix] = ipix;
+      }
+      raw->num_sig = raw->num_smp = raw->num_pixels;
    }
+   raw->smp_samples = raw->num_samples;
+
+   /* Pixels with samples but without sums were appended at the end. */
+   adc_sig_sort(raw);
 
    raw->known |= 2;
 
@@ -5094,36 +5543,32 @@ int print_hess_teladc_samples (IO_BUFFER *iobuf)
    return get_item_end(iobuf,&item_header);
 }
 
-/* -------------------------------- adc_reset ------------------------- */
-
-static void adc_reset (AdcData *raw);
+/* -------------------------------- set_adc_sparse_mode ------------------------- */
+/**
+ *  @short Switch the sparse representation of zero-suppressed ADC data on or off.
+ *
+ *  The readers for ADC sums and samples keep a list (sig_list) of
+ *  all pixels for which any data was read, in ascending order.
+ *  In sparse mode, resetting the structure before the next event
+ *  only touches the pixels in that list, not even the per-pixel flags
+ *  and sums of other pixels. Application code can iterate
+ *  over that list (see ADC_PIX_LOOP_SIZE and ADC_PIX_LOOP_ID) instead of
+ *  testing all pixels for significance.
+ *  The structure gets fully reset once here since the incremental reset relies
+ *  on all pixels not in the list being cleared already. Use this function
+ *  also after filling in ADC data other than through the readers.
+ *
+ *  @param raw    Pointer to the ADC data structure of one telescope.
+ *  @param sparse 1: sparse mode, 0: traditional dense mode.
+ */
 
-static void adc_reset (AdcData *raw)
+void set_adc_sparse_mode (AdcData *raw, int sparse)
 {
-   int ipix, igain;
-//   int is;
-   size_t nb;
    if ( raw == NULL )
       return;
+   adc_full_reset(raw);
    raw->known = 0;
-   raw->list_known = 0;
-   raw->list_size = 0;
-   nb = raw->num_samples * sizeof(raw->adc_sample[0][0][0]);
-   for (igain=0; igain<raw->num_gains; igain++)
-   {
-      for (ipix=0; ipix<raw->num_pixels; ipix++)
-      {
-         raw->significant[ipix] = 0;
-         raw->adc_known[igain][ipix] = 0;
-         raw->adc_sum[igain][ipix] = 0;
-//         /* Traditionally resetting samples one by one */
-//         for (is=0; is<raw->num_samples; is++)
-//            raw->adc_sample[igain][ipix][is] = 0;
-         /* At the typical length of traces, memset is a bit faster than 
-            resetting the samples one by one. */
-         memset(&raw->adc_sample[igain][ipix][0],0,nb);
-      }
-   }
+   raw->sparse = (sparse != 0);
 }
 
 /* -------------------- write_hess_aux_trace_digital ----------------- */
@@ -6947,30 +7392,143 @@ int write_hess_televent (IO_BUFFER *iobuf, TelEvent *te, int what)
    return put_item_end(iobuf,&item_header);
 }
 
-/* ----------------------- read_hess_televent ------------------------ */
-/**
- *  Read data for one telescope camera in eventio format.
-*/  
+/* ------------------------ read_hess_telpart ------------------------- */
+/*
+ *  Read one of the ADC sums, ADC samples, pixel timing or image
+ *  sub-items of a telescope event, either when the telescope event
+ *  gets read or later, on demand (see hess_televent_decode).
+ */
 
-int read_hess_televent (IO_BUFFER *iobuf, TelEvent *te, int what)
-{
-   IO_ITEM_HEADER item_header, sub_item_header;
-   int rc;
-   AdcData *raw;
-   ImgData *img;
-   int tel_id;
-   int tel_img = 0;
-   int iaux;
-   static int w_sum=0, w_samp=0, w_pixtm=0, w_pixcal=0;
+static int read_hess_telpart (IO_BUFFER *iobuf, TelEvent *te, int type, 
+   int what, int *tel_img);
 
-   if ( iobuf == (IO_BUFFER *) NULL || te == NULL )
-      return -1;
+static int read_hess_telpart (IO_BUFFER *iobuf, TelEvent *te, int type, 
+   int what, int *tel_img)
+{
+   AdcData *raw = te->raw;
+   int rc = -9;
+
+   switch ( type )
+   {
+      case IO_TYPE_HESS_TELADCSUM:
+         rc = read_hess_teladc_sums(iobuf,raw);
+         te->readout_mode = 0;     /* ADC sums */
+         if ( rc == 0 )
+            raw->known = 1;
+         raw->tel_id = te->tel_id; /* For IDs beyond 31, bits may be missing */
+         break;
+
+      case IO_TYPE_HESS_TELADCSAMP:
+         if ( raw->known ) /* Preceded by sum data? */
+            te->readout_mode = 2; /* sum + samples (perhaps different zero suppression) */
+         else
+         {
+            adc_reset(raw); /* Do we need that? */
+            te->readout_mode = 1; /* ADC samples, sums usually rebuilt */
+         }
+         rc = read_hess_teladc_samples(iobuf,raw,what);
+         if ( rc == 0 )
+         {
+            raw->known |= 2;
+         }
+         raw->tel_id = te->tel_id; /* For IDs beyond 31, bits may be missing (?) */
+         break;
 
-   te->known = 0;
-   te->readout_mode = 0;
+      case IO_TYPE_HESS_PIXELTIMING:
+         rc = read_hess_pixtime(iobuf,te->pixtm);
+         break;
 
-   item_header.type = 0;  /* No data type this time */
-   if ( (rc = get_item_begin(iobuf,&item_header)) < 0 )
+      case IO_TYPE_HESS_TELIMAGE:
+         if ( *tel_img >= te->max_image_sets )
+         {
+            Warning("Not enough space to read all image sets");
+            break;
+         }
+         if ( (rc = read_hess_telimage(iobuf,&te->img[*tel_img])) == 0 )
+         {
+            te->img[*tel_img].known = 1;
+            (*tel_img)++;
+         }
+         te->num_image_sets = *tel_img;
+         break;
+   }
+
+   return rc;
+}
+
+static int hess_televent_pending (TelEvent *te, int what, int *tel_img);
+
+/* ------------------------ hess_televent_defer ----------------------- */
+/*
+ *  In lazy mode, remember where an ADC, timing or image sub-item
+ *  starts and skip it. If too many sub-items are pending already,
+ *  these get decoded now and 1 is returned, with lazy mode ended
+ *  for the rest of the telescope event: the given sub-item and all
+ *  following ones have to be read right away, keeping the order
+ *  of the data stream (e.g. samples after sums, image sets in turn).
+ */
+
+static int hess_televent_defer (IO_BUFFER *iobuf, TelEvent *te, int type,
+   int *lazy, int *tel_img);
+
+static int hess_televent_defer (IO_BUFFER *iobuf, TelEvent *te, int type,
+   int *lazy, int *tel_img)
+{
+   int i;
+
+   if ( te->num_lazy >= H_MAX_LAZY_ITEMS )
+   {
+      *lazy = 0;
+      if ( (i = hess_televent_pending(te,-1,tel_img)) < 0 )
+         return i;
+      return 1;
+   }
+
+   if ( type == IO_TYPE_HESS_TELADCSUM )
+      te->readout_mode = 0;
+   else if ( type == IO_TYPE_HESS_TELADCSAMP )
+   {
+      /* Same as after reading: samples alone or in addition to sums */
+      te->readout_mode = 1;
+      for ( i=0; i<te->num_lazy; i++ )
+         if ( te->lazy_type[i] == IO_TYPE_HESS_TELADCSUM )
+            te->readout_mode = 2;
+   }
+
+   te->lazy_type[te->num_lazy] = type;
+   te->lazy_offset[te->num_lazy] = (long) (iobuf->data - iobuf->buffer);
+   te->num_lazy++;
+
+   return skip_subitem(iobuf);
+}
+
+/* ----------------------- read_hess_televent ------------------------ */
+/**
+ *  Read data for one telescope camera in eventio format.
+*/  
+
+int read_hess_televent (IO_BUFFER *iobuf, TelEvent *te, int what)
+{
+   IO_ITEM_HEADER item_header, sub_item_header;
+   int rc;
+   AdcData *raw;
+   ImgData *img;
+   int tel_id;
+   int tel_img = 0;
+   int lazy;
+   int iaux;
+   static int w_sum=0, w_samp=0, w_pixtm=0, w_pixcal=0;
+
+   if ( iobuf == (IO_BUFFER *) NULL || te == NULL )
+      return -1;
+
+   te->known = 0;
+   te->readout_mode = 0;
+   te->num_lazy = 0;
+   lazy = te->lazy;
+
+   item_header.type = 0;  /* No data type this time */
+   if ( (rc = get_item_begin(iobuf,&item_header)) < 0 )
       return rc;
    tel_id = (item_header.type - IO_TYPE_HESS_TELEVENT)%100 +
             100 * ((item_header.type - IO_TYPE_HESS_TELEVENT)/1000);
@@ -6990,6 +7548,16 @@ int read_hess_televent (IO_BUFFER *iobuf, TelEvent *te, int what)
 
    te->glob_count = item_header.ident;
 
+   if ( te->lazy )
+   {
+      /* Enough to find the sub-items again as long as the block is not replaced */
+      te->lazy_iobuf = iobuf;
+      te->lazy_what = what;
+      te->lazy_level = item_header.level;
+      te->lazy_item_offset = iobuf->item_start_offset[item_header.level];
+      te->lazy_item_length = iobuf->item_length[item_header.level];
+   }
+
    if ( (raw = te->raw) != NULL )
       raw->known = 0;
    if ( te->pixtm != NULL )
@@ -7027,11 +7595,9 @@ int read_hess_televent (IO_BUFFER *iobuf, TelEvent *te, int what)
                rc = skip_subitem(iobuf);
                continue;
             }
-            rc = read_hess_teladc_sums(iobuf,raw);
-	    te->readout_mode = 0;     /* ADC sums */
-            if ( rc == 0 )
-	       raw->known = 1;
-            raw->tel_id = te->tel_id; /* For IDs beyond 31, bits may be missing */
+            if ( lazy && (rc = hess_televent_defer(iobuf,te,nt,&lazy,&tel_img)) <= 0 )
+               break;
+            rc = read_hess_telpart(iobuf,te,nt,what,&tel_img);
             break;
 
          case IO_TYPE_HESS_TELADCSAMP:
@@ -7042,19 +7608,9 @@ int read_hess_televent (IO_BUFFER *iobuf, TelEvent *te, int what)
                rc = skip_subitem(iobuf);
                continue;
             }
-            if ( raw->known ) /* Preceded by sum data? */
-               te->readout_mode = 2; /* sum + samples (perhaps different zero suppression) */
-            else
-            {
-               adc_reset(raw); /* Do we need that? */
-               te->readout_mode = 1; /* ADC samples, sums usually rebuilt */
-            }
-	    rc = read_hess_teladc_samples(iobuf,raw,what);
-            if ( rc == 0 )
-            {
-	       raw->known |= 2;
-            }
-            raw->tel_id = te->tel_id; /* For IDs beyond 31, bits may be missing (?) */
+            if ( lazy && (rc = hess_televent_defer(iobuf,te,nt,&lazy,&tel_img)) <= 0 )
+               break;
+            rc = read_hess_telpart(iobuf,te,nt,what,&tel_img);
             break;
 
          case IO_TYPE_HESS_PIXELTIMING:
@@ -7065,7 +7621,9 @@ int read_hess_televent (IO_BUFFER *iobuf, TelEvent *te, int what)
                rc = skip_subitem(iobuf);
                continue;
             }
-            rc = read_hess_pixtime(iobuf,te->pixtm);
+            if ( lazy && (rc = hess_televent_defer(iobuf,te,nt,&lazy,&tel_img)) <= 0 )
+               break;
+            rc = read_hess_telpart(iobuf,te,nt,what,&tel_img);
             break;
 
          case IO_TYPE_HESS_PIXELCALIB:
@@ -7087,17 +7645,9 @@ int read_hess_televent (IO_BUFFER *iobuf, TelEvent *te, int what)
          case IO_TYPE_HESS_TELIMAGE:
             if ( img == NULL || (what & IMAGE_FLAG) == 0 )
                break;
-      	    if ( tel_img >= te->max_image_sets )
-	    {
-	       Warning("Not enough space to read all image sets");
-	       break;
-	    }
-	    if ( (rc = read_hess_telimage(iobuf,&img[tel_img])) == 0 )
-	    {
-	       img[tel_img].known = 1;
-	       tel_img++;
-	    }
-            te->num_image_sets = tel_img;
+            if ( lazy && (rc = hess_televent_defer(iobuf,te,nt,&lazy,&tel_img)) <= 0 )
+               break;
+            rc = read_hess_telpart(iobuf,te,nt,what,&tel_img);
             break;
 
          case IO_TYPE_HESS_PIXELLIST:
@@ -7715,6 +8265,7 @@ int read_hess_event (IO_BUFFER *iobuf, FullEvent *ev, int what)
    for ( j=0; j<ev->num_tel; j++ )
    {
       ev->teldata[j].known = 0;
+      ev->teldata[j].num_lazy = 0;
       ev->trackdata[j].raw_known = ev->trackdata[j].cor_known = 0;
    }
    ev->shower.known = 0;
@@ -7869,6 +8420,240 @@ int read_hess_event (IO_BUFFER *iobuf, FullEvent *ev, int what)
    return get_item_end(iobuf,&item_header);
 }
 
+/* --------------------- set_hess_lazy_decode -------------------- */
+/**
+ *  @short Switch decoding on demand of telescope data on or off.
+ *
+ *  In lazy mode, read_hess_event() (and read_hess_televent()) only
+ *  remember where the ADC sums and samples, the pixel timing, and the
+ *  image parameters of each telescope are found in the I/O buffer.
+ *  They get decoded on first access through hess_tel_raw(),
+ *  hess_tel_pixtm(), and hess_tel_img() or hess_televent_decode().
+ *  That must happen before the next block is read into the same
+ *  I/O buffer. Anything else (trigger data, pixel lists, tracking,
+ *  central event data, ...) is decoded right away as usual.
+ *  A telescope event with more than H_MAX_LAZY_ITEMS such sub-items
+ *  ends up completely decoded while reading it.
+ *
+ *  @param ev    The event data structure.
+ *  @param lazy  1: decode on demand, 0: decode everything immediately.
+ */
+
+void set_hess_lazy_decode (FullEvent *ev, int lazy)
+{
+   int j;
+
+   if ( ev == NULL )
+      return;
+   for ( j=0; j<H_MAX_TEL; j++ )
+   {
+      ev->teldata[j].lazy = lazy;
+      ev->teldata[j].num_lazy = 0;
+   }
+}
+
+/* ------------------------ hess_lazy_flags ------------------------ */
+/*
+ *  The 'what' flags corresponding to a sub-item type kept for later.
+ */
+
+static int hess_lazy_flags (int type);
+
+static int hess_lazy_flags (int type)
+{
+   switch ( type )
+   {
+      case IO_TYPE_HESS_TELADCSUM:
+      case IO_TYPE_HESS_TELADCSAMP:
+         return RAWDATA_FLAG|RAWSUM_FLAG;
+      case IO_TYPE_HESS_PIXELTIMING:
+         return TIME_FLAG;
+      case IO_TYPE_HESS_TELIMAGE:
+         return IMAGE_FLAG;
+   }
+   return 0;
+}
+
+/* --------------------- hess_televent_decode -------------------- */
+/**
+ *  @short Decode those parts of a telescope event not yet decoded
+ *         because the event was read in lazy mode.
+ *
+ *  The I/O buffer from which the event was read must still contain
+ *  the same block. Its reading position is restored afterwards, such
+ *  that this is safe to call also while reading other items from it.
+ *
+ *  @param te    The telescope event data.
+ *  @param what  RAWDATA_FLAG or RAWSUM_FLAG for ADC data, TIME_FLAG
+ *               for pixel timing, IMAGE_FLAG for image parameters,
+ *               or -1 for all of them.
+ *
+ *  @return 0 (o.k.), <0 (error as for read_hess_televent())
+ */
+
+int hess_televent_decode (TelEvent *te, int what)
+{
+   int tel_img = 0;
+
+   if ( te == NULL )
+      return -1;
+   /* Any image sets decoded already for this event come first. */
+   if ( te->img != NULL )
+      while ( tel_img < te->max_image_sets && te->img[tel_img].known )
+         tel_img++;
+
+   return hess_televent_pending(te,what,&tel_img);
+}
+
+/* -------------------- hess_televent_pending -------------------- */
+/*
+ *  Decode the pending sub-items selected by 'what', in the order
+ *  of the data stream. Image sets are stored starting at *tel_img,
+ *  the counter shared with sub-items read right away.
+ */
+
+static int hess_televent_pending (TelEvent *te, int what, int *tel_img)
+{
+   IO_BUFFER *iobuf;
+   BYTE *data;
+   long r_remaining;
+   int item_level, level;
+   long item_length[MAX_IO_ITEM_LEVEL], sub_item_length[MAX_IO_ITEM_LEVEL],
+      item_start_offset[MAX_IO_ITEM_LEVEL];
+   int i, j, rc = 0, img0 = *tel_img;
+
+   for ( i=0; i<te->num_lazy; i++ )
+      if ( (hess_lazy_flags(te->lazy_type[i]) & what) != 0 )
+         break;
+   if ( i >= te->num_lazy )
+      return 0; /* Nothing of that kind pending */
+   if ( (iobuf = te->lazy_iobuf) == NULL || iobuf->buffer == NULL ||
+        (level = te->lazy_level) < 0 || level+1 >= MAX_IO_ITEM_LEVEL )
+   {
+      Warning("Telescope event data no longer available for decoding");
+      te->num_lazy = 0;
+      return -1;
+   }
+
+   /* Save the present reading position ... */
+   data = iobuf->data;
+   r_remaining = iobuf->r_remaining;
+   item_level = iobuf->item_level;
+   memcpy(item_length,iobuf->item_length,sizeof(item_length));
+   memcpy(sub_item_length,iobuf->sub_item_length,sizeof(sub_item_length));
+   memcpy(item_start_offset,iobuf->item_start_offset,sizeof(item_start_offset));
+
+   /* ... and go back into the telescope event item. */
+   iobuf->item_level = level + 1;
+   iobuf->item_start_offset[level] = te->lazy_item_offset;
+   iobuf->item_length[level] = te->lazy_item_length;
+   iobuf->sub_item_length[level] = 0;
+
+   for ( i=j=0; i<te->num_lazy; i++ )
+   {
+      if ( (hess_lazy_flags(te->lazy_type[i]) & what) == 0 )
+      {
+         /* Keep it for later */
+         te->lazy_type[j] = te->lazy_type[i];
+         te->lazy_offset[j] = te->lazy_offset[i];
+         j++;
+         continue;
+      }
+      if ( rc < 0 )
+         continue;
+      iobuf->data = iobuf->buffer + te->lazy_offset[i];
+      iobuf->r_remaining = iobuf->item_length[0] + 16 + 
+         (iobuf->item_extension[0]?4:0) - te->lazy_offset[i];
+      rc = read_hess_telpart(iobuf,te,te->lazy_type[i],te->lazy_what,tel_img);
+   }
+   te->num_lazy = j;
+
+   /* Fix for missing number of pixels in image of older data format: */
+   if ( img0 == 0 && *tel_img > 0 && te->img[0].known && te->img[0].pixels == 0 )
+      te->img[0].pixels = te->image_pixels.pixels;
+
+   iobuf->data = data;
+   iobuf->r_remaining = r_remaining;
+   iobuf->item_level = item_level;
+   memcpy(iobuf->item_length,item_length,sizeof(item_length));
+   memcpy(iobuf->sub_item_length,sub_item_length,sizeof(sub_item_length));
+   memcpy(iobuf->item_start_offset,item_start_offset,sizeof(item_start_offset));
+
+   return rc;
+}
+
+/* ------------------------- hess_tel_raw ------------------------- */
+/**
+ *  @short Access the ADC data of one telescope, decoding it first
+ *         if the event was read in lazy mode.
+ *
+ *  @param ev    The event data.
+ *  @param itel  The telescope index (not the ID, see find_tel_idx()).
+ *
+ *  @return Pointer to the ADC data or NULL if not available.
+ */
+
+AdcData *hess_tel_raw (FullEvent *ev, int itel)
+{
+   TelEvent *te;
+
+   if ( ev == NULL || itel < 0 || itel >= ev->num_tel )
+      return NULL;
+   te = &ev->teldata[itel];
+   if ( !te->known || te->raw == NULL )
+      return NULL;
+   if ( hess_televent_decode(te,RAWDATA_FLAG|RAWSUM_FLAG) < 0 ||
+        !te->raw->known )
+      return NULL;
+   return te->raw;
+}
+
+/* ------------------------ hess_tel_pixtm ------------------------ */
+/**
+ *  @short Access the pixel timing data of one telescope, decoding it
+ *         first if the event was read in lazy mode.
+ *
+ *  @return Pointer to the timing data or NULL if not available.
+ */
+
+PixelTiming *hess_tel_pixtm (FullEvent *ev, int itel)
+{
+   TelEvent *te;
+
+   if ( ev == NULL || itel < 0 || itel >= ev->num_tel )
+      return NULL;
+   te = &ev->teldata[itel];
+   if ( !te->known || te->pixtm == NULL )
+      return NULL;
+   if ( hess_televent_decode(te,TIME_FLAG) < 0 || !te->pixtm->known )
+      return NULL;
+   return te->pixtm;
+}
+
+/* ------------------------- hess_tel_img ------------------------- */
+/**
+ *  @short Access the image parameters of one telescope, decoding them
+ *         first if the event was read in lazy mode.
+ *
+ *  @return Pointer to the first of te->num_image_sets image sets
+ *          or NULL if not available.
+ */
+
+ImgData *hess_tel_img (FullEvent *ev, int itel)
+{
+   TelEvent *te;
+
+   if ( ev == NULL || itel < 0 || itel >= ev->num_tel )
+      return NULL;
+   te = &ev->teldata[itel];
+   if ( !te->known || te->img == NULL )
+      return NULL;
+   if ( hess_televent_decode(te,IMAGE_FLAG) < 0 ||
+        te->num_image_sets <= 0 || !te->img[0].known )
+      return NULL;
+   return te->img;
+}
+
 /* --------------------- print_hess_event -------------------- */
 /**
  *  Print the full array data of one event in eventio format.
@@ -7985,6 +8770,418 @@ int print_hess_event (IO_BUFFER *iobuf)
    return get_item_end(iobuf,&item_header);
 }
 
+/* ------------------ copy_hess_tel_item_remapped ------------------ */
+/**
+ *  @short Copy a telescope event or tracking data block from an event,
+ *         changing the telescope ID but without decoding the data.
+ *
+ *  Programs like merge_simtel only need to change the telescope ID
+ *  in the telescope-specific parts of an event. Instead of decoding
+ *  and re-encoding everything (which for raw data means unpacking and
+ *  re-packing all ADC sums and samples), only the item headers that
+ *  carry the telescope ID get rewritten here. All data is copied
+ *  byte-for-byte, except for the telescope ID at the start of
+ *  auxiliary traces.
+ *
+ *  The copy is started as a new item at the current level in iobuf2,
+ *  as a top-level item if nothing else is being written there.
+ *
+ *  @param iobuf   Input I/O buffer, positioned at a sub-item of an
+ *                 event block of type IO_TYPE_HESS_TELEVENT+...
+ *                 or IO_TYPE_HESS_TRACKEVENT+...
+ *  @param iobuf2  Output I/O buffer.
+ *  @param tel_id  The new telescope ID.
+ *
+ *  @return 0 (o.k.), -1 (error), -3 (cannot be remapped without 
+ *          decoding, like for input in a different byte order,
+ *          unknown sub-items or old data formats where the new
+ *          telescope ID does not fit into the header bits;
+ *          nothing was taken from the input or written then).
+ */
+
+int copy_hess_tel_item_remapped (IO_BUFFER *iobuf, IO_BUFFER *iobuf2, int tel_id)
+{
+   IO_ITEM_HEADER item_header, sub_item_header, out_header, out_sub_header;
+   int type, rc;
+   unsigned long code;
+   long ident;
+   int is_track = 0;
+
+   if ( iobuf == (IO_BUFFER *) NULL || iobuf2 == (IO_BUFFER *) NULL ||
+        tel_id < 0 || tel_id > 0x3fff )
+      return -1;
+   /* Data copied as bytes must be in the byte order used for output. */
+   if ( iobuf->byte_order != 0 )
+      return -3;
+   code = (unsigned long) (tel_id%100 + 1000*(tel_id/100));
+
+   item_header.type = 0;
+   if ( (rc = get_item_begin(iobuf,&item_header)) < 0 )
+      return rc;
+   if ( item_header.type >= IO_TYPE_HESS_TRACKEVENT &&
+        (item_header.type - IO_TYPE_HESS_TRACKEVENT) % 1000 < 100 )
+      is_track = 1;
+   else if ( item_header.type >= IO_TYPE_HESS_TELEVENT &&
+        (item_header.type - IO_TYPE_HESS_TELEVENT) % 1000 < 100 )
+      is_track = 0;
+   else
+   {
+      unget_item(iobuf,&item_header);
+      return -3;
+   }
+
+   out_header.version = item_header.version;
+   if ( is_track )
+   {
+      out_header.type = IO_TYPE_HESS_TRACKEVENT + code;
+      /* Keep the raw/corrected flag bits. */
+      out_header.ident = (item_header.ident & ~0x3f0000ffL) |
+         (tel_id & 0xff) | ((tel_id & 0x3f00) << 16);
+   }
+   else
+   {
+      out_header.type = IO_TYPE_HESS_TELEVENT + code;
+      out_header.ident = item_header.ident;
+   }
+   if ( (rc = put_item_begin_with_flags(iobuf2,&out_header,
+           item_header.user_flag,item_header.use_extension)) < 0 )
+   {
+      unget_item(iobuf,&item_header);
+      return rc;
+   }
+
+   if ( is_track )
+   {
+      put_vector_of_byte(iobuf->data,(int)item_header.length,iobuf2);
+      get_item_end(iobuf,&item_header);
+      return put_item_end(iobuf2,&out_header);
+   }
+
+   while ( (type = next_subitem_type(iobuf)) > 0 )
+   {
+      int aux_id = 0;
+      sub_item_header.type = 0;
+      if ( (rc = get_item_begin(iobuf,&sub_item_header)) < 0 )
+         break;
+      ident = sub_item_header.ident;
+      switch ( type )
+      {
+         case IO_TYPE_HESS_TELEVTHEAD:
+         case IO_TYPE_HESS_PIXELTIMING:
+         case IO_TYPE_HESS_PIXELCALIB:
+         case IO_TYPE_HESS_PIXELTRG_TM:
+            ident = tel_id;
+            break;
+         case IO_TYPE_HESS_TELADCSUM:
+         case IO_TYPE_HESS_TELADCSAMP:
+            if ( sub_item_header.version >= 2 )
+               ident = (ident & ~(0xffffL << 12)) | ((long) tel_id << 12);
+            else if ( tel_id <= 0x1f )
+               ident = (ident & ~(0x1fL << 25)) | ((long) tel_id << 25);
+            else
+               rc = -3;
+            break;
+         case IO_TYPE_HESS_TELIMAGE:
+            ident = (ident & ~0x3f0000ffL) | 
+               (tel_id & 0xff) | ((tel_id & 0x3f00) << 16);
+            break;
+         case IO_TYPE_HESS_PIXELLIST:
+            ident = (ident / 1000000) * 1000000 + tel_id;
+            break;
+         case IO_TYPE_HESS_AUX_DIGITAL_TRACE:
+         case IO_TYPE_HESS_AUX_ANALOG_TRACE:
+            aux_id = 1; /* Telescope ID is in the data, not the header. */
+            break;
+         default:
+            rc = -3;
+      }
+      if ( rc < 0 || (aux_id && sub_item_header.length < 4) )
+      {
+         if ( rc == 0 )
+            rc = -3;
+         break;
+      }
+      out_sub_header.type = sub_item_header.type;
+      out_sub_header.version = sub_item_header.version;
+      out_sub_header.ident = ident;
+      if ( (rc = put_item_begin_with_flags(iobuf2,&out_sub_header,
+              sub_item_header.user_flag,sub_item_header.use_extension)) < 0 )
+         break;
+      if ( aux_id )
+      {
+         (void) get_long(iobuf);
+         put_long(tel_id,iobuf2);
+         put_vector_of_byte(iobuf->data,(int)sub_item_header.length-4,iobuf2);
+      }
+      else
+         put_vector_of_byte(iobuf->data,(int)sub_item_header.length,iobuf2);
+      get_item_end(iobuf,&sub_item_header);
+      if ( (rc = put_item_end(iobuf2,&out_sub_header)) < 0 )
+         break;
+   }
+
+   if ( rc < 0 )
+   {
+      /* Nothing to be written, and back to where we started. */
+      unput_item(iobuf2,&out_header);
+      unget_item(iobuf,&item_header);
+      return rc;
+   }
+
+   get_item_end(iobuf,&item_header);
+   return put_item_end(iobuf2,&out_header);
+}
+
+/* ----------------------------------------------------------------------- */
+/*
+ *  Pass-through of telescope-specific event data:
+ *  Telescope event and tracking data blocks of a (full) event only
+ *  need their telescope IDs changed when merging or extracting
+ *  telescopes. Rather than decoding and re-encoding all raw data,
+ *  they are copied byte-for-byte with re-written headers into a
+ *  staging area and appended to the output event when it gets
+ *  written. Only the central trigger block is decoded and re-mapped.
+ */
+
+static IO_BUFFER *pt_iobuf = NULL; /**< For re-mapped telescope data blocks. */
+static BYTE *pt_data = NULL;     /**< Staged blocks, appended to the event at output. */
+static long pt_len = 0, pt_max = 0;
+
+static int pt_collect (unsigned char *buf, long len, int mode);
+
+/** 
+ *  Output function for pt_iobuf, collecting complete blocks
+ *  (all after the first one without their synchronisation marker).
+ */
+
+static int pt_collect (unsigned char *buf, long len, int mode)
+{
+   long skip = (pt_len > 0) ? 4 : 0;
+
+   if ( mode != 1 || len < 16 )
+      return -1;
+   if ( pt_len + len - skip > pt_max )
+   {
+      long nmax = 2*pt_max + len;
+      BYTE *ndata = (BYTE *) realloc(pt_data,(size_t)nmax);
+      if ( ndata == NULL )
+      {
+         Warning("Not enough memory for staging event data");
+         return -1;
+      }
+      pt_data = ndata;
+      pt_max = nmax;
+   }
+   memcpy(pt_data+pt_len,buf+skip,(size_t)(len-skip));
+   pt_len += len - skip;
+   return 0;
+}
+
+/* ------------------- init_hess_pass_through -------------------- */
+/**
+ *  @short Set up the staging area for passing telescope data through.
+ *
+ *  Without this, read_hess_event_pass_through() always reports
+ *  that full decoding is needed.
+ *
+ *  @return 0 (o.k.), -1 (not enough memory)
+ */
+
+int init_hess_pass_through (void)
+{
+   if ( pt_iobuf != NULL )
+      return 0;
+   if ( (pt_iobuf = allocate_io_buffer(1000000L)) == NULL )
+      return -1;
+   pt_iobuf->max_length = 400000000L;
+   pt_iobuf->user_function = pt_collect;
+   return 0;
+}
+
+/* ------------------- reset_hess_pass_through -------------------- */
+/**
+ *  @short Discard any telescope data staged for the next output event.
+ */
+
+void reset_hess_pass_through (void)
+{
+   pt_len = 0;
+}
+
+/* ----------------- read_hess_event_pass_through ------------------ */
+/**
+ *  @short Read a full event, passing telescope data through to the output.
+ *
+ *  Read a full event, decoding only the central trigger data
+ *  and staging re-mapped copies of all telescope event and tracking
+ *  data blocks of mapped telescopes (tracking only for telescopes
+ *  with event data), to be written by write_hess_event_pass_through().
+ *  Any shower data in the input is ignored.
+ *
+ *  @param iobuf      Input I/O buffer, at a full event block.
+ *  @param evi        Event structure for the central trigger data.
+ *  @param out_tel_id Function returning the output telescope ID
+ *                    for an input telescope ID (and the given
+ *                    input file number), or -1 if not wanted.
+ *  @param ifile      Input file number, passed on to out_tel_id.
+ *  @param tel_list   The (output) IDs of telescopes with staged
+ *                    event data (size H_MAX_TEL).
+ *  @param ntel_list  The number of entries in tel_list.
+ *
+ *  @return 0 (o.k.), -1 (error), -3 (cannot pass through, nothing
+ *          taken from input; use read_hess_event() instead).
+ */
+
+int read_hess_event_pass_through (IO_BUFFER *iobuf, FullEvent *evi, 
+   int (*out_tel_id) (int tel_id, int ifile), int ifile,
+   int *tel_list, int *ntel_list)
+{
+   IO_ITEM_HEADER item_header;
+   long pt_len0 = pt_len;
+   int type, tel_id, tel_id3, rc = 0, j, nlist = 0;
+
+   if ( pt_iobuf == NULL || iobuf->byte_order != 0 || out_tel_id == NULL )
+      return -3;
+
+   item_header.type = IO_TYPE_HESS_EVENT;
+   if ( (rc = get_item_begin(iobuf,&item_header)) < 0 )
+      return rc;
+   if ( item_header.version != 0 )
+   {
+      unget_item(iobuf,&item_header);
+      return -3;
+   }
+
+   evi->central.glob_count = evi->central.teltrg_pattern = 
+      evi->central.teldata_pattern = 
+      evi->central.num_teltrg = evi->central.num_teldata = 0;
+   reset_htime(&evi->central.cpu_time);
+   reset_htime(&evi->central.gps_time);
+   evi->num_teldata = 0;
+   for ( j=0; j<evi->num_tel; j++ )
+   {
+      evi->teldata[j].known = 0;
+      evi->trackdata[j].raw_known = evi->trackdata[j].cor_known = 0;
+   }
+   evi->shower.known = 0;
+
+   while ( rc >= 0 && (type = next_subitem_type(iobuf)) > 0 )
+   {
+      int is_track = 0;
+      if ( type == IO_TYPE_HESS_CENTEVENT )
+      {
+         rc = read_hess_centralevent(iobuf,&evi->central);
+         continue;
+      }
+      else if ( type >= IO_TYPE_HESS_TRACKEVENT &&
+         (type-IO_TYPE_HESS_TRACKEVENT)%1000 < 100 )
+      {
+         is_track = 1;
+         tel_id = (type - IO_TYPE_HESS_TRACKEVENT)%100 +
+                  100*((type-IO_TYPE_HESS_TRACKEVENT)/1000);
+      }
+      else if ( type >= IO_TYPE_HESS_TELEVENT &&
+         (type-IO_TYPE_HESS_TELEVENT)%1000 < 100 )
+      {
+         tel_id = (type - IO_TYPE_HESS_TELEVENT)%100 +
+                  100*((type-IO_TYPE_HESS_TELEVENT)/1000);
+      }
+      else
+      {
+         rc = skip_subitem(iobuf);
+         continue;
+      }
+      if ( is_track )
+      {
+         /* Tracking data goes with telescope data, like in write_hess_event(). */
+         for ( j=0; j<evi->central.num_teldata; j++ )
+            if ( evi->central.teldata_list[j] == tel_id )
+               break;
+         if ( j >= evi->central.num_teldata )
+            tel_id = -1;
+      }
+      tel_id3 = (tel_id < 0) ? -1 : out_tel_id(tel_id,ifile);
+      if ( tel_id3 < 0 )
+      {
+         rc = skip_subitem(iobuf);
+         continue;
+      }
+      rc = copy_hess_tel_item_remapped(iobuf,pt_iobuf,tel_id3);
+      if ( rc == 0 && !is_track && nlist < H_MAX_TEL )
+         tel_list[nlist++] = tel_id3;
+   }
+
+   /* Old-style or missing central data would need the telescope data for completion. */
+   if ( rc == 0 && evi->central.num_teltrg == 0 && 
+        (evi->central.teltrg_pattern != 0 || evi->central.num_teldata == 0) )
+      rc = -3;
+
+   if ( rc < 0 )
+   {
+      pt_len = pt_len0;
+      if ( rc == -3 )
+         unget_item(iobuf,&item_header);
+      else
+         get_item_end(iobuf,&item_header);
+      return rc;
+   }
+
+   *ntel_list = nlist;
+
+   return get_item_end(iobuf,&item_header);
+}
+
+/* ----------------- write_hess_event_pass_through ----------------- */
+/**
+ *  @short Write an event with the telescope data passed through.
+ *
+ *  Write the event, with any decoded telescope data followed
+ *  by the staged pass-through data blocks, which are discarded
+ *  afterwards. Without staged data, this is the same as
+ *  write_hess_event().
+ *
+ *  @param iobuf  Output I/O buffer.
+ *  @param ev     The event with decoded central (and any other) data.
+ *  @param ident  The event number, as used for single-telescope data
+ *                (for multi-telescope data the global count is used).
+ *
+ *  @return 0 (o.k.), <0 (error)
+ */
+
+int write_hess_event_pass_through (IO_BUFFER *iobuf, FullEvent *ev, long ident)
+{
+   IO_ITEM_HEADER item_header;
+   int j, rc = 0;
+
+   if ( pt_len == 0 )
+      return write_hess_event(iobuf,ev,-1);
+
+   item_header.type = IO_TYPE_HESS_EVENT;
+   item_header.version = 0;
+   if ( ev->num_tel > 1 )
+      item_header.ident = ev->central.glob_count;
+   else
+      item_header.ident = ident;
+   put_item_begin(iobuf,&item_header);
+   rc = write_hess_centralevent(iobuf,&ev->central);
+   for ( j=0; j<ev->num_tel && rc == 0; j++ )
+      if ( ev->teldata[j].known )
+         rc = write_hess_televent(iobuf,&ev->teldata[j],-1);
+   for ( j=0; j<ev->num_tel && rc == 0; j++ )
+      if ( ev->trackdata[j].raw_known || ev->trackdata[j].cor_known )
+         rc = write_hess_trackevent(iobuf,&ev->trackdata[j]);
+   if ( rc == 0 )
+      rc = append_io_block_as_item(iobuf,&item_header,pt_data,pt_len);
+   pt_len = 0;
+   if ( rc != 0 )
+   {
+      Warning("Abort write_hess_event_pass_through() due to problem in event data");
+      unput_item(iobuf,&item_header);
+      return rc;
+   }
+   return put_item_end(iobuf,&item_header);
+}
+
 /* ------------------- write_hess_calib_event -------------------- */
 /**
  *  @short Write a calibration event (pedestal, laser, led, ...) as
@@ -9725,7 +10922,6 @@ int read_hess_mc_phot (IO_BUFFER *iobuf, MCEvent *mce)
    int iarray=0, itel=0, itel_pe=0, tel_id=0, jtel=0, type, nbunches=0, max_bunches=0, flags=0;
    int npe=0, pixels=0, max_npe=0;
    int rc;
-   double photons=0.;
    IO_ITEM_HEADER item_header;
    if ( (rc = begin_read_tel_array(iobuf, &item_header, &iarray)) < 0 )
       return rc;
@@ -9734,22 +10930,24 @@ int read_hess_mc_phot (IO_BUFFER *iobuf, MCEvent *mce)
       switch (type)
       {
       	 case IO_TYPE_MC_PHOTONS:
-            /* The purpose of this first call to read_tel_photons is only
-               to retrieve the array and telescope numbers (the original offset
-               number without ignored telescopes, basically telescope ID minus one), etc. */
-	    /* With a NULL pointer argument, we expect rc = -10 */
-      	    rc = read_tel_photons(iobuf, 0, &iarray, &itel_pe, &photons,
-	          NULL, &nbunches);
-	    if ( rc != -10 )
+         {
+            struct tel_photons_cursor cur;
+            /* Array and telescope numbers (the original offset number
+               without ignored telescopes, basically telescope ID minus one)
+               and the number of bunches are known before reading the bunches. */
+      	    if ( (rc = begin_read_tel_photons(iobuf, &cur)) < 0 )
 	    {
       	       get_item_end(iobuf,&item_header);
 	       return -1;
 	    }
-            tel_id = itel_pe + 1;
+            iarray = cur.array;
+            nbunches = cur.nbunches;
+            tel_id = cur.tel + 1;
             itel = find_tel_idx(tel_id);
 	    if ( itel < 0 || itel >= H_MAX_TEL )
 	    {
 	       Warning("Invalid telescope number in MC photons");
+               end_read_tel_photons(&cur);
       	       get_item_end(iobuf,&item_header);
 	       return -1;
 	    }
@@ -9764,6 +10962,7 @@ int read_hess_mc_phot (IO_BUFFER *iobuf, MCEvent *mce)
 		    calloc(nbunches,sizeof(struct bunch))) == NULL )
 	       {
 		  mce->mc_photons[itel].max_bunches = 0;
+                  end_read_tel_photons(&cur);
       	          get_item_end(iobuf,&item_header);
 	          return -4;
 	       }
@@ -9772,9 +10971,13 @@ int read_hess_mc_phot (IO_BUFFER *iobuf, MCEvent *mce)
 	    else
 	       max_bunches = mce->mc_photons[itel].max_bunches;
 
-            /* Now really get the photon bunches */
-      	    rc = read_tel_photons(iobuf, max_bunches, &iarray, &jtel, 
-	       &photons, mce->mc_photons[itel].bunches, &nbunches);
+            /* Now really get the photon bunches, all in one chunk */
+      	    rc = read_tel_photons_chunk(&cur, mce->mc_photons[itel].bunches, max_bunches);
+            jtel = cur.tel;
+            if ( rc >= 0 )
+               rc = end_read_tel_photons(&cur);
+            else
+               end_read_tel_photons(&cur);
 
 	    if ( rc < 0 )
 	    {
@@ -9791,6 +10994,7 @@ int read_hess_mc_phot (IO_BUFFER *iobuf, MCEvent *mce)
       	       get_item_end(iobuf,&item_header);
 	       return -5;
 	    }
+         }
 	    break;
 	 case IO_TYPE_MC_PE:
             /* The purpose of this first call to read_photo_electrons is only
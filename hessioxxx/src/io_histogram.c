@@ -78,6 +78,59 @@ int write_all_histograms (const char *fname)
    return rc;
 }
 
+/* ---------------------- write_histogram_set --------------------------- */
+/**
+ *  @short Save all histograms of a set into the file with the given name.
+ *
+ *  The histograms are written straight from the set, in the order
+ *  of their IDs, without going through the global list.
+ *  Very large sets are split into several histogram blocks.
+ *
+ *  @return 0 (O.k.), -1 (error), -4 (nothing to write)
+ */
+
+int write_histogram_set (const char *fname, const HISTOGRAM_SET *hset)
+{
+   FILE *file;
+   IO_BUFFER *iobuf = NULL;
+   size_t ihisto, nblock;
+   int rc = 0;
+
+   if ( hset == (const HISTOGRAM_SET *) NULL || hset->num == 0 )
+   {
+      fprintf(stderr,"No histograms to write.\n");
+      return -4;
+   }
+
+   if ( (file = fileopen(fname,"w")) == NULL )
+   {
+      perror(fname);
+      return -1;
+   }
+
+   if ( (iobuf = allocate_io_buffer(8000000)) == NULL )
+   {
+      fileclose(file);
+      return -1;
+   }
+   iobuf->max_length = 800000000;
+   iobuf->output_file = file;
+
+   /* The number of histograms per block must fit into a short. */
+   for ( ihisto=0; ihisto<hset->num && rc == 0; ihisto+=nblock )
+   {
+      nblock = hset->num - ihisto;
+      if ( nblock > 30000 )
+         nblock = 30000;
+      rc = write_histograms(hset->histo+ihisto,(int)nblock,iobuf);
+   }
+
+   free_io_buffer(iobuf);
+   fileclose(file);
+
+   return rc;
+}
+
 /* ------------------ read_histogram_file --------------------- */
 /*
  * @short Read all histograms from a file, optionally adding them up.
@@ -202,6 +255,254 @@ int read_histogram_file_x (const char *fname, int add_flag, const long *xcld_ids
    return 0;
 }
 
+/* ------------------ read_histogram_set_file --------------------- */
+/**
+ * @short Read (selected) histograms from a file into a set of histograms.
+ *
+ *  Only histogram blocks (type 100) get read into memory. All other
+ *  data blocks, like the events in a sim_telarray output file, are
+ *  stepped over by seeking (or by reading and discarding them if the
+ *  input is a pipe, as for compressed files). Histograms other than
+ *  the wanted ones are not even allocated. The global list of
+ *  histograms (and its lock) is not used, such that several files
+ *  can be read concurrently into separate sets.
+ *
+ * @param fname Name of file to be read, optionally compressed.
+ * @param hset  The set to which the histograms are added.
+ * @param ids   Vector of wanted histogram IDs or NULL for all.
+ * @param nids  Number of elements in ids (0 for all).
+ * @param stop_early If non-zero and a list of IDs was given, reading
+ *        of the file stops as soon as each of the IDs was seen in one
+ *        histogram block. Only use this if any histogram appears at
+ *        most once per file (as in sim_telarray output).
+ *
+ * @return Number of histograms read (>=0) or -1 (error).
+ */
+
+int read_histogram_set_file (const char *fname, HISTOGRAM_SET *hset,
+   const long *ids, int nids, int stop_early)
+{
+   FILE *hdata_file;
+   IO_BUFFER *iobuf;
+   IO_ITEM_HEADER item_header;
+   int rc, n, nhist = 0, nfound = 0, i;
+   int *found = NULL;
+
+   if ( ids == (const long *) NULL || nids <= 0 )
+   {
+      nids = 0;
+      stop_early = 0;
+   }
+   if ( nids > 0 && (found = (int *) calloc((size_t)nids,sizeof(int))) == NULL )
+      return -1;
+
+   if ( strcmp(fname,"-") == 0 )
+      hdata_file = stdin;
+   else if ( (hdata_file = fileopen(fname,READ_BINARY)) == (FILE *) NULL )
+   {
+      fprintf(stderr,"File '%s' not opened\n",fname);
+      free(found);
+      return -1;
+   }
+
+   /* Histogram blocks are usually small, the buffer may grow if needed. */
+   if ( (iobuf = allocate_io_buffer(1000000)) == (IO_BUFFER *) NULL )
+   {
+      fprintf(stderr,"No I/O buffer\n");
+      if ( hdata_file != stdin )
+         fileclose(hdata_file);
+      free(found);
+      return -1;
+   }
+   iobuf->input_file = hdata_file;
+   iobuf->max_length = 800000000;
+
+   while ( (rc = find_io_block(iobuf,&item_header)) >= 0 )
+   {
+      if ( item_header.type != 100 )
+      {
+         (void) skip_io_block(iobuf,&item_header);
+         continue;
+      }
+      if ( (rc = read_io_block(iobuf,&item_header)) < 0 )
+      {
+         Warning("Input data read error.");
+         break;
+      }
+      if ( (n = read_histograms_to_set(hset,ids,nids,found,iobuf)) < 0 )
+         Warning("There are problems with the input histograms");
+      else
+         nhist += n;
+      if ( stop_early )
+      {
+         for ( i=nfound=0; i<nids; i++ )
+            nfound += found[i];
+         if ( nfound >= nids )
+            break;
+      }
+   }
+
+   free_io_buffer(iobuf);
+   clearerr(hdata_file);
+   if ( hdata_file != stdin )
+      fileclose(hdata_file);
+   free(found);
+
+   return (rc == -1) ? -1 : nhist;
+}
+
+/* ------------------ read_histogram_files --------------------- */
+
+#ifdef _REENTRANT
+/** Shared state of the threads reading histogram files. */
+struct histo_files_job
+{
+   const char **fnames;
+   int nfiles;
+   int next_file;
+   const long *ids;
+   int nids;
+   int stop_early;
+   int nerr;
+   pthread_mutex_t lock;
+};
+
+/** Thread function: take the next file until none is left and
+    accumulate its histograms into the thread's own set. */
+
+static void *read_histogram_files_thread (void *arg)
+{
+   struct histo_files_job *job = ((void **) arg)[0];
+   HISTOGRAM_SET *hset = ((void **) arg)[1];
+
+   for (;;)
+   {
+      int ifile;
+      pthread_mutex_lock(&job->lock);
+      ifile = job->next_file++;
+      pthread_mutex_unlock(&job->lock);
+      if ( ifile >= job->nfiles )
+         break;
+      if ( read_histogram_set_file(job->fnames[ifile],hset,
+              job->ids,job->nids,job->stop_early) < 0 )
+      {
+         pthread_mutex_lock(&job->lock);
+         job->nerr++;
+         pthread_mutex_unlock(&job->lock);
+      }
+   }
+   return NULL;
+}
+#endif
+
+/**
+ * @short Read and add up histograms from many files.
+ *
+ *  Each file is read with read_histogram_set_file(). With more than
+ *  one thread, the files are handed out to the threads one at a time,
+ *  each thread adds up into its own set, and the per-thread sets are
+ *  finally merged pairwise. Without thread support (no _REENTRANT)
+ *  the files are read one after the other.
+ *  Since histogram contents are added up in a different order,
+ *  weighted ('F') histograms may differ in the last bits of precision
+ *  from a sequential sum.
+ *
+ * @param fnames   Vector of file names.
+ * @param nfiles   Number of file names.
+ * @param ids      Vector of wanted histogram IDs or NULL for all.
+ * @param nids     Number of elements in ids (0 for all).
+ * @param stop_early See read_histogram_set_file().
+ * @param nthreads Number of reading threads (<=1: no extra threads).
+ * @param result   Set where the summed histograms end up.
+ *
+ * @return Number of files which could not be read (0: o.k.).
+ */
+
+int read_histogram_files (const char **fnames, int nfiles,
+   const long *ids, int nids, int stop_early, int nthreads,
+   HISTOGRAM_SET *result)
+{
+   int ifile, nerr = 0;
+
+   if ( fnames == NULL || result == (HISTOGRAM_SET *) NULL )
+      return -1;
+
+#ifdef _REENTRANT
+   if ( nthreads > nfiles )
+      nthreads = nfiles;
+   if ( nthreads > 1 )
+   {
+      struct histo_files_job job;
+      HISTOGRAM_SET *sets;
+      pthread_t *threads;
+      void **args;
+      int ithr, nstarted = 0, step;
+
+      sets = (HISTOGRAM_SET *) calloc((size_t)nthreads,sizeof(HISTOGRAM_SET));
+      threads = (pthread_t *) calloc((size_t)nthreads,sizeof(pthread_t));
+      args = (void **) calloc((size_t)(2*nthreads),sizeof(void *));
+      if ( sets == NULL || threads == NULL || args == NULL )
+      {
+         free(sets);
+         free(threads);
+         free(args);
+         return read_histogram_files(fnames,nfiles,ids,nids,stop_early,1,result);
+      }
+      job.fnames = fnames;
+      job.nfiles = nfiles;
+      job.next_file = 0;
+      job.ids = ids;
+      job.nids = nids;
+      job.stop_early = stop_early;
+      job.nerr = 0;
+      pthread_mutex_init(&job.lock,NULL);
+
+      for ( ithr=0; ithr<nthreads; ithr++ )
+      {
+         args[2*ithr] = &job;
+         args[2*ithr+1] = &sets[ithr];
+         if ( pthread_create(&threads[ithr],NULL,read_histogram_files_thread,
+                 &args[2*ithr]) != 0 )
+            break;
+         nstarted++;
+      }
+      for ( ithr=0; ithr<nstarted; ithr++ )
+         pthread_join(threads[ithr],NULL);
+      /* If no thread could be started, the work is all ours. */
+      if ( nstarted == 0 )
+      {
+         (void) read_histogram_files_thread(&args[0]);
+         nstarted = 1;
+      }
+
+      /* Pairwise (tree) reduction of the per-thread sets. */
+      for ( step=1; step<nstarted; step*=2 )
+         for ( ithr=0; ithr+step<nstarted; ithr+=2*step )
+         {
+            merge_histogram_sets(&sets[ithr],&sets[ithr+step]);
+            free_histogram_set(&sets[ithr+step]);
+         }
+      merge_histogram_sets(result,&sets[0]);
+      free_histogram_set(&sets[0]);
+
+      pthread_mutex_destroy(&job.lock);
+      nerr = job.nerr;
+      free(sets);
+      free(threads);
+      free(args);
+      return nerr;
+   }
+#else
+   (void) nthreads;
+#endif
+
+   for ( ifile=0; ifile<nfiles; ifile++ )
+      if ( read_histogram_set_file(fnames[ifile],result,ids,nids,stop_early) < 0 )
+         nerr++;
+
+   return nerr;
+}
+
 /* ------------------------- write_histograms ---------------------------- */
 /**
  *  Save specific histograms or all allocated histograms.
@@ -388,6 +689,241 @@ int read_histograms (HISTOGRAM **phisto, int nhisto, IO_BUFFER *iobuf)
    return read_histograms_x (phisto, nhisto, NULL, 0, iobuf);
 }
 
+/* Definition and statistics of one histogram as found in the data,
+   before anything gets allocated for it. */
+
+struct histo_record
+{
+   char type;
+   char title[256];
+   long ident;
+   int nbins, nbins_2d, ncounts;
+   long entries, tentries, underflow[2], overflow[2];
+   double rlower[2], rupper[2], rsum[2], rtsum[2];
+   long ilower[2], iupper[2], isum[2], itsum[2];
+};
+
+/* -------------------- get_histo_record ---------------------- */
+/**
+ *  Get the definition part of one histogram, up to its contents.
+ */
+
+static void get_histo_record (struct histo_record *hr, IO_BUFFER *iobuf)
+{
+   char __attribute__((unused)) cdummy;
+   int real_type;
+
+   memset(hr,0,sizeof(*hr));
+   hr->type = (char) get_byte(iobuf);
+   if ( get_string(hr->title,sizeof(hr->title)-1,iobuf) % 2 == 0 )
+      cdummy = get_byte(iobuf); /* Compiler may warn about it but this is OK. */
+   hr->ident = get_long(iobuf);
+   hr->nbins = (int) get_short(iobuf);
+   hr->nbins_2d = (int) get_short(iobuf);
+   hr->entries = (uint32_t) get_long(iobuf);
+   hr->tentries = (uint32_t) get_long(iobuf);
+   hr->underflow[0] = (uint32_t) get_long(iobuf);
+   hr->overflow[0] = (uint32_t) get_long(iobuf);
+   real_type = ( hr->type == 'R' || hr->type == 'r' || 
+                 hr->type == 'F' || hr->type == 'D' );
+   if ( real_type )
+   {
+      hr->rlower[0] = get_real(iobuf);
+      hr->rupper[0] = get_real(iobuf);
+      hr->rsum[0] = get_real(iobuf);
+      hr->rtsum[0] = get_real(iobuf);
+   }
+   else
+   {
+      hr->ilower[0] = get_long(iobuf);
+      hr->iupper[0] = get_long(iobuf);
+      hr->isum[0] = get_long(iobuf);
+      hr->itsum[0] = get_long(iobuf);
+   }
+   if ( hr->nbins_2d > 0 )
+   {
+      hr->underflow[1] = (uint32_t) get_long(iobuf);
+      hr->overflow[1] = (uint32_t) get_long(iobuf);
+      if ( real_type )
+      {
+         hr->rlower[1] = get_real(iobuf);
+         hr->rupper[1] = get_real(iobuf);
+         hr->rsum[1] = get_real(iobuf);
+         hr->rtsum[1] = get_real(iobuf);
+      }
+      else
+      {
+         hr->ilower[1] = get_long(iobuf);
+         hr->iupper[1] = get_long(iobuf);
+         hr->isum[1] = get_long(iobuf);
+         hr->itsum[1] = get_long(iobuf);
+      }
+      hr->ncounts = hr->nbins * hr->nbins_2d;
+   }
+   else
+      hr->ncounts = hr->nbins;
+}
+
+/* -------------------- skip_histo_contents ---------------------- */
+/**
+ *  Step over the contents of a histogram not wanted or not allocated.
+ *  All contents elements are four bytes wide, no matter of the type.
+ */
+
+static void skip_histo_contents (const struct histo_record *hr, IO_BUFFER *iobuf)
+{
+   if ( hr->type == 'F' || hr->type == 'D' )
+      get_vector_of_byte(NULL,10*4,iobuf); /* contents... in histogram extension */
+   if ( hr->tentries > 0 )
+      get_vector_of_byte(NULL,hr->ncounts*4,iobuf);
+}
+
+/* -------------------- alloc_histo_record ---------------------- */
+/**
+ *  Allocate a histogram according to its type and definition
+ *  (without title and ident). A detached histogram is not
+ *  entered into the global list, thus no global lock is needed.
+ */
+
+static HISTOGRAM *alloc_histo_record (struct histo_record *hr, int detached)
+{
+   HISTOGRAM *thisto;
+   int mbins[2];
+
+   mbins[0] = hr->nbins;
+   mbins[1] = hr->nbins_2d;
+   if ( detached )
+   {
+      double dlower[2], dupper[2];
+      const char *type;
+      int i;
+      if ( hr->type == 'R' || hr->type == 'r' )
+         type = "R";
+      else if ( hr->type == 'F' )
+         type = "F";
+      else if ( hr->type == 'D' )
+         type = "D";
+      else
+         type = "I";
+      for ( i=0; i<2; i++ )
+      {
+         dlower[i] = (*type == 'I') ? (double) hr->ilower[i] : hr->rlower[i];
+         dupper[i] = (*type == 'I') ? (double) hr->iupper[i] : hr->rupper[i];
+      }
+      thisto = alloc_histogram_detached(type,(hr->nbins_2d > 0) ? 2 : 1,
+         dlower,dupper,mbins);
+   }
+   else if ( hr->nbins_2d > 0 )
+   {
+      if ( hr->type == 'R' || hr->type == 'r' )
+         thisto = alloc_2d_real_histogram(hr->rlower[0],hr->rupper[0],hr->nbins,
+             hr->rlower[1],hr->rupper[1],hr->nbins_2d);
+      else if ( hr->type == 'F' || hr->type == 'D' )
+         thisto = allocate_histogram(&hr->type,2,hr->rlower,hr->rupper,mbins);
+      else
+         thisto = alloc_2d_int_histogram(hr->ilower[0],hr->iupper[0],hr->nbins,
+             hr->ilower[1],hr->iupper[1],hr->nbins_2d);
+   }
+   else
+   {
+      if ( hr->type == 'R' || hr->type == 'r' )
+         thisto = alloc_real_histogram(hr->rlower[0],hr->rupper[0],hr->nbins);
+      else if ( hr->type == 'F' || hr->type == 'D' )
+         thisto = allocate_histogram(&hr->type,1,hr->rlower,hr->rupper,&hr->nbins);
+      else
+         thisto = alloc_int_histogram(hr->ilower[0],hr->iupper[0],hr->nbins);
+   }
+   if ( thisto != (HISTOGRAM *) NULL )
+      thisto->type = hr->type;
+
+   return thisto;
+}
+
+/* -------------------- get_histo_contents ---------------------- */
+/**
+ *  Set the statistics of an allocated histogram from the record
+ *  and read the histogram contents.
+ */
+
+static void get_histo_contents (HISTOGRAM *thisto, const struct histo_record *hr,
+   IO_BUFFER *iobuf)
+{
+   int ibin, ncounts = hr->ncounts;
+   char type = hr->type;
+
+#ifdef _REENTRANT
+   histogram_lock(thisto);
+#endif
+
+   /* Set the values for histogram statistics. */
+   thisto->entries = hr->entries;
+   thisto->tentries = hr->tentries;
+   thisto->underflow = hr->underflow[0];
+   thisto->overflow = hr->overflow[0];
+   if ( type == 'R' || type == 'r' || type == 'F' || type == 'D' )
+   {
+      thisto->specific.real.sum = hr->rsum[0];
+      thisto->specific.real.tsum = hr->rtsum[0];
+   }
+   else
+   {
+      thisto->specific.integer.sum = hr->isum[0];
+      thisto->specific.integer.tsum = hr->itsum[0];
+   }
+   if ( hr->nbins_2d > 0 )
+   {
+      thisto->underflow_2d = hr->underflow[1];
+      thisto->overflow_2d = hr->overflow[1];
+      if ( type == 'R' || type == 'r' || type == 'F' || type == 'D' )
+      {
+         thisto->specific_2d.real.sum = hr->rsum[1];
+         thisto->specific_2d.real.tsum = hr->rtsum[1];
+      }
+      else
+      {
+         thisto->specific_2d.integer.sum = hr->isum[1];
+         thisto->specific_2d.integer.tsum = hr->itsum[1];
+      }
+   }
+
+   /* Finally, read the histogram contents. */
+   if ( type == 'F' || type == 'D' )
+   {
+      struct Histogram_Extension *he = thisto->extension;
+      he->content_all = get_real(iobuf);
+      he->content_inside = get_real(iobuf);
+      get_vector_of_real(he->content_outside,8,iobuf);
+      if ( type == 'F' )
+      {
+         if ( thisto->tentries > 0 )
+            for ( ibin=0; ibin<ncounts; ibin++ )
+               he->fdata[ibin] = (float) get_real(iobuf);
+         else
+            for ( ibin=0; ibin<ncounts; ibin++ )
+               he->fdata[ibin] = (float) 0.;
+      }
+      else
+      {
+         if ( thisto->tentries > 0 )
+            get_vector_of_real(he->ddata,ncounts,iobuf);
+         else
+            for ( ibin=0; ibin<ncounts; ibin++ )
+               he->ddata[ibin] = 0.;
+      }
+   }
+   else
+   {
+      if ( thisto->tentries > 0 )
+         get_vector_of_long((long *)thisto->counts,ncounts,iobuf);
+      else
+         for ( ibin=0; ibin<hr->nbins; ibin++ )
+            thisto->counts[ibin] = 0;
+   }
+#ifdef _REENTRANT
+   histogram_unlock(thisto);
+#endif
+}
+
 /* ------------------------ read_histograms_x ------------------ */
 /**
  *  Read and allocate histograms and optionally return histogram pointers to caller.
@@ -411,15 +947,8 @@ int read_histograms (HISTOGRAM **phisto, int nhisto, IO_BUFFER *iobuf)
 
 int read_histograms_x (HISTOGRAM **phisto, int nhisto, const long *xcld_ids, int nxcld, IO_BUFFER *iobuf)
 {
-   int mhisto, ihisto, rc, ncounts;
-   char title[256];
-   char type, __attribute__((unused)) cdummy;
-   long ident;
-   double rlower[2] = {0., 0.}, rupper[2] = {0., 0.}, 
-          rsum[2] = {0., 0.}, rtsum[2] = {0., 0.};
-   long ilower[2] = {0,0}, iupper[2] = {0,0}, isum[2] = {0,0}, itsum[2] = {0,0};
-   long entries=0, tentries=0, underflow[2] = {0,0}, overflow[2] = {0,0};
-   int nbins=0, nbins_2d=0, ibin, mbins[2] = {0,0};
+   int mhisto, ihisto, rc;
+   struct histo_record hr;
    HISTOGRAM *thisto=NULL, *ohisto=NULL;
    IO_ITEM_HEADER item_header;
    int adding = 0;
@@ -450,55 +979,11 @@ int read_histograms_x (HISTOGRAM **phisto, int nhisto, const long *xcld_ids, int
    for (ihisto=0; ihisto<mhisto; ihisto++)
    {
       int add_this = 0, exclude_this = 0;
-      type = (char) get_byte(iobuf);
-      if ( get_string(title,sizeof(title)-1,iobuf) % 2 == 0 )
-         cdummy = get_byte(iobuf); /* Compiler may warn about it but this is OK. */
-      ident = get_long(iobuf);
-      nbins = (int) get_short(iobuf);
-      nbins_2d = (int) get_short(iobuf);
-      entries = (uint32_t) get_long(iobuf);
-      tentries = (uint32_t) get_long(iobuf);
-      underflow[0] = (uint32_t) get_long(iobuf);
-      overflow[0] = (uint32_t) get_long(iobuf);
-      if ( type == 'R' || type == 'r' || type == 'F' || type == 'D' )
-      {
-         rlower[0] = get_real(iobuf);
-         rupper[0] = get_real(iobuf);
-         rsum[0] = get_real(iobuf);
-         rtsum[0] = get_real(iobuf);
-      }
-      else
-      {
-         ilower[0] = get_long(iobuf);
-         iupper[0] = get_long(iobuf);
-         isum[0] = get_long(iobuf);
-         itsum[0] = get_long(iobuf);
-      }
-      if ( nbins_2d > 0 )
-      {
-         underflow[1] = (uint32_t) get_long(iobuf);
-         overflow[1] = (uint32_t) get_long(iobuf);
-         if ( type == 'R' || type == 'r' || type == 'F' || type == 'D' )
-         {
-            rlower[1] = get_real(iobuf);
-            rupper[1] = get_real(iobuf);
-            rsum[1] = get_real(iobuf);
-            rtsum[1] = get_real(iobuf);
-         }
-         else
-         {
-            ilower[1] = get_long(iobuf);
-            iupper[1] = get_long(iobuf);
-            isum[1] = get_long(iobuf);
-            itsum[1] = get_long(iobuf);
-         }
-         ncounts = nbins * nbins_2d;
-      }
-      else
-         ncounts = nbins;
+
+      get_histo_record(&hr,iobuf);
 
       /* Don't attempt to allocate histograms without data. */
-      if ( ncounts <= 0 )
+      if ( hr.ncounts <= 0 )
          continue;
 
       if ( xcld_ids != (const long *) NULL && nxcld > 0 )
@@ -506,7 +991,7 @@ int read_histograms_x (HISTOGRAM **phisto, int nhisto, const long *xcld_ids, int
          int ixcld;
          for ( ixcld=0; ixcld<nxcld && xcld_ids[ixcld] > 0; ixcld++ )
          {
-            if ( xcld_ids[ixcld] == ident )
+            if ( xcld_ids[ixcld] == hr.ident )
             {
                exclude_this = 1;
                break;
@@ -517,9 +1002,9 @@ int read_histograms_x (HISTOGRAM **phisto, int nhisto, const long *xcld_ids, int
       /* If the histogram has a numerical identifier delete a */
       /* previously existing histogram with the same identifier. */
       ohisto = NULL;
-      if ( ident != 0 )
+      if ( hr.ident != 0 )
       {
-         if ( (ohisto=get_histogram_by_ident(ident)) !=
+         if ( (ohisto=get_histogram_by_ident(hr.ident)) !=
                (HISTOGRAM *)NULL )
          {
             if ( adding && ! exclude_this )
@@ -530,34 +1015,8 @@ int read_histograms_x (HISTOGRAM **phisto, int nhisto, const long *xcld_ids, int
       }
 
       /* (Re-) Allocate the new histogram according to its type. */
-      thisto = NULL;
       /* if ( ! exclude_this ) */ /* Would really exclude all histograms of this ID but we just don't want to add it up */
-      {
-         if ( nbins_2d > 0 )
-         {
-            if ( type == 'R' || type == 'r' )
-               thisto = alloc_2d_real_histogram(rlower[0],rupper[0],nbins,
-                   rlower[1],rupper[1],nbins_2d);
-            else if ( type == 'F' || type == 'D' )
-            {
-               mbins[0] = nbins;
-               mbins[1] = nbins_2d;
-               thisto = allocate_histogram(&type,2,rlower,rupper,mbins);
-            }
-            else
-               thisto = alloc_2d_int_histogram(ilower[0],iupper[0],nbins,
-                   ilower[1],iupper[1],nbins_2d);
-         }
-         else
-         {
-            if ( type == 'R' || type == 'r' )
-               thisto = alloc_real_histogram(rlower[0],rupper[0],nbins);
-            else if ( type == 'F' || type == 'D' )
-               thisto = allocate_histogram(&type,1,rlower,rupper,&nbins);
-            else
-               thisto = alloc_int_histogram(ilower[0],iupper[0],nbins);
-         }
-      }
+      thisto = alloc_histo_record(&hr,0);
       
       /* If the allocation failed or the histogram should be excluded, skip the histogram contents. */
       /* This should guarantee that reading the input doesn't get */
@@ -566,96 +1025,19 @@ int read_histograms_x (HISTOGRAM **phisto, int nhisto, const long *xcld_ids, int
       /* indicator for the caller. */
       if ( thisto == (HISTOGRAM *) NULL )
       {
-         if ( type == 'F' || type == 'D' )
-            for (ibin=0; ibin<10; ibin++ )
-               (void) get_real(iobuf); /* contents... in histogram extension */
-         if ( tentries > 0 )
-            for (ibin=0; ibin<ncounts; ibin++)
-               (void) get_long(iobuf); /* long and real is the same length */
+         skip_histo_contents(&hr,iobuf);
          continue;
       }
-      else
-         thisto->type = type;
 
       /* Give the histogram its title and identifier. */
-      if ( *title )
-         describe_histogram(thisto,title,add_this?0:ident);
-
-#ifdef _REENTRANT
-      histogram_lock(thisto);
-#endif
-
-      /* Set the values for histogram statistics. */
-      thisto->entries = entries;
-      thisto->tentries = tentries;
-      thisto->underflow = underflow[0];
-      thisto->overflow = overflow[0];
-      if ( type == 'R' || type == 'r' || type == 'F' || type == 'D' )
-      {
-         thisto->specific.real.sum = rsum[0];
-         thisto->specific.real.tsum = rtsum[0];
-      }
-      else
-      {
-         thisto->specific.integer.sum = isum[0];
-         thisto->specific.integer.tsum = itsum[0];
-      }
-      if ( nbins_2d > 0 )
-      {
-         thisto->underflow_2d = underflow[1];
-         thisto->overflow_2d = overflow[1];
-         if ( type == 'R' || type == 'r' || type == 'F' || type == 'D' )
-         {
-            thisto->specific_2d.real.sum = rsum[1];
-            thisto->specific_2d.real.tsum = rtsum[1];
-         }
-         else
-         {
-            thisto->specific_2d.integer.sum = isum[1];
-            thisto->specific_2d.integer.tsum = itsum[1];
-         }
-      }
+      if ( *hr.title )
+         describe_histogram(thisto,hr.title,add_this?0:hr.ident);
 
       /* If wanted and possible, return the pointer to caller. */
       if ( phisto != (HISTOGRAM **) NULL && ihisto < nhisto )
          phisto[ihisto] = (add_this ? ohisto : thisto);
 
-      /* Finally, read the histogram contents. */
-      if ( type == 'F' || type == 'D' )
-      {
-         struct Histogram_Extension *he = thisto->extension;
-         he->content_all = get_real(iobuf);
-         he->content_inside = get_real(iobuf);
-         get_vector_of_real(he->content_outside,8,iobuf);
-         if ( type == 'F' )
-         {
-            if ( thisto->tentries > 0 )
-               for ( ibin=0; ibin<ncounts; ibin++ )
-                  he->fdata[ibin] = (float) get_real(iobuf);
-            else
-               for ( ibin=0; ibin<ncounts; ibin++ )
-                  he->fdata[ibin] = (float) 0.;
-         }
-         else
-         {
-            if ( thisto->tentries > 0 )
-               get_vector_of_real(he->ddata,ncounts,iobuf);
-            else
-               for ( ibin=0; ibin<ncounts; ibin++ )
-                  he->ddata[ibin] = 0.;
-         }
-      }
-      else
-      {
-         if ( thisto->tentries > 0 )
-            get_vector_of_long((long *)thisto->counts,ncounts,iobuf);
-         else
-            for ( ibin=0; ibin<nbins; ibin++ )
-               thisto->counts[ibin] = 0;
-      }
-#ifdef _REENTRANT
-      histogram_unlock(thisto);
-#endif
+      get_histo_contents(thisto,&hr,iobuf);
 
       if ( add_this )
       {
@@ -674,6 +1056,99 @@ int read_histograms_x (HISTOGRAM **phisto, int nhisto, const long *xcld_ids, int
    return(mhisto);
 }
 
+/* ------------------------ read_histograms_to_set ------------------ */
+/**
+ *  @short Read histograms from a histogram block into a set of
+ *         histograms kept apart from the global list.
+ *
+ *  Nothing is looked up or changed in the global list of histograms,
+ *  making this usable from several threads at the same time (each with
+ *  its own set). Histograms not requested are skipped without being
+ *  allocated. Matching histograms with the same ID are added up,
+ *  unless the 'replace' flag of the set is on.
+ *
+ *  @param  hset    The set of histograms to be extended.
+ *  @param  ids     Vector of the wanted histogram IDs or NULL for all.
+ *  @param  nids    Number of IDs in the ids vector (0: all histograms).
+ *  @param  found   Optional flags, set for each of the nids IDs found.
+ *  @param  iobuf   The input iobuf descriptor.
+ *
+ *  @return  >= 0 (O.k., no. of histograms kept),
+ *		     -1 (error),
+ *		     -2 (e.o.d.)
+ */
+
+int read_histograms_to_set (HISTOGRAM_SET *hset, const long *ids, int nids,
+   int *found, IO_BUFFER *iobuf)
+{
+   int mhisto, ihisto, rc, nkept = 0;
+   struct histo_record hr;
+   HISTOGRAM *thisto;
+   IO_ITEM_HEADER item_header;
+
+   if ( iobuf == (IO_BUFFER *) NULL || hset == (HISTOGRAM_SET *) NULL )
+      return -1;
+   if ( ids == (const long *) NULL )
+      nids = 0;
+
+   item_header.type = 100;
+   if ( (rc = get_item_begin(iobuf,&item_header)) != 0 )
+      return rc;
+
+   if ( item_header.version < 1 || item_header.version > 2 )
+   {
+      Warning("Wrong version no. of histogram data to be read");
+      return -1;
+   }
+   mhisto = get_short(iobuf);
+
+   for (ihisto=0; ihisto<mhisto; ihisto++)
+   {
+      get_histo_record(&hr,iobuf);
+      if ( hr.ncounts <= 0 )
+         continue;
+
+      if ( nids > 0 )
+      {
+         int i;
+         for ( i=0; i<nids; i++ )
+            if ( ids[i] == hr.ident )
+               break;
+         if ( i >= nids )
+         {
+            skip_histo_contents(&hr,iobuf);
+            continue;
+         }
+         if ( found != NULL )
+            found[i] = 1;
+      }
+
+      /* Histograms without ID cannot be merged with anything. */
+      /* Allocated detached, only the set knows about it. */
+      if ( hr.ident <= 0 || (thisto = alloc_histo_record(&hr,1)) == NULL )
+      {
+         skip_histo_contents(&hr,iobuf);
+         continue;
+      }
+      thisto->ident = hr.ident;
+      if ( *hr.title )
+      {
+         if ( (thisto->title = (char *) malloc(strlen(hr.title)+1)) != NULL )
+            strcpy(thisto->title,hr.title);
+      }
+
+      get_histo_contents(thisto,&hr,iobuf);
+
+      if ( add_to_histogram_set(hset,thisto,!hset->replace) == 0 )
+         nkept++;
+   }
+
+   if ( (rc = get_item_end(iobuf,&item_header)) != 0 )
+      return rc;
+
+   return nkept;
+}
+
 /* ------------------------ print_histograms ------------------ */
 /**
  *  Print out some basics about histogram data as we read it.
@@ -40,6 +40,9 @@
 #include "io_basic.h"     /* This file includes others as required. */
 #include "mc_tel.h"
 #include "fileopen.h"
+#ifdef _REENTRANT
+#include <pthread.h>
+#endif
 
 /* -------------------------- write_tel_block --------------------- */
 /**
@@ -1145,6 +1148,159 @@ int write_tel_compact_photons (IO_BUFFER *iobuf, int array, int tel,
    return put_item_end(iobuf,&item_header);
 }
 
+/* ------------------------- zem_table_init --------------------- */
+/*
+ *  The emission height in the compact bunch format is coded as
+ *  1000*log10(zem). All 65536 possible values get converted once,
+ *  with the same expression as before, instead of calling pow()
+ *  for each bunch.
+ */
+
+static float zem_table[65536]; /**< pow(10.,0.001*s) at index s+32768 */
+
+static void zem_table_init (void);
+
+static void zem_table_init ()
+{
+   int i;
+   for (i=0; i<65536; i++)
+      zem_table[i] = pow(10.,0.001*(i-32768));
+}
+
+#ifdef _REENTRANT
+static pthread_once_t zem_table_once = PTHREAD_ONCE_INIT;
+#else
+static int zem_table_done = 0;
+#endif
+
+/* ------------------------- get_bunch_data --------------------- */
+/*
+ *  Decode a number of photon bunches in either format, in chunks,
+ *  with one bulk vector read for the interleaved data of each chunk
+ *  and separate conversion loops for each quantity.
+ *  Element i of each output goes to p[i*stride], such that the same
+ *  code fills an array of struct bunch (stride 8) or separate
+ *  arrays (stride 1).
+ *  Returns the sum of the absolute photon numbers.
+ */
+
+#define BUNCH_CHUNK 256
+
+static double get_bunch_data (IO_BUFFER *iobuf, int compact, int n,
+   float *x, float *y, float *cx, float *cy, float *ctime, float *zem,
+   float *ph, float *lambda, size_t stride);
+
+static double get_bunch_data (IO_BUFFER *iobuf, int compact, int n,
+   float *x, float *y, float *cx, float *cy, float *ctime, float *zem,
+   float *ph, float *lambda, size_t stride)
+{
+   double check_photons = 0.;
+   int i0, i, m;
+   size_t k;
+
+   if ( compact )
+   {
+      short sv[8*BUNCH_CHUNK];
+
+#ifdef _REENTRANT
+      pthread_once(&zem_table_once,zem_table_init);
+#else
+      if ( !zem_table_done )
+      {
+         zem_table_init();
+         zem_table_done = 1;
+      }
+#endif
+      for (i0=0; i0<n; i0+=BUNCH_CHUNK)
+      {
+         m = (n-i0 < BUNCH_CHUNK) ? n-i0 : BUNCH_CHUNK;
+         get_vector_of_short(sv,8*m,iobuf);
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+            x[k] = 0.1*sv[8*i];
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+            y[k] = 0.1*sv[8*i+1];
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+         {
+            double c = sv[8*i+2]/30000.;
+            cx[k] = (c > 1.) ? 1. : (c < -1.) ? -1. : c;
+         }
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+         {
+            double c = sv[8*i+3]/30000.;
+            cy[k] = (c > 1.) ? 1. : (c < -1.) ? -1. : c;
+         }
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+            ctime[k] = 0.1*sv[8*i+4];
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+            zem[k] = zem_table[sv[8*i+5]+32768];
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+            ph[k] = 0.01*sv[8*i+6];
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+            lambda[k] = sv[8*i+7];
+         /* Negative value could be used for special purposes */
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+            check_photons += fabs(ph[k]);
+      }
+   }
+   else
+   {
+      float fv[8*BUNCH_CHUNK];
+
+      for (i0=0; i0<n; i0+=BUNCH_CHUNK)
+      {
+         m = (n-i0 < BUNCH_CHUNK) ? n-i0 : BUNCH_CHUNK;
+         get_vector_of_float(fv,8*m,iobuf);
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+         {
+            x[k] = fv[8*i];
+            y[k] = fv[8*i+1];
+            cx[k] = fv[8*i+2];
+            cy[k] = fv[8*i+3];
+            ctime[k] = fv[8*i+4];
+            zem[k] = fv[8*i+5];
+            ph[k] = fv[8*i+6];
+            lambda[k] = fv[8*i+7];
+         }
+         for (i=0, k=i0*stride; i<m; i++, k+=stride)
+            check_photons += fabs(ph[k]);
+      }
+   }
+
+   return check_photons;
+}
+
+/* ---------------------- read_tel_photons_head ------------------- */
+/*
+ *  Begin reading a photon bunches item, up to the number of bunches.
+ *  Returns the format (0: long, 1: compact) or a negative value
+ *  on error, in which case the item was finished already.
+ */
+
+static int read_tel_photons_head (IO_BUFFER *iobuf, IO_ITEM_HEADER *item_header,
+   int *array, int *tel, double *photons, int *nbunches);
+
+static int read_tel_photons_head (IO_BUFFER *iobuf, IO_ITEM_HEADER *item_header,
+   int *array, int *tel, double *photons, int *nbunches)
+{
+   int rc;
+
+   item_header->type = IO_TYPE_MC_PHOTONS;  /* Data type */
+   if ( (rc=get_item_begin(iobuf,item_header)) < 0 )
+      return rc;
+   if ( item_header->version%1000 != 0 || item_header->version/1000 > 1 )
+   {
+      get_item_end(iobuf,item_header);
+      return -1;
+   }
+
+   *array = get_short(iobuf);
+   *tel = get_short(iobuf);
+   *photons = get_real(iobuf);
+   *nbunches = get_long(iobuf);
+
+   return item_header->version/1000;
+}
+
 /* ------------------------- read_tel_photons --------------------- */
 /**
  *  Read bunches of Cherenkov photons for one telescope/detector.
@@ -1165,25 +1321,15 @@ int read_tel_photons (IO_BUFFER *iobuf, int max_bunches, int *array,
    int *tel, double *photons, struct bunch *bunches, int *nbunches)
 {
    IO_ITEM_HEADER item_header;
-   int i, rc;
+   int compact;
    double check_photons = 0.;
    
    if ( iobuf == (IO_BUFFER *) NULL )
       return -1;
    
-   item_header.type = IO_TYPE_MC_PHOTONS;  /* Data type */
-   if ( (rc=get_item_begin(iobuf,&item_header)) < 0 )
-      return rc;
-   if ( item_header.version%1000 != 0 )
-   {
-      get_item_end(iobuf,&item_header);
-      return -1;
-   }
-
-   *array = get_short(iobuf);
-   *tel = get_short(iobuf);
-   *photons = get_real(iobuf);
-   *nbunches = get_long(iobuf);
+   if ( (compact = read_tel_photons_head(iobuf,&item_header,
+           array,tel,photons,nbunches)) < 0 )
+      return compact;
 
    /* We may have a first attempt at finding out the numbers. */
    if ( bunches == NULL )
@@ -1202,49 +1348,71 @@ int read_tel_photons (IO_BUFFER *iobuf, int max_bunches, int *array,
       return -1;
    }
 
-   if ( item_header.version/1000 == 0 ) /* The long format */
-   {
-      for (i=0; i<*nbunches; i++)
-      {
-         bunches[i].x = get_real(iobuf);
-         bunches[i].y = get_real(iobuf);
-         bunches[i].cx = get_real(iobuf);
-         bunches[i].cy = get_real(iobuf);
-         bunches[i].ctime = get_real(iobuf);
-         bunches[i].zem = get_real(iobuf);
-         bunches[i].photons = get_real(iobuf);
-         bunches[i].lambda = get_real(iobuf);
-         check_photons += fabs(bunches[i].photons); /* Negative value could be used for special purposes */
-      }
-   }
-   else if ( item_header.version/1000 == 1 ) /* The compact format */
+   if ( *nbunches > 0 )
+      check_photons = get_bunch_data(iobuf, compact, *nbunches,
+         &bunches[0].x, &bunches[0].y, &bunches[0].cx, &bunches[0].cy,
+         &bunches[0].ctime, &bunches[0].zem, &bunches[0].photons,
+         &bunches[0].lambda, sizeof(struct bunch)/sizeof(float));
+   
+   if ( *photons > 10.0 )
+      if ( fabs(check_photons-(*photons)) / (*photons) > 0.01 )
+         fprintf(stderr,"Photon numbers do not match. Maybe problems with disk space?\n");
+
+   return get_item_end(iobuf,&item_header);
+}
+
+/* ----------------------- read_tel_photons_soa ------------------- */
+/**
+ *  Read bunches of Cherenkov photons for one telescope/detector
+ *  into separate arrays for each quantity, as may be more suitable
+ *  for vectorised ray-tracing than an array of struct bunch.
+ *  Otherwise the same as read_tel_photons().
+ *
+ *  @param  iobuf	 I/O buffer descriptor
+ *  @param  max_bunches  maximum number of bunches that fit into the arrays
+ *  @param  array	 array number
+ *  @param  tel 	 telescope number
+ *  @param  photons	 sum of photons (and fractions) in this device
+ *  @param  ba  	 the arrays for the bunch data
+ *  @param  nbunches	 number of bunches
+ *  @return 0 (o.k.), -1, -2, -3 (error, as usual in eventio),
+ *          -10 (ba was NULL, only numbers known)
+*/
+
+int read_tel_photons_soa (IO_BUFFER *iobuf, int max_bunches, int *array,
+   int *tel, double *photons, struct bunch_arrays *ba, int *nbunches)
+{
+   IO_ITEM_HEADER item_header;
+   int compact;
+   double check_photons = 0.;
+   
+   if ( iobuf == (IO_BUFFER *) NULL )
+      return -1;
+   
+   if ( (compact = read_tel_photons_head(iobuf,&item_header,
+           array,tel,photons,nbunches)) < 0 )
+      return compact;
+
+   if ( ba == NULL )
    {
-      for (i=0; i<*nbunches; i++)
-      {
-         bunches[i].x = 0.1*get_short(iobuf);
-         bunches[i].y = 0.1*get_short(iobuf);
-         bunches[i].cx = get_short(iobuf)/30000.;
-         if ( bunches[i].cx > 1. )
-            bunches[i].cx = 1.;
-         else if ( bunches[i].cx < -1. )
-            bunches[i].cx = -1.;
-         bunches[i].cy = get_short(iobuf)/30000.;
-         if ( bunches[i].cy > 1. )
-            bunches[i].cy = 1.;
-         else if ( bunches[i].cy < -1. )
-            bunches[i].cy = -1.;
-         bunches[i].ctime = 0.1*get_short(iobuf);
-         bunches[i].zem = pow(10.,0.001*get_short(iobuf));
-         bunches[i].photons = 0.01*get_short(iobuf);
-         bunches[i].lambda = get_short(iobuf);
-         check_photons += fabs(bunches[i].photons); /* Negative value could be used for special purposes */
-      }
+      unget_item(iobuf,&item_header);
+      return -10;
    }
-   else
+   
+   if ( *nbunches > max_bunches )
    {
+      fflush(NULL);
+      fprintf(stderr,"Too many photon bunches in item type %d.\n",
+         IO_TYPE_MC_PHOTONS);
+      fflush(NULL);
       get_item_end(iobuf,&item_header);
       return -1;
    }
+
+   if ( *nbunches > 0 )
+      check_photons = get_bunch_data(iobuf, compact, *nbunches,
+         ba->x, ba->y, ba->cx, ba->cy, ba->ctime, ba->zem, 
+         ba->photons, ba->lambda, 1);
    
    if ( *photons > 10.0 )
       if ( fabs(check_photons-(*photons)) / (*photons) > 0.01 )
@@ -1253,6 +1421,131 @@ int read_tel_photons (IO_BUFFER *iobuf, int max_bunches, int *array,
    return get_item_end(iobuf,&item_header);
 }
 
+/* ---------------------- begin_read_tel_photons ------------------- */
+/**
+ *  Start reading the photon bunches for one telescope/detector in
+ *  chunks of a size chosen by the caller, in a single pass and without
+ *  the need to hold all bunches in memory at the same time.
+ *  Array and telescope numbers, the sum of photons, and the total
+ *  number of bunches are known in the cursor after this call.
+ *  The bunches themselves are then obtained with repeated calls to
+ *  read_tel_photons_chunk() (or read_tel_photons_chunk_soa()),
+ *  until that returns zero, followed by end_read_tel_photons().
+ *  No other item may be read from the I/O buffer in between.
+ *
+ *  @param  iobuf	 I/O buffer descriptor
+ *  @param  cur 	 the cursor, filled in here
+ *  @return 0 (o.k.), -1, -2, -3 (error, as usual in eventio)
+*/
+
+int begin_read_tel_photons (IO_BUFFER *iobuf, struct tel_photons_cursor *cur)
+{
+   int rc;
+
+   if ( iobuf == (IO_BUFFER *) NULL || cur == NULL )
+      return -1;
+
+   cur->iobuf = NULL;
+   cur->next = cur->nbunches = 0;
+   cur->check_photons = 0.;
+   if ( (rc = read_tel_photons_head(iobuf,&cur->item_header,
+           &cur->array,&cur->tel,&cur->photons,&cur->nbunches)) < 0 )
+      return rc;
+   cur->compact = rc;
+   cur->iobuf = iobuf;
+   if ( cur->nbunches < 0 )
+      cur->nbunches = 0;
+
+   return 0;
+}
+
+/* ---------------------- read_tel_photons_chunk ------------------- */
+/**
+ *  Get the next chunk of photon bunches, after begin_read_tel_photons().
+ *
+ *  @param  cur 	 the cursor
+ *  @param  bunches	 space for at least max_bunches bunches
+ *  @param  max_bunches  the maximum number of bunches to be returned
+ *  @return number of bunches filled in (0: no more bunches), -1 (error)
+*/
+
+int read_tel_photons_chunk (struct tel_photons_cursor *cur, 
+   struct bunch *bunches, int max_bunches)
+{
+   int n;
+
+   if ( cur == NULL || cur->iobuf == NULL || bunches == NULL )
+      return -1;
+   if ( (n = cur->nbunches - cur->next) > max_bunches )
+      n = max_bunches;
+   if ( n <= 0 )
+      return 0;
+
+   cur->check_photons += get_bunch_data(cur->iobuf, cur->compact, n,
+         &bunches[0].x, &bunches[0].y, &bunches[0].cx, &bunches[0].cy,
+         &bunches[0].ctime, &bunches[0].zem, &bunches[0].photons,
+         &bunches[0].lambda, sizeof(struct bunch)/sizeof(float));
+   cur->next += n;
+
+   return n;
+}
+
+/* -------------------- read_tel_photons_chunk_soa ----------------- */
+/**
+ *  Get the next chunk of photon bunches into separate arrays,
+ *  otherwise as read_tel_photons_chunk().
+ *
+ *  @param  cur 	 the cursor
+ *  @param  ba  	 arrays with space for at least max_bunches bunches
+ *  @param  max_bunches  the maximum number of bunches to be returned
+ *  @return number of bunches filled in (0: no more bunches), -1 (error)
+*/
+
+int read_tel_photons_chunk_soa (struct tel_photons_cursor *cur, 
+   struct bunch_arrays *ba, int max_bunches)
+{
+   int n;
+
+   if ( cur == NULL || cur->iobuf == NULL || ba == NULL )
+      return -1;
+   if ( (n = cur->nbunches - cur->next) > max_bunches )
+      n = max_bunches;
+   if ( n <= 0 )
+      return 0;
+
+   cur->check_photons += get_bunch_data(cur->iobuf, cur->compact, n,
+         ba->x, ba->y, ba->cx, ba->cy, ba->ctime, ba->zem, 
+         ba->photons, ba->lambda, 1);
+   cur->next += n;
+
+   return n;
+}
+
+/* ----------------------- end_read_tel_photons -------------------- */
+/**
+ *  Finish reading photon bunches in chunks. Any bunches not yet
+ *  read are skipped. If all were read, their photon sum is checked
+ *  as in read_tel_photons().
+ *
+ *  @param  cur 	 the cursor
+ *  @return 0 (o.k.), -1, -2, -3 (error, as usual in eventio)
+*/
+
+int end_read_tel_photons (struct tel_photons_cursor *cur)
+{
+   IO_BUFFER *iobuf;
+
+   if ( cur == NULL || (iobuf = cur->iobuf) == NULL )
+      return -1;
+   cur->iobuf = NULL;
+
+   if ( cur->next == cur->nbunches && cur->photons > 10.0 )
+      if ( fabs(cur->check_photons-cur->photons) / cur->photons > 0.01 )
+         fprintf(stderr,"Photon numbers do not match. Maybe problems with disk space?\n");
+
+   return get_item_end(iobuf,&cur->item_header);
+}
+
 /* ------------------------- print_tel_photons --------------------- */
 /**
  *  Print bunches of Cherenkov photons for one telescope/detector.
@@ -1892,6 +2185,167 @@ int read_photo_electrons (IO_BUFFER *iobuf, int max_pixels, int max_pe,
    return get_item_end(iobuf,&item_header);
 }
 
+/* ---------------------- read_photo_electrons_csr --------------------- */
+/**
+ *  Read the photoelectrons registered in a Cherenkov telescope camera
+ *  into a compact compressed-sparse-row layout with single-precision
+ *  times and amplitudes (as they are stored in the data).
+ *  All times (and amplitudes) of a pixel are fetched with one
+ *  vector read each and pixel offsets are built while reading, with no
+ *  separate per-pixel start and count vectors to be kept in sync.
+ *  The vectors in 'pe' get (re-) allocated as needed.
+ *  Requires the pixels in the list to be in ascending order, as
+ *  written by write_photo_electrons(). Photon counts, if present,
+ *  are skipped.
+ *
+ *  @param  iobuf	 I/O buffer descriptor
+ *  @param  pe           Where the photo-electron list is stored.
+ *  @param  pix_pe       Optional vector (e.g. pix_pe of MCpeSum for this
+ *                       telescope) filled with the number of p.e. per
+ *                       pixel in the same pass (including NSB p.e.
+ *                       if bit 1 of the flags is set). May be NULL.
+ *  @param  max_pix_pe   Size of the 'pix_pe' vector.
+ *  @return 0 (o.k.), -1, -2, -3 (error, as usual in eventio),
+ *          -4 (allocation failure or inconsistent sizes), -5 (bad pixel list)
+*/
+
+int read_photo_electrons_csr (IO_BUFFER *iobuf, 
+   struct photo_electrons_csr *pe, int *pix_pe, int max_pix_pe)
+{
+   IO_ITEM_HEADER item_header;
+   int i, it, ipix, jpix, n, rc, nonempty;
+
+   if ( iobuf == (IO_BUFFER *) NULL || pe == NULL )
+      return -1;
+   
+   item_header.type = IO_TYPE_MC_PE;    /* Data type */
+   if ( (rc = get_item_begin(iobuf,&item_header)) < 0 )
+      return rc;
+   if ( item_header.version < 1 || item_header.version > 3 )
+   {
+      fprintf(stderr,"Invalid version %d of photo-electrons block.\n", 
+         item_header.version);
+      get_item_end(iobuf,&item_header);
+      return -1;
+   }
+
+   pe->array = item_header.ident/1000;
+   pe->tel = item_header.ident%1000;
+   pe->npe = 0;
+
+   n = get_long(iobuf);
+   pe->pixels = get_long(iobuf);
+   if ( item_header.version > 1 )
+      pe->flags = get_short(iobuf);
+   else
+      pe->flags = 0;
+   nonempty = get_long(iobuf);
+
+   if ( n < 0 || pe->pixels < 0 || nonempty < 0 || nonempty > pe->pixels )
+   {
+      fprintf(stderr,"Inconsistent sizes in photo-electrons block: "
+         "%d p.e., %d pixels, %d non-empty\n", n, pe->pixels, nonempty);
+      pe->pixels = 0;
+      get_item_end(iobuf,&item_header);
+      return -4;
+   }
+
+   if ( pe->offset == NULL || pe->pixels > pe->max_pixels )
+   {
+      if ( pe->offset != NULL )
+         free(pe->offset);
+      if ( (pe->offset = (int *) malloc((pe->pixels+1)*sizeof(int))) == NULL )
+      {
+         pe->max_pixels = pe->pixels = 0;
+         get_item_end(iobuf,&item_header);
+         return -4;
+      }
+      pe->max_pixels = pe->pixels;
+   }
+   if ( pe->t == NULL || n > pe->max_npe ||
+        (pe->a == NULL && (pe->flags&1) != 0) )
+   {
+      int m = (n > pe->max_npe) ? n : pe->max_npe;
+      if ( pe->t != NULL )
+         free(pe->t);
+      if ( pe->a != NULL )
+         free(pe->a);
+      pe->a = NULL;
+      pe->max_npe = 0;
+      if ( (pe->t = (float *) malloc((m>0?m:1)*sizeof(float))) == NULL ||
+           ((pe->flags&1) != 0 && 
+            (pe->a = (float *) malloc((m>0?m:1)*sizeof(float))) == NULL) )
+      {
+         pe->pixels = 0;
+         get_item_end(iobuf,&item_header);
+         return -4;
+      }
+      pe->max_npe = m;
+   }
+
+   if ( pix_pe != NULL )
+      for (ipix=0; ipix<pe->pixels && ipix<max_pix_pe; ipix++)
+         pix_pe[ipix] = 0;
+
+   for (i=it=0, jpix=0; i<nonempty; i++)
+   {
+      if ( item_header.version > 2 )
+         ipix = get_count(iobuf);
+      else
+         ipix = get_short(iobuf);
+      if ( ipix < jpix || ipix >= pe->pixels )
+      {
+      	 Warning("Invalid or unordered pixel number for photo-electron list");
+         pe->pixels = 0;
+	 get_item_end(iobuf,&item_header);
+	 return -5;
+      }
+      /* Pixels skipped in between are empty. */
+      while ( jpix <= ipix )
+         pe->offset[jpix++] = it;
+      n = get_long(iobuf);
+      if ( n < 0 || it + n > pe->max_npe )
+      {
+         fprintf(stderr,"Invalid number of photo-electrons for pixel %d: %d\n",
+            ipix, n);
+         pe->pixels = 0;
+	 get_item_end(iobuf,&item_header);
+	 return -5;
+      }
+      get_vector_of_float(pe->t+it,n,iobuf);
+      if ( (pe->flags & 1) != 0 )
+         get_vector_of_float(pe->a+it,n,iobuf);
+      if ( pix_pe != NULL && ipix < max_pix_pe )
+         pix_pe[ipix] = n;
+      it += n;
+   }
+   while ( jpix <= pe->pixels )
+      pe->offset[jpix++] = it;
+   pe->npe = it;
+
+   return get_item_end(iobuf,&item_header);
+}
+
+/* ---------------------- free_photo_electrons_csr --------------------- */
+/**
+ *  Release the vectors allocated by read_photo_electrons_csr().
+*/
+
+void free_photo_electrons_csr (struct photo_electrons_csr *pe)
+{
+   if ( pe == NULL )
+      return;
+   if ( pe->offset != NULL )
+      free(pe->offset);
+   if ( pe->t != NULL )
+      free(pe->t);
+   if ( pe->a != NULL )
+      free(pe->a);
+   pe->offset = NULL;
+   pe->t = pe->a = NULL;
+   pe->max_pixels = pe->max_npe = pe->pixels = pe->npe = 0;
+}
+
 /* ------------------------ print_photo_electrons ----------------------- */
 /**
  *  List the the photoelectrons registered in a Cherenkov telescope camera.
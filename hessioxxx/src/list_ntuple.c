@@ -0,0 +1,112 @@
+/* ============================================================================
+
+Copyright (C) 2026  The pyhessio contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+============================================================================ */
+
+/** @file list_ntuple.c
+ *  @short Utility program for listing binary basic selection n-tuples.
+@verbatim
+Syntax:  list_ntuple [ options ] input_file ...
+Options:
+   --columns       (List the available column names.)
+   --column name   (List only the values of the named column,
+                    one per line, reading no other columns.)
+@endverbatim
+ *  Without options, the binary n-tuple files written by
+ *  'read_hess --ntuple-file name.bnt' are converted to the
+ *  same text form as written by read_hess for other file names.
+ */
+
+/** @defgroup list_ntuple_c The list_ntuple program */
+/** @{ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "basic_ntuple.h"
+
+static void syntax (const char *prg);
+
+static void syntax (const char *prg)
+{
+   printf("Syntax: %s [ options ] input_file ...\n", prg);
+   printf("Options:\n");
+   printf("   --columns       (List the available column names.)\n");
+   printf("   --column name   (List only the values of the named column.)\n");
+   exit(1);
+}
+
+int main (int argc, char **argv)
+{
+   const char *prg = argv[0];
+   int icol = -1;
+   int rc = 0;
+
+   while ( argc >= 2 && argv[1][0] == '-' )
+   {
+      if ( strcmp(argv[1],"--columns") == 0 )
+      {
+         const char *name;
+         int i;
+         for ( i=0; (name = ntuple_column_name(i)) != NULL; i++ )
+            printf("%s\n", name);
+         return 0;
+      }
+      else if ( strcmp(argv[1],"--column") == 0 && argc > 2 )
+      {
+         if ( (icol = ntuple_column(argv[2])) < 0 )
+         {
+            fprintf(stderr,"No such n-tuple column: %s\n", argv[2]);
+            return 1;
+         }
+         argc -= 2;
+         argv += 2;
+      }
+      else
+         syntax(prg);
+   }
+   if ( argc < 2 )
+      syntax(prg);
+
+   for ( ; argc >= 2; argc--, argv++ )
+   {
+      struct ntuple_file *nf = open_ntuple_input(argv[1]);
+      if ( nf == NULL )
+      {
+         rc = 1;
+         continue;
+      }
+      if ( icol >= 0 )
+      {
+         size_t n = ntuple_rows(nf), i;
+         double *v = (double *) malloc((n>0?n:1)*sizeof(double));
+         if ( v == NULL || read_ntuple_column(nf,icol,v,n) != (long) n )
+            rc = 1;
+         else
+            for ( i=0; i<n; i++ )
+               printf("%.10g\n", v[i]);
+         free(v);
+      }
+      else if ( ntuple_to_text(nf,stdout) < 0 )
+         rc = 1;
+      close_ntuple(nf);
+   }
+
+   return rc;
+}
+
+/** @} */
@@ -21,9 +21,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *  @short A program for merging events from separate telescope simulations
  *     of the same showers.
  *
- *  The program will read sim_telarray raw or DST data on two input files,
- *  map telescope ID according to a mapping file and write the merged
- *  blocks to an output file.
+ *  The program will read sim_telarray raw or DST data on two or more input
+ *  files, map telescope ID according to a mapping file and write the merged
+ *  blocks to an output file. All inputs are read in one pass, each one
+ *  by its own reader thread (if compiled with -D_REENTRANT) filling a
+ *  small window of data blocks read ahead. The next block to be processed
+ *  is always the earliest one, in terms of run, kind of block and
+ *  shower/event number, that any of the inputs has to offer.
  *
  *  Inputs expected - and the action to be performed:
  *     Type
@@ -60,11 +64,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *   FIXME: Ignoring 'trgmask' files initially - include them later on.
  *
 @verbatim
-Syntax:  merge_simtel [ options ] map-file input1 input2 output
+Syntax:  merge_simtel [ options ] map-file input1 input2 [ input3 ... ] output
 Options:
      --auto-trgmask  : Load trgmask.gz files for each input file where available.
      --min-trg-tel n : Require at least n telescopes in merged event (default: 2).
      --verbose       : Show events being merged.
+     --full-decode   : Decode and re-encode all telescope event data instead
+                       of copying it with re-mapped telescope IDs only.
+     --window n      : Read ahead up to n data blocks per input (default: 4).
+     --write-queue n : Write output from a separate thread, with up to n blocks queued.
 @endverbatim
  *
  *  @author  Konrad Bernloehr
@@ -87,6 +95,9 @@ Options:
 #include "warning.h"
 #include "io_trgmask.h"
 #include "eventio_version.h"
+#ifdef _REENTRANT
+#include <pthread.h>
+#endif
 
 #ifndef _UNUSED_
 # ifdef __GNUC__
@@ -131,6 +142,11 @@ void stop_signal_function (int isig)
 
 /* ------------------------------------------------------------------------------ */
 
+/** Maximum number of input files to be merged (one telescope ID lookup table each, plus one for output). */
+#define MAX_MERGE_INPUTS (H_MAX_TEL_IDX_REF-1)
+
+static int num_inputs = 2;  /**< Actual number of input files */
+
 /**
  *  Structure with per output telescope information keeping track of prerequisites.
  */
@@ -138,7 +154,7 @@ void stop_signal_function (int isig)
 struct map_tel_struct
 {
    int tel_id;              ///< Telescope ID on output
-   int ifn;                 ///< Input file number (1 or 2)
+   int ifn;                 ///< Input file number (1 ... num_inputs)
    int inp_id;              ///< Telescope ID on input
    int inp_itel;            ///< Sequential telescope count on input
    int have_camset;         ///< Have camera_settings for this telescope
@@ -155,23 +171,20 @@ struct map_tel_struct map_tel[H_MAX_TEL];
 
 /** Mapping structures from input telescope ID to output telescope ID.
     Not mapped telescopes are defined by output telescope ID of -1. */
-int map_to[2][H_MAX_TEL+1];   ///< The telescope ID to which a given input telescope ID should get mapped.
+int map_to[MAX_MERGE_INPUTS][H_MAX_TEL+1];   ///< The telescope ID to which a given input telescope ID should get mapped.
 
 /** Mapping from telescope IDs to offsets in the data structures, first for input telescope IDs.
  *  We restrict the ID/index mapping here to well behaved cases (0<ID<=H_MAX_TEL).
  *  An index value of -1 indicates a non-existant/ignored telescope. */
-int tel_idx[2][H_MAX_TEL+1];  ///< Where is a telescope of given ID in the input data structures?
+int tel_idx[MAX_MERGE_INPUTS][H_MAX_TEL+1];  ///< Where is a telescope of given ID in the input data structures?
 /** Mapping from output telescope ID to offset in output data structures. */
 int tel_idx_out[H_MAX_TEL+1]; ///< Where is a telescope of given ID in the output data structures?
 
 int find_in_tel_idx(int tel_id, int ifile);
 int find_out_tel_idx(int tel_id, int ifile);
 int find_mapped_telescope (int tel_id, int ifile);
-int ntel1, ntel2, ntel;
-int nrtel1, nrtel2;
-long event1 = -1, event2 = 0;
+int ntel_in[MAX_MERGE_INPUTS], ntel;
 long ev_hess_event = 0, ev_pe_sum = 0; /**< For delayed writing */
-int run1 = -1, run2 = -1;
 int min_trg = 2;
 double distinct_sep = 1.0;
 
@@ -181,7 +194,7 @@ double distinct_sep = 1.0;
 
 int find_in_tel_idx(int tel_id, int ifile)
 {
-   if ( tel_id >= 0 && tel_id <= H_MAX_TEL && ifile > 0 && ifile <= 2 )
+   if ( tel_id >= 0 && tel_id <= H_MAX_TEL && ifile > 0 && ifile <= num_inputs )
       return tel_idx[ifile-1][tel_id];
    else
       return -1;
@@ -194,7 +207,7 @@ int find_in_tel_idx(int tel_id, int ifile)
 int find_out_tel_idx(int tel_id, int ifile)
 {
    int itel_in, itel_out, tel_id_out;
-   if ( tel_id >= 0 && tel_id <= H_MAX_TEL && ifile > 0 && ifile <= 2 )
+   if ( tel_id >= 0 && tel_id <= H_MAX_TEL && ifile > 0 && ifile <= num_inputs )
    {
       /* First check that the telescope is present in the input */
       itel_in = tel_idx[ifile-1][tel_id];
@@ -218,7 +231,7 @@ int find_out_tel_idx(int tel_id, int ifile)
 
 int find_mapped_telescope (int tel_id, int ifile)
 {
-   if ( tel_id >= 0 && tel_id <= H_MAX_TEL && ifile > 0 && ifile <= 2 )
+   if ( tel_id >= 0 && tel_id <= H_MAX_TEL && ifile > 0 && ifile <= num_inputs )
       return map_to[ifile-1][tel_id];
    else
       return -1;
@@ -226,24 +239,54 @@ int find_mapped_telescope (int tel_id, int ifile)
 
 /* ----------------------------------------------------------------------- */
 /** 
- *  Write an I/O block as-is to another file than foreseen for the I/O buffer.
+ *  Write an I/O block as-is to the output of another I/O buffer.
+ *  With asynchronous output on that buffer, the block goes into
+ *  the same queue, keeping the order of everything written.
  */
 
-int write_io_block_to_file (IO_BUFFER *iobuf, FILE *f);
+int write_io_block_to_file (IO_BUFFER *iobuf, IO_BUFFER *iobuf_out);
 
-int write_io_block_to_file (IO_BUFFER *iobuf, FILE *f)
+int write_io_block_to_file (IO_BUFFER *iobuf, IO_BUFFER *iobuf_out)
 {
    int rc = 0;
-   if ( iobuf != NULL && f != NULL )
+   if ( iobuf != NULL && iobuf_out != NULL && iobuf_out->output_file != NULL )
    {
       FILE *t = iobuf->output_file;
-      iobuf->output_file = f;
+      struct _struct_IO_ASYNC *ta = iobuf->async;
+      iobuf->output_file = iobuf_out->output_file;
+      iobuf->async = iobuf_out->async;
       rc = write_io_block(iobuf);
       iobuf->output_file = t;
+      iobuf->async = ta;
    }
    return rc;
 }
 
+/* ----------------------------------------------------------------------- */
+/*
+ *  Pass-through of telescope-specific event data (see
+ *  read_hess_event_pass_through() in the library):
+ *  Telescope event and tracking data blocks only get their
+ *  telescope IDs changed, without decoding and re-encoding them.
+ */
+
+static int pass_through = 1;     /**< Disabled with the '--full-decode' option. */
+
+static int pt_out_tel_id (int tel_id, int ifile);
+
+/**
+ *  Output telescope ID for an input telescope of given ID, for the
+ *  data passed through, or -1 if the telescope is not in the output.
+ */
+
+static int pt_out_tel_id (int tel_id, int ifile)
+{
+   int itel3 = find_out_tel_idx(tel_id,ifile);
+   if ( itel3 < 0 || itel3 >= H_MAX_TEL )
+      return -1;
+   return map_tel[itel3].tel_id;
+}
+
 /* ----------------------------------------------------------------------- */
 
 int has_min_trg_tel (AllHessData *hsdata_out, int mtrg, double rtm);
@@ -367,9 +410,10 @@ printf("Delayed writing of data event %ld (current data block type: %d, id: %ld)
          if ( has_min_trg_tel(hsdata_out, min_trg, distinct_sep) )
          {
             set_tel_idx_ref(0);
-            rc = write_hess_event(iobuf_out,&hsdata_out->event,-1);
+            rc = write_hess_event_pass_through(iobuf_out,&hsdata_out->event,ev_hess_event);
          }
          ev_hess_event = 0;
+         reset_hess_pass_through();
       }
    }
    else if ( type == IO_TYPE_HESS_EVENT )
@@ -399,9 +443,10 @@ printf("Delayed writing of data event %ld (current data block type: %d, id: %ld)
          if ( has_min_trg_tel(hsdata_out, min_trg, distinct_sep) )
          {
             set_tel_idx_ref(0);
-            rc = write_hess_event(iobuf_out,&hsdata_out->event,-1);
+            rc = write_hess_event_pass_through(iobuf_out,&hsdata_out->event,ev_hess_event);
          }
          ev_hess_event = 0;
+         reset_hess_pass_through();
       }
    }
    else if ( type == IO_TYPE_HESS_MC_PE_SUM )
@@ -429,9 +474,10 @@ printf("Delayed writing of data event %ld (current data block type: %d, id: %ld)
          if ( has_min_trg_tel(hsdata_out, min_trg, distinct_sep) )
          {
             set_tel_idx_ref(0);
-            rc = write_hess_event(iobuf_out,&hsdata_out->event,-1);
+            rc = write_hess_event_pass_through(iobuf_out,&hsdata_out->event,ev_hess_event);
          }
          ev_hess_event = 0;
+         reset_hess_pass_through();
       }
    }
    return rc;
@@ -439,15 +485,15 @@ printf("Delayed writing of data event %ld (current data block type: %d, id: %ld)
 
 /* ----------------------------------------------------------------------- */
 
-static struct trgmask_set *tms[2] = { NULL, NULL };
-static struct trgmask_hash_set *ths[2] = { NULL, NULL };
-static int events[2] = { 0, 0 };
-static int mcshowers[2] = { 0, 0 };
-static int mcevents[2] = { 0, 0 };
+static struct trgmask_set *tms[MAX_MERGE_INPUTS];
+static struct trgmask_hash_set *ths[MAX_MERGE_INPUTS];
+static int events[MAX_MERGE_INPUTS];
+static int mcshowers[MAX_MERGE_INPUTS];
+static int mcevents[MAX_MERGE_INPUTS];
 static int max_list = 999;
 
 /**
- *  Processing and merging of I/O blocks from the two input files,
+ *  Processing and merging of I/O blocks from the input files,
  *  hopefully presented in the right order.
  */
 
@@ -463,9 +509,10 @@ int merge_data_from_io_block (IO_BUFFER *iobuf, IO_ITEM_HEADER *item_header,
    int tel_id3, itel3;
    int rc = -9;
    static int nlist = 0, prev_run_header_from = -1;
+   static int run_headers_seen = 0; /* Run headers of the current run seen so far */
 
    if ( iobuf == NULL || item_header == NULL || hsdata == NULL || 
-         hsdata_out == NULL || iobuf_out == NULL || ifile < 1 || ifile > 2 )
+         hsdata_out == NULL || iobuf_out == NULL || ifile < 1 || ifile > num_inputs )
    {
       fprintf(stderr,"Invalid parameter in merge_data_from_io_block()\n");
       exit(1);
@@ -509,7 +556,7 @@ printf("Now processing item type %d (ID=%ld) from file %d ...\n",
          // memset(&hsdata->event,0,sizeof(FullEvent));
          memset(&hsdata->mc_event,0,sizeof(MCEvent));
          /* Clearing MCShower is a bit more tricky because of allocated shower profiles */
-         if ( ifile == 1 )
+         if ( run_headers_seen == 0 ) /* First input with this run */
          {
             for (itel3=0; itel3<hsdata_out->run_header.ntel; itel3++)
             {
@@ -552,17 +599,15 @@ printf("Now processing item type %d (ID=%ld) from file %d ...\n",
                hsdata->run_header.run, hsdata->run_header.ntel,
                (long) hsdata->run_header.time);
          }
-         if ( ifile == 2 && hsdata->run_header.run != hsdata_out->run_header.run &&
+         if ( run_headers_seen > 0 && hsdata->run_header.run != hsdata_out->run_header.run &&
               hsdata_out->run_header.run != 0 )
          {
             fflush(stdout);
-            fprintf(stderr,"Run numbers do not match: file2 has %d, output has run %d !\n",
-               hsdata->run_header.run, hsdata_out->run_header.run);
+            fprintf(stderr,"Run numbers do not match: file %d has %d, output has run %d !\n",
+               ifile, hsdata->run_header.run, hsdata_out->run_header.run);
             exit(1);
          }
-         else if ( ifile == 2 && hsdata_out->run_header.run == 0 )
-            hsdata_out->run_header.run = hsdata->run_header.run;
-         else if ( ifile == 1 )
+         else if ( run_headers_seen == 0 || hsdata_out->run_header.run == 0 )
             hsdata_out->run_header.run = hsdata->run_header.run;
          if ( hsdata->run_header.ntel > H_MAX_TEL )
          {
@@ -584,7 +629,6 @@ printf("Now processing item type %d (ID=%ld) from file %d ...\n",
             hsdata_out->run_header.conv_depth = hsdata->run_header.conv_depth;
             hsdata_out->run_header.conv_ref_pos[0] = hsdata->run_header.conv_ref_pos[0];
             hsdata_out->run_header.conv_ref_pos[1] = hsdata->run_header.conv_ref_pos[1];
-            nrtel1 = hsdata->run_header.ntel;
             hsdata_out->event.num_tel = hsdata_out->run_header.ntel = ntel;
             hsdata_out->run_header.min_tel_trig = hsdata->run_header.min_tel_trig;
             hsdata_out->run_header.duration = hsdata->run_header.duration;
@@ -601,7 +645,6 @@ printf("Now processing item type %d (ID=%ld) from file %d ...\n",
          }
          else
          {
-            nrtel2 = hsdata->run_header.ntel;
             hsdata_out->event.num_tel = hsdata_out->run_header.ntel = ntel;
             rc = 0;
             if ( hsdata->run_header.time != hsdata_out->run_header.time )
@@ -803,10 +846,12 @@ printf("Now processing item type %d (ID=%ld) from file %d ...\n",
 
             events[ifile-1] = mcshowers[ifile-1] = mcevents[ifile-1] = 0;
          }
-         if ( ifile == 2 )
+         /* Merged run header gets written once we have it from all inputs. */
+         if ( ++run_headers_seen >= num_inputs )
          {
             set_tel_idx_ref(0);
             write_hess_runheader(iobuf_out,&hsdata_out->run_header);
+            run_headers_seen = 0;
          }
          break;
 
@@ -826,13 +871,13 @@ printf("Now processing item type %d (ID=%ld) from file %d ...\n",
          /* Except for the detector simulation version, which could differ, */
          /* pretty much everything should be identical. */
          /* Nevertheless, record both MC run headers as they came in. */
-         rc = write_io_block_to_file (iobuf,iobuf_out->output_file);
+         rc = write_io_block_to_file(iobuf, iobuf_out);
          break;
 
       /* =================================================== */
       case IO_TYPE_MC_INPUTCFG: /* 1212 */
          /* Copy to output buffer without unpacking it, if possible ... */
-         rc = write_io_block_to_file(iobuf, iobuf_out->output_file);
+         rc = write_io_block_to_file(iobuf, iobuf_out);
 	 if ( rc != 0 || verbose )
             printf("writing input cfg to output, rc=%d\n", rc);
          break;
@@ -840,7 +885,7 @@ printf("Now processing item type %d (ID=%ld) from file %d ...\n",
       /* =================================================== */
       case 70: /* How sim_hessarray was run and how it was configured. */
          /* Copy to output buffer without unpacking it, if possible ... */
-         rc = write_io_block_to_file(iobuf, iobuf_out->output_file);
+         rc = write_io_block_to_file(iobuf, iobuf_out);
 	 if ( rc != 0 || verbose )
             printf("writing history to output, rc=%d\n", rc);
          break;
@@ -1061,7 +1106,12 @@ if ( ev_hess_event > 0 && ev_hess_event < item_header->ident )
          FullEvent *evi = &hsdata->event;
          FullEvent *evo = &hsdata_out->event;
          int j, ntrg=0, ndata=0, ndt=0;
-         rc = read_hess_event(iobuf,evi,-1);
+         int pt_list[H_MAX_TEL], npt=0;
+         rc = -3;
+         if ( pass_through )
+            rc = read_hess_event_pass_through(iobuf,evi,pt_out_tel_id,ifile,pt_list,&npt);
+         if ( rc == -3 ) /* Needs full decoding */
+            rc = read_hess_event(iobuf,evi,-1);
 	 if ( rc != 0 || verbose )
          {
             printf("read_hess_event(), rc = %d\n",rc);
@@ -1342,6 +1392,9 @@ if ( ev_hess_event > 0 && ev_hess_event < item_header->ident )
                ndt++;
             }
          }
+         /* Telescopes with event data passed through without decoding */
+         for ( j=0; j<npt && ndt<H_MAX_TEL; j++ )
+            evo->teldata_list[ndt++] = pt_list[j];
          ndt = evo->num_teldata = ndt;
          ev_hess_event = item_header->ident;
 if ( nlist < max_list || nlist%1000 ==0 )
@@ -1393,7 +1446,7 @@ exit(1);
             }
             memcpy(&hsdata_out->mc_shower,&hsdata->mc_shower,sizeof(hsdata->mc_shower));
             /* Write the original data block to the output file. */
-            rc = write_io_block_to_file(iobuf, iobuf_out->output_file);
+            rc = write_io_block_to_file(iobuf, iobuf_out);
          }
          else
          {
@@ -1459,7 +1512,7 @@ exit(1);
             }
             /* Write the original data block to the output file. */
             /* The other data reset above is not part of the I/O block. */
-            rc = write_io_block_to_file(iobuf, iobuf_out->output_file);
+            rc = write_io_block_to_file(iobuf, iobuf_out);
          }
          else
          {
@@ -1618,7 +1671,7 @@ if ( ev_pe_sum > 0 && ev_pe_sum < item_header->ident )
          memcpy(&hsdata_out->run_stat,&hsdata->run_stat,sizeof(hsdata->run_stat));
          /* Copy the data block from input 1 and ignore that from input 2. */
          if ( ifile == 1 )
-            rc = write_io_block_to_file(iobuf, iobuf_out->output_file);
+            rc = write_io_block_to_file(iobuf, iobuf_out);
          break;
 
       /* =================================================== */
@@ -1636,7 +1689,7 @@ if ( ev_pe_sum > 0 && ev_pe_sum < item_header->ident )
          memcpy(&hsdata_out->mc_run_stat,&hsdata->mc_run_stat,sizeof(hsdata->mc_run_stat));
           /* Copy the data block from input 1 and ignore that from input 2. */
          if ( ifile == 1 )
-            rc = write_io_block_to_file(iobuf, iobuf_out->output_file);
+            rc = write_io_block_to_file(iobuf, iobuf_out);
          break;
 
       /* =================================================== */
@@ -1659,10 +1712,9 @@ if ( ev_pe_sum > 0 && ev_pe_sum < item_header->ident )
       case 100:
          check_for_delayed_write(item_header, ifile, hsdata_out, iobuf_out);
          /* The processing loop should just offer the histogram block from one file, */
-         /* typically from file 2, if available. But if file 2 has no histogram */
-         /* block at a matching position, it could be from file 1.  */
+         /* the last one with a histogram block at a matching position. */
          /* Thus no extra check here. */
-         rc = write_io_block_to_file(iobuf, iobuf_out->output_file);
+         rc = write_io_block_to_file(iobuf, iobuf_out);
          break;
 
       /* =================================================== */
@@ -1699,7 +1751,7 @@ int check_autoload_trgmask(const char *input_fname, IO_BUFFER *iobuf, int ifile)
    FILE *f1 = iobuf->input_file;
    IO_ITEM_HEADER item_header;
    
-   if ( input_fname == NULL || iobuf == NULL || ifile < 1 || ifile > 2 )
+   if ( input_fname == NULL || iobuf == NULL || ifile < 1 || ifile > num_inputs )
       return -99;
  
    if ( tms[ifile-1] != NULL )
@@ -1749,18 +1801,357 @@ int check_autoload_trgmask(const char *input_fname, IO_BUFFER *iobuf, int ifile)
       return 1; /* Success, trgmask values loaded */
 }
 
+/* ------------------------ struct merge_input --------------------------- */
+/**
+ *  Everything we keep per input file: its data structures, the
+ *  window of data blocks read ahead, and the block next in line
+ *  together with its position in the overall processing order.
+ */
+
+struct merge_input
+{
+   const char *fname;        ///< Input file name
+   FILE *input_file;         ///< Opened input file
+   AllHessData *hsdata;      ///< Data structures filled from this input
+   int window;               ///< Number of blocks that can be read ahead
+   IO_BUFFER **slot;         ///< Ring of 'window' I/O buffers
+   IO_ITEM_HEADER *slot_header; ///< Item headers of the blocks in the ring
+   int *slot_rc;             ///< 0 (o.k.), 1 (end of data), -1 (read error)
+   int head;                 ///< Ring position of the oldest block
+   int count;                ///< Number of blocks in the ring (incl. one being processed)
+   int stop;                 ///< Reader should stop.
+#ifdef _REENTRANT
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   int have_thread;
+#endif
+   IO_BUFFER *iobuf;         ///< The I/O buffer with the pending block, if any
+   IO_ITEM_HEADER item_header; ///< Item header of the pending block
+   int this_type;            ///< Type of pending block (0: none)
+   int prev_type;            ///< Type of last processed block
+   int done;                 ///< No more data from this input
+   int run;                  ///< Run number from last run header, -1 before
+   int run_seq;              ///< Sequence count of runs seen in this input
+   int run_phase;            ///< Latest kind of block seen in this run
+   int phase;                ///< Kind of pending block, in processing order (-1: unknown)
+   long event;               ///< Event number (or 100 * shower number)
+   int sub;                  ///< Order of block types for the same event
+};
+
+/* ------------------------- read_input_block ---------------------------- */
+/**
+ *  Find and read the next block of data from an input into the
+ *  next free ring slot (which the caller must make sure is free).
+ */
+
+static void read_input_block (struct merge_input *inp, int islot);
+
+static void read_input_block (struct merge_input *inp, int islot)
+{
+   IO_BUFFER *iobuf = inp->slot[islot];
+
+   if ( find_io_block(iobuf,&inp->slot_header[islot]) != 0 )
+      inp->slot_rc[islot] = 1;
+   else if ( read_io_block(iobuf,&inp->slot_header[islot]) != 0 )
+      inp->slot_rc[islot] = -1;
+   else
+      inp->slot_rc[islot] = 0;
+}
+
+#ifdef _REENTRANT
+/* -------------------------- input_reader ------------------------------- */
+/**
+ *  Reader thread for one input, filling the ring of data blocks
+ *  as far as free slots are available and stopping at the
+ *  end of the data.
+ */
+
+static void *input_reader (void *arg);
+
+static void *input_reader (void *arg)
+{
+   struct merge_input *inp = (struct merge_input *) arg;
+   int islot, rc = 0;
+
+   while ( rc == 0 )
+   {
+      pthread_mutex_lock(&inp->mutex);
+      while ( inp->count >= inp->window && !inp->stop )
+         pthread_cond_wait(&inp->cond,&inp->mutex);
+      if ( inp->stop )
+      {
+         pthread_mutex_unlock(&inp->mutex);
+         break;
+      }
+      islot = (inp->head + inp->count) % inp->window;
+      pthread_mutex_unlock(&inp->mutex);
+
+      /* Only this thread ever touches a slot outside of the filled part. */
+      read_input_block(inp,islot);
+      rc = inp->slot_rc[islot];
+
+      pthread_mutex_lock(&inp->mutex);
+      inp->count++;
+      pthread_cond_broadcast(&inp->cond);
+      pthread_mutex_unlock(&inp->mutex);
+   }
+
+   return NULL;
+}
+#endif
+
+/* --------------------------- open_input -------------------------------- */
+/**
+ *  Set up the window of I/O buffers of an input and, if possible,
+ *  start its reader thread. The input file must have been opened.
+ */
+
+static int open_input (struct merge_input *inp, int window);
+
+static int open_input (struct merge_input *inp, int window)
+{
+   int i;
+
+#ifndef _REENTRANT
+   window = 1; /* Without reader threads there is nothing to be read ahead. */
+#endif
+   if ( window < 1 )
+      window = 1;
+   inp->window = window;
+   inp->slot = (IO_BUFFER **) calloc((size_t)window,sizeof(IO_BUFFER *));
+   inp->slot_header = (IO_ITEM_HEADER *) calloc((size_t)window,sizeof(IO_ITEM_HEADER));
+   inp->slot_rc = (int *) calloc((size_t)window,sizeof(int));
+   if ( inp->slot == NULL || inp->slot_header == NULL || inp->slot_rc == NULL )
+      return -1;
+   for ( i=0; i<window; i++ )
+   {
+      /* Buffers get extended as needed, thus starting with moderate size. */
+      if ( (inp->slot[i] = allocate_io_buffer(4000000L)) == NULL )
+         return -1;
+      /* Allow buffers much larger than during simulation: most likely never exceeded */
+      inp->slot[i]->max_length = 400000000L;
+      inp->slot[i]->input_file = inp->input_file;
+   }
+   inp->head = inp->count = 0;
+   inp->stop = 0;
+   inp->iobuf = NULL;
+   inp->this_type = inp->prev_type = 0;
+   inp->done = 0;
+   inp->run = -1;
+   inp->run_seq = inp->run_phase = inp->phase = inp->sub = 0;
+   inp->event = -1;
+#ifdef _REENTRANT
+   inp->have_thread = 0;
+   pthread_mutex_init(&inp->mutex,NULL);
+   pthread_cond_init(&inp->cond,NULL);
+   if ( pthread_create(&inp->thread,NULL,input_reader,inp) == 0 )
+      inp->have_thread = 1;
+   else
+      Warning("Cannot start reader thread. Reading input without it.");
+#endif
+   return 0;
+}
+
+/* -------------------------- next_input_block --------------------------- */
+/**
+ *  Make the oldest block in the ring of an input the pending block.
+ *
+ *  @return 0 (o.k.), 1 (end of data), -1 (read error).
+ */
+
+static int next_input_block (struct merge_input *inp);
+
+static int next_input_block (struct merge_input *inp)
+{
+   int rc;
+
+#ifdef _REENTRANT
+   if ( inp->have_thread )
+   {
+      pthread_mutex_lock(&inp->mutex);
+      while ( inp->count == 0 )
+         pthread_cond_wait(&inp->cond,&inp->mutex);
+      pthread_mutex_unlock(&inp->mutex);
+   }
+   else
+#endif
+   {
+      read_input_block(inp,inp->head);
+      inp->count = 1;
+   }
+
+   if ( (rc = inp->slot_rc[inp->head]) != 0 )
+      return rc;
+   inp->iobuf = inp->slot[inp->head];
+   memcpy(&inp->item_header,&inp->slot_header[inp->head],sizeof(IO_ITEM_HEADER));
+   inp->this_type = (int) inp->item_header.type;
+   return 0;
+}
+
+/* ------------------------- release_input_block ------------------------- */
+/**
+ *  Done with the pending block (processed or ignored): its slot may
+ *  get filled again.
+ */
+
+static void release_input_block (struct merge_input *inp);
+
+static void release_input_block (struct merge_input *inp)
+{
+   inp->prev_type = inp->this_type;
+   inp->this_type = 0;
+   inp->iobuf = NULL;
+#ifdef _REENTRANT
+   if ( inp->have_thread )
+   {
+      pthread_mutex_lock(&inp->mutex);
+      inp->head = (inp->head + 1) % inp->window;
+      inp->count--;
+      pthread_cond_broadcast(&inp->cond);
+      pthread_mutex_unlock(&inp->mutex);
+      return;
+   }
+#endif
+   inp->count = 0;
+}
+
+/* --------------------------- close_input ------------------------------- */
+
+static void close_input (struct merge_input *inp);
+
+static void close_input (struct merge_input *inp)
+{
+   int i;
+#ifdef _REENTRANT
+   if ( inp->have_thread )
+   {
+      pthread_mutex_lock(&inp->mutex);
+      inp->stop = 1;
+      pthread_cond_broadcast(&inp->cond);
+      pthread_mutex_unlock(&inp->mutex);
+      pthread_join(inp->thread,NULL);
+      inp->have_thread = 0;
+   }
+   pthread_mutex_destroy(&inp->mutex);
+   pthread_cond_destroy(&inp->cond);
+#endif
+   for ( i=0; i<inp->window; i++ )
+   {
+      inp->slot[i]->input_file = NULL;
+      free_io_buffer(inp->slot[i]);
+   }
+   free(inp->slot);
+   free(inp->slot_header);
+   free(inp->slot_rc);
+   inp->slot = NULL;
+   inp->window = 0;
+}
+
+/* ------------------------- set_block_order ----------------------------- */
+/**
+ *  Classify the pending block of an input for the processing order:
+ *  run-level blocks (history, run headers, CORSIKA inputs) come first,
+ *  then per-telescope set-up and monitoring blocks, then shower and event
+ *  blocks by shower/event number (MC shower, MC event, p.e. sums, event),
+ *  and histograms last. A run-level block after any other starts a new run.
+ *  Unknown kinds of blocks are processed as soon as they are found.
+ */
+
+static void set_block_order (struct merge_input *inp);
+
+static void set_block_order (struct merge_input *inp)
+{
+   int type = inp->this_type;
+   int phase = -1, sub = 0;
+   long event = -1;
+
+   switch ( type )
+   {
+      case 70:   sub = 0; phase = 0; break;
+      case 2000: sub = 1; phase = 0; break;
+      case 2001: sub = 2; phase = 0; break;
+      case 1212: sub = 3; phase = 0; break;
+      case 2002: /* IO_TYPE_HESS_CAMSETTINGS */
+      case 2003: /* IO_TYPE_HESS_CAMORGAN */
+      case 2004: /* IO_TYPE_HESS_PIXELSET */
+      case 2005: /* IO_TYPE_HESS_PIXELDISABLE */
+      case 2006: /* IO_TYPE_HESS_CAMSOFTSET */
+      case 2007: /* IO_TYPE_HESS_POINTINGCOR */
+      case 2008: /* IO_TYPE_HESS_TRACKSET */
+      case 2022: /* IO_TYPE_HESS_TEL_MONI */
+      case 2023: /* IO_TYPE_HESS_LASCAL */
+         phase = 1;
+         break;
+      case 2020: /* IO_TYPE_HESS_MC_SHOWER */
+         phase = 2; sub = 0;
+         event = inp->item_header.ident * 100; /* shower number */
+         break;
+      case 2021: /* IO_TYPE_HESS_MC_EVENT */
+         phase = 2; sub = 1;
+         event = inp->item_header.ident;
+         break;
+      case 2026: /* IO_TYPE_HESS_MC_PE_SUM */
+      case 1204: /* IO_TYPE_MC_TELARRAY */
+         phase = 2; sub = 2;
+         event = inp->item_header.ident;
+         break;
+      case 2010: /* IO_TYPE_HESS_EVENT */
+         phase = 2; sub = 3;
+         event = inp->item_header.ident;
+         break;
+      case 100:
+         phase = 3;
+         break;
+      default:
+         break;
+   }
+
+   if ( phase == 0 && inp->run_phase > 0 )
+      inp->run_seq++;
+   if ( phase >= 0 )
+      inp->run_phase = phase;
+   inp->phase = phase;
+   inp->event = event;
+   inp->sub = sub;
+}
+
+/* ------------------------- block_goes_first ---------------------------- */
+/**
+ *  Should the pending block of input a be processed before that of input b?
+ *  Ties go to the input listed first.
+ */
+
+static int block_goes_first (const struct merge_input *a, int ia, 
+   const struct merge_input *b, int ib);
+
+static int block_goes_first (const struct merge_input *a, int ia, 
+   const struct merge_input *b, int ib)
+{
+   if ( a->run_seq != b->run_seq )
+      return (a->run_seq < b->run_seq);
+   if ( a->phase != b->phase )
+      return (a->phase < b->phase);
+   if ( a->event != b->event )
+      return (a->event < b->event);
+   if ( a->sub != b->sub )
+      return (a->sub < b->sub);
+   return (ia < ib);
+}
+
 /* ---------------------- print_process_status --------------------------- */
 
-void print_process_status (int prev_type1, int this_type1, int prev_type2, int this_type2);
+void print_process_status (struct merge_input *inp, int ninp);
 
-void print_process_status (int prev_type1, int this_type1, int prev_type2, int this_type2)
+void print_process_status (struct merge_input *inp, int ninp)
 {
-   printf("Last processed data type from file 1: %d\n", prev_type1);
-   if ( this_type1 != 0 )
-      printf("Not yet processed data type from file 1: %d\n", this_type1);
-   printf("Last processed data type from file 2: %d\n", prev_type2);
-   if ( this_type2 != 0 )
-      printf("Not yet processed data type from file 2: %d\n", this_type2);
+   int i;
+   for ( i=0; i<ninp; i++ )
+   {
+      printf("Last processed data type from file %d: %d\n", i+1, inp[i].prev_type);
+      if ( inp[i].this_type != 0 )
+         printf("Not yet processed data type from file %d: %d\n", i+1, inp[i].this_type);
+   }
 }
 
 /* ----------------------------- read_map -------------------------------- */
@@ -1769,7 +2160,7 @@ int read_map(const char *map_fname);
 
 int read_map(const char *map_fname)
 {
-   int itel=0;
+   int itel=0, ifile=0;
    FILE *map_file = NULL;
    char line[1000];
    char hl[120];
@@ -1790,10 +2181,13 @@ int read_map(const char *map_fname)
       map_tel[itel].have_pointcor = 0;
       map_tel[itel].have_trackset = 0;
 
-      map_to[0][itel] = map_to[1][itel] = -1;
    }
-   for ( itel=0; itel<=H_MAX_TEL; itel++ )
-      tel_idx[1][itel] = tel_idx[0][itel] = -1;
+   for ( ifile=0; ifile<MAX_MERGE_INPUTS; ifile++ )
+   {
+      for ( itel=0; itel<=H_MAX_TEL; itel++ )
+         map_to[ifile][itel] = tel_idx[ifile][itel] = -1;
+      ntel_in[ifile] = 0;
+   }
 
    /* Open map file */
 
@@ -1845,7 +2239,7 @@ int read_map(const char *map_fname)
                   exit(1);
                }
                to = ntel+1; /* Force incremental telescope IDs on output */
-               if ( (ni != 1 && ni != 2) || 
+               if ( ni < 1 || ni > num_inputs || 
                     to < 1 || to > H_MAX_TEL ||
                     ti < 1 || ti > H_MAX_TEL )
                {
@@ -1873,10 +2267,7 @@ int read_map(const char *map_fname)
                map_tel[ntel].inp_id = ti;
                map_to[ni-1][ti] = to;
                ntel++;
-               if ( ni == 1 )
-                  ntel1++;
-               else
-                  ntel2++;
+               ntel_in[ni-1]++;
             }
          }
       }
@@ -1885,11 +2276,17 @@ int read_map(const char *map_fname)
 
    fileclose(map_file);
 
-   printf("Mapping for %d telescopes (%d from input 1, %d from input 2)\n", ntel, ntel1, ntel2);
-   if ( ntel1 == 0 || ntel2 == 0 )
+   printf("Mapping for %d telescopes (", ntel);
+   for ( ifile=0; ifile<num_inputs; ifile++ )
+      printf("%s%d from input %d", (ifile>0) ? ", " : "", ntel_in[ifile], ifile+1);
+   printf(")\n");
+   for ( ifile=0; ifile<num_inputs; ifile++ )
    {
-      fprintf(stderr,"No event merging needed.\n");
-      exit(1);
+      if ( ntel_in[ifile] == 0 )
+      {
+         fprintf(stderr,"No telescopes mapped from input %d. No event merging needed.\n", ifile+1);
+         exit(1);
+      }
    }
    
    for (itel=0; itel<H_MAX_TEL; itel++)
@@ -1914,7 +2311,7 @@ static void syntax (const char *program);
 
 static void syntax (const char *program)
 {
-   printf("Syntax: %s [ options ] map-file input1 input2 output\n",program);
+   printf("Syntax: %s [ options ] map-file input1 input2 [ input3 ... ] output\n",program);
    printf("Options:\n");
    printf("     --auto-trgmask  : Load trgmask.gz files for each input file where available.\n");
    printf("     --min-trg-tel n : Require at least n telescopes in merged event (default: 2).\n");
@@ -1922,11 +2319,18 @@ static void syntax (const char *program)
    printf("                       count triggers in them as separate.\n");
    printf("     --max-list n    : All of the first n events are reported (default: 999).\n");
    printf("     --verbose       : Show events being merged.\n");
+   printf("     --full-decode   : Decode and re-encode all telescope event data instead\n");
+   printf("                       of copying it with re-mapped telescope IDs only.\n");
+   printf("     --window n      : Read ahead up to n data blocks per input (default: 4).\n");
+#ifdef _REENTRANT
+   printf("     --write-queue n : Write output from a separate thread, with up to n blocks queued.\n");
+#endif
    printf("     --clean-history : Drop previous history data blocks.\n");
    printf("     --clean-history-after n : Similar but keep first n blocks.\n");
    printf("     --no-stray-mc-runheader : Ignore MC runheaders before the main run header.\n");
    printf("     --single-corsika-inputs : Keep only the first CORSIKA inputs block.\n");
-   printf("\nCompiled for a maximum of %d telescopes before and after merging.\n", H_MAX_TEL);
+   printf("\nCompiled for a maximum of %d telescopes before and after merging", H_MAX_TEL);
+   printf(" and up to %d input files.\n", MAX_MERGE_INPUTS);
    printf("Linked against eventIO/hessio library\n");
 #ifdef EVENTIO_VERSION
          printf("   version %s\n", EVENTIO_VERSION);
@@ -1951,38 +2355,27 @@ static void syntax (const char *program)
 int main (int argc, char **argv)
 {
    const char *prg = argv[0];
-   IO_BUFFER *iobuf1 = NULL, *iobuf2 = NULL, *iobuf3 = NULL;
-   IO_ITEM_HEADER item_header1, item_header2;
+   IO_BUFFER *iobuf3 = NULL;
+   struct merge_input inputs[MAX_MERGE_INPUTS];
    const char *map_fname = NULL;
-   const char *input_fname1 = NULL, *input_fname2 = NULL;
+   const char *fnames[MAX_MERGE_INPUTS+1];
    const char *output_fname = NULL;
    int max_events = -1;
    int auto_trgmask = 0;
    char hl[512];
    int clean_history = 0, clean_history_after = -1, history_count = 0;
+   int window = 4;
+   int write_queue = 0;
 
-   int iarg=0, jarg=0;
+   int iarg=0, jarg=0, ifile=0;
    char *program = argv[0];
-   int done1 = 0, done2 = 0;
-   int read_from = 1;
-   int prev_type1 = 0, prev_type2 = 0;
-   int this_type1 = 0, this_type2 = 0;
    int no_stray_mc = 0, single_corsika_inputs = 0, have_corsika_inputs = 0;
+   AllHessData *hsdata3 = NULL;
    
    H_CHECK_MAX();
 
    push_command_history(argc, argv);
 
-   AllHessData *hsdata1 = (AllHessData *) calloc(1,sizeof(AllHessData)); /* First input */
-   AllHessData *hsdata2 = (AllHessData *) calloc(1,sizeof(AllHessData)); /* Second input */
-   AllHessData *hsdata3 = (AllHessData *) calloc(1,sizeof(AllHessData)); /* Merged, output */
-
-   if ( hsdata1 == NULL || hsdata2 == NULL || hsdata3 == NULL )
-   {
-      perror("Allocating data structures");
-      exit(1);
-   }
-
    /* Show command line on output */
    if ( getenv("SHOWCOMMAND") != NULL )
    {
@@ -2007,6 +2400,11 @@ int main (int argc, char **argv)
             verbose = 1;
 	    continue;
          }
+         else if ( strcmp(argv[iarg],"--full-decode") == 0 )
+         {
+            pass_through = 0;
+	    continue;
+         }
          else if ( strcmp(argv[iarg],"--no-stray-mc-runheader") == 0 )
          {
             no_stray_mc = 1;
@@ -2048,6 +2446,18 @@ int main (int argc, char **argv)
             iarg++;
             continue;
          }
+         else if ( strcmp(argv[iarg],"--window") == 0 && iarg+1<argc )
+         {
+            window = atoi(argv[iarg+1]);
+            iarg++;
+            continue;
+         }
+         else if ( strcmp(argv[iarg],"--write-queue") == 0 && iarg+1<argc )
+         {
+            write_queue = atoi(argv[iarg+1]);
+            iarg++;
+            continue;
+         }
          else
          {
             if ( strcmp(argv[iarg],"--help") != 0 && strcmp(argv[iarg],"--version") != 0 )
@@ -2058,16 +2468,20 @@ int main (int argc, char **argv)
       }
       else if ( jarg == 0 )
          map_fname = argv[iarg];
-      else if ( jarg == 1 )
-         input_fname1 = argv[iarg];
-      else if ( jarg == 2 )
-         input_fname2 = argv[iarg];
-      else if ( jarg == 3 )
-         output_fname = argv[iarg];
+      else if ( jarg <= MAX_MERGE_INPUTS+1 )
+         fnames[jarg-1] = argv[iarg];
       else
+      {
+         fprintf(stderr,"Too many input files; can only merge up to %d.\n", MAX_MERGE_INPUTS);
          syntax(program);
+      }
       jarg++;
    }
+   /* Map file, at least two inputs, and the output (last one) */
+   if ( jarg < 4 )
+      syntax(program);
+   num_inputs = jarg - 2;
+   output_fname = fnames[num_inputs];
 
    if ( strcmp(output_fname,"-") == 0 )
    {
@@ -2078,10 +2492,11 @@ int main (int argc, char **argv)
 
    snprintf(hl,sizeof(hl),"Mapping file is %s\n", map_fname);
    push_config_history(hl,1);
-   snprintf(hl,sizeof(hl),"Input file 1 is %s\n", input_fname1);
-   push_config_history(hl,1);
-   snprintf(hl,sizeof(hl),"Input file 2 is %s\n", input_fname2);
-   push_config_history(hl,1);
+   for ( ifile=0; ifile<num_inputs; ifile++ )
+   {
+      snprintf(hl,sizeof(hl),"Input file %d is %s\n", ifile+1, fnames[ifile]);
+      push_config_history(hl,1);
+   }
    snprintf(hl,sizeof(hl),"Output file is %s\n", output_fname);
    push_config_history(hl,1);
 
@@ -2096,516 +2511,177 @@ int main (int argc, char **argv)
    /* Check assumed limits with the ones compiled into the library. */
    H_CHECK_MAX();
 
+   if ( (hsdata3 = (AllHessData *) calloc(1,sizeof(AllHessData))) == NULL ) /* Merged, output */
+   {
+      perror("Allocating data structures");
+      exit(1);
+   }
    /* Start with quite large buffers; don't worry about wasting memory */
-   if ( (iobuf1 = allocate_io_buffer(40000000L)) == NULL ||
-        (iobuf2 = allocate_io_buffer(40000000L)) == NULL ||
-        (iobuf3 = allocate_io_buffer(40000000L)) == NULL )
+   if ( (iobuf3 = allocate_io_buffer(40000000L)) == NULL )
    {
       Error("Cannot allocate I/O buffers");
       exit(1);
    }
    /* Allow buffers much larger than during simulation: most likely never exceeded */
-   iobuf1->max_length = 400000000L;
-   iobuf2->max_length = 400000000L;
    iobuf3->max_length = 800000000L;
-
-   if ( auto_trgmask )
-      check_autoload_trgmask(input_fname1, iobuf1, 1);
-   if ( (iobuf1->input_file = fileopen(input_fname1,"r")) == NULL )
+   /* Staging buffer for telescope data passed through without decoding */
+   if ( pass_through && init_hess_pass_through() != 0 )
    {
-      perror(input_fname1);
+      Error("Cannot allocate I/O buffers");
       exit(1);
    }
-   if ( auto_trgmask )
-      check_autoload_trgmask(input_fname2, iobuf2, 2);
-   if ( (iobuf2->input_file = fileopen(input_fname2,"r")) == NULL )
+
+   for ( ifile=0; ifile<num_inputs; ifile++ )
    {
-      perror(input_fname2);
-      exit(1);
+      struct merge_input *inp = &inputs[ifile];
+      memset(inp,0,sizeof(struct merge_input));
+      inp->fname = fnames[ifile];
+      if ( (inp->hsdata = (AllHessData *) calloc(1,sizeof(AllHessData))) == NULL )
+      {
+         perror("Allocating data structures");
+         exit(1);
+      }
+      /* The output buffer is not yet in use and can be borrowed for that. */
+      if ( auto_trgmask )
+         check_autoload_trgmask(inp->fname, iobuf3, ifile+1);
+      if ( (inp->input_file = fileopen(inp->fname,"r")) == NULL )
+      {
+         perror(inp->fname);
+         exit(1);
+      }
+      if ( open_input(inp,window) != 0 )
+      {
+         Error("Cannot allocate I/O buffers");
+         exit(1);
+      }
    }
    if ( (iobuf3->output_file = fileopen(output_fname,"w")) == NULL )
    {
       perror(output_fname);
       exit(1);
    }
+   if ( write_queue > 0 && set_async_output(iobuf3,write_queue,0) != 0 )
+      fprintf(stderr,"Asynchronous output not available, writing synchronously.\n");
    write_history(9,iobuf3);
 
-   for (;;) /* Loop over all data in both input files */
+   for (;;) /* Loop over all data in all input files */
    {
-      int merge_now = 0, merge_next = 0;
+      struct merge_input *inp;
+      int rc = 0, inext = -1, skip = 0, type;
 
-      int rc = 0;
       if ( interrupted )
-      {
-         rc = 1;
-         break;
-      }
-
-      if ( max_events > 0 && (events[0] >= max_events || events[1] >= max_events) )
          break;
 
-#ifdef DEBUG_MERGE
-printf("Processing loop: r=%d, t1=%d, t2=%d, p1=%d, p2=%d, e1=%ld, e2=%ld, d1=%d, d2=%d, mnow=%d, mnext=%d\n",
-   read_from, this_type1, this_type2, prev_type1, prev_type2, event1, event2, done1, done2, merge_now, merge_next);
-#endif
-
-      /* Can the request to read the next data block be satisfied? */
-      if ( done1 || done2 )
-      {
-         if ( done1 && done2 )
-         {
-            printf("Reading from both input files completed.\n");
-            if ( this_type1 == 100 && this_type2 == 100 )
-            {
-               merge_data_from_io_block(iobuf1, &item_header1, 1, hsdata1, hsdata3, iobuf3);
-               /* Ignore the histogram block from the second file */
-               this_type1 = this_type2 = 0;
-            }
-            if ( this_type1 != 0 || this_type2 != 0 )
-            {
-               printf("There is still some unprocessed data:\n");
-               print_process_status(prev_type1,this_type1,prev_type2,this_type2);
-            }
-            break;
-         }
-         if ( (read_from == 1 && done1) || (read_from == 2 && done2) )
-         {
-            printf("Should read from input file %d but no more data available.\n", read_from);
-            print_process_status(prev_type1,this_type1,prev_type2,this_type2);
+      for ( ifile=0; ifile<num_inputs; ifile++ )
+         if ( max_events > 0 && events[ifile] >= max_events )
             break;
-         }
-      }
-
-      if ( (read_from == 1 && this_type1 != 0) || (read_from == 2 && this_type2 != 0) )
-      {
-         fprintf(stderr,"Should read from input file %d but have not processed previous block yet.\n", read_from);
-         print_process_status(prev_type1,this_type1,prev_type2,this_type2);
+      if ( ifile < num_inputs )
          break;
-      }
 
-      /* Should we read a data block from the first file? */
-      if ( read_from == 1 && !done1 )
+      /* Every input still having data must show its next block before we can decide. */
+      for ( ifile=0; ifile<num_inputs && rc >= 0; ifile++ )
       {
-         /* Find and read the next block of data. */
-         /* In case of problems with the data, just give up. */
-         if ( find_io_block(iobuf1,&item_header1) != 0 )
-         {
-            rc = 2;
-            done1 = 1; /* No more data to come from the first file. */
-            read_from = 2;
+         inp = &inputs[ifile];
+         if ( inp->done || inp->this_type != 0 )
             continue;
-         }
-         else if ( read_io_block(iobuf1,&item_header1) != 0 )
+         if ( (rc = next_input_block(inp)) > 0 )
          {
-            rc = -1; /* An unexpected failure to read the data. We better give up. */
-            break;
+            inp->done = 1; /* No more data to come from this file. */
+            rc = 0;
          }
-         this_type1 = item_header1.type;
+         else if ( rc < 0 ) /* An unexpected failure to read the data. We better give up. */
+            fprintf(stderr,"Reading data from input file %d failed.\n", ifile+1);
+         else
+            set_block_order(inp);
 #ifdef DEBUG_MERGE
-printf("Type1 = %d, ID = %ld\n", this_type1, item_header1.ident);
+if ( inp->this_type != 0 )
+printf("Type%d = %d, ID = %ld\n", ifile+1, inp->this_type, inp->item_header.ident);
 #endif
-         if ( this_type1 == 70 )
-         {
-            history_count++;
-            if ( clean_history || 
-                 ( clean_history_after >= 0 && history_count > clean_history_after ) )
-            {
-               prev_type1 = this_type1;
-               this_type1 = 0;
-               continue;
-            }
-         }
-         if ( this_type1 == 2001 && run1 < 0 && no_stray_mc )
-         {
-            prev_type1 = this_type1;
-            this_type1 = 0;
-            printf("\nIgnoring stray MC run header before main run header in file 1.\n\n");
-            continue;
-         }
-         if ( this_type1 == 1212 && single_corsika_inputs && have_corsika_inputs )
-         {
-            prev_type1 = this_type1;
-            this_type1 = 0;
-            printf("\nIgnoring repeated CORSIKA inputs data block.\n\n");
-            continue;
-         }
-         if ( (this_type1 == 70 || this_type1 == 2000 || 
-               this_type1 == 2001 || this_type1 == 1212) && 
-              this_type2 == 0 ) /* switch to second file */
-         {
-            read_from = 2;
-            continue;
-         }
-         switch ( this_type1 )
-         {
-            case 70:   /* Immediate output without other actions */
-            case 2000: /* IO_TYPE_HESS_RUNHEADER: Merging without immediate output (waits for file 2) */
-            case 2001: /* IO_TYPE_HESS_MCRUNHEADER: Merging without immediate output (waits for file 2) */
-            case 1212: /* IO_TYPE_MC_INPUTCFG: Immediate output (once) without other actions */
-               if ( this_type1 == 2000 )
-                  run1 = item_header1.ident;
-               merge_now = 1;
-               if ( this_type1 == this_type2 )
-                  merge_next = 2;
-               read_from = 1;
-               if ( this_type1 == 2001 && run2 >= 0 )
-               {
-                  merge_next = 2;
-                  read_from = 2;
-               }
-               if ( this_type1 == 1212 )
-                  have_corsika_inputs = 1;
-               event1 = -2;
-               break;
-
-            /* These can all be merged with immediate output, unless file 2 is behind: */
-            case 2002: /* IO_TYPE_HESS_CAMSETTINGS */
-            case 2003: /* IO_TYPE_HESS_CAMORGAN */
-            case 2004: /* IO_TYPE_HESS_PIXELSET */
-            case 2005: /* IO_TYPE_HESS_PIXELDISABLE */
-            case 2006: /* IO_TYPE_HESS_CAMSOFTSET */
-            case 2007: /* IO_TYPE_HESS_POINTINGCOR */
-            case 2008: /* IO_TYPE_HESS_TRACKSET */
-            case 2022: /* IO_TYPE_HESS_TEL_MONI */
-            case 2023: /* IO_TYPE_HESS_LASCAL */
-               if ( this_type2 == 70 || this_type2 == 2000 || 
-                    this_type2 == 2001 || this_type2 == 1212 )
-               {
-                  merge_now = 2;
-                  read_from = 2;
-               }
-               else
-               {
-                  merge_now = 1;
-                  // merge_next = 2;
-                  read_from = 1;
-               }
-               if ( this_type1 < 2020 )
-                  event1 = -1;
-               break;
-
-            case 2020: /* IO_TYPE_HESS_MC_SHOWER */
-            case 2021: /* IO_TYPE_HESS_MC_EVENT */
-            case 2026: /* IO_TYPE_HESS_MC_PE_SUM */
-            case 1204: /* IO_TYPE_MC_TELARRAY */
-            case 2010: /* IO_TYPE_HESS_EVENT */
-               if ( this_type1 == 2020 )
-                  event1 = item_header1.ident * 100; /* shower number */
-               else
-                  event1 = item_header1.ident; /* event number */
-               if ( this_type2 == 70 || this_type2 == 1212 || 
-                    (this_type2 >= 2000 && this_type2 <= 2008 ) ||
-                    this_type2 == 2022 || this_type2 == 2023 )
-               {
-                  merge_now = 2; /* File 2 is far behind and needs to catch up */
-                  read_from = 2;
-               }
-               else if ( event2 < event1 ) /* File 2 may be behind */
-               {
-                  merge_now = 2;
-                  read_from = 2;
-               }
-               else if ( event2 > event1 ) /* File 1 is behind */
-               {
-                  merge_now = 1;
-                  read_from = 1;
-               }
-               else /* event2 == event1 */
-               {
-                  if ( this_type1 == this_type2 ) /* We caught up with file 2. Merge both. */
-                  {
-                     merge_now = 1;
-                     merge_next = 2;
-                     read_from = 1;
-                  }
-                  else if ( this_type1 == 2020 ) /* First the MC shower block */
-                  {
-                     merge_now = 1;
-                     read_from = 1;
-                  }
-                  else if ( this_type2 == 2020 ) /* First the MC shower block */
-                  {
-                     merge_now = 2;
-                     read_from = 2;
-                  }
-                  else if ( this_type1 == 2021 ) /* Next the MC event block */
-                  {
-                     merge_now = 1;
-                     read_from = 1;
-                  }
-                  else if ( this_type2 == 2021 ) /* Next the MC event block */
-                  {
-                     merge_now = 2;
-                     read_from = 2;
-                  }
-                  else if ( this_type1 == 2026 || this_type1 == 1204 ) /* then anything else than the event */
-                  {
-                     merge_now = 1;
-                     read_from = 1;
-                  }
-                  else if ( this_type2 == 2026 || this_type2 == 1204 ) /* then anything else than the event */
-                  {
-                     merge_now = 2;
-                     read_from = 2;
-                  }
-                  else
-                  {
-                     merge_now = 1;
-                     read_from = 1;
-                  }
-               }
-               break;
-
-            case 100: /* Probably the last block of file 1 */
-               merge_now = 0;
-               if ( this_type2 == 100 )
-               {
-                  merge_now = 2;
-                  this_type1 = 0;
-               }
-               else if ( done2 )
-                  merge_now = 1;
-               read_from = 2;
-               break;
-
-            default: /* Probably complaining about unknown block type but try anyway */
-               merge_now = 1;
-               read_from = 2;
-               break;
-         }
       }
-      /* Or should we read a data block from the second file? */
-      else if ( read_from == 2 && !done2 && rc >= 0 )
+      if ( rc < 0 )
+         break;
+
+      /* The earliest of all pending blocks is next. */
+      for ( ifile=0; ifile<num_inputs; ifile++ )
       {
-         /* Find and read the next block of data. */
-         /* In case of problems with the data, just give up. */
-         if ( find_io_block(iobuf2,&item_header2) != 0 )
-         {
-            rc = 2;
-            done2 = 1; /* No more data to come from the first file. */
-            continue;
-         }
-         else if ( read_io_block(iobuf2,&item_header2) != 0 )
-         {
-            rc = -1; /* An unexpected failure to read the data. We better give up. */
-            break;
-         }
-         this_type2 = item_header2.type;
-#ifdef DEBUG_MERGE
-printf("Type2 = %d, ID = %ld\n", this_type2, item_header2.ident);
-#endif
-         if ( this_type2 == 70 )
-         {
-            history_count++;
-            if ( clean_history || 
-                 ( clean_history_after >= 0 && history_count > clean_history_after ) )
-            {
-               prev_type2 = this_type2;
-               this_type2 = 0;
-               continue;
-            }
-         }
-         if ( this_type2 == 2001 && run2 < 0 && no_stray_mc )
-         {
-            prev_type2 = this_type2;
-            this_type2 = 0;
-            printf("\nIgnoring stray MC run header before main run header in file 2.\n\n");
-            continue;
-         }
-         if ( this_type2 == 1212 && single_corsika_inputs && have_corsika_inputs )
-         {
-            prev_type2 = this_type2;
-            this_type2 = 0;
-            printf("\nIgnoring repeated CORSIKA inputs data block.\n\n");
-            continue;
-         }
-         if ( (this_type2 == 2000 || 
-               this_type2 == 2001 || this_type2 == 1212) && 
-              this_type1 == 0 ) /* switch to first file */
-         {
-            read_from = 1;
+         if ( inputs[ifile].this_type == 0 )
             continue;
-         }
-         switch ( this_type2 )
-         {
-            case 70:   /* Immediate output without other actions */
-            case 2000: /* IO_TYPE_HESS_RUNHEADER: Merging with immediate output (must have merged run header of file 1) */
-            case 2001: /* IO_TYPE_HESS_MCRUNHEADER: Merging without immediate output (must have MC merged run header of file 1) */
-            case 1212: /* Immediate output (once) without other actions */
-               if ( this_type2 == 2000 )
-                  run2 = item_header2.ident;
-               if ( this_type1 == this_type2 ) /* Caught up with file 1 */
-               {
-                  merge_now = 1;
-                  merge_next = 2;
-                  read_from = 1;
-               }
-               else if ( this_type1 == 70 || this_type1 == 2000 || this_type1 == 2001 ) /* First process data from file 1 */
-               {
-                  merge_now = 1;
-                  read_from = 1;
-               }
-               else
-               {
-                  merge_now = 2;
-                  read_from = 2;
-               }
-               if ( this_type2 == 1212 )
-                  have_corsika_inputs = 1;
-               event2 = -2;
-               break;
-
-            /* These can all be merged with immediate output, unless file 1 is behind: */
-            case 2002: /* IO_TYPE_HESS_CAMSETTINGS */
-            case 2003: /* IO_TYPE_HESS_CAMORGAN */
-            case 2004: /* IO_TYPE_HESS_PIXELSET */
-            case 2005: /* IO_TYPE_HESS_PIXELDISABLE */
-            case 2006: /* IO_TYPE_HESS_CAMSOFTSET */
-            case 2007: /* IO_TYPE_HESS_POINTINGCOR */
-            case 2008: /* IO_TYPE_HESS_TRACKSET */
-            case 2022: /* IO_TYPE_HESS_TEL_MONI */
-            case 2023: /* IO_TYPE_HESS_LASCAL */
-               if ( this_type1 == 70 || this_type1 == 2000 || 
-                    this_type1 == 2001 || this_type1 == 1212 ||
-                    this_type1 == 2002 || this_type1 == 2003 || this_type1 == 2004 || this_type1 == 2005 ||
-                    this_type1 == 2006 || this_type1 == 2007 || this_type1 == 2008 ||
-                    ((this_type2 == 2022 || this_type2 == 2023) && (this_type1 == 2022 || this_type1 == 2023)) )
-               {
-                  merge_now = 1; /* Process file one as far as we get */
-                  read_from = 1;
-               }
-               else
-               {
-                  merge_now = 2;
-                  read_from = 2;
-               }
-               if ( this_type2 < 2020 )
-                  event2 = -1;
-               break;
-
-            case 2020: /* IO_TYPE_HESS_MC_SHOWER */
-            case 2021: /* IO_TYPE_HESS_MC_EVENT */
-            case 2026: /* IO_TYPE_HESS_MC_PE_SUM */
-            case 1204:
-            case 2010: /* IO_TYPE_HESS_EVENT */
-               if ( this_type2 == 2020 )
-                  event2 = item_header2.ident * 100; /* shower number */
-               else
-                  event2 = item_header2.ident; /* event number */
-               if ( this_type1 == 70 || this_type1 == 1212 || 
-                    (this_type1 >= 2000 && this_type1 <= 2008 ) ||
-                    this_type1 == 2022 || this_type1 == 2023 )
-               {
-                  merge_now = 1; /* File 1 is far behind and needs to catch up */
-                  read_from = 1;
-               }
-               else if ( event1 < event2 ) /* File 1 may be behind */
-               {
-                  merge_now = 1;
-                  read_from = 1;
-               }
-               else if ( event1 > event2 ) /* File 2 is behind */
-               {
-                  merge_now = 2;
-                  read_from = 2;
-               }
-               else /* event2 == event1 */
-               {
-                  if ( this_type1 == this_type2 ) /* We caught up with file 1. Merge both. */
-                  {
-                     merge_now = 1;
-                     merge_next = 2;
-                     read_from = 1;
-                  }
-                  else if ( this_type1 == 2020 ) /* First the MC shower block */
-                  {
-                     merge_now = 1;
-                     read_from = 1;
-                  }
-                  else if ( this_type2 == 2020 ) /* First the MC shower block */
-                  {
-                     merge_now = 2;
-                     read_from = 2;
-                  }
-                  else if ( this_type1 == 2021 ) /* Next the MC event block */
-                  {
-                     merge_now = 1;
-                     read_from = 1;
-                  }
-                  else if ( this_type2 == 2021 ) /* Next the MC event block */
-                  {
-                     merge_now = 2;
-                     read_from = 2;
-                  }
-                  else if ( this_type1 == 2026 || this_type1 == 1204 ) /* then anything else than the event */
-                  {
-                     merge_now = 1;
-                     read_from = 1;
-                  }
-                  else if ( this_type2 == 2026 || this_type2 == 1204 ) /* then anything else than the event */
-                  {
-                     merge_now = 2;
-                     read_from = 2;
-                  }
-                  else
-                  {
-                     merge_now = 2;
-                     read_from = 2;
-                  }
-               }
-               break;
-
-            case 100: /* Probably the last block of file 2 */
-               merge_now = 2;
-               if ( this_type1 == 100 )
-                  this_type1 = 0;
-               read_from = 1;
-               break;
-
-            default: /* Probably complaining about unknown block type but try anyway */
-               merge_now = 2;
-               read_from = 1;
-               break;
-         }
+         if ( inext < 0 || block_goes_first(&inputs[ifile],ifile,&inputs[inext],inext) )
+            inext = ifile;
+      }
+      if ( inext < 0 )
+      {
+         printf("Reading from all input files completed.\n");
+         break;
       }
 
-      if ( merge_now == 1 && this_type1 != 0 )
+      inp = &inputs[inext];
+      type = inp->this_type;
+      if ( type == 70 )
       {
-         merge_data_from_io_block(iobuf1, &item_header1, 1, hsdata1, hsdata3, iobuf3);
-         prev_type1 = this_type1;
-         this_type1 = 0;
-         merge_now = 0;
+         history_count++;
+         if ( clean_history || 
+              ( clean_history_after >= 0 && history_count > clean_history_after ) )
+            skip = 1;
       }
-      else if ( merge_now == 2 && this_type2 != 0 )
+      else if ( type == 2000 )
+         inp->run = inp->item_header.ident;
+      else if ( type == 2001 && inp->run < 0 && no_stray_mc )
       {
-         merge_data_from_io_block(iobuf2, &item_header2, 2, hsdata2, hsdata3, iobuf3);
-         prev_type2 = this_type2;
-         this_type2 = 0;
-         merge_now = 0;
+         printf("\nIgnoring stray MC run header before main run header in file %d.\n\n", inext+1);
+         skip = 1;
       }
-      if ( merge_next == 1 && this_type1 != 0 )
+      else if ( type == 1212 )
       {
-         merge_data_from_io_block(iobuf1, &item_header1, 1, hsdata1, hsdata3, iobuf3);
-         prev_type1 = this_type1;
-         this_type1 = 0;
-         merge_next = 0;
+         if ( single_corsika_inputs && have_corsika_inputs )
+         {
+            printf("\nIgnoring repeated CORSIKA inputs data block.\n\n");
+            skip = 1;
+         }
+         have_corsika_inputs = 1;
       }
-      else if ( merge_next == 2 && this_type2 != 0 )
+      else if ( type == 100 )
       {
-         merge_data_from_io_block(iobuf2, &item_header2, 2, hsdata2, hsdata3, iobuf3);
-         prev_type2 = this_type2;
-         this_type2 = 0;
-         merge_next = 0;
+         /* Histograms cannot be merged: only that from the last input offering one is kept. */
+         for ( ifile=num_inputs-1; ifile>inext; ifile-- )
+            if ( inputs[ifile].this_type == 100 && inputs[ifile].run_seq == inp->run_seq )
+               break;
+         if ( ifile > inext )
+         {
+            release_input_block(inp);
+            inp = &inputs[ifile];
+            inext = ifile;
+         }
+         for ( ifile=0; ifile<inext; ifile++ )
+            if ( inputs[ifile].this_type == 100 && inputs[ifile].run_seq == inp->run_seq )
+               release_input_block(&inputs[ifile]);
       }
 
+      if ( !skip )
+         merge_data_from_io_block(inp->iobuf, &inp->item_header, inext+1, 
+            inp->hsdata, hsdata3, iobuf3);
+      release_input_block(inp);
+   }
+
+   for ( ifile=0; ifile<num_inputs; ifile++ )
+   {
+      if ( inputs[ifile].this_type != 0 )
+      {
+         printf("There is still some unprocessed data:\n");
+         print_process_status(inputs,num_inputs);
+         break;
+      }
    }
    
-   fileclose(iobuf1->input_file);
-   fileclose(iobuf2->input_file);
+   for ( ifile=0; ifile<num_inputs; ifile++ )
+   {
+      close_input(&inputs[ifile]);
+      fileclose(inputs[ifile].input_file);
+      free(inputs[ifile].hsdata);
+   }
+   set_async_output(iobuf3,0,0); /* Everything written before closing */
    fileclose(iobuf3->output_file);
    /* Avoid cppcheck false positives: */
-   free(hsdata1);
-   free(hsdata2);
    free(hsdata3);
 
    return 0;
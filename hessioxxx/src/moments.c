@@ -374,3 +374,123 @@ int stat_moments (MOMENTS *mom, struct momstat *stmom)
    }
    return(0);
 }
+
+/* ----------------------- sum_weighted_powers --------------------- */
+/**
+ *    Sum up weights and weighted first to fourth powers of values
+ *    in one pass over contiguous arrays. The sums are kept in
+ *    four interleaved partial sums which the compiler can map
+ *    onto vector registers, using fused multiply-adds where
+ *    available. Compared to sequential accumulation, results differ
+ *    only by rounding (relative differences of order 1e-15 times the
+ *    condition of the sums).
+ *
+ *    @param  x   Values.
+ *    @param  w   Weights of the values (NULL: all weights are 1).
+ *    @param  n   Number of values.
+ *    @param  s   Resulting sums (five elements):
+ *                s[k] = sum of w*x^k for k=0 to 4.
+ *
+ */
+
+void sum_weighted_powers (const double *x, const double *w, size_t n,
+     double *s)
+{
+   double p0[4] = {0.,0.,0.,0.}, p1[4] = {0.,0.,0.,0.}, p2[4] = {0.,0.,0.,0.},
+          p3[4] = {0.,0.,0.,0.}, p4[4] = {0.,0.,0.,0.};
+   size_t i, k, n4 = n & ~((size_t)3);
+
+   for ( i=0; i<n4; i+=4 )
+   {
+      for ( k=0; k<4; k++ )
+      {
+         double v = x[i+k];
+         double a = (w != NULL) ? w[i+k] : 1.;
+         double av = a * v;
+         double av2 = av * v;
+         p0[k] += a;
+         p1[k] += av;
+         p2[k] += av2;
+         p3[k] = MOMENTS_FMA(av2, v, p3[k]);
+         p4[k] = MOMENTS_FMA(av2, v*v, p4[k]);
+      }
+   }
+   for ( ; i<n; i++ )
+   {
+      double v = x[i];
+      double a = (w != NULL) ? w[i] : 1.;
+      double av = a * v;
+      double av2 = av * v;
+      p0[0] += a;
+      p1[0] += av;
+      p2[0] += av2;
+      p3[0] = MOMENTS_FMA(av2, v, p3[0]);
+      p4[0] = MOMENTS_FMA(av2, v*v, p4[0]);
+   }
+
+   s[0] = (p0[0] + p0[1]) + (p0[2] + p0[3]);
+   s[1] = (p1[0] + p1[1]) + (p1[2] + p1[3]);
+   s[2] = (p2[0] + p2[1]) + (p2[2] + p2[3]);
+   s[3] = (p3[0] + p3[1]) + (p3[2] + p3[3]);
+   s[4] = (p4[0] + p4[1]) + (p4[2] + p4[3]);
+}
+
+/* ------------------------ fill_real_moments_n ---------------------- */
+/**
+ *    Same as calling fill_real_moments() for each of n values,
+ *    but with the sums for all data done in one pass through
+ *    sum_weighted_powers().
+ *
+ *    @param  mom    Pointer to previously allocated MOMENTS structure.
+ *    @param  value  Measurement values
+ *    @param  weight Weighting factors of the values (NULL: all 1)
+ *    @param  n      Number of values
+ *
+ */
+
+void fill_real_moments_n (MOMENTS *mom, const double *value,
+     const double *weight, size_t n)
+{
+   double s[5];
+   size_t i, nin = 0;
+
+   if ( mom == (MOMENTS *) NULL || n == 0 )
+      return;
+
+   sum_weighted_powers(value, weight, n, s);
+   mom->sum  += s[1];
+   mom->sum2 += s[2];
+   mom->sum3 += s[3];
+   mom->sum4 += s[4];
+   mom->entries += n;
+
+   for ( i=0; i<n; i++ )
+      if ( value[i] >= mom->lower_limit && value[i] < mom->upper_limit )
+         nin++;
+
+   if ( nin == n ) /* Everything within range: same sums again */
+   {
+      mom->tsum  += s[1];
+      mom->tsum2 += s[2];
+      mom->tsum3 += s[3];
+      mom->tsum4 += s[4];
+      mom->tentries += n;
+   }
+   else if ( nin > 0 )
+   {
+      for ( i=0; i<n; i++ )
+      {
+         double x1, x2;
+         if ( !(value[i] >= mom->lower_limit && value[i] < mom->upper_limit) )
+            continue;
+         x1 = value[i] * ((weight != NULL) ? weight[i] : 1.);
+         x2 = x1*value[i];
+         mom->tsum  += x1;
+         mom->tsum2 += x2;
+         mom->tsum3 += x2*value[i];
+         mom->tsum4 += x2*value[i]*value[i];
+      }
+      mom->tentries += nin;
+   }
+   mom->level = 4;
+}
@@ -167,7 +167,13 @@ Options:
    --dst-file name (Name of output file for DST-type output.)
                    A DST file is needed for cleaning > 0 or DST level >= 0.
    --output-file   (Synonym to --dst-file)
+   --write-queue n (Write DST output from a separate thread, with up to n blocks queued.)
    --histogram-file name (Name of histogram file.)
+   --ntuple-file name (Name of file for the basic selection n-tuple.)
+                   Names ending in '.bnt' get a binary, column-chunked
+                   n-tuple, see list_ntuple. Otherwise the n-tuple is text.
+   --timing        (Report time spent per processing stage and data block type.)
+   --timing-json name (Also write that timing report as JSON to the named file.)
    -f fname        (Get list of input file names from fname.)
 
 Parameters followed by a '*' can be type-specific if preceded by a
@@ -201,6 +207,7 @@ Parameters followed by a '*' can be type-specific if preceded by a
 #include "basic_ntuple.h"
 #include "io_trgmask.h"
 #include "eventio_version.h"
+#include "stage_timing.h"
 #ifdef WITH_RANDFLAT
 #include "rndm2.h"
 #endif
@@ -609,7 +616,15 @@ static void syntax (char *program)
    printf("   --dst-file name (Name of output file for DST-type output.)\n");
    printf("                   A DST file is needed for cleaning > 0 or DST level >= 0.\n");
    printf("   --output-file   (Synonym to --dst-file)\n");
+#ifdef _REENTRANT
+   printf("   --write-queue n (Write DST output from a separate thread, with up to n blocks queued.)\n");
+#endif
    printf("   --histogram-file name (Name of histogram file.)\n");
+   printf("   --ntuple-file name (Name of file for the basic selection n-tuple.)\n");
+   printf("                   Names ending in '.bnt' get a binary, column-chunked\n");
+   printf("                   n-tuple, see list_ntuple. Otherwise the n-tuple is text.\n");
+   printf("   --timing        (Report time spent per processing stage and data block type.)\n");
+   printf("   --timing-json name (Also write that timing report as JSON to the named file.)\n");
 #ifdef CHECK_MISSING_PE_LIST
    printf("   --check-missing-pe-list (Check if any p.e. lists are missing.)\n");
 #endif
@@ -747,6 +762,7 @@ int main (int argc, char **argv)
    int flag_amp_tm = 0;
    size_t num_only = 0, num_not = 0;
    FILE *ntuple_file = NULL;
+   struct ntuple_file *ntuple_bin = NULL;
    double oa_range[2] = { 0., 90. };
    int diffuse_mode = 0;
 #ifdef CHECK_MISSING_PE_LIST
@@ -797,6 +813,8 @@ int main (int argc, char **argv)
    NextFile *next_file = &first_file;
    static RangeList only_runs = { 0, 0, NULL }, not_runs = { -1, -1, NULL };
    int skip_run = 0;
+   int write_queue = 0;
+   const char *timing_json = NULL;
    int show_type_sum = 0, ntypes = 0;
    int auto_trgmask = 0;
    struct trgmask_set *tms = NULL;
@@ -1183,6 +1201,13 @@ int main (int argc, char **argv)
 	 argv += 2;
 	 continue;
       }
+      else if ( strcmp(argv[1],"--write-queue") == 0 && argc > 2 )
+      {
+       	 write_queue = atoi(argv[2]);
+	 argc -= 2;
+	 argv += 2;
+	 continue;
+      }
       else if ( strcmp(argv[1],"--dst-process") == 0 )
       {
          /* In normal data, the configuration for every telescope
@@ -1199,7 +1224,14 @@ int main (int argc, char **argv)
       }
       else if ( strcmp(argv[1],"--ntuple-file") == 0 && argc > 2 )
       {
-       	 ntuple_file = fileopen(argv[2],"w");
+         size_t l = strlen(argv[2]);
+         if ( l > 4 && strcmp(argv[2]+l-4,".bnt") == 0 )
+         {
+            if ( (ntuple_bin = open_ntuple_output(argv[2],1,1)) == NULL )
+               exit(1);
+         }
+         else
+       	    ntuple_file = fileopen(argv[2],"w");
 	 argc -= 2;
 	 argv += 2;
 	 continue;
@@ -1211,6 +1243,21 @@ int main (int argc, char **argv)
 	 argv += 2;
 	 continue;
       }
+      else if ( strcmp(argv[1],"--timing") == 0 )
+      {
+         stage_timing_enable(1);
+	 argc--;
+	 argv++;
+	 continue;
+      }
+      else if ( strcmp(argv[1],"--timing-json") == 0 && argc > 2 )
+      {
+         timing_json = argv[2];
+         stage_timing_enable(1);
+	 argc -= 2;
+	 argv += 2;
+	 continue;
+      }
       else if ( strcmp(argv[1],"--powerlaw") == 0 && argc > 2 )
       {
        	 plidx = atof(argv[2]);
@@ -2132,6 +2179,8 @@ int main (int argc, char **argv)
       }
       else
          printf("DST output file opened: %s\n", dst_fname);
+      if ( write_queue > 0 && set_async_output(iobuf,write_queue,0) != 0 )
+         fprintf(stderr,"Asynchronous output not available, writing DST data synchronously.\n");
       if ( (dst_level%10) >= 2 && dst_level < 100 )
       {
          double xl = -0.5, xh = 6.5;
@@ -2157,6 +2206,7 @@ int main (int argc, char **argv)
          fill_histogram(h,4.,0.,tailcut_high);
          fill_histogram(h,5.,0.,min_pix);
          fill_histogram(h,6.,0.,reco_flag);
+         flush_async_output(iobuf); /* Same output stream as iobuf */
          write_histograms(&h,1,iobuf2);
       }
       /* Save the command line history */
@@ -2367,6 +2417,8 @@ int main (int argc, char **argv)
 
       /* Find and read the next block of data. */
       /* In case of problems with the data, just give up. */
+      stage_timing_block_done();
+      stage_timing_begin(STAGE_INPUT);
       if ( find_io_block(iobuf,&item_header) != 0 )
          break;
       if ( max_events > 0 && events >= max_events )
@@ -2379,6 +2431,9 @@ int main (int argc, char **argv)
       }
       if ( read_io_block(iobuf,&item_header) != 0 )
          break;
+      stage_timing_end(STAGE_INPUT);
+      stage_timing_block(item_header.type,
+         item_header.length + (item_header.use_extension ? 20 : 16));
 
       if ( hsdata == NULL && !skip_run &&
            item_header.type > IO_TYPE_HESS_RUNHEADER &&
@@ -2412,6 +2467,7 @@ int main (int argc, char **argv)
       if ( cleaning > 0 || (dst_level >= 0 && dst_level <= 3) ||
            (dst_level >= 10 && dst_level <= 13) || dst_level >= 100 ) /* DST-type data extraction */
       {
+         stage_timing_begin(STAGE_OUTPUT);
          if ( dst_level == 0 || dst_level == 1 || dst_level == 100 ) /* Everything copied verbatim except event data */
          {
             if ( (int) item_header.type != IO_TYPE_HESS_EVENT &&
@@ -2492,6 +2548,7 @@ int main (int argc, char **argv)
             fprintf(stderr,"Unsupported DST level %d\n",dst_level);
             exit(1);
          }
+         stage_timing_end(STAGE_OUTPUT);
       }
 
       /* What did we actually get? */
@@ -2876,7 +2933,9 @@ int main (int argc, char **argv)
                continue;
             if ( hsdata->mc_shower.energy < min_true_energy )
                continue;
+            stage_timing_begin(STAGE_DECODE);
             rc = read_hess_event(iobuf,&hsdata->event,-1);
+            stage_timing_end(STAGE_DECODE);
 	    if ( verbose || rc != 0 )
                printf("read_hess_event(), rc = %d\n",rc);
             events++;
@@ -3266,6 +3325,7 @@ int main (int argc, char **argv)
                     (last_event_selected = user_selected_event()) != 0 ) ||
                   dst_level >= 100 )
             {
+               stage_timing_begin(STAGE_OUTPUT);
                if ( dst_level != 100 && !no_mc_data )
                {
                   if ( mc_shower_stored == 0 && dst_level > 1 )
@@ -3297,6 +3357,7 @@ int main (int argc, char **argv)
                      mc_pe_sum_stored = 1;
                   }
                }
+               stage_timing_end(STAGE_OUTPUT);
 
                if ( dst_level >= 0 )
                {
@@ -3359,6 +3420,7 @@ int main (int argc, char **argv)
                         hsdata->event.teldata[itel].raw->zero_sup_mode = zero_suppression & 0x1f;
                      }
                }
+               stage_timing_begin(STAGE_OUTPUT);
                if ( dst_level == 0 )
                   rc = write_hess_event(iobuf,&hsdata->event,-1 ^ RAWDATA_FLAG );
                else if ( dst_level == 10 || cleaning > 0 || dst_level >= 100 )
@@ -3366,6 +3428,7 @@ int main (int argc, char **argv)
                else
                   rc = write_hess_event(iobuf,&hsdata->event,
                         -1 ^ (RAWDATA_FLAG|RAWSUM_FLAG|TIME_FLAG|TRACKDATA_FLAG));
+               stage_timing_end(STAGE_OUTPUT);
                if ( rc != 0 )
                {
                   fprintf(stderr,"Writing of event data failed (rc=%d).\n", rc);
@@ -3373,10 +3436,14 @@ int main (int argc, char **argv)
                }
             }
 
-            if ( ntuple_file != NULL && hsdata->event.shower.known && 
+            if ( (ntuple_file != NULL || ntuple_bin != NULL) && 
+                 hsdata->event.shower.known && 
                  bnt.n_img >= 2 && bnt.lg_e > -3. )
             {
-               list_ntuple(ntuple_file,&bnt,1);
+               if ( ntuple_bin != NULL )
+                  write_ntuple(ntuple_bin,&bnt);
+               else
+                  list_ntuple(ntuple_file,&bnt,1);
             }
             break;
 
@@ -3641,7 +3708,10 @@ int main (int argc, char **argv)
             if ( user_ana )
                do_user_ana(hsdata,item_header.type,0);
             if ( (dst_level%10) >= 2 )
+            {
+               flush_async_output(iobuf);
                write_dst_histos(iobuf2);
+            }
             break;
 
          /* =================================================== */
@@ -3797,7 +3867,10 @@ int main (int argc, char **argv)
 
     /* If the RUNSTAT block was missing we should still record our stats. */
     if ( (dst_level%10) >= 2 )
+    {
+       flush_async_output(iobuf);
        write_dst_histos(iobuf2);
+    }
 
     if ( hsdata != NULL )
        hsdata->run_header.run = 0;
@@ -3808,7 +3881,9 @@ int main (int argc, char **argv)
    if ( user_ana && hsdata != NULL )
       do_user_ana(hsdata,0,1);
 
-   /* Close output files or pipes. */
+   /* Close output files or pipes, after any queued output is written. */
+   if ( iobuf != NULL )
+      set_async_output(iobuf,0,0);
    if ( iobuf2 != NULL && iobuf != NULL && 
         iobuf2->output_file != NULL && 
         iobuf2->output_file != iobuf->output_file )
@@ -3817,6 +3892,15 @@ int main (int argc, char **argv)
       fileclose(iobuf->output_file);
    if ( ntuple_file != NULL )
       fileclose(ntuple_file);
+   if ( ntuple_bin != NULL && close_ntuple(ntuple_bin) != 0 )
+      fprintf(stderr,"Error writing the binary n-tuple file.\n");
+
+   if ( stage_timing_enabled )
+   {
+      stage_timing_summary(stdout);
+      if ( timing_json != NULL && stage_timing_json(timing_json) != 0 )
+         fprintf(stderr,"Writing timing report to %s failed.\n", timing_json);
+   }
 
    if ( iobuf2 != NULL )
    {
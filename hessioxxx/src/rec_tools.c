@@ -248,6 +248,109 @@ void cam_to_ref (double ximg, double yimg, double phi,
    *phiref = phi + cam_rot + (dphi2-dphi1); 
 }
 
+/* =================== cam_to_ref_n ====================== */
+/**
+ *  @short Transform images of several telescopes to the common reference frame.
+ *
+ *  Same as cam_to_ref() for each of the n images, with
+ *  the trigonometric functions of the reference direction evaluated
+ *  once and those of telescope altitude and camera rotation
+ *  re-used as long as they are the same as for the preceding image
+ *  (as usual for an array pointing in one direction).
+ *  Results are identical to those of cam_to_ref().
+*/
+
+void cam_to_ref_n (int n, const double *ximg, const double *yimg, 
+   const double *phi, double ref_azimuth, double ref_altitude, 
+   const double *cam_rot, const double *azimuth, const double *altitude,
+   const double *focal_length, double *axref, double *ayref, double *phiref)
+{
+   double cx_ref = sin(ref_altitude), sx_ref = cos(ref_altitude);
+   double cx = 0., sx = 0., alt_last = 0.;
+   double c = 1., s = 0., rot_last = 0.;
+   int i, have_alt = 0, have_rot = 0;
+
+   for ( i=0; i<n; i++ )
+   {
+      double ximg_rot, yimg_rot, azm_img, alt_img, dphi1, dphi2;
+      double xp0, yp0, zp0, xp1, yp1, zp1;
+
+      if ( fabs(cam_rot[i]) > 1e-14 )
+      {
+         if ( !have_rot || cam_rot[i] != rot_last )
+         {
+            c = cos(cam_rot[i]);
+            s = sin(cam_rot[i]);
+            rot_last = cam_rot[i];
+            have_rot = 1;
+         }
+         ximg_rot = ximg[i]*c + yimg[i]*s;
+         yimg_rot = yimg[i]*c - ximg[i]*s;
+      }
+      else
+      {
+         ximg_rot = ximg[i];
+         yimg_rot = yimg[i];
+      }
+
+      /* As in offset_to_angles() */
+      if ( ximg_rot == 0. && yimg_rot == 0. )
+      {
+         azm_img = azimuth[i];
+         alt_img = altitude[i];
+      }
+      else
+      {
+         double d = sqrt(ximg_rot*ximg_rot+yimg_rot*yimg_rot);
+         double q = atan(d/focal_length[i]);
+         double sq = sin(q);
+         if ( !have_alt || altitude[i] != alt_last )
+         {
+            cx = sin(altitude[i]);
+            sx = cos(altitude[i]);
+            alt_last = altitude[i];
+            have_alt = 1;
+         }
+         xp1 = ximg_rot * (sq/d);
+         yp1 = yimg_rot * (sq/d);
+         zp1 = cos(q);
+         xp0 = cx*xp1 - sx*zp1;
+         yp0 = yp1;
+         zp0 = sx*xp1 + cx*zp1;
+         alt_img = asin(zp0);
+         azm_img = atan2(yp0,-xp0) + azimuth[i];
+         if ( azm_img < 0. )
+            azm_img += 2.*M_PI;
+         else if ( azm_img >= (2.*M_PI ) )
+            azm_img -= 2.*M_PI;
+      }
+      dphi1 = -atan(tan(azm_img-azimuth[i])*sin(alt_img));
+
+      /* As in angles_to_offset(), with unit focal length */
+      {
+         double daz = azm_img - ref_azimuth;
+         double coa = cos(alt_img);
+         xp0 = -cos(daz) * coa;
+         yp0 = sin(daz) * coa;
+         zp0 = sin(alt_img);
+         xp1 = cx_ref*xp0 + sx_ref*zp0;
+         yp1 = yp0;
+         zp1 = -sx_ref*xp0 + cx_ref*zp0;
+         if ( xp1 == 0 && yp1 == 0 )
+            axref[i] = ayref[i] = 0.;
+         else
+         {
+            double sc = 1.0 / zp1;
+            axref[i] = sc * xp1;
+            ayref[i] = sc * yp1;
+         }
+      }
+      dphi2 = -atan(tan(azm_img-ref_azimuth)*sin(alt_img));
+
+      phiref[i] = phi[i] + cam_rot[i] + (dphi2-dphi1);
+   }
+}
+
 /* =================== intersect_lines ====================== */
 /**
  *  @short Intersect pairs of lines.
@@ -326,16 +429,84 @@ int intersect_lines (double xp1, double yp1, double phi1,
    return 1;
 }
 
-#ifndef MAX_TEL
-# ifdef H_MAX_TEL
-#  define MAX_TEL H_MAX_TEL
-# else
-#  define MAX_TEL 100
-# endif
-#endif
-
 static inline double square(double a) { return a*a; }
 
+#define WT_DISP 1
+
+/** Number of telescope pairs handled per block in sum_intersections(). */
+#define REC_PAIR_BLOCK 16
+
+/** Up to this number of telescopes, work space is taken from the stack. */
+#define REC_STACK_TEL 64
+
+static void sum_intersections (int i, const double *x, const double *y,
+   const double *s, const double *c, const double *h, const double *a,
+   const double *f, const unsigned char *use, double sum[5]);
+
+/**
+ *  @short Weighted sums of the intersections of line i with lines 0 to i-1.
+ *
+ *  The lines are given in Hesse normal form (s,-c,h) with h = y*c-x*s
+ *  for a line through (x,y) at an angle with sine s and cosine c.
+ *  Intersection points and weights are evaluated without branches
+ *  in blocks of REC_PAIR_BLOCK pairs, which compilers can vectorize,
+ *  and then summed up in the same order as one pair after the other.
+ *  The intersections are the same as from intersect_lines() and the
+ *  sine of the intersection angle is |A1*B2-A2*B1| instead of the
+ *  equivalent sin(acos(...)), thus results only differ by rounding.
+ *  Pairs with use[j]==0, parallel lines and coincident points
+ *  get zero weight, as they are skipped in the pair-by-pair loop.
+*/
+
+static void sum_intersections (int i, const double *x, const double *y,
+   const double *s, const double *c, const double *h, const double *a,
+   const double *f, const unsigned char *use, double sum[5])
+{
+   double bxs[REC_PAIR_BLOCK], bys[REC_PAIR_BLOCK], bw[REC_PAIR_BLOCK];
+   double si = s[i], ci = c[i], hi = h[i], ai = a[i], fi = f[i];
+   double xi = x[i], yi = y[i];
+   int j0, j, nb;
+
+   for ( j0=0; j0<i; j0+=REC_PAIR_BLOCK )
+   {
+      nb = (i-j0 < REC_PAIR_BLOCK) ? i-j0 : REC_PAIR_BLOCK;
+      for ( j=0; j<nb; j++ )
+      {
+         int k = j0+j;
+         double det_ab = si*(-c[k]) - s[k]*(-ci);
+         double det_bc = (-ci)*h[k] - (-c[k])*hi;
+         double det_ca = hi*s[k] - h[k]*si;
+         int ok = (fabs(det_ab) >= 1e-14);
+         double xs = ok ? det_bc / (ok ? det_ab : 1.) : 0.;
+         double ys = ok ? det_ca / (ok ? det_ab : 1.) : 0.;
+         double dx1 = xs-xi, dy1 = ys-yi, dx2 = xs-x[k], dy2 = ys-y[k];
+         int degenerate = ((dx1 == 0. && dy1 == 0.) || (dx2 == 0. && dy2 == 0.));
+#ifdef WT_DISP
+         /* "Reduced amplitude" like reduced mass in celestial dynamics,
+            with lower weight for round images, low amplitude on low
+            amplitude, and again on small intersection angles. */
+         double amp_red = (ai*a[k])/(ai+a[k]);
+         double w = square(amp_red * fabs(det_ab) * fi * f[k]);
+#else
+         double w = (ai<a[k]?ai:a[k]) * fabs(det_ab); /* Old style */
+#endif
+         bxs[j] = xs;
+         bys[j] = ys;
+         bw[j] = (ok && use[k] && !degenerate) ? w : 0.;
+      }
+      for ( j=0; j<nb; j++ )
+      {
+         if ( bw[j] == 0. )
+            continue;
+         sum[0] += bxs[j] * bw[j];
+         sum[1] += bxs[j]*bxs[j] * bw[j];
+         sum[2] += bys[j] * bw[j];
+         sum[3] += bys[j]*bys[j] * bw[j];
+         sum[4] += bw[j];
+      }
+   }
+}
+
 /* ================ shower_geometric_reconstruction ================ */
 /**
  *  @short Simple reconstruction by intersecting pairs of lines.
@@ -348,6 +519,8 @@ static inline double square(double a) { return a*a; }
  *  calculated.
  *  This should sooner or later be superceded by a fit procedure
  *  taking advantage of estimated errors on image positions and angles.
+ *  There is no limit on the number of telescopes, the work space
+ *  is allocated as needed for large numbers.
  *
  *  @param ntel   The number of telescopes with suitable images.
  *  @param amp    The image amplitudes in each suitable telescope [p.e.].
@@ -392,11 +565,15 @@ int shower_geometric_reconstruction (int ntel,
    double *shower_az, double *shower_alt, double *var_dir,
    double *xc, double *yc, double *var_core)
 {
-   double xang[MAX_TEL], yang[MAX_TEL], aphi[MAX_TEL];
-   double xt[MAX_TEL], yt[MAX_TEL];
-   double xs, ys, sa, w, xh, yh, zh;
-   double sum_xs = 0., sum_ys = 0., sum_w = 0., sum_xs2 = 0., sum_ys2 = 0.;
-   int itel, jtel;
+   double stack_buf[9*REC_STACK_TEL];
+   unsigned char stack_use[2*REC_STACK_TEL];
+   double *buf = stack_buf;
+   unsigned char *use = stack_use, *all;
+   double *xang, *yang, *aphi, *xt, *yt, *s, *c, *h, *f;
+   double xs, ys, xh, yh, zh;
+   double sum[5];
+   double sum_xs, sum_ys, sum_w, sum_xs2, sum_ys2;
+   int itel, rc = 2;
    double trans[3][3];
    
    if ( ntel < 2 )
@@ -404,65 +581,63 @@ int shower_geometric_reconstruction (int ntel,
       fprintf(stderr,"Not enough images.\n");
       return 0;
    }
-   else if ( ntel > MAX_TEL )
+   if ( ntel > REC_STACK_TEL )
    {
-      fprintf(stderr,"Too many images, current limit is %d.", MAX_TEL);
-      return 0;
+      if ( (buf = (double *) malloc(9*ntel*sizeof(double))) == NULL ||
+           (use = (unsigned char *) malloc(2*ntel)) == NULL )
+      {
+         fprintf(stderr,"Not enough memory for %d images.\n", ntel);
+         free(buf);
+         return 0;
+      }
    }
+   /* Structure-of-arrays work space */
+   xang = buf;
+   yang = xang + ntel;
+   aphi = yang + ntel;
+   xt   = aphi + ntel;
+   yt   = xt + ntel;
+   s    = yt + ntel;
+   c    = s + ntel;
+   h    = c + ntel;
+   f    = h + ntel;
+   all  = use + ntel;
    
    /* Convert positions of images to a common reference frame. */
+   cam_to_ref_n(ntel, ximg, yimg, phi, ref_az, ref_alt,
+      cam_rot, az, alt, flen, xang, yang, aphi);
+   /* Note: at this point the angles are only corrected for */
+   /* camera rotation but not for imaging errors. */
+
    for ( itel=0; itel<ntel; itel++ )
    {
-      xang[itel] = yang[itel] = aphi[itel] = 0.;
-      if ( amp[itel] <= 10. )
-      	 continue;
-      cam_to_ref(ximg[itel], yimg[itel], phi[itel], ref_az, ref_alt,
-      	 cam_rot[itel], az[itel], alt[itel], flen[itel],
-      	 &xang[itel], &yang[itel], &aphi[itel]);
-
-      /* Note: at this point the angles are only corrected for */
-      /* camera rotation but not for imaging errors. */
+      use[itel] = (amp[itel] > 10.);
+      all[itel] = 1;
+      if ( !use[itel] )
+         xang[itel] = yang[itel] = aphi[itel] = 0.;
+      s[itel] = sin(aphi[itel]);
+      c[itel] = cos(aphi[itel]);
+      h[itel] = yang[itel]*c[itel] - xang[itel]*s[itel];
+      f[itel] = (disp != NULL) ? disp[itel] : 1.0;
    }
-   sum_xs = sum_ys = sum_w = 0.;
+
+   sum[0] = sum[1] = sum[2] = sum[3] = sum[4] = 0.;
    for ( itel=0; itel<ntel; itel++ )
    {
-      double amp_red;
-      if ( amp[itel] <= 10. )
-      	 continue;
-      for ( jtel=0; jtel<itel; jtel++ )
-      {
-	 if ( amp[jtel] <= 10. )
-      	    continue;
-         /* Do the lines have an intersection point? */
-         if ( intersect_lines(xang[itel],yang[itel],aphi[itel],
-               xang[jtel],yang[jtel],aphi[jtel],
-               &xs, &ys, &sa) != 1 )
-            continue;
-         /* "Reduced amplitude" like reduced mass in celestial dynamics. */
-         amp_red = (amp[itel]*amp[jtel])/(amp[itel]+amp[jtel]);
-#define WT_DISP 1
-#ifdef WT_DISP
-         /* New: lower weight for round images, low amplitude on low
-            amplitude, and again on small intersection angles. */
-         /* FIXME: We might also want to use the NSB rates where different
-            telescope types are involved. */
-         if ( disp != NULL )
-            w = square(amp_red * sin(sa) * disp[itel] * disp[jtel]);
-         else
-            w = square(amp_red * sin(sa));
-#else
-         w = (amp[itel]<amp[jtel]?amp[itel]:amp[jtel]) * sin(sa); /* Old style */
-#endif
-         sum_xs += xs * w;
-         sum_xs2+= xs*xs * w;
-         sum_ys += ys * w;
-         sum_ys2+= ys*ys * w;
-         sum_w  += w;
-      }
+      if ( use[itel] )
+         sum_intersections(itel, xang, yang, s, c, h, amp, f, use, sum);
    }
+   sum_xs  = sum[0];
+   sum_xs2 = sum[1];
+   sum_ys  = sum[2];
+   sum_ys2 = sum[3];
+   sum_w   = sum[4];
 
    if ( fabs(sum_w) < 1e-10 )
-      return -1;
+   {
+      rc = -1;
+      goto done;
+   }
 
    /* Weighted average of intersection points. */
    sum_xs /= sum_w;
@@ -503,38 +678,23 @@ int shower_geometric_reconstruction (int ntel,
       /* Given some assumption on the distance to the shower maximum, */
       /* e.g. 10 km/cos(z), we could also try a central projection */
       /* by calculating the intersection (x,y) at z=0. */
+      h[itel] = yt[itel]*c[itel] - xt[itel]*s[itel];
    }
    
-   sum_xs = sum_ys = sum_w = sum_xs2 = sum_ys2 = 0.;
+   sum[0] = sum[1] = sum[2] = sum[3] = sum[4] = 0.;
    for ( itel=0; itel<ntel; itel++ )
-      for ( jtel=0; jtel<itel; jtel++ )
-      {
-         double amp_red;
-         /* Do the lines have an intersection point? */
-         if ( intersect_lines(xt[itel],yt[itel],aphi[itel],
-               xt[jtel],yt[jtel],aphi[jtel],
-               &xs, &ys, &sa) != 1 )
-            continue;
-
-         /* Weighting of intersection point of pair of lines. */
-         amp_red = (amp[itel]*amp[jtel])/(amp[itel]+amp[jtel]);
-#ifdef WT_DISP
-         if ( disp != NULL )
-            w = square(amp_red * sin(sa) * disp[itel] * disp[jtel]);
-         else
-            w = square(amp_red * sin(sa));
-#else
-         w = (amp[itel]<amp[jtel]?amp[itel]:amp[jtel]) * sin(sa); /* Old style */
-#endif
-         sum_xs += xs * w;
-         sum_xs2+= xs*xs * w;
-         sum_ys += ys * w;
-         sum_ys2+= ys*ys * w;
-         sum_w  += w;
-      }
+      sum_intersections(itel, xt, yt, s, c, h, amp, f, all, sum);
+   sum_xs  = sum[0];
+   sum_xs2 = sum[1];
+   sum_ys  = sum[2];
+   sum_ys2 = sum[3];
+   sum_w   = sum[4];
 
    if ( sum_w == 0. )
-      return 1;
+   {
+      rc = 1;
+      goto done;
+   }
 
    /* Reverse transformation matrix is just transposed but z!=0 */
    xs = sum_xs / sum_w;
@@ -559,7 +719,13 @@ int shower_geometric_reconstruction (int ntel,
          *var_core = 0.;
    }
 
-   return 2;
+done:
+   if ( buf != stack_buf )
+   {
+      free(buf);
+      free(use);
+   }
+   return rc;
 }
 
 /* ==================== angle_between ====================== */
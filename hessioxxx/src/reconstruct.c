@@ -29,6 +29,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "rec_tools.h"
 #include "reconstruct.h"
 #include "user_analysis.h"
+#include "histogram.h"
+#include "stage_timing.h"
+#include "argsort.h"
 #ifdef WITH_RANDFLAT
 #include "rndm2.h"
 #endif
@@ -360,9 +363,11 @@ static int find_neighbours(CameraSettings *camset, int itel);
 
 static int find_neighbours(CameraSettings *camset, int itel)
 {
-   int nb[3][H_MAX_PIX][H_MAX_NB];  ///< Temporary neighbour lists for one telescope.
-   int xt[H_MAX_PIX][H_MAX_NB];
-   int nnb[3][H_MAX_PIX], nxt[H_MAX_PIX];
+   /* Temporary neighbour lists for one telescope, static since far too */
+   /* large for the stack with big cameras (like with CTA_MAX_SC). */
+   static int nb[3][H_MAX_PIX][H_MAX_NB];
+   static int xt[H_MAX_PIX][H_MAX_NB];
+   static int nnb[3][H_MAX_PIX], nxt[H_MAX_PIX];
    int ntot[3], ntxt;
    double r2[3] = { 1.0, 0., 0. }, rxt2 = 0.;
    int ttype = which_telescope_type(camset);
@@ -756,14 +761,18 @@ int calibrate_amplitude(AllHessData *hsdata, int itel,
       with_tm = 1;
    }
    
-   for (i=0; i<npix; i++)
+   /* Pixels without data were reset above; in sparse mode they can be skipped. */
+   for (j=0; j<(raw->sparse ? raw->num_sig : npix); j++)
    {
       double npe, npe_hg=0., sig_hg;
 #if ( H_MAX_GAINS >= 2 )
       double npe_lg=0., sig_lg;
 #endif
+      int significant;
 
-      int significant = raw->significant[i];
+      if ( (i = ADC_PIX_LOOP_ID(raw,j)) >= npix )
+         continue;
+      significant = raw->significant[i];
       int hg_known = (no_high_gain && raw->num_gains > 1) ? 0 : raw->adc_known[HI_GAIN][i];
 #if ( H_MAX_GAINS >= 2 )
       int lg_known = ((raw->num_gains>=2 && !no_low_gain) ? raw->adc_known[LO_GAIN][i] : 0);
@@ -1154,7 +1163,7 @@ static int simple_integration(AllHessData *hsdata, int itel, int nsum, int nskip
 
 static int simple_integration(AllHessData *hsdata, int itel, int nsum, int nskip)
 {
-   int isamp, ipix, igain;
+   int isamp, ipix, jpix, igain;
    TelEvent *teldata = NULL;
    AdcData *raw;
    TelMoniData *moni;
@@ -1183,8 +1192,9 @@ static int simple_integration(AllHessData *hsdata, int itel, int nsum, int nskip
    }
    for (igain=0; igain<raw->num_gains; igain++)
    {
-      for (ipix=0; ipix<raw->num_pixels; ipix++)
+      for (jpix=0; jpix<ADC_PIX_LOOP_SIZE(raw); jpix++)
       {
+         ipix = ADC_PIX_LOOP_ID(raw,jpix);
          /* For zero-suppressed sample mode data check relevant bit */
          if ( (raw->zero_sup_mode & 0x20) != 0 && (raw->significant[ipix] & 0x020) == 0 )
             raw->adc_sum[igain][ipix] = 0;
@@ -1236,7 +1246,7 @@ static int global_peak_integration(AllHessData *hsdata, int itel, int nsum, int
 
 static int global_peak_integration(AllHessData *hsdata, int itel, int nsum, int nbefore, int *sigamp)
 {
-   int isamp, ipix, igain;
+   int isamp, ipix, jpix, igain;
    TelEvent *teldata = NULL;
    AdcData *raw;
    TelMoniData *moni;
@@ -1262,8 +1272,9 @@ static int global_peak_integration(AllHessData *hsdata, int itel, int nsum, int
    {
       int peakpos = -1, start = 0;
       npeaks = 0;
-      for (ipix=0; ipix<raw->num_pixels; ipix++)
+      for (jpix=0; jpix<ADC_PIX_LOOP_SIZE(raw); jpix++)
       {
+         ipix = ADC_PIX_LOOP_ID(raw,jpix);
          raw->adc_sum[igain][ipix] = 0;
          /* For zero-suppressed sample mode data check relevant bit */
          if ( (raw->zero_sup_mode & 0x20) != 0 && (raw->significant[ipix] & 0x020) == 0 )
@@ -1337,8 +1348,9 @@ printf("** Event %d, telescope %d: npeaks=%d, peakpos = %d, start = %d, correcti
 hsdata->event.central.glob_count,
 teldata->tel_id, npeaks, peakpos, start, integration_correction[itel][0]);
 #endif
-      for (ipix=0; ipix<raw->num_pixels; ipix++)
+      for (jpix=0; jpix<ADC_PIX_LOOP_SIZE(raw); jpix++)
       {
+         ipix = ADC_PIX_LOOP_ID(raw,jpix);
          /* For zero-suppressed sample mode data check relevant bit */
          if ( (raw->zero_sup_mode & 0x20) != 0 && (raw->significant[ipix] & 0x020) == 0 )
             raw->adc_sum[igain][ipix] = 0;
@@ -1390,7 +1402,7 @@ static int local_peak_integration(AllHessData *hsdata, int itel, int nsum, int n
 
 static int local_peak_integration(AllHessData *hsdata, int itel, int nsum, int nbefore, int *sigamp)
 {
-   int isamp, ipix, igain;
+   int isamp, ipix, jpix, igain;
    TelEvent *teldata = NULL;
    AdcData *raw;
    TelMoniData *moni;
@@ -1413,8 +1425,9 @@ static int local_peak_integration(AllHessData *hsdata, int itel, int nsum, int n
       nsum = raw->num_samples;
    }
 
-   for (ipix=0; ipix<raw->num_pixels; ipix++)
+   for (jpix=0; jpix<ADC_PIX_LOOP_SIZE(raw); jpix++)
    {
+      ipix = ADC_PIX_LOOP_ID(raw,jpix);
       for (igain=0; igain<raw->num_gains; igain++)
          raw->adc_sum[igain][ipix] = 0;
       /* For zero-suppressed sample mode data check relevant bit */
@@ -1553,7 +1566,7 @@ static int nb_peak_integration(AllHessData *hsdata, int lwt, int itel, int nsum,
 
 static int nb_peak_integration(AllHessData *hsdata, int lwt, int itel, int nsum, int nbefore, int *sigamp)
 {
-   int isamp, ipix, igain, ipeak, p;
+   int isamp, ipix, jpix, igain, ipeak, p;
    TelEvent *teldata = NULL;
    AdcData *raw;
    TelMoniData *moni;
@@ -1588,8 +1601,9 @@ static int nb_peak_integration(AllHessData *hsdata, int lwt, int itel, int nsum,
       return -1;
    nbl = &nb_lists[itel][0];
 
-   for (ipix=0; ipix<raw->num_pixels; ipix++)
+   for (jpix=0; jpix<ADC_PIX_LOOP_SIZE(raw); jpix++)
    {
+      ipix = ADC_PIX_LOOP_ID(raw,jpix);
       int nb_samples[H_MAX_SLICES], inb, knb=0;
       for (igain=0; igain<raw->num_gains; igain++)
          raw->adc_sum[igain][ipix] = 0;
@@ -1942,7 +1956,7 @@ static int nb_fc_shaped_peak_integration(AllHessData *hsdata, int itel, int nsum
 
 static int nb_fc_shaped_peak_integration(AllHessData *hsdata, int itel, int nsum, int nbefore, int *sigamp, int psopt, int ithr)
 {
-   int isamp, ipix, igain, ipeak;
+   int isamp, ipix, jpix, igain, ipeak;
    TelEvent *teldata = NULL;
    AdcData *raw;
    TelMoniData *moni;
@@ -2036,8 +2050,9 @@ static int nb_fc_shaped_peak_integration(AllHessData *hsdata, int itel, int nsum
       double bpx0[4*H_MAX_SLICES], bpx1[4*H_MAX_SLICES];
       uint16_t *smp;
 
-      for ( ipix=0; ipix<raw->num_pixels; ipix++ )
+      for ( jpix=0; jpix<ADC_PIX_LOOP_SIZE(raw); jpix++ )
       {
+         ipix = ADC_PIX_LOOP_ID(raw,jpix);
          /* Initialize pulse sum to (sum) pedestal in case of any 'continue' statement ... */
          raw->adc_sum[igain][ipix] = (uint32_t) (moni->pedestal[igain][ipix]+0.5);
 
@@ -2814,6 +2829,11 @@ printf("Pixel integration for telescope #%d\n",itel);
 static int clean_image_tailcut(AllHessData *hsdata, int itel, 
    double al, double ah, int lref, double minfrac);
 
+/** Up to this number of image pixels, their amplitudes and order
+    for the minimum fraction of the reference amplitude are kept
+    on the stack in clean_image_tailcut(). */
+#define CLEAN_STACK 1024
+
 static int clean_image_tailcut(AllHessData *hsdata, int itel, 
    double al, double ah, int lref, double minfrac)
 {
@@ -2884,44 +2904,51 @@ static int clean_image_tailcut(AllHessData *hsdata, int itel,
    }
 
    /* If a minimum fraction of the amplitude of the n-th hottest pixel */
-   /* is required, we sort the pixels by amplitude first. */
+   /* is required, only pixels above that are kept, sorted by amplitude. */
    if ( lref > 0 && lref < image_numpix[itel] && minfrac > 0. )
    {
-      int j;
-      double refamp;
-      for (i=0; i<image_numpix[itel]; i++)
+      int n = image_numpix[itel], nkeep = 0;
+      double minamp;
+      double amp_buf[CLEAN_STACK], *clean_amp = amp_buf;
+      int order_buf[CLEAN_STACK], *clean_order = order_buf;
+
+      if ( n > CLEAN_STACK &&
+           (clean_amp = (double *) malloc((size_t)n*(sizeof(double)+sizeof(int)))) != NULL )
+         clean_order = (int *) (clean_amp + n);
+      if ( clean_amp != NULL )
+         for (i=0; i<n; i++)
+            clean_amp[i] = pixel_amp[itel][image_list[itel][i]];
+      /* The lref hottest pixels first, for the reference amplitude. */
+      if ( clean_amp == NULL || dtopk(clean_amp,n,lref,clean_order) != lref )
+         nkeep = -1;
+      else
       {
-         for (j=i+1; j<image_numpix[itel]; j++)
-         {
-            int ipix = teldata->image_pixels.pixel_list[i];
-            int jpix = teldata->image_pixels.pixel_list[j];
-            if ( pixel_amp[itel][jpix] > pixel_amp[itel][ipix] )
-            {
-               teldata->image_pixels.pixel_list[i] = jpix;
-               teldata->image_pixels.pixel_list[j] = ipix;
-            }
-         }
+         minamp = minfrac * clean_amp[clean_order[lref-1]];
+         for (i=0; i<n; i++)
+            if ( clean_amp[i] >= minamp )
+               nkeep++;
+         /* The lref hottest pixels are kept in any case (if minfrac > 1). */
+         if ( nkeep < lref )
+            nkeep = lref;
+         nkeep = dtopk(clean_amp,n,nkeep,clean_order);
       }
-      refamp = pixel_amp[itel][teldata->image_pixels.pixel_list[lref-1]];
-      for ( i=lref; i<image_numpix[itel]; i++ )
+      if ( nkeep < 0 ) /* Not enough memory for sorting */
       {
-         int ipix = teldata->image_pixels.pixel_list[i];
-         if ( pixel_amp[itel][ipix] < minfrac*refamp )
-         {
-#if 0
-int k;
-printf("\nSorted pixel list with");
-for (k=0; k<image_numpix[itel]; k++)
-{
-   int kpix = teldata->image_pixels.pixel_list[k];
-   printf(" %f",pixel_amp[itel][kpix]);
-}
-printf(" gets truncated after %d hottest pixels.\n", i);
-#endif
-            image_numpix[itel] = i;
-            break;
-         }
+         if ( clean_amp != amp_buf )
+            free(clean_amp);
+         image_numpix[itel] = 0;
+         teldata->image_pixels.pixels = 0;
+         return -1;
       }
+      /* Keep the image list consistent with the sorted pixel list,
+         such that the image parameters use the pixels actually kept. */
+      for (i=0; i<nkeep; i++)
+         teldata->image_pixels.pixel_list[i] = image_list[itel][clean_order[i]];
+      for (i=0; i<nkeep; i++)
+         image_list[itel][i] = teldata->image_pixels.pixel_list[i];
+      if ( clean_amp != amp_buf )
+         free(clean_amp);
+      image_numpix[itel] = nkeep;
    }
 
    teldata->image_pixels.pixels = image_numpix[itel];
@@ -2929,6 +2956,76 @@ printf(" gets truncated after %d hottest pixels.\n", i);
    return 0;
 }
 
+/* ------------------------- image_moments_soa --------------------------- */
+
+/** Type used for accumulating first and second image moments.
+    Compiling with -DHILLAS_FLOAT_SUMS accumulates in single precision,
+    doubling the vector width. Since the sums are taken with respect to
+    the brightest pixel, width and length then still agree with the
+    double precision results to a relative accuracy of about 1e-5
+    (and absolute 1e-6 deg) for images of up to a few thousand pixels,
+    which is well below any systematic uncertainty of the parameters.
+    In double precision the results agree to within 1e-11 relative. */
+#ifdef HILLAS_FLOAT_SUMS
+typedef float hillas_sum_t;
+# define HILLAS_FMA(a,b,c) MOMENTS_FMAF(a,b,c)
+#else
+typedef double hillas_sum_t;
+# define HILLAS_FMA(a,b,c) MOMENTS_FMA(a,b,c)
+#endif
+
+/** Up to this number of image pixels, the contiguous copies of the
+    image in second_moments() are kept on the stack. */
+#define SOA_STACK 1024
+
+/** Sums of amplitude-weighted first and second powers of pixel
+    positions relative to (x0,y0), all in one pass:
+    s[0]=sum(A*x), s[1]=sum(A*y), s[2]=sum(A*x*x), s[3]=sum(A*x*y), s[4]=sum(A*y*y).
+    Four partial sums of each are kept for vectorisation. */
+
+void image_moments_soa(const double *x, const double *y, const double *a,
+   int n, double x0, double y0, double *s)
+{
+   hillas_sum_t px[4] = {0,0,0,0}, py[4] = {0,0,0,0}, pxx[4] = {0,0,0,0},
+      pxy[4] = {0,0,0,0}, pyy[4] = {0,0,0,0};
+   hillas_sum_t fx0 = (hillas_sum_t) x0, fy0 = (hillas_sum_t) y0;
+   int j, k, n4 = n & ~3;
+
+   for ( j=0; j<n4; j+=4 )
+   {
+      for ( k=0; k<4; k++ )
+      {
+         hillas_sum_t xr = (hillas_sum_t) x[j+k] - fx0;
+         hillas_sum_t yr = (hillas_sum_t) y[j+k] - fy0;
+         hillas_sum_t ax = (hillas_sum_t) a[j+k] * xr;
+         hillas_sum_t ay = (hillas_sum_t) a[j+k] * yr;
+         px[k] += ax;
+         py[k] += ay;
+         pxx[k] = HILLAS_FMA(ax, xr, pxx[k]);
+         pxy[k] = HILLAS_FMA(ax, yr, pxy[k]);
+         pyy[k] = HILLAS_FMA(ay, yr, pyy[k]);
+      }
+   }
+   for ( ; j<n; j++ )
+   {
+      hillas_sum_t xr = (hillas_sum_t) x[j] - fx0;
+      hillas_sum_t yr = (hillas_sum_t) y[j] - fy0;
+      hillas_sum_t ax = (hillas_sum_t) a[j] * xr;
+      hillas_sum_t ay = (hillas_sum_t) a[j] * yr;
+      px[0] += ax;
+      py[0] += ay;
+      pxx[0] = HILLAS_FMA(ax, xr, pxx[0]);
+      pxy[0] = HILLAS_FMA(ax, yr, pxy[0]);
+      pyy[0] = HILLAS_FMA(ay, yr, pyy[0]);
+   }
+
+   s[0] = (double) ((px[0] + px[1]) + (px[2] + px[3]));
+   s[1] = (double) ((py[0] + py[1]) + (py[2] + py[3]));
+   s[2] = (double) ((pxx[0] + pxx[1]) + (pxx[2] + pxx[3]));
+   s[3] = (double) ((pxy[0] + pxy[1]) + (pxy[2] + pxy[3]));
+   s[4] = (double) ((pyy[0] + pyy[1]) + (pyy[2] + pyy[3]));
+}
+
 /* ---------------------------- second_moments ---------------------------- */
 
 /** Reconstruction of second moments parameters from cleaned image. */
@@ -2945,6 +3042,8 @@ static int second_moments(AllHessData *hsdata, int itel, int cut_id, int nimg, d
    int i, j;
    double dx = 0., dy = 0.; // Source offsets in camera
    double sx = 0.,sy = 0., sxx = 0., sxy = 0., syy = 0., sA = 0.;
+   double x0 = 0., y0 = 0., s[5];
+   int n;
    double img_scale = 180./M_PI/hsdata->camera_set[itel].flen;
    double a, b, sx3, sx4, beta, cb, sb;
    double alpha, distance, miss, width, length;
@@ -2956,6 +3055,9 @@ static int second_moments(AllHessData *hsdata, int itel, int cut_id, int nimg, d
    double stot=0.;
    int npix = hsdata->camera_set[itel].num_pixels;
    ImgData *img = NULL;
+   /* Contiguous copies of the cleaned image (positions, amplitudes, and
+      positions projected onto the major axis), gathered from the image list. */
+   double soa_buf[4*SOA_STACK], *soa_x, *soa_y, *soa_a, *soa_p;
 
    if ( itel < 0 || itel >= H_MAX_TEL )
       return -1;
@@ -2982,8 +3084,16 @@ static int second_moments(AllHessData *hsdata, int itel, int cut_id, int nimg, d
       for (i=0; i<npix; i++)
          stot += pixel_amp[itel][i];
 
-   if ( image_numpix[itel] < 2 ) // Minimum 2 pixels
+   if ( (n = image_numpix[itel]) < 2 ) // Minimum 2 pixels
+      return -1;
+
+   soa_x = soa_buf;
+   if ( n > SOA_STACK &&
+        (soa_x = (double *) malloc(4*(size_t)n*sizeof(double))) == NULL )
       return -1;
+   soa_y = soa_x + n;
+   soa_a = soa_y + n;
+   soa_p = soa_a + n;
 
    for (j=0; j<5; j++)
    {
@@ -2991,9 +3101,14 @@ static int second_moments(AllHessData *hsdata, int itel, int cut_id, int nimg, d
       hot_amp[j] = -1;
    }
 
-   for (j=0; j<image_numpix[itel]; j++)
+   /* Gather the cleaned image into contiguous arrays, summing up the
+      amplitude and finding the hottest pixels on the way. */
+   for (j=0; j<n; j++)
    {
       i = image_list[itel][j];
+      soa_x[j] = camset->xpix[i] - dx;
+      soa_y[j] = camset->ypix[i] - dy;
+      soa_a[j] = pixel_amp[itel][i];
       sA += pixel_amp[itel][i];
       if ( pixel_amp[itel][i] > hot_amp[4] )
       {
@@ -3014,25 +3129,27 @@ static int second_moments(AllHessData *hsdata, int itel, int cut_id, int nimg, d
    }
    
    if ( sA < 1. )
+   {
+      if ( soa_x != soa_buf )
+         free(soa_x);
       return -1;
+   }
 
-   for (j=0; j<image_numpix[itel]; j++)
+   /* First and second moments in one pass, taken relative to the
+      hottest pixel to avoid cancellation in the central moments. */
+   if ( hot_pixel[0] >= 0 )
    {
-      int ipix = image_list[itel][j];
-      double x = camset->xpix[ipix] - dx;
-      double y = camset->ypix[ipix] - dy;
-      double A = pixel_amp[itel][ipix];
-      sx  += (A * x);
-      sxx += (A * x) * x;
-      sxy += (A * x) * y;
-      sy  += (A * y);
-      syy += (A * y) * y;
-   }
-   sx /= sA;
-   sy /= sA;
-   sxx = sxx/sA - sx*sx;
-   sxy = sxy/sA - sx*sy; 
-   syy = syy/sA - sy*sy;
+      x0 = camset->xpix[hot_pixel[0]] - dx;
+      y0 = camset->ypix[hot_pixel[0]] - dy;
+   }
+   image_moments_soa(soa_x, soa_y, soa_a, n, x0, y0, s);
+   sx = s[0]/sA;
+   sy = s[1]/sA;
+   sxx = s[2]/sA - sx*sx;
+   sxy = s[3]/sA - sx*sy; 
+   syy = s[4]/sA - sy*sy;
+   sx += x0;
+   sy += y0;
    
    // if ( sxy != 0. )
    if ( fabs(sxy) > 1e-8*fabs(sxx) && fabs(sxy) > 1e-8*fabs(syy) )
@@ -3103,20 +3220,19 @@ static int second_moments(AllHessData *hsdata, int itel, int cut_id, int nimg, d
       ymean = rmean * sin(rphi);
    }
 
-   sxx = sx3 = sx4 = 0.;
-   for (j=0; j<image_numpix[itel]; j++)
+   /* Higher moments along the major axis, with the same kernel
+      as used for skewness and kurtosis in moments.c */
+   for (j=0; j<n; j++)
    {
-      int ipix = image_list[itel][j];
-      double x = camset->xpix[ipix] - dx;
-      double y = camset->ypix[ipix] - dy;
-      double A = pixel_amp[itel][ipix];
-      double xp;
-      xp =  cb*(x-sx) + sb*(y-sy);
+      soa_p[j] = cb*(soa_x[j]-sx) + sb*(soa_y[j]-sy);
       /* yp = -sb*(x-sx) + cb*(y-sy); */ /* Not used */
-      sxx += (A*xp) * xp;
-      sx3 += ((A*xp) * xp) * xp;
-      sx4 += (((A*xp) * xp) * xp) * xp;
    }
+   sum_weighted_powers(soa_p, soa_a, (size_t) n, s);
+   if ( soa_x != soa_buf )
+      free(soa_x);
+   sxx = s[2];
+   sx3 = s[3];
+   sx4 = s[4];
 
    if ( verbosity >= 0 )
    {
@@ -3417,20 +3533,38 @@ static int image_reconstruct(AllHessData *hsdata, int itel, int cut_id,
       nimg = 0;
    if ( teldata->raw != NULL && teldata->raw->known )
    {
+      int rc;
+      stage_timing_begin(STAGE_CALIBRATION);
       calibrate_amplitude(hsdata, itel, second_image_from_timing?0:flag_amp_tm, clip_amp);
-      if ( clean_image_tailcut(hsdata, itel, tcl, tch, lref, minfrac) < 0 )
+      stage_timing_end(STAGE_CALIBRATION);
+      stage_timing_begin(STAGE_CLEANING);
+      rc = clean_image_tailcut(hsdata, itel, tcl, tch, lref, minfrac);
+      stage_timing_end(STAGE_CLEANING);
+      if ( rc < 0 )
          return -1;
-      if ( second_moments(hsdata, itel, cut_id, nimg, clip_amp) < 0 )
+      stage_timing_begin(STAGE_IMAGE);
+      rc = second_moments(hsdata, itel, cut_id, nimg, clip_amp);
+      if ( rc >= 0 )
+         pixel_timing_analysis(hsdata,itel,nimg); /* Optional; may fail */
+      stage_timing_end(STAGE_IMAGE);
+      if ( rc < 0 )
          return -1;
-      pixel_timing_analysis(hsdata,itel,nimg); /* Optional; may fail */
 
       if ( second_image_from_timing && teldata->num_image_sets > 1) 
       /* We reconstruct both image types */
       {
+         stage_timing_begin(STAGE_CALIBRATION);
          calibrate_amplitude(hsdata, itel, flag_amp_tm==0?2:flag_amp_tm, clip_amp);
-         if ( clean_image_tailcut(hsdata, itel, tcl, tch, lref, minfrac) < 0 )
+         stage_timing_end(STAGE_CALIBRATION);
+         stage_timing_begin(STAGE_CLEANING);
+         rc = clean_image_tailcut(hsdata, itel, tcl, tch, lref, minfrac);
+         stage_timing_end(STAGE_CLEANING);
+         if ( rc < 0 )
             return -1;
-         if ( second_moments(hsdata, itel, 2, 1, clip_amp) < 0 )
+         stage_timing_begin(STAGE_IMAGE);
+         rc = second_moments(hsdata, itel, 2, 1, clip_amp);
+         stage_timing_end(STAGE_IMAGE);
+         if ( rc < 0 )
             return -1;
       }
 
@@ -3996,7 +4130,9 @@ printf("Reconstruct data\n");
                /* (Re-) summing pixel intensities, if samples available and integrator given: */
                if ( up->i.integrator > 0 )
                {
+                  stage_timing_begin(STAGE_INTEGRATION);
                   pixel_integration(hsdata, itel, up);
+                  stage_timing_end(STAGE_INTEGRATION);
                }
 
                /* (Re-) calculate Hillas parameters: */
@@ -4018,14 +4154,18 @@ printf("Reconstruct data\n");
                
                if ( clean_flag )
                {
+                  stage_timing_begin(STAGE_CLEANING);
                   clean_raw_data(hsdata, itel, clean_flag, tcl[itel], tch[itel], up);
+                  stage_timing_end(STAGE_CLEANING);
                }
             }
          }
       }
    }
 
+   stage_timing_begin(STAGE_SHOWER);
    shower_reconstruct(hsdata, min_amp, min_pix, cut_id);
+   stage_timing_end(STAGE_SHOWER);
 
    return 0;
 }
@@ -35,7 +35,16 @@ Options:
    --output-path d (Create output files in given directory instead of current.)
    --only-telescope[s] (Only data for the given telescopes IDs is written.)
    --not-telescope[s]  (No data for the given telescopes IDs is written.)
+   --max-open n    (Keep at most so many output files open at a time, default: 64.)
+   --writers n     (Number of writer threads, default: 4, 0: write from main thread.)
 @endverbatim
+ *
+ *  Data for the output files is queued per output and, if compiled
+ *  with -D_REENTRANT, written by a pool of writer threads. With many
+ *  telescopes, in particular with compressed output where each open
+ *  output file has its own compressor process, the least recently
+ *  used outputs get closed and later re-opened for appending, such
+ *  that no more than the '--max-open' number of files is open at a time.
  *
  *  @author  Konrad Bernloehr
  *  @date    @verbatim CVS $Date: 2017/05/16 12:31:52 $ @endverbatim
@@ -67,6 +76,9 @@ Options:
 #endif
 
 #include <signal.h>
+#ifdef _REENTRANT
+#include <pthread.h>
+#endif
 
 void stop_signal_function (int isig);
 
@@ -97,6 +109,443 @@ void stop_signal_function (int isig)
    signal(SIGTERM,SIG_DFL);
 }
 
+/* ====================================================================== */
+/*
+ *  Output fan-out: each data block is handed over to one of possibly
+ *  very many output files (several per telescope). Blocks are queued
+ *  per output and written by a pool of writer threads (if compiled
+ *  with -D_REENTRANT), so that one slow output (typically a compressor
+ *  pipe) does not hold up the others. Only a limited number of outputs
+ *  is kept open at any time. The least recently used one gets closed
+ *  when another one has to be opened and later gets re-opened in
+ *  append mode. Compressed outputs may then consist of several
+ *  concatenated compressed streams, which gzip, bzip2, xz, lz4, zstd
+ *  all decompress as one.
+ */
+
+/** A data block waiting to be written to one of the outputs. */
+struct split_block
+{
+   struct split_block *next;   /**< Next block in queue for the same output. */
+   size_t length;              /**< Number of bytes in block. */
+   unsigned char data[1];      /**< The block, as written by write_io_block(). */
+};
+
+/** One of the output files. */
+struct split_output
+{
+   char *fname;                /**< Name of the output file. */
+   FILE *f;                    /**< Output stream while open, NULL otherwise. */
+   int created;                /**< Opened before, re-open in append mode. */
+   int busy;                   /**< Being written, opened or closed by some thread. */
+   int ready;                  /**< Is in the list of outputs with pending data. */
+   struct split_block *first, *last; /**< Queue of blocks not yet written. */
+   struct split_output *next_ready;  /**< Next output with pending data. */
+   struct split_output *lru_prev, *lru_next; /**< Neighbours in list of open outputs. */
+   struct split_output *next;  /**< Next in list of all outputs. */
+};
+
+static struct split_output *all_outputs;   /**< All outputs for the current input file. */
+static struct split_output *lru_head, *lru_tail; /**< Most and least recently used open output. */
+static struct split_output *ready_head, *ready_tail; /**< Outputs with pending data. */
+static struct split_output *current_output; /**< Where write_io_block() output goes to. */
+static size_t num_open, max_open = 64;
+static size_t num_busy;
+static size_t queued_bytes;
+static int num_writers = 4;
+
+#ifdef _REENTRANT
+static size_t max_queued_bytes = 256*1024*1024; /**< Main thread waits beyond that. */
+static pthread_mutex_t out_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t out_work = PTHREAD_COND_INITIALIZER;  /**< Signals pending data to writers. */
+static pthread_cond_t out_done = PTHREAD_COND_INITIALIZER;  /**< Signals finished writing to main thread. */
+static pthread_t *writer_threads;
+static int writers_running, writers_stop;
+#endif
+
+static void out_lock (void);
+static void out_unlock (void);
+
+static void out_lock (void)
+{
+#ifdef _REENTRANT
+   pthread_mutex_lock(&out_mutex);
+#endif
+}
+
+static void out_unlock (void)
+{
+#ifdef _REENTRANT
+   pthread_mutex_unlock(&out_mutex);
+#endif
+}
+
+/* ---------------------------- lru_unlink ------------------------------ */
+/** Remove an open output from the LRU list. Call with lock held. */
+
+static void lru_unlink (struct split_output *o);
+
+static void lru_unlink (struct split_output *o)
+{
+   if ( o->lru_prev != NULL )
+      o->lru_prev->lru_next = o->lru_next;
+   else
+      lru_head = o->lru_next;
+   if ( o->lru_next != NULL )
+      o->lru_next->lru_prev = o->lru_prev;
+   else
+      lru_tail = o->lru_prev;
+   o->lru_prev = o->lru_next = NULL;
+}
+
+/* ----------------------------- lru_touch ------------------------------ */
+/** Make an open output the most recently used one. Call with lock held. */
+
+static void lru_touch (struct split_output *o);
+
+static void lru_touch (struct split_output *o)
+{
+   if ( lru_head == o )
+      return;
+   if ( o->lru_prev != NULL || o->lru_next != NULL || lru_tail == o )
+      lru_unlink(o);
+   o->lru_next = lru_head;
+   if ( lru_head != NULL )
+      lru_head->lru_prev = o;
+   lru_head = o;
+   if ( lru_tail == NULL )
+      lru_tail = o;
+}
+
+/* --------------------------- mark_ready ------------------------------- */
+/** 
+ *  Put an output with pending data into the list for the writers,
+ *  unless some thread is already working on it. Call with lock held.
+ */
+
+static void mark_ready (struct split_output *o);
+
+static void mark_ready (struct split_output *o)
+{
+   if ( o->busy || o->ready || o->first == NULL )
+      return;
+   o->ready = 1;
+   o->next_ready = NULL;
+   if ( ready_tail != NULL )
+      ready_tail->next_ready = o;
+   else
+      ready_head = o;
+   ready_tail = o;
+#ifdef _REENTRANT
+   pthread_cond_signal(&out_work);
+#endif
+}
+
+/* --------------------------- open_output ------------------------------ */
+/**
+ *  Open an output, after closing the least recently used other output
+ *  if the limit of open outputs is reached. The caller must have
+ *  marked the output as busy and must hold the lock, which gets
+ *  released while files are actually opened or closed.
+ */
+
+static void open_output (struct split_output *o);
+
+static void open_output (struct split_output *o)
+{
+   FILE *f;
+
+   while ( num_open >= max_open )
+   {
+      /* Outputs with pending data are not good candidates to be closed. */
+      struct split_output *v = lru_tail;
+      while ( v != NULL && (v->busy || v->ready) )
+         v = v->lru_prev;
+      if ( v == NULL )
+         break; /* All open outputs in use: the limit is exceeded for a moment. */
+      lru_unlink(v);
+      num_open--;
+      v->busy = 1;
+      num_busy++;
+      out_unlock();
+      fileclose(v->f);
+      out_lock();
+      v->f = NULL;
+      v->busy = 0;
+      num_busy--;
+      mark_ready(v);
+   }
+
+   num_open++;
+   out_unlock();
+   f = fileopen(o->fname, o->created ? "a" : "w");
+   out_lock();
+   if ( f == NULL )
+   {
+      perror(o->fname);
+      exit(1);
+   }
+   o->f = f;
+   o->created = 1;
+   lru_touch(o);
+}
+
+/* -------------------------- write_output ------------------------------ */
+/**
+ *  Write all blocks queued for an output. The caller must have marked
+ *  the output as busy and must hold the lock, which is released while
+ *  writing.
+ */
+
+static void write_output (struct split_output *o);
+
+static void write_output (struct split_output *o)
+{
+   struct split_block *b = o->first, *bn;
+   size_t nb = 0;
+
+   o->first = o->last = NULL;
+   if ( o->f == NULL )
+      open_output(o);
+   else
+      lru_touch(o);
+   out_unlock();
+
+   for ( ; b != NULL; b = bn )
+   {
+      bn = b->next;
+      if ( fwrite(b->data,1,b->length,o->f) != b->length )
+      {
+         perror(o->fname);
+         exit(1);
+      }
+      nb += b->length;
+      free(b);
+   }
+
+   out_lock();
+   queued_bytes -= nb;
+   o->busy = 0;
+   num_busy--;
+   mark_ready(o);
+#ifdef _REENTRANT
+   pthread_cond_broadcast(&out_done);
+#endif
+}
+
+#ifdef _REENTRANT
+/* -------------------------- writer_thread ----------------------------- */
+/** Writer threads take any output with pending data and write it. */
+
+static void *writer_thread (void *arg _UNUSED_);
+
+static void *writer_thread (void *arg _UNUSED_)
+{
+   out_lock();
+   for (;;)
+   {
+      struct split_output *o;
+      while ( ready_head == NULL && !writers_stop )
+         pthread_cond_wait(&out_work,&out_mutex);
+      if ( (o = ready_head) == NULL )
+         break;
+      if ( (ready_head = o->next_ready) == NULL )
+         ready_tail = NULL;
+      o->ready = 0;
+      o->busy = 1;
+      num_busy++;
+      write_output(o);
+   }
+   out_unlock();
+   return NULL;
+}
+#endif
+
+/* -------------------------- start_writers ----------------------------- */
+/** Start the pool of writer threads, if possible and requested. */
+
+static void start_writers (void);
+
+static void start_writers (void)
+{
+#ifdef _REENTRANT
+   int i;
+   if ( num_writers <= 0 )
+      return;
+   if ( (writer_threads = (pthread_t *) calloc(num_writers,sizeof(pthread_t))) == NULL )
+      return;
+   writers_stop = 0;
+   for ( i=0; i<num_writers; i++ )
+   {
+      if ( pthread_create(&writer_threads[i],NULL,writer_thread,NULL) != 0 )
+      {
+         Warning("Cannot create writer thread; writing from main thread instead.");
+         break;
+      }
+   }
+   writers_running = i;
+#endif
+}
+
+/* -------------------------- stop_writers ------------------------------ */
+/** Stop the writer threads after all pending data has been written. */
+
+static void stop_writers (void);
+
+static void stop_writers (void)
+{
+#ifdef _REENTRANT
+   int i;
+   if ( writer_threads == NULL )
+      return;
+   out_lock();
+   writers_stop = 1;
+   pthread_cond_broadcast(&out_work);
+   out_unlock();
+   for ( i=0; i<writers_running; i++ )
+      pthread_join(writer_threads[i],NULL);
+   free(writer_threads);
+   writer_threads = NULL;
+   writers_running = 0;
+#endif
+}
+
+/* --------------------------- add_output ------------------------------- */
+/**
+ *  Register a new output file. It is created right away as long as
+ *  the limit of open outputs is not reached, otherwise when it first
+ *  gets data (or at the latest when closing all outputs).
+ */
+
+static struct split_output *add_output (const char *fname);
+
+static struct split_output *add_output (const char *fname)
+{
+   struct split_output *o = (struct split_output *) calloc(1,sizeof(struct split_output));
+   if ( o == NULL || (o->fname = strdup(fname)) == NULL )
+   {
+      Warning("Not enough memory");
+      exit(1);
+   }
+   out_lock();
+   o->next = all_outputs;
+   all_outputs = o;
+   if ( num_open < max_open )
+   {
+      o->busy = 1;
+      num_busy++;
+      open_output(o);
+      o->busy = 0;
+      num_busy--;
+   }
+   out_unlock();
+   return o;
+}
+
+/* --------------------------- collect_block ---------------------------- */
+/**
+ *  User function of the I/O buffer, called by write_io_block() for
+ *  every complete data block to be written to the current output.
+ */
+
+static int collect_block (unsigned char *buffer, long length, int mode);
+
+static int collect_block (unsigned char *buffer, long length, int mode)
+{
+   struct split_output *o = current_output;
+   struct split_block *b;
+
+   if ( mode != 1 || o == NULL || length < 0 )
+      return -1;
+   if ( (b = (struct split_block *) malloc(sizeof(struct split_block)+length)) == NULL )
+   {
+      Warning("Not enough memory");
+      return -1;
+   }
+   b->next = NULL;
+   b->length = (size_t) length;
+   memcpy(b->data,buffer,b->length);
+
+   out_lock();
+#ifdef _REENTRANT
+   /* Do not let the queues grow without limits if the writers cannot keep up. */
+   while ( writers_running > 0 && queued_bytes > 0 &&
+           queued_bytes + b->length > max_queued_bytes )
+      pthread_cond_wait(&out_done,&out_mutex);
+#endif
+   if ( o->last != NULL )
+      o->last->next = b;
+   else
+      o->first = b;
+   o->last = b;
+   queued_bytes += b->length;
+#ifdef _REENTRANT
+   if ( writers_running > 0 )
+      mark_ready(o);
+   else
+#endif
+   if ( !o->busy )
+   {
+      /* No writer threads: write it out immediately. */
+      o->busy = 1;
+      num_busy++;
+      write_output(o);
+   }
+   out_unlock();
+
+   return 0;
+}
+
+/* --------------------------- select_output ---------------------------- */
+/**
+ *  Direct anything written with the I/O buffer to the given output.
+ *
+ *  @return 1 if there is an output, 0 if the data should not be written.
+ */
+
+static int select_output (IO_BUFFER *iobuf, struct split_output *o);
+
+static int select_output (IO_BUFFER *iobuf, struct split_output *o)
+{
+   iobuf->output_file = NULL;
+   iobuf->user_function = (o != NULL) ? collect_block : NULL;
+   current_output = o;
+   return (o != NULL);
+}
+
+/* ------------------------ close_all_outputs --------------------------- */
+/**
+ *  Wait until all queued data is written, then close all outputs
+ *  (creating any which have not been opened so far) and forget them.
+ */
+
+static void close_all_outputs (void);
+
+static void close_all_outputs (void)
+{
+   struct split_output *o, *on;
+
+   out_lock();
+#ifdef _REENTRANT
+   while ( ready_head != NULL || num_busy > 0 )
+      pthread_cond_wait(&out_done,&out_mutex);
+#endif
+   for ( o = all_outputs; o != NULL; o = on )
+   {
+      on = o->next;
+      if ( o->f == NULL && !o->created )
+         o->f = fileopen(o->fname,"w");
+      if ( o->f != NULL )
+         fileclose(o->f);
+      free(o->fname);
+      free(o);
+   }
+   all_outputs = lru_head = lru_tail = ready_head = ready_tail = NULL;
+   current_output = NULL;
+   num_open = 0;
+   out_unlock();
+}
+
 /** Show program syntax */
 
 static void syntax (char *program);
@@ -117,6 +566,10 @@ static void syntax (char *program)
    printf("   --output-path d (Create output files in given directory instead of current.)\n");
    printf("   --only-telescope[s] (Only data for the given telescopes IDs is written.)\n");
    printf("   --not-telescope[s]  (No data for the given telescopes IDs is written.)\n");
+   printf("   --max-open n    (Keep at most so many output files open at a time, default: %zu.)\n", max_open);
+#ifdef _REENTRANT
+   printf("   --writers n     (Number of writer threads, default: %d, 0: write from main thread.)\n", num_writers);
+#endif
 
    exit(1);
 }
@@ -141,8 +594,8 @@ int main (int argc, char **argv)
    char *program = argv[0];
    size_t events = 0, max_events = 0;
    int iarg;
-   static FILE *f_teldata[H_MAX_TEL], *f_telaux[H_MAX_TEL], *f_telaux2[H_MAX_TEL];
-   static FILE *f_mc = NULL, *f_head = NULL, *f_tail = NULL, *f_central = NULL;
+   static struct split_output *f_teldata[H_MAX_TEL], *f_telaux[H_MAX_TEL], *f_telaux2[H_MAX_TEL];
+   static struct split_output *f_mc = NULL, *f_head = NULL, *f_tail = NULL, *f_central = NULL;
    static int tel_used[H_MAX_TEL];
    size_t num_only = 0, num_not = 0;
    int only_telescope[H_MAX_TEL], not_telescope[H_MAX_TEL];
@@ -337,6 +790,21 @@ int main (int argc, char **argv)
 	 argv++;
 	 continue;
       }
+      else if ( strcmp(argv[1],"--max-open") == 0 && argc > 2 )
+      {
+         int n = atoi(argv[2]);
+       	 max_open = (n > 0) ? (size_t) n : 1;
+	 argc -= 2;
+	 argv += 2;
+	 continue;
+      }
+      else if ( strcmp(argv[1],"--writers") == 0 && argc > 2 )
+      {
+       	 num_writers = atoi(argv[2]);
+	 argc -= 2;
+	 argv += 2;
+	 continue;
+      }
       else if ( strcmp(argv[1],"--help") == 0 )
       {
         printf("\nhessio_extract_tel: Extract data to telescope-specific files.\n\n");
@@ -351,6 +819,8 @@ int main (int argc, char **argv)
         break;
    }
    
+   start_writers();
+
    /* Now go over rest of the command line */
    while ( argc > 1 || input_fname != NULL )
    {
@@ -407,45 +877,11 @@ int main (int argc, char **argv)
        continue;
     }
     
-    if ( f_head != NULL )
-    {
-       fileclose(f_head);
-       f_head = NULL;
-    }
-    if ( f_mc != NULL )
-    {
-       fileclose(f_mc);
-       f_mc = NULL;
-    }
-    if ( f_central != NULL )
-    {
-       fileclose(f_central);
-       f_central = NULL;
-    }
-    if ( f_tail != NULL )
-    {
-       fileclose(f_tail);
-       f_tail = NULL;
-    }
-    
+    /* Everything for the previous input file must be written out first. */
+    close_all_outputs();
+    f_head = f_mc = f_central = f_tail = NULL;
     for ( itel=0; itel<H_MAX_TEL; itel++ )
-    {
-       if ( f_telaux[itel] != NULL )
-       {
-          fileclose(f_telaux[itel]);
-          f_telaux[itel] = NULL;
-       }
-       if ( f_telaux2[itel] != NULL )
-       {
-          fileclose(f_telaux2[itel]);
-          f_telaux2[itel] = NULL;
-       }
-       if ( f_teldata[itel] != NULL )
-       {
-          fileclose(f_teldata[itel]);
-          f_teldata[itel] = NULL;
-       }
-    }
+       f_teldata[itel] = f_telaux[itel] = f_telaux2[itel] = NULL;
 
     if ( f_head == NULL )
     {
@@ -453,12 +889,8 @@ int main (int argc, char **argv)
        strcat(tmp_fname,tmp_fname_head);
        strcat(tmp_fname,".headers");
        strcat(tmp_fname,tmp_fname_tail);
-       if ( (f_head = fileopen(tmp_fname,"w")) == NULL )
-       {
-          perror(tmp_fname);
-          exit(1);
-       }
-       iobuf->output_file = f_head;
+       f_head = add_output(tmp_fname);
+       select_output(iobuf,f_head);
        write_history(0,iobuf);  /* Save the command line history */
     }
     if ( f_tail == NULL )
@@ -467,11 +899,7 @@ int main (int argc, char **argv)
        strcat(tmp_fname,tmp_fname_head);
        strcat(tmp_fname,".tail");
        strcat(tmp_fname,tmp_fname_tail);
-       if ( (f_tail = fileopen(tmp_fname,"w")) == NULL )
-       {
-          perror(tmp_fname);
-          exit(1);
-       }
+       f_tail = add_output(tmp_fname);
     }
     if ( f_mc == NULL )
     {
@@ -479,11 +907,7 @@ int main (int argc, char **argv)
        strcat(tmp_fname,tmp_fname_head);
        strcat(tmp_fname,".mc");
        strcat(tmp_fname,tmp_fname_tail);
-       if ( (f_mc = fileopen(tmp_fname,"w")) == NULL )
-       {
-          perror(tmp_fname);
-          exit(1);
-       }
+       f_mc = add_output(tmp_fname);
     }
     if ( f_central == NULL )
     {
@@ -491,11 +915,7 @@ int main (int argc, char **argv)
        strcat(tmp_fname,tmp_fname_head);
        strcat(tmp_fname,".central");
        strcat(tmp_fname,tmp_fname_tail);
-       if ( (f_central = fileopen(tmp_fname,"w")) == NULL )
-       {
-          perror(tmp_fname);
-          exit(1);
-       }
+       f_central = add_output(tmp_fname);
     }
 
     for (;;) /* Loop over all data in the input file */
@@ -505,6 +925,7 @@ int main (int argc, char **argv)
 
       /* Find and read the next block of data. */
       /* In case of problems with the data, just give up. */
+      select_output(iobuf,NULL); /* Output hook must not interfere with reading. */
       if ( find_io_block(iobuf,&item_header) != 0 )
          break;
       if ( max_events > 0 && events >= max_events )
@@ -534,7 +955,7 @@ int main (int argc, char **argv)
          case IO_TYPE_HESS_RUNHEADER:
             nev = ntrg = 0;
  
-            if ( (iobuf->output_file = f_head) != NULL )
+            if ( select_output(iobuf,f_head) )
             {
                write_io_block(iobuf);   /* Re-write the run header as is */
             }
@@ -610,11 +1031,7 @@ int main (int argc, char **argv)
                      strcat(tmp_fname,".teldata-");
                      strcat(tmp_fname,exn);
                      strcat(tmp_fname,tmp_fname_tail);
-                     if ( (f_teldata[itel] = fileopen(tmp_fname,"w")) == NULL )
-                     {
-                        perror(tmp_fname);
-                        exit(1);
-                     }
+                     f_teldata[itel] = add_output(tmp_fname);
                   }
                   if ( f_telaux[itel] == NULL )
                   {
@@ -623,11 +1040,7 @@ int main (int argc, char **argv)
                      strcat(tmp_fname,".telaux-");
                      strcat(tmp_fname,exn);
                      strcat(tmp_fname,tmp_fname_tail);
-                     if ( (f_telaux[itel] = fileopen(tmp_fname,"w")) == NULL )
-                     {
-                        perror(tmp_fname);
-                        exit(1);
-                     }
+                     f_telaux[itel] = add_output(tmp_fname);
                   }
                   if ( f_telaux2[itel] == NULL )
                   {
@@ -636,11 +1049,7 @@ int main (int argc, char **argv)
                      strcat(tmp_fname,".telaux2-");
                      strcat(tmp_fname,exn);
                      strcat(tmp_fname,tmp_fname_tail);
-                     if ( (f_telaux2[itel] = fileopen(tmp_fname,"w")) == NULL )
-                     {
-                        perror(tmp_fname);
-                        exit(1);
-                     }
+                     f_telaux2[itel] = add_output(tmp_fname);
                   }
                }
 
@@ -684,19 +1093,19 @@ int main (int argc, char **argv)
 
          /* =================================================== */
          case IO_TYPE_HESS_MCRUNHEADER:
-            if ( (iobuf->output_file = f_mc) != NULL )
+            if ( select_output(iobuf,f_mc) )
                write_io_block(iobuf);
             break;
 
          /* =================================================== */
 	 case IO_TYPE_MC_INPUTCFG:
-            if ( (iobuf->output_file = f_mc) != NULL )
+            if ( select_output(iobuf,f_mc) )
                write_io_block(iobuf);
             break;
 
          /* =================================================== */
          case 70: /* How sim_hessarray was run and how it was configured. */
-            if ( !clean_history && (iobuf->output_file = f_head) != NULL )
+            if ( !clean_history && select_output(iobuf,f_head) )
                write_io_block(iobuf);
             break;
 
@@ -711,7 +1120,7 @@ int main (int argc, char **argv)
                Warning(msg);
                exit(1);
             }
-            if ( (iobuf->output_file = f_telaux[itel]) != NULL )
+            if ( select_output(iobuf,f_telaux[itel]) )
                write_io_block(iobuf);
             break;
 
@@ -726,7 +1135,7 @@ int main (int argc, char **argv)
                Warning(msg);
                exit(1);
             }
-            if ( (iobuf->output_file = f_telaux[itel]) != NULL )
+            if ( select_output(iobuf,f_telaux[itel]) )
                write_io_block(iobuf);
             break;
 
@@ -741,7 +1150,7 @@ int main (int argc, char **argv)
                Warning(msg);
                exit(1);
             }
-            if ( (iobuf->output_file = f_telaux[itel]) != NULL )
+            if ( select_output(iobuf,f_telaux[itel]) )
                write_io_block(iobuf);
             break;
 
@@ -756,7 +1165,7 @@ int main (int argc, char **argv)
                Warning(msg);
                exit(1);
             }
-            if ( (iobuf->output_file = f_telaux2[itel]) != NULL )
+            if ( select_output(iobuf,f_telaux2[itel]) )
                write_io_block(iobuf);
             break;
 
@@ -771,7 +1180,7 @@ int main (int argc, char **argv)
                Warning(msg);
                exit(1);
             }
-            if ( (iobuf->output_file = f_telaux[itel]) != NULL )
+            if ( select_output(iobuf,f_telaux[itel]) )
                write_io_block(iobuf);
             break;
 
@@ -786,7 +1195,7 @@ int main (int argc, char **argv)
                Warning(msg);
                exit(1);
             }
-            if ( (iobuf->output_file = f_telaux[itel]) != NULL )
+            if ( select_output(iobuf,f_telaux[itel]) )
                write_io_block(iobuf);
             break;
 
@@ -801,7 +1210,7 @@ int main (int argc, char **argv)
                Warning(msg);
                exit(1);
             }
-            if ( (iobuf->output_file = f_telaux[itel]) != NULL )
+            if ( select_output(iobuf,f_telaux[itel]) )
                write_io_block(iobuf);
             break;
 
@@ -851,7 +1260,7 @@ int main (int argc, char **argv)
             if ( ntel_trg < min_tel_trg )
                continue;
             ntrg++;
-            if ( (iobuf->output_file = f_central) != NULL )
+            if ( select_output(iobuf,f_central) )
             {
                rc = write_hess_centralevent(iobuf,&hsdata->event.central);
             }
@@ -868,7 +1277,7 @@ int main (int argc, char **argv)
                      hsdata->event.teldata[itel].known = 1;
                      hsdata->event.trackdata[itel].raw_known = 1;
 
-                     if ( (iobuf->output_file = f_teldata[itel]) != NULL )
+                     if ( select_output(iobuf,f_teldata[itel]) )
                      {
                         if ( extract_televent == 1 )
                         {
@@ -906,25 +1315,25 @@ int main (int argc, char **argv)
 
          /* =================================================== */
          case IO_TYPE_HESS_CALIBEVENT:
-            if ( (iobuf->output_file = f_head) != NULL )
+            if ( select_output(iobuf,f_head) )
                write_io_block(iobuf);
             break;
 
          /* =================================================== */
          case IO_TYPE_HESS_MC_SHOWER:
-            if ( (iobuf->output_file = f_mc) != NULL )
+            if ( select_output(iobuf,f_mc) )
                write_io_block(iobuf);
             break;
 
          /* =================================================== */
          case IO_TYPE_HESS_MC_EVENT:
-            if ( (iobuf->output_file = f_mc) != NULL )
+            if ( select_output(iobuf,f_mc) )
                write_io_block(iobuf);
             break;
 
          /* =================================================== */
          case IO_TYPE_MC_TELARRAY:
-            if ( (iobuf->output_file = f_mc) != NULL )
+            if ( select_output(iobuf,f_mc) )
                write_io_block(iobuf);
             break;
 
@@ -933,7 +1342,7 @@ int main (int argc, char **argv)
             arriving at ground level would be stored as seemingly
             stray photon bunch block. */
          case IO_TYPE_MC_PHOTONS:
-            if ( (iobuf->output_file = f_mc) != NULL )
+            if ( select_output(iobuf,f_mc) )
                write_io_block(iobuf);
             break;
 
@@ -942,13 +1351,13 @@ int main (int argc, char **argv)
          case IO_TYPE_MC_EVTH:
          case IO_TYPE_MC_EVTE:
          case IO_TYPE_MC_RUNE:
-            if ( (iobuf->output_file = f_mc) != NULL )
+            if ( select_output(iobuf,f_mc) )
                write_io_block(iobuf);
             break;
 
          /* =================================================== */
          case IO_TYPE_HESS_MC_PE_SUM:
-            if ( (iobuf->output_file = f_mc) != NULL )
+            if ( select_output(iobuf,f_mc) )
                write_io_block(iobuf);
             break;
 
@@ -965,7 +1374,7 @@ int main (int argc, char **argv)
                Warning(msg);
                exit(1);
             }
-            if ( (iobuf->output_file = f_telaux2[itel]) != NULL )
+            if ( select_output(iobuf,f_telaux2[itel]) )
                write_io_block(iobuf);
            break;
 
@@ -980,25 +1389,25 @@ int main (int argc, char **argv)
                Warning(msg);
                exit(1);
             }
-            if ( (iobuf->output_file = f_telaux2[itel]) != NULL )
+            if ( select_output(iobuf,f_telaux2[itel]) )
                write_io_block(iobuf);
             break;
 
          /* =================================================== */
          case IO_TYPE_HESS_RUNSTAT:
-            if ( (iobuf->output_file = f_tail) != NULL )
+            if ( select_output(iobuf,f_tail) )
                write_io_block(iobuf);
             break;
 
          /* =================================================== */
          case IO_TYPE_HESS_MC_RUNSTAT:
-            if ( (iobuf->output_file = f_mc) != NULL )
+            if ( select_output(iobuf,f_mc) )
                write_io_block(iobuf);
             break;
 
          /* (End-of-job or DST) histograms */
          case 100:
-            if ( (iobuf->output_file = f_tail) != NULL )
+            if ( select_output(iobuf,f_tail) )
                write_io_block(iobuf);
             break;
 
@@ -1020,6 +1429,9 @@ int main (int argc, char **argv)
        hsdata->run_header.run = 0;
    }
 
+   close_all_outputs();
+   stop_writers();
+
    return 0;
 }
 
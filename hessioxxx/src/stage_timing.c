@@ -0,0 +1,305 @@
+/* ============================================================================
+
+Copyright (C) 2026  The pyhessio contributors
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+============================================================================ */
+
+/** @file stage_timing.c
+ *  @short Optional timing of processing stages and data block types.
+ *
+ *  Time spent in each processing stage is accumulated between
+ *  stage_timing_begin() and stage_timing_end(), using the monotonic
+ *  clock. In addition, the number of blocks, the number of bytes,
+ *  and the time for reading and for processing are accumulated per
+ *  data block type. Unless enabled, each of the macros costs no
+ *  more than testing a global flag.
+ *
+ *  Input from compressed files is decompressed by a separate process,
+ *  thus waiting for it is part of the input stage. The CPU time of
+ *  the program itself is shown separately in the summary.
+ */
+
+#include "initial.h"
+#include "io_basic.h"
+#include "stage_timing.h"
+#include <time.h>
+
+/** Global flag: timing is only done if non-zero. */
+int stage_timing_enabled = 0;
+
+static const char *stage_names[STAGE_NUM_STAGES] =
+   { "input", "decode", "integration", "calibration", "cleaning",
+     "image", "shower_reco", "user_ana", "dst_output" };
+
+static double stage_start[STAGE_NUM_STAGES];
+static double stage_total[STAGE_NUM_STAGES];
+static unsigned long stage_calls[STAGE_NUM_STAGES];
+
+/** Accumulated data per data block type. */
+struct block_timing
+{
+   unsigned long type;   /**< Data block type number. */
+   unsigned long count;  /**< Number of blocks of that type. */
+   double bytes;         /**< Total number of bytes in these blocks. */
+   double t_read;        /**< Time spent finding and reading these blocks. */
+   double t_proc;        /**< Time spent processing them (until the next block is searched). */
+};
+
+#define MAX_BLOCK_TIMING 128
+static struct block_timing block_timing[MAX_BLOCK_TIMING];
+static size_t num_block_timing;
+static struct block_timing *current_block;
+static double current_block_start, timing_start, cpu_start;
+
+/* -------------------------- stage_timing_now ---------------------------- */
+/** Monotonic clock reading in seconds. */
+
+static double stage_timing_now (void);
+
+static double stage_timing_now (void)
+{
+   struct timespec ts;
+#ifdef CLOCK_MONOTONIC
+   clock_gettime(CLOCK_MONOTONIC,&ts);
+#else
+   clock_gettime(CLOCK_REALTIME,&ts);
+#endif
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+/* -------------------------- stage_timing_enable ------------------------- */
+/**
+ *  Enable (or disable) timing. Enabling it (again) resets all counters.
+ */
+
+void stage_timing_enable (int on)
+{
+   if ( on )
+   {
+      memset(stage_total,0,sizeof(stage_total));
+      memset(stage_calls,0,sizeof(stage_calls));
+      num_block_timing = 0;
+      current_block = NULL;
+      timing_start = stage_timing_now();
+      cpu_start = (double) clock() / CLOCKS_PER_SEC;
+   }
+   stage_timing_enabled = on;
+}
+
+/* -------------------------- stage_timing_begin_ ------------------------- */
+/** Start timing of a stage. Use the stage_timing_begin() macro instead. */
+
+void stage_timing_begin_ (int stage)
+{
+   if ( stage >= 0 && stage < STAGE_NUM_STAGES )
+      stage_start[stage] = stage_timing_now();
+}
+
+/* --------------------------- stage_timing_end_ -------------------------- */
+/** Stop timing of a stage. Use the stage_timing_end() macro instead. */
+
+void stage_timing_end_ (int stage)
+{
+   if ( stage >= 0 && stage < STAGE_NUM_STAGES )
+   {
+      stage_total[stage] += stage_timing_now() - stage_start[stage];
+      stage_calls[stage]++;
+   }
+}
+
+/* -------------------------- stage_timing_block -------------------------- */
+/**
+ *  Account for a data block just read, including the time for
+ *  finding and reading it (the last input stage). Processing time
+ *  is then accumulated until stage_timing_block_done() is called.
+ *
+ *  @param type   The data block type.
+ *  @param length The data block length including its header.
+ */
+
+void stage_timing_block (unsigned long type, size_t length)
+{
+   struct block_timing *bt = current_block;
+   size_t i;
+
+   if ( !stage_timing_enabled )
+      return;
+   stage_timing_block_done();
+
+   if ( bt == NULL || bt->type != type )
+   {
+      for ( i=0, bt=NULL; i<num_block_timing; i++ )
+         if ( block_timing[i].type == type )
+         {
+            bt = &block_timing[i];
+            break;
+         }
+      if ( bt == NULL )
+      {
+         if ( num_block_timing >= MAX_BLOCK_TIMING )
+            return; /* Unlikely, but further types are then just not accounted. */
+         bt = &block_timing[num_block_timing++];
+         bt->type = type;
+      }
+   }
+   bt->count++;
+   bt->bytes += (double) length;
+   current_block_start = stage_timing_now();
+   /* The input stage just ended before this call. */
+   bt->t_read += current_block_start - stage_start[STAGE_INPUT];
+   current_block = bt;
+}
+
+/* ------------------------ stage_timing_block_done ----------------------- */
+/**
+ *  Processing of the current data block is finished.
+ */
+
+void stage_timing_block_done (void)
+{
+   if ( !stage_timing_enabled || current_block == NULL )
+      return;
+   current_block->t_proc += stage_timing_now() - current_block_start;
+   current_block = NULL;
+}
+
+/* -------------------------- stage_timing_total -------------------------- */
+/**
+ *  Accumulated time of one stage since timing was enabled.
+ *
+ *  @param stage  The stage in question.
+ *  @param calls  Optional pointer for the number of times it was timed.
+ *  @return Time in seconds.
+ */
+
+double stage_timing_total (int stage, unsigned long *calls)
+{
+   if ( stage < 0 || stage >= STAGE_NUM_STAGES )
+   {
+      if ( calls != NULL )
+         *calls = 0;
+      return 0.;
+   }
+   if ( calls != NULL )
+      *calls = stage_calls[stage];
+   return stage_total[stage];
+}
+
+/* ---------------------------- compare_blocks ---------------------------- */
+
+static int compare_blocks (const void *a, const void *b);
+
+static int compare_blocks (const void *a, const void *b)
+{
+   const struct block_timing *ba = (const struct block_timing *) a;
+   const struct block_timing *bb = (const struct block_timing *) b;
+   return (ba->type < bb->type) ? -1 : (ba->type > bb->type) ? 1 : 0;
+}
+
+/* -------------------------- stage_timing_summary ------------------------ */
+/**
+ *  Print a summary table of stages and data block types.
+ */
+
+void stage_timing_summary (FILE *f)
+{
+   double wall, cpu;
+   size_t i;
+   int is;
+
+   if ( !stage_timing_enabled || f == NULL )
+      return;
+   stage_timing_block_done();
+   wall = stage_timing_now() - timing_start;
+   cpu = (double) clock() / CLOCKS_PER_SEC - cpu_start;
+   if ( wall <= 0. )
+      wall = 1e-9;
+   qsort(block_timing,num_block_timing,sizeof(block_timing[0]),compare_blocks);
+
+   fprintf(f,"\nTiming summary: %.3f s elapsed, %.3f s CPU time used by this process.\n",
+      wall, cpu);
+   fprintf(f,"   %-14s %12s %12s %12s %7s\n", "Stage", "Calls", "Total [s]", "Mean [us]", "Share");
+   for ( is=0; is<STAGE_NUM_STAGES; is++ )
+   {
+      if ( stage_calls[is] == 0 )
+         continue;
+      fprintf(f,"   %-14s %12lu %12.4f %12.2f %6.2f%%\n",
+         stage_names[is], stage_calls[is], stage_total[is],
+         1e6*stage_total[is]/stage_calls[is], 100.*stage_total[is]/wall);
+   }
+   fprintf(f,"\n   %6s %-24s %10s %12s %10s %10s %10s\n",
+      "Type", "Name", "Blocks", "MBytes", "Read [s]", "MB/s", "Proc [s]");
+   for ( i=0; i<num_block_timing; i++ )
+   {
+      struct block_timing *bt = &block_timing[i];
+      const char *name = eventio_registered_typename(bt->type);
+      fprintf(f,"   %6lu %-24s %10lu %12.3f %10.4f %10.2f %10.4f\n",
+         bt->type, name != NULL ? name : "-", bt->count, 1e-6*bt->bytes,
+         bt->t_read, (bt->t_read > 0.) ? 1e-6*bt->bytes/bt->t_read : 0.,
+         bt->t_proc);
+   }
+   fprintf(f,"\n");
+}
+
+/* --------------------------- stage_timing_json -------------------------- */
+/**
+ *  Write the same information as in the summary to a JSON file.
+ *
+ *  @return 0 (O.k.), -1 (error)
+ */
+
+int stage_timing_json (const char *fname)
+{
+   FILE *f;
+   double wall, cpu;
+   size_t i;
+   int is, n;
+
+   if ( !stage_timing_enabled || fname == NULL )
+      return -1;
+   if ( (f = fopen(fname,"w")) == NULL )
+   {
+      perror(fname);
+      return -1;
+   }
+   stage_timing_block_done();
+   wall = stage_timing_now() - timing_start;
+   cpu = (double) clock() / CLOCKS_PER_SEC - cpu_start;
+   qsort(block_timing,num_block_timing,sizeof(block_timing[0]),compare_blocks);
+
+   fprintf(f,"{\n  \"wall_seconds\": %.6f,\n  \"cpu_seconds\": %.6f,\n", wall, cpu);
+   fprintf(f,"  \"stages\": [");
+   for ( is=0, n=0; is<STAGE_NUM_STAGES; is++ )
+   {
+      if ( stage_calls[is] == 0 )
+         continue;
+      fprintf(f,"%s\n    { \"name\": \"%s\", \"calls\": %lu, \"seconds\": %.6f }",
+         n++ ? "," : "", stage_names[is], stage_calls[is], stage_total[is]);
+   }
+   fprintf(f,"\n  ],\n  \"block_types\": [");
+   for ( i=0; i<num_block_timing; i++ )
+   {
+      struct block_timing *bt = &block_timing[i];
+      const char *name = eventio_registered_typename(bt->type);
+      fprintf(f,"%s\n    { \"type\": %lu, \"name\": \"%s\", \"count\": %lu, \"bytes\": %.0f,"
+         " \"read_seconds\": %.6f, \"process_seconds\": %.6f }",
+         i ? "," : "", bt->type, name != NULL ? name : "", bt->count, bt->bytes,
+         bt->t_read, bt->t_proc);
+   }
+   fprintf(f,"\n  ]\n}\n");
+
+   return fclose(f) == 0 ? 0 : -1;
+}
@@ -47,6 +47,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "atmprof.h"
 #include "straux.h"
 #include "basic_ntuple.h"
+#include "stage_timing.h"
 
 #define MAX_TEL_TYPES 10
 
@@ -1361,176 +1362,268 @@ static double expected_max_distance(double E, double theta, double height)
    return expected_max_height(E, theta, height) / cos(theta);
 }
 
-/* ------------------------  img_norm  -------------------------- */
+/* ------------------------  image lookups  -------------------------- */
+/*
+ *  The lookups generated by gen_lookup (mean and r.m.s. of width,
+ *  length and amplitude/energy versus core distance and log10(amplitude),
+ *  and of core and image distance versus width/length and log10(amplitude))
+ *  are copied after reading into dense grids per telescope type, with
+ *  all values needed for one image adjacent in memory. Once set up, the
+ *  grids are only read, such that any number of threads can share them.
+ */
+
+#define IMG_LUT_NPAR 6  /**< Mean and r.m.s. of width, length, energy scale */
+#define IMG_LUT_NPAR_O 4 /**< Mean and r.m.s. of core distance and image distance */
+
+/** Lookups of one telescope type in dense single-precision grids. */
+struct img_lut_type
+{
+   int nx, ny;       /**< Bins in core distance and in log10(amplitude) */
+   double rl, sx;    /**< Lower limit and bin size in core distance */
+   double al, sy;    /**< Lower limit and bin size in log10(amplitude) */
+   double rh, ah;    /**< Upper limits */
+   float *cell;      /**< nx*ny cells of IMG_LUT_NPAR values (wm, ws, lm, ls, em, es) */
+   int nxo;          /**< Bins in width/length or 0 if not available */
+   float *cell_o;    /**< nxo*ny cells of IMG_LUT_NPAR_O values (mean and r.m.s.
+                          of core distance and of image distance, r.m.s.
+                          negative where not available) */
+};
+
+/** Lookups of all telescope types. */
+struct img_lut
+{
+   struct img_lut_type type[MAX_TEL_TYPES+1];
+};
+
+/** Results of img_norm_n() for one image. */
+struct img_norm_result
+{
+   int status;    /**< 1: all results set; 0: outside lookup range; -1: no lookups. */
+   double scrw;   /**< Scaled reduced width (HESS style). */
+   double scrl;   /**< Scaled reduced length (HESS style). */
+   double scw;    /**< Scaled width (HEGRA style). */
+   double scl;    /**< Scaled length (HEGRA style). */
+   double sce;    /**< Expected energy [TeV] for the amplitude at the core distance. */
+   double scer;   /**< Relative fluctuation of energy/amplitude at this point. */
+   double rco;    /**< Expected core distance from width/length and amplitude. */
+   double rcor;   /**< Its error, or negative if not available. */
+   double dimgo;  /**< Expected image distance (as for rco). */
+   double dimgor; /**< Its error, or negative if not available. */
+};
+
+static struct img_lut *img_luts = NULL;
+
+static void free_img_lut (struct img_lut *lut);
+
+static void free_img_lut (struct img_lut *lut)
+{
+   int tt;
+   if ( lut == NULL )
+      return;
+   for ( tt=0; tt<=MAX_TEL_TYPES; tt++ )
+   {
+      free(lut->type[tt].cell);
+      free(lut->type[tt].cell_o);
+   }
+   free(lut);
+}
+
+/* ------------------------  build_img_lut  -------------------------- */
 /**
- *  @short Get scaled + reduced scaled image parameters (both HEGRA
- *         and HESS type scaling) as well as energy scaling from the
- *         lookups.
+ *  @short Set up the dense lookup grids from the lookup histograms
+ *         (as read from the gen_lookup output).
  *
- *  All variables for the results are optional. For variables which are
- *  of no interest, pass a NULL pointer.
+ *  Telescope types without the basic lookups (histograms 18113, 18114,
+ *  18123, 18124, 18153, 18154 plus 100000 times the type) remain unused.
  *
- *  @param w      Image width [rad].
- *  @param l      Image length [rad].
- *  @param A      Image amplitude [ peak p.e. ].
- *  @param lgA    log10(A)
- *  @param rc     Reconstructed core distance.
- *  @param tel_type Telescope type (for multiple lookups).
- *  @param scrw   Variable getting the scaled reduced width (HESS style).
- *  @param scrl   Variable getting the scaled reduced length (HESS style).
- *  @param scw    Variable getting the scaled width (HEGRA style).
- *  @param scl    Variable getting the scaled length (HEGRA style).
- *  @param sce    Variable getting the expected energy [TeV] for
- *                the given amplitude at the given core distance.
- *  @param scer   Variable getting the relative fluctuation of energy/amplitude at this point.
- *  @param rco    Variable getting the expected core distance based on width/length and amplitude.
- *  @param rcor   Variable getting the relative error in the core distance estimate.
- *  @param dimgo  Variable getting the expected distance in the image (as for rco).
- *  @param dimgor Variable getting the relative error in the image distance estimate.
+ *  @return Pointer to the new lookups or NULL if there are none at all.
  */
 
-static int img_norm (double w, double l, double A, double lgA, double rc,
-        int tel_type,
-	double *scrw, double *scrl, double *scw, double *scl,
-        double *sce, double *scer, 
-        double *rco, double *rcor, double *dimgo, double *dimgor);
-
-static int img_norm (double w, double l, double A, double lgA, double rc,
-        int tel_type,
-	double *scrw, double *scrl, double *scw, double *scl,
-        double *sce, double *scer, 
-        double *rco, double *rcor, double *dimgo, double *dimgor)
+static struct img_lut *build_img_lut (void);
+
+static struct img_lut *build_img_lut (void)
 {
-   static HISTOGRAM *h18113[MAX_TEL_TYPES+1], *h18114[MAX_TEL_TYPES+1], 
-      *h18123[MAX_TEL_TYPES+1], *h18124[MAX_TEL_TYPES+1], 
-      *h18153[MAX_TEL_TYPES+1], *h18154[MAX_TEL_TYPES+1];
-   static HISTOGRAM *h18173[MAX_TEL_TYPES+1], *h18174[MAX_TEL_TYPES+1], 
-      *h18183[MAX_TEL_TYPES+1], *h18184[MAX_TEL_TYPES+1];
-   static double rl, rh, al, ah;
-   static double sx, sy;
-   static int nx=0, ny=0, nxo=0;
-   int ix, iy, ixo;
-   double wm, lm, em, ws, ls, es;
-   double dom = 0., dos = 0., rom = 0., ros = 0., wol = 0.;
-
-   if ( l > 0. )
-      wol = w / l;
-
-   if ( h18113[0] == 0 && h18113[1] == 0 ) /* Initialization after booking */
+   static const int id_main[IMG_LUT_NPAR] = 
+      { 18113, 18114, 18123, 18124, 18153, 18154 };
+   static const int id_o[IMG_LUT_NPAR_O] = 
+      { 18173, 18174, 18183, 18184 };
+   struct img_lut *lut;
+   int tt, k, ix, iy, ntypes = 0;
+
+   if ( (lut = (struct img_lut *) calloc(1,sizeof(struct img_lut))) == NULL )
+      return NULL;
+
+   for ( tt = 0; tt <= MAX_TEL_TYPES; tt++ )
    {
-      int tt = 0;
-      for ( tt = 0; tt <= MAX_TEL_TYPES; tt++ )
+      struct img_lut_type *lt = &lut->type[tt];
+      HISTOGRAM *hm[IMG_LUT_NPAR], *ho[IMG_LUT_NPAR_O];
+      int ht = 100000 * tt, nxy;
+
+      for ( k=0; k<IMG_LUT_NPAR; k++ )
+         if ( (hm[k] = get_histogram_by_ident(ht+id_main[k])) == NULL ||
+              hm[k]->extension == NULL || hm[k]->extension->ddata == NULL ||
+              hm[k]->nbins != hm[0]->nbins || hm[k]->nbins_2d != hm[0]->nbins_2d )
+            break;
+      if ( k < IMG_LUT_NPAR )
+         continue;
+
+      lt->nx = hm[0]->nbins;
+      lt->ny = hm[0]->nbins_2d;
+      lt->rl = hm[0]->specific.real.lower_limit;
+      lt->rh = hm[0]->specific.real.upper_limit;
+      lt->al = hm[0]->specific_2d.real.lower_limit;
+      lt->ah = hm[0]->specific_2d.real.upper_limit;
+      lt->sx = (lt->rh-lt->rl) / lt->nx;
+      lt->sy = (lt->ah-lt->al) / lt->ny;
+      nxy = lt->nx * lt->ny;
+      if ( nxy <= 0 || 
+           (lt->cell = (float *) malloc(nxy*IMG_LUT_NPAR*sizeof(float))) == NULL )
       {
-         int ht = 100000 * tt;
-         if ( (h18113[tt] = get_histogram_by_ident(ht+18113)) == NULL ||
-              (h18114[tt] = get_histogram_by_ident(ht+18114)) == NULL ||
-              (h18123[tt] = get_histogram_by_ident(ht+18123)) == NULL ||
-              (h18124[tt] = get_histogram_by_ident(ht+18124)) == NULL ||
-              (h18153[tt] = get_histogram_by_ident(ht+18153)) == NULL ||
-              (h18154[tt] = get_histogram_by_ident(ht+18154)) == NULL )
-            continue;
-         h18173[tt] = get_histogram_by_ident(ht+18173);
-         h18174[tt] = get_histogram_by_ident(ht+18174);
-         h18183[tt] = get_histogram_by_ident(ht+18183);
-         h18184[tt] = get_histogram_by_ident(ht+18184);
-         if ( h18173[tt] != NULL )
+         lt->nx = lt->ny = 0;
+         continue;
+      }
+      for ( iy=0; iy<lt->ny; iy++ )
+         for ( ix=0; ix<lt->nx; ix++ )
          {
-            nxo = h18173[tt]->nbins;
+            float *c = lt->cell + (ix+lt->nx*iy)*IMG_LUT_NPAR;
+            for ( k=0; k<IMG_LUT_NPAR; k++ )
+               c[k] = (float) hm[k]->extension->ddata[ix+lt->nx*iy];
          }
-
-         rl = h18113[tt]->specific.real.lower_limit;
-         rh = h18113[tt]->specific.real.upper_limit;
-         al = h18113[tt]->specific_2d.real.lower_limit;
-         ah = h18113[tt]->specific_2d.real.upper_limit;
-         nx = h18113[tt]->nbins;
-         ny = h18113[tt]->nbins_2d;
-         sx = (rh-rl) / nx;
-         sy = (ah-al) / ny;
+      ntypes++;
+
+      /* The core/image distance lookups are optional, with bins in
+         width/length; rows are addressed with the stride of the
+         main lookups, as before. */
+      for ( k=0; k<IMG_LUT_NPAR_O; k++ )
+         if ( (ho[k] = get_histogram_by_ident(ht+id_o[k])) == NULL ||
+              ho[k]->extension == NULL || ho[k]->extension->ddata == NULL )
+            break;
+      if ( k < IMG_LUT_NPAR_O || ho[0]->nbins <= 0 )
+         continue;
+      lt->nxo = ho[0]->nbins;
+      if ( (lt->cell_o = (float *) 
+             malloc(lt->nxo*lt->ny*IMG_LUT_NPAR_O*sizeof(float))) == NULL )
+      {
+         lt->nxo = 0;
+         continue;
       }
+      for ( iy=0; iy<lt->ny; iy++ )
+         for ( ix=0; ix<lt->nxo; ix++ )
+         {
+            float *c = lt->cell_o + (ix+lt->nxo*iy)*IMG_LUT_NPAR_O;
+            double v[IMG_LUT_NPAR_O];
+            int ih = ix+lt->nx*iy;
+            for ( k=0; k<IMG_LUT_NPAR_O; k++ )
+               v[k] = (ih < ho[k]->nbins*ho[k]->nbins_2d) ?
+                  ho[k]->extension->ddata[ih] : 0.;
+            /* The r.m.s. is evaluated here in double precision, since
+               mean square minus squared mean may suffer from cancellation. */
+            c[0] = (float) v[0];
+            c[1] = (v[1] >= v[0]*v[0]) ? (float) sqrt(v[1]-v[0]*v[0]) : -1.f;
+            c[2] = (float) v[2];
+            c[3] = (v[3] >= v[2]*v[2]) ? (float) sqrt(v[3]-v[2]*v[2]) : -1.f;
+         }
    }
 
-   if ( tel_type < 0 || tel_type > MAX_TEL_TYPES || h18113[tel_type] == 0 )
-      return -1;
-
-   if ( lgA < al || lgA >= ah || rc < rl || rc >= rh )
-      return 0;
-   ix = (rc-rl) / sx;
-   iy = (lgA-al) / sy;
-   ixo= wol * nxo;
-   if ( ix < 0 || ix >= nx || iy < 0 || iy >= ny )
-      return 0;
-   wm = h18113[tel_type]->extension->ddata[ix+nx*iy];
-   ws = h18114[tel_type]->extension->ddata[ix+nx*iy];
-   lm = h18123[tel_type]->extension->ddata[ix+nx*iy];
-   ls = h18124[tel_type]->extension->ddata[ix+nx*iy];
-   em = h18153[tel_type]->extension->ddata[ix+nx*iy];
-   es = h18154[tel_type]->extension->ddata[ix+nx*iy];
-   if ( h18173[tel_type] != NULL && ixo >= 0 && ixo < nxo )
-   {
-      rom = h18173[tel_type]->extension->ddata[ixo+nx*iy];
-      ros = h18174[tel_type]->extension->ddata[ixo+nx*iy];
-      dom = h18183[tel_type]->extension->ddata[ixo+nx*iy];
-      dos = h18184[tel_type]->extension->ddata[ixo+nx*iy];
-   }
-   if ( scw != NULL )
-   {
-      if ( wm > 0. )
-         *scw = w / wm;
-      else
-         *scw = 999.;
-   }
-   if ( scl != NULL )
-   {
-      if ( lm > 0. )
-         *scl = l / lm;
-      else
-         *scl = 999.;
-   }
-   if ( scrw != NULL )
-   {
-      if ( wm > 0. && ws > 0. )
-         *scrw = (w-wm) / ws;
-      else
-         *scrw = 999.;
-   }
-   if ( scrl != NULL )
-   {
-      if ( lm > 0. && ls > 0. )
-         *scrl = (l-lm) / ls;
-      else
-         *scrl = 999.;
-   }
-   if ( sce != NULL )
+   if ( ntypes == 0 )
    {
-      if ( A > 0. && em > 0. )
-         *sce = A/em;
-      else
-         *sce = 0.;
-   }
-   if ( scer != NULL )
-   {
-      if ( em > 0. && es > 0. )
-         *scer = es/em;
-      else
-         *scer = 999.;
-   }
-   if ( rco != NULL )
-   {
-      *rco = rom;
-   }
-   if ( rcor != NULL && ros >= rom*rom )
-   {
-      *rcor = sqrt(ros-rom*rom);
-   }
-   if ( dimgo != NULL )
-   {
-      *dimgo = dom;
+      free_img_lut(lut);
+      return NULL;
    }
-   if ( dimgor != NULL && dos >= dom*dom )
+   return lut;
+}
+
+/* ------------------------  img_norm_n  -------------------------- */
+/**
+ *  @short Get scaled + reduced scaled image parameters (both HEGRA
+ *         and HESS type scaling) as well as energy scaling from the
+ *         lookups, for all images of an event in one call.
+ *
+ *  The lookup is by bin (no interpolation between bins). Since the
+ *  grids are in single precision, results may differ from those with
+ *  the double-precision histograms in the last few digits.
+ *  No static data is modified, such that several threads may call
+ *  this with the same lookups.
+ *
+ *  @param lut    Lookups as set up by build_img_lut() (may be NULL).
+ *  @param n      Number of images.
+ *  @param tel_type Telescope type of each image.
+ *  @param w      Image width [rad].
+ *  @param l      Image length [rad].
+ *  @param A      Image amplitude [ peak p.e. ].
+ *  @param rc     Reconstructed core distance.
+ *  @param res    Results for each image. Except for the status, 
+ *                results are only set if the status is 1.
+ */
+
+static void img_norm_n (const struct img_lut *lut, int n, const int *tel_type,
+   const double *w, const double *l, const double *A, const double *rc,
+   struct img_norm_result *res);
+
+static void img_norm_n (const struct img_lut *lut, int n, const int *tel_type,
+   const double *w, const double *l, const double *A, const double *rc,
+   struct img_norm_result *res)
+{
+   int i;
+
+   for ( i=0; i<n; i++ )
    {
-      *dimgor = sqrt(dos-dom*dom);
+      const struct img_lut_type *lt;
+      struct img_norm_result *r = &res[i];
+      const float *c;
+      double lgA = (A[i]>0.) ? log10(A[i]) : -999.;
+      double wol = (l[i] > 0.) ? w[i] / l[i] : 0.;
+      double wm, lm, em, ws, ls, es;
+      double dom = 0., dor = 0., rom = 0., ror = 0.;
+      int ix, iy, ixo;
+
+      if ( lut == NULL || tel_type[i] < 0 || tel_type[i] > MAX_TEL_TYPES || 
+           lut->type[tel_type[i]].cell == NULL )
+      {
+         r->status = -1;
+         continue;
+      }
+      lt = &lut->type[tel_type[i]];
+      if ( lgA < lt->al || lgA >= lt->ah || rc[i] < lt->rl || rc[i] >= lt->rh )
+      {
+         r->status = 0;
+         continue;
+      }
+      ix = (rc[i]-lt->rl) / lt->sx;
+      iy = (lgA-lt->al) / lt->sy;
+      ixo= wol * lt->nxo;
+      if ( ix < 0 || ix >= lt->nx || iy < 0 || iy >= lt->ny )
+      {
+         r->status = 0;
+         continue;
+      }
+      c = lt->cell + (ix+lt->nx*iy)*IMG_LUT_NPAR;
+      wm = c[0];
+      ws = c[1];
+      lm = c[2];
+      ls = c[3];
+      em = c[4];
+      es = c[5];
+      if ( lt->cell_o != NULL && ixo >= 0 && ixo < lt->nxo )
+      {
+         c = lt->cell_o + (ixo+lt->nxo*iy)*IMG_LUT_NPAR_O;
+         rom = c[0];
+         ror = c[1];
+         dom = c[2];
+         dor = c[3];
+      }
+      r->status = 1;
+      r->scw  = (wm > 0.) ? w[i] / wm : 999.;
+      r->scl  = (lm > 0.) ? l[i] / lm : 999.;
+      r->scrw = (wm > 0. && ws > 0.) ? (w[i]-wm) / ws : 999.;
+      r->scrl = (lm > 0. && ls > 0.) ? (l[i]-lm) / ls : 999.;
+      r->sce  = (A[i] > 0. && em > 0.) ? A[i]/em : 0.;
+      r->scer = (em > 0. && es > 0.) ? es/em : 999.;
+      r->rco  = rom;
+      r->rcor = ror;
+      r->dimgo = dom;
+      r->dimgor = dor;
    }
-   return 1;
 }
 
 /** Declare local (static) data here ... */
@@ -3043,6 +3136,9 @@ static void user_init (AllHessData *hsdata)
    else
    {
       printf("Lookups read from '%s'.\n", lookup_fname);
+      /* Dense copies of the lookups, shared read-only during analysis. */
+      free_img_lut(img_luts);
+      img_luts = build_img_lut();
       if ( up[0].i.user_flags == 0 ) /* not HESS-style */
       {
          int ires;
@@ -3179,6 +3275,7 @@ static void user_event_fill (AllHessData *hsdata, int stage)
    double v_dimg[H_MAX_TEL];               /**< distance of image c.o.g. to source [rad] */
    int img_ok[H_MAX_TEL];                  /**< Amplitude and edge distance are ok */
    int sc_ok[H_MAX_TEL];
+   struct img_norm_result v_nrm[H_MAX_TEL]; /**< Lookup results for each image */
    int alt_ok = 0;
    
    /* Example code: */
@@ -3200,6 +3297,8 @@ static void user_event_fill (AllHessData *hsdata, int stage)
       double tr2s = 0., mdisp = 0., tss = 0., tsw = 0.;
       double r_lc = 125., r_lc_max = -1.;
       int num_trg_type[11];
+      double b_scrw[H_MAX_TEL], b_scrl[H_MAX_TEL], b_wt[H_MAX_TEL]; /* Filled into 17500 */
+      size_t n_sr = 0;
       int ntp = sizeof(num_trg_type)/sizeof(num_trg_type[0]);
 
       static int have_atm_set = -1; /* For height to Xmax lookup */
@@ -3244,8 +3343,15 @@ static void user_event_fill (AllHessData *hsdata, int stage)
       if ( num_trg > 0 )
       {
          int itrg, ie = -1;
+         double tel_ids[H_MAX_TEL], trg_nums[H_MAX_TEL], trg_wts[H_MAX_TEL];
          for ( itel=0; itel<hsdata->run_header.ntel; itel++)
-            fill_histogram_by_ident(10002, hsdata->event.teldata[itel].tel_id, num_trg, ewt);
+         {
+            tel_ids[itel] = hsdata->event.teldata[itel].tel_id;
+            trg_nums[itel] = num_trg;
+            trg_wts[itel] = ewt;
+         }
+         fill_2d_weighted_histogram_n(get_histogram_by_ident(10002), 
+            tel_ids, trg_nums, trg_wts, (size_t) hsdata->run_header.ntel);
          if ( E_true > 0.01 )
             ie = (int)(10.*log10(E_true/0.01)/3.) + 1; /* Ten bins per three decades in energy */
          if ( ie > 15 )
@@ -3261,8 +3367,19 @@ static void user_event_fill (AllHessData *hsdata, int stage)
       fill_histogram_by_ident(10001, num_trg, 0., ewt);
       fill_histogram_by_ident(10004, num_trg, 0., 1.0);
       fill_histogram_by_ident(10003, num_trg, lg_E_true, ewt);
-      for ( itp=0; itp<ntp; itp++ )
-         fill_histogram_by_ident(10005, num_trg_type[itp], itp, ewt);
+      {
+         double ntt[sizeof(num_trg_type)/sizeof(num_trg_type[0])];
+         double tps[sizeof(num_trg_type)/sizeof(num_trg_type[0])];
+         double tp_wts[sizeof(num_trg_type)/sizeof(num_trg_type[0])];
+         for ( itp=0; itp<ntp; itp++ )
+         {
+            ntt[itp] = num_trg_type[itp];
+            tps[itp] = itp;
+            tp_wts[itp] = ewt;
+         }
+         fill_2d_weighted_histogram_n(get_histogram_by_ident(10005),
+            ntt, tps, tp_wts, (size_t) ntp);
+      }
 
       /* True core offset w.r.t. array centre */
       rs = line_point_distance(xc_true, yc_true, 0.,
@@ -3434,8 +3551,15 @@ static void user_event_fill (AllHessData *hsdata, int stage)
             init_atmprof(hsdata->mc_run_header.atmosphere);
             have_atm_set = hsdata->mc_run_header.atmosphere;
          }
-         hsdata->event.shower.xmax = thickx(hmax); /* Result is in g/cm^2 */
-         hsdata->event.shower.err_xmax = 0.5*(thickx(hmax-hmax_err)-thickx(hmax+hmax_err));
+         {
+            double hx[3], tx[3];
+            hx[0] = hmax;
+            hx[1] = hmax-hmax_err;
+            hx[2] = hmax+hmax_err;
+            thickx_n(hx,tx,3);
+            hsdata->event.shower.xmax = tx[0]; /* Result is in g/cm^2 */
+            hsdata->event.shower.err_xmax = 0.5*(tx[1]-tx[2]);
+         }
          if ( verbosity > 0 )
             printf("Xmax = %5.2f +- %4.2f g/cm^2 (Hmax = %5.1f m) from %d images\n", 
                hsdata->event.shower.xmax, hsdata->event.shower.err_xmax, hmax, n_img3);
@@ -3465,6 +3589,30 @@ static void user_event_fill (AllHessData *hsdata, int stage)
       bnt.n_tsl0 = 0;
       bnt.acceptance = 0;
 
+      /* Look up the scaled parameters for all images at once. */
+      {
+         int b_type[H_MAX_TEL], b_tel[H_MAX_TEL], nb = 0, ib;
+         double b_w[H_MAX_TEL], b_l[H_MAX_TEL], b_amp[H_MAX_TEL], b_tr[H_MAX_TEL];
+         struct img_norm_result b_res[H_MAX_TEL];
+         for (itel=0; itel<hsdata->run_header.ntel; itel++)
+         {
+            v_nrm[itel].status = -1;
+            if ( v_amp[itel] > 0. )
+            {
+               b_tel[nb]  = itel;
+               b_type[nb] = telescope_type[itel];
+               b_w[nb]    = v_w[itel];
+               b_l[nb]    = v_l[itel];
+               b_amp[nb]  = v_amp[itel];
+               b_tr[nb]   = v_tr[itel];
+               nb++;
+            }
+         }
+         img_norm_n(img_luts, nb, b_type, b_w, b_l, b_amp, b_tr, b_res);
+         for ( ib=0; ib<nb; ib++ )
+            v_nrm[b_tel[ib]] = b_res[ib];
+      }
+
       for (itel=0; itel<hsdata->run_header.ntel; itel++)
       {
          int ht = 100000 * telescope_type[itel]; // Used for histograms
@@ -3555,10 +3703,21 @@ static void user_event_fill (AllHessData *hsdata, int stage)
             }
 
             /* All cut-related parameters use reconstructed core distance. */
-            if ( img_norm(w, l, amp, lg10_amp, tr, telescope_type[itel],
-                          &scrw, &scrl, &scw, &scl, &sce, &scer,
-                          &rwol, &rwol_err, &dwol, &dwol_err) == 1 )
+            if ( v_nrm[itel].status == 1 )
             {
+               const struct img_norm_result *nrm = &v_nrm[itel];
+               scrw = nrm->scrw;
+               scrl = nrm->scrl;
+               scw  = nrm->scw;
+               scl  = nrm->scl;
+               sce  = nrm->sce;
+               scer = nrm->scer;
+               rwol = nrm->rco;
+               if ( nrm->rcor >= 0. )
+                  rwol_err = nrm->rcor;
+               dwol = nrm->dimgo;
+               if ( nrm->dimgor >= 0. )
+                  dwol_err = nrm->dimgor;
                if ( amp > up[ttyp].d.min_amp && scrw < 990 && scrl < 990 )
                {
                   double ww = 1.;//sqrt(amp); // Not intuitive but 'sqrt(amp)' performs better than 'amp'.
@@ -3608,7 +3767,10 @@ static void user_event_fill (AllHessData *hsdata, int stage)
                   tr2s += tr * ww;
                   mdisp += (1.-v_w[itel]/v_l[itel]) * ww;
                }
-               fill_histogram_by_ident(17500,scrw,scrl,ewt*sqrt(amp));
+               b_scrw[n_sr] = scrw;
+               b_scrl[n_sr] = scrl;
+               b_wt[n_sr] = ewt*sqrt(amp);
+               n_sr++;
 
                if ( verbosity > 0 )
                   printf("Image with amplitude %f p.e. at core distance %3.1f (%3.1f (%3.1f+-%3.1f)) m:\n"
@@ -3624,6 +3786,8 @@ static void user_event_fill (AllHessData *hsdata, int stage)
             }
          }
       }
+      fill_2d_weighted_histogram_n(get_histogram_by_ident(17500),
+         b_scrw, b_scrl, b_wt, n_sr);
 
       if ( n_sc > 0 && n_sc < up[0].i.min_tel_img )
       {
@@ -4507,6 +4671,8 @@ static void user_finish (AllHessData *hsdata)
          }
       }
    }
+   /* Any thread-private shadow histograms of this thread go into the masters first. */
+   merge_shadow_histograms();
    /* Example code (here auto-generating lookup tables): */
    fflush(NULL);
    fprintf(stderr,"Writing histograms to '%s'\n", hist_fname);
@@ -4566,6 +4732,8 @@ int do_user_ana (AllHessData *hsdata, unsigned long item_type, int stage)
    static int init_done = 0;
    event_selected = 0;
 
+   stage_timing_begin(STAGE_USER_ANA);
+
    switch ( item_type )
    {
       case IO_TYPE_HESS_RUNHEADER:
@@ -4625,5 +4793,7 @@ int do_user_ana (AllHessData *hsdata, unsigned long item_type, int stage)
          break; /* Everything else is ignored. */
    }
 
+   stage_timing_end(STAGE_USER_ANA);
+
    return 0;
 }
@@ -84,12 +84,15 @@ class HessioChannelIndexError(HessioError):
     pass
 
 @contextmanager
-def open_hessio(filename):
+def open_hessio(filename, sparse_adc=False):
     """
     Context manager
     Parameters
     ----------
     filename: str
+    sparse_adc: bool
+        Read ADC data in sparse mode: with zero suppression, only
+        pixels read out are reset and filled
     Yields
     ------
         HessioFile instance with file opened
@@ -97,7 +100,8 @@ def open_hessio(filename):
     ------
     HessioError: when a file is already open. Use pyhessio.close_file()
     """
-    hessfile = HessioFile(filename, enter_by_context_mng=True)
+    hessfile = HessioFile(filename, enter_by_context_mng=True,
+                          sparse_adc=sparse_adc)
     try:
         yield hessfile
     finally:
@@ -128,7 +132,8 @@ class HessioFile:
     """
     Represents a pyhessio file instance
     """
-    def __init__(self, filename=None, enter_by_context_mng=False):
+    def __init__(self, filename=None, enter_by_context_mng=False,
+                 sparse_adc=False):
         if not enter_by_context_mng:
             raise HessioError('HessioFile can be only use with'
                               ' context manager thanks to pyhessio.open'
@@ -141,6 +146,7 @@ class HessioFile:
         self.__opened_filename = None        # private
         self.lib = None
         self.init_lib()
+        self.lib.set_sparse_adc(1 if sparse_adc else 0)
         if filename:
             self.open_file(filename)
 
@@ -148,6 +154,8 @@ class HessioFile:
         lib_path = os.path.dirname(__file__)
         self.lib = np.ctypeslib.load_library('pyhessioc', lib_path)
         self.lib.close_file.restype = None
+        self.lib.set_sparse_adc.argtypes = [ctypes.c_int]
+        self.lib.set_sparse_adc.restype = None
         self.lib.file_open.argtypes = [ctypes.c_char_p]
         self.lib.file_open.restype = ctypes.c_int
         self.lib.get_adc_sample.argtypes = [ctypes.c_int, ctypes.c_int,
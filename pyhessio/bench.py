@@ -0,0 +1,77 @@
+# Licensed under a 3-clause BSD style license - see LICENSE.rst
+"""
+Timing of the per-event data access through pyhessio.
+
+The output has the same format as that of the bench_hessio program
+('name items ns/item MB/s'), such that both can be compared against
+the same baseline. Data files for it can be generated with
+'bench_hessio --keep fname'.
+
+Usage: python -m pyhessio.bench data_file [repeat]
+"""
+
+import sys
+import time
+
+from pyhessio import open_hessio
+
+
+def bench_event_access(filename, repeat=3):
+    """
+    Time reading all events and copying the ADC sums and samples
+    of all telescopes with data out of each event.
+
+    Returns
+    -------
+    list of (name, items, seconds, bytes) with the best time of all repetitions
+    """
+    best = {}
+    for _ in range(repeat):
+        t_next = t_get = 0.
+        n_events = n_tel = 0
+        n_bytes = 0
+        with open_hessio(filename) as f:
+            events = f.move_to_next_event()
+            while True:
+                t = time.perf_counter()
+                try:
+                    next(events)
+                except StopIteration:
+                    t_next += time.perf_counter() - t
+                    break
+                t_next += time.perf_counter() - t
+                n_events += 1
+                t = time.perf_counter()
+                for tel_id in f.get_teldata_list():
+                    adc_sum = f.get_adc_sum(tel_id)
+                    adc_sample = f.get_adc_sample(tel_id)
+                    n_bytes += adc_sum.nbytes + adc_sample.nbytes
+                    n_tel += 1
+                t_get += time.perf_counter() - t
+        for name, items, sec, nb in (('pyhessio.py.move_to_next_event',
+                                      n_events, t_next, 0),
+                                     ('pyhessio.py.get_adc', n_tel, t_get,
+                                      n_bytes)):
+            if name not in best or sec < best[name][2]:
+                best[name] = (name, items, sec, nb)
+    return [best[k] for k in sorted(best)]
+
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__)
+        return 1
+    repeat = int(argv[2]) if len(argv) > 2 else 3
+    print('# pyhessio.bench format 1')
+    print('# {:<30} {:>10} {:>12} {:>10}'.format('name', 'items', 'ns/item',
+                                                 'MB/s'))
+    for name, items, sec, nb in bench_event_access(argv[1], repeat):
+        ns = 1e9 * sec / items if items > 0 else 0.
+        mbs = 1e-6 * nb / sec if nb > 0 and sec > 0 else 0.
+        print('{:<32} {:>10d} {:>12.2f} {:>10.2f}'.format(name, items, ns,
+                                                          mbs))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -113,12 +113,14 @@ double get_camera_rotation_angle(int telescope_id);
 double get_optical_foclen(int telescope_id);
 int get_telescope_ids(int* list);
 int show_history(void);
+void set_sparse_adc (int on);
 
 static AllHessData *hsdata = NULL;
 static IO_ITEM_HEADER item_header;
 static IO_BUFFER *iobuf = NULL;
 static int file_is_opened = 0;
 static int showhistory = 0;
+static int sparse_adc = 0;
 #define TEL_INDEX_NOT_VALID -2
 #define PIXEL_INDEX_NOT_VALID -3
 //-----------------------------------
@@ -224,6 +226,14 @@ int move_to_next_calib_event (int *event_id){
 	}
 	return get_run_number ();
 }
+/*
+ * Read ADC data of files opened afterwards in sparse mode (on != 0),
+ * see set_adc_sparse_mode(). Only the ADC accessors of this module
+ * are aware of it, thus it is off by default.
+*/
+void set_sparse_adc (int on){
+	sparse_adc = on ? 1 : 0;
+}
 /* 
  * show how sim_telarray was run and configured
 */
@@ -540,8 +550,9 @@ int get_mc_number_photon_electron(int telescope_id, int* pe){
 			return TEL_INDEX_NOT_VALID;
 		AdcData *raw = hsdata->event.teldata[itel].raw;
 		if (raw != NULL && raw->known){	// If triggered telescopes
-			int ipix = 0.;
-			for (ipix = 0.; ipix < raw->num_pixels; ipix++){ 	//  loop over pixels
+			int ipix = 0, jpix = 0;
+			for (jpix = 0; jpix < ADC_PIX_LOOP_SIZE(raw); jpix++){ 	//  loop over (listed) pixels
+				ipix = ADC_PIX_LOOP_ID(raw,jpix);
 				if (raw->significant[ipix]){
 					 *pe++ = hsdata->mc_event.mc_pe_list[itel].pe_count[ipix];
 				}		// end if raw->significant[ipix]
@@ -696,18 +707,23 @@ double get_mc_event_ycore ()
 //
 long get_mc_num_generated_events(const char *filename)
 {
-    const long excluded[9] = {1, 2, 3, 4, 7, 11, 12, 21, 22};
+    const long wanted[1] = {6};
+    HISTOGRAM_SET hset = {NULL, 0, 0, 0};
 
-    HISTOGRAM* hist = get_histogram_by_ident(6);
-    if (hist)
-        clear_histogram(hist);  // In case it exists from a previous call!
-
-    // read histograms #6 from file, if more than one, add contents:
-    read_histogram_file_x(filename, 1, excluded, 9);
+    // Only histogram blocks are read, everything else is skipped by seeking,
+    // and only histogram #6 gets allocated. Merged files may have it in
+    // several blocks, therefore the whole file is scanned (no stop_early).
+    // The global histogram list is left alone.
+    if (read_histogram_set_file(filename, &hset, wanted, 1, 0) < 0) {
+        free_histogram_set(&hset);
+        Error("Could not read histograms to get number of generated MC events!");
+        return -1;
+    }
 
-    hist = get_histogram_by_ident(6);
+    HISTOGRAM* hist = find_in_histogram_set(&hset, 6);
 
-    if (!hist){
+    if (!hist || hist->extension == NULL || hist->extension->fdata == NULL){
+        free_histogram_set(&hset);
         Error("Could not find histogram #6 to get number of generated MC events!");
         return -1;
     }
@@ -720,6 +736,7 @@ long get_mc_num_generated_events(const char *filename)
     for (ibin = 0; ibin < hist->nbins * hist->nbins_2d; ibin++)
          numsimushowers += he->fdata[ibin];
 
+    free_histogram_set(&hset);
     return numsimushowers;
 }
 
@@ -1183,8 +1200,9 @@ int get_adc_sample (int telescope_id, int channel, uint16_t * data){
 			return TEL_INDEX_NOT_VALID;
 		AdcData *raw = hsdata->event.teldata[itel].raw;
 		if (raw != NULL && raw->known){	// If triggered telescopes
-			int ipix = 0.;
-			for (ipix = 0.; ipix < raw->num_pixels; ipix++){ 	//  loop over pixels
+			int ipix = 0, jpix = 0;
+			for (jpix = 0; jpix < ADC_PIX_LOOP_SIZE(raw); jpix++){ 	//  loop over (listed) pixels
+				ipix = ADC_PIX_LOOP_ID(raw,jpix);
 				if (raw->significant[ipix]){
 					int isamp = 0.;
 					for (isamp = 0.; isamp < raw->num_samples; isamp++){
@@ -1232,7 +1250,15 @@ int get_adc_sum (int telescope_id, int channel, uint32_t * data){
 			return TEL_INDEX_NOT_VALID;
 		AdcData *raw = hsdata->event.teldata[itel].raw;
 		if (raw != NULL && raw->known){	// If triggered telescopes
-			int ipix = 0.;
+			int ipix = 0, jpix = 0;
+			if (raw->sparse){	// only listed pixels have data
+				memset(data,0,raw->num_pixels*sizeof(data[0]));
+				for (jpix = 0; jpix < raw->num_sig; jpix++){
+					ipix = raw->sig_list[jpix];
+					data[ipix] = raw->adc_sum[channel][ipix];
+				}
+				return 0;
+			}
 			for (ipix = 0.; ipix < raw->num_pixels; ipix++){	//  loop over pixels
 				*data++ = raw->adc_sum[channel][ipix];
 			}			// end of   loop over pixels
@@ -1638,6 +1664,7 @@ int fill_hsdata (int *event_id)	//,int *header_readed)
 					exit (1);
 					}
 				(hsdata)->event.teldata[itel].raw->tel_id = tel_id;
+				set_adc_sparse_mode((hsdata)->event.teldata[itel].raw, sparse_adc);
 				if (((hsdata)->event.teldata[itel].pixtm =
 					(PixelTiming *) calloc (1, sizeof (PixelTiming))) == NULL){
 					Warning ("Not enough memory");
@@ -3,6 +3,7 @@ from setuptools import setup, Extension
 pyhessio_module = Extension(
     'pyhessio.pyhessioc',
     sources=['pyhessio/src/pyhessio.c',
+             'hessioxxx/src/argsort.c',
              'hessioxxx/src/atmprof.c',
              'hessioxxx/src/current.c',
              'hessioxxx/src/dhsort.c',